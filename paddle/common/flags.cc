@@ -1185,10 +1185,10 @@ PD_DEFINE_int32(record_pool_max_size,
                 "SlotRecordDataset slot record pool max size");
 PD_DEFINE_int32(slotpool_thread_num,
                 1,
-                "SlotRecordDataset slot pool thread num");
+                "Deprecated, the slot pool recycles records without threads");
 PD_DEFINE_bool(enable_slotpool_wait_release,  // NOLINT
                false,
-               "enable slotrecord object wait release, default false");
+               "Deprecated, the slot pool releases records synchronously");
 PD_DEFINE_bool(enable_slotrecord_reset_shrink,  // NOLINT
                false,
                "enable slotrecord object reset shrink memory, default false");
@@ -1553,6 +1553,106 @@ PHI_DEFINE_EXPORTED_bool(pir_apply_inplace_pass,
                          "Whether to apply inplace pass on lowering "
                          "::pir::Program to Kernel Dialect");
 
+/**
+ * Skip stable InferMeta in PIR executor FLAG
+ * Name: pir_skip_stable_infer_meta
+ * Since Version: 3.0.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, a phi kernel instruction whose input metas are the same as
+ * in its last run restores the output metas of that run instead of calling
+ * InferMeta again.
+ */
+PHI_DEFINE_EXPORTED_bool(pir_skip_stable_infer_meta,
+                         false,
+                         "Whether to skip InferMeta of phi kernel "
+                         "instructions whose input metas are unchanged");
+
+/**
+ * Static memory plan in PIR executor FLAG
+ * Name: pir_static_memory_plan
+ * Since Version: 3.0.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, PirInterpreter running in trace mode, e.g. for inference,
+ * binds the intermediate tensors to fixed offsets of one pre-allocated arena
+ * planned from their lifetimes and sizes, once per shape signature of the
+ * inputs, instead of allocating and freeing them in every run.
+ */
+PHI_DEFINE_EXPORTED_bool(pir_static_memory_plan,
+                         false,
+                         "Whether to plan the memory of intermediate tensors "
+                         "statically in PIR executor trace mode");
+
+/**
+ * Critical path schedule in PIR executor FLAG
+ * Name: pir_critical_path_schedule
+ * Since Version: 3.0.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, PirInterpreter running in multi-thread mode runs the ready
+ * instruction with the longest critical path first, and runs cheap successors
+ * on the worker that made them ready instead of dispatching them to another
+ * worker. Costs are measured in the first runs.
+ */
+PHI_DEFINE_EXPORTED_bool(pir_critical_path_schedule,
+                         false,
+                         "Whether to schedule instructions by critical path "
+                         "in PIR executor multi-thread mode");
+
+/**
+ * CPU thread budget in PIR executor FLAG
+ * Name: pir_cpu_thread_budget
+ * Since Version: 3.0.0
+ * Value Range: int32, default=0
+ * Example: FLAGS_pir_cpu_thread_budget=16
+ * Note: If positive, PirInterpreter on CPU runs independent instructions
+ * concurrently, in multi-thread mode even for inference, and splits this
+ * number of threads between them: the work queue gets as many threads as the
+ * widest level of the program, and every running instruction bounds its
+ * intra-op (OpenMP) threads to its share. 0 disables the budget.
+ */
+PHI_DEFINE_EXPORTED_int32(pir_cpu_thread_budget,
+                          0,
+                          "The number of CPU threads shared by inter-op and "
+                          "intra-op parallelism in PIR executor, 0 means no "
+                          "budget");
+
+/**
+ * Plan cache in PIR executor FLAG
+ * Name: pir_plan_cache_dir
+ * Since Version: 3.0.0
+ * Value Range: string, default=""
+ * Example: FLAGS_pir_plan_cache_dir=/tmp/paddle_plan_cache
+ * Note: If not empty, PirInterpreter saves the dependencies and the trace
+ * execution order it analyses to this existing directory, keyed by the hash
+ * of the program, the place and the flags they depend on, and loads them
+ * instead of analysing again when another process runs the same program.
+ */
+PHI_DEFINE_EXPORTED_string(pir_plan_cache_dir,
+                           "",
+                           "The directory of the compiled plan cache of PIR "
+                           "executor, empty means no cache");
+
+/**
+ * Captured program replay in PIR executor FLAG
+ * Name: pir_capture_cpu_program
+ * Since Version: 3.0.0
+ * Value Range: bool, default=false
+ * Example: FLAGS_pir_capture_cpu_program=true
+ * Note: If true, PirInterpreter on CPU in trace mode captures the phi kernels
+ * of a program after a run, and replays them without the per-instruction
+ * executor work (InferMeta, profiling events, GC) in later runs, until the
+ * metas of the tensors the program reads change. Intermediate tensors keep
+ * their buffers between runs. The phi kernel instructions record the InferMeta
+ * cache of pir_skip_stable_infer_meta for the capture, with or without that
+ * flag, and must be built with this flag already set.
+ */
+PHI_DEFINE_EXPORTED_bool(pir_capture_cpu_program,
+                         false,
+                         "Whether to capture and replay the phi kernels of "
+                         "CPU programs in PIR executor trace mode");
+
 PHI_DEFINE_EXPORTED_string(
     ir_inplace_kernel_blacklist,
     "",
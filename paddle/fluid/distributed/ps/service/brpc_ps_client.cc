@@ -14,6 +14,7 @@
 
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
 
+#include <chrono>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -82,6 +83,11 @@ PD_DEFINE_int32(pserver_sparse_table_shard_num,
                 1000,
                 "sparse table shard for save & load");
 
+PD_DEFINE_int32(pserver_pull_sparse_merge_window_us,
+                0,
+                "merge concurrent pull_sparse requests within the window, "
+                "0 to disable");
+
 inline size_t get_sparse_shard(uint32_t shard_num,
                                uint32_t server_num,
                                uint64_t key) {
@@ -374,6 +380,13 @@ int32_t BrpcPsClient::Initialize() {
   // _async_push_sparse_thread.detach();
   _async_push_dense_thread =
       std::thread(std::bind(&BrpcPsClient::PushDenseTaskConsume, this));
+  // 启动pull sparse请求合并线程
+  _merge_pull_sparse = FLAGS_pserver_pull_sparse_merge_window_us > 0;
+  _pull_sparse_merge_stop = false;
+  if (_merge_pull_sparse) {
+    _pull_sparse_merge_thread =
+        std::thread(std::bind(&BrpcPsClient::PullSparseMergeConsume, this));
+  }
   // for debug
   // _print_thread =
   //    std::thread(std::bind(&BrpcPsClient::PrintQueueSizeThread, this));
@@ -680,6 +693,62 @@ std::future<int32_t> BrpcPsClient::CheckSavePrePatchDone() {
   return SendCmd(-1, PS_CHECK_SAVE_PRE_PATCH_DONE, {});
 }
 
+std::future<int32_t> BrpcPsClient::PrefetchSparse(size_t table_id,
+                                                  const uint64_t *keys,
+                                                  size_t num) {
+  size_t request_call_num = _server_channels.size();
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(
+      request_call_num, [request_call_num](void *done) {
+        int ret = 0;
+        auto *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
+        for (size_t i = 0; i < request_call_num; ++i) {
+          if (closure->check_response(i, PS_PREFETCH_SPARSE_TABLE) != 0) {
+            ret = -1;
+            break;
+          }
+        }
+        closure->set_promise_value(ret);
+      });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+
+  const auto &server_param = _config.server_param().downpour_server_param();
+  uint64_t shard_num = FLAGS_pserver_sparse_table_shard_num;
+  for (int i = 0; i < server_param.downpour_table_param_size(); ++i) {
+    const auto &table_param = server_param.downpour_table_param(i);
+    if (table_param.table_id() == table_id) {
+      shard_num = table_param.shard_num();
+      break;
+    }
+  }
+  std::vector<std::vector<uint64_t>> ids(request_call_num);
+  for (size_t i = 0; i < num; ++i) {
+    ids[get_sparse_shard(shard_num, request_call_num, keys[i])].push_back(
+        keys[i]);
+  }
+
+  for (size_t shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
+    auto &kvs = ids[shard_idx];
+    size_t kv_size = kvs.size();
+    auto *request = closure->request(shard_idx);
+    request->set_cmd_id(PS_PREFETCH_SPARSE_TABLE);
+    request->set_table_id(table_id);
+    request->set_client_id(_client_id);
+    request->add_params((char *)&kv_size, sizeof(uint32_t));  // NOLINT
+    request->set_data(reinterpret_cast<const char *>(kvs.data()),
+                      kv_size * sizeof(uint64_t));
+    PsService_Stub rpc_stub(GetSparseChannel(shard_idx));
+    closure->cntl(shard_idx)->set_request_compress_type(
+        (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
+    rpc_stub.service(closure->cntl(shard_idx),
+                     request,
+                     closure->response(shard_idx),
+                     closure);
+  }
+  return fut;
+}
+
 std::future<int32_t> BrpcPsClient::Flush() {
   VLOG(0) << "BrpcPsClient::flush begin";
   _flushing = true;
@@ -726,6 +795,7 @@ void BrpcPsClient::FinalizeWorker() {
   _running = false;
   _async_push_dense_thread.join();
   _async_push_sparse_thread.join();
+  StopPullSparseMerge();
   // _print_thread.join();
   VLOG(0) << "BrpcPsClient::FinalizeWorker begin join server";
   _server.Stop(1000);
@@ -1141,6 +1211,78 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
                                               const uint64_t *keys,
                                               size_t num,
                                               bool is_training) {
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  std::future<int> fut = promise->get_future();
+  if (_merge_pull_sparse) {
+    std::lock_guard<std::mutex> lock(_pull_sparse_merge_mutex);
+    if (!_pull_sparse_merge_stop) {
+      auto &batch = _pull_sparse_batches[{table_id, is_training}];
+      batch.keys.insert(batch.keys.end(), keys, keys + num);
+      batch.select_values.insert(
+          batch.select_values.end(), select_values, select_values + num);
+      batch.promises.push_back(promise);
+      _pull_sparse_merge_cv.notify_one();
+      return fut;
+    }
+  }
+  SendPullSparse(select_values, table_id, keys, num, is_training, {promise});
+  return fut;
+}
+
+void BrpcPsClient::PullSparseMergeConsume() {
+  std::unique_lock<std::mutex> lock(_pull_sparse_merge_mutex);
+  while (true) {
+    _pull_sparse_merge_cv.wait(lock, [this] {
+      return _pull_sparse_merge_stop || !_pull_sparse_batches.empty();
+    });
+    if (!_pull_sparse_merge_stop) {
+      // wait for the requests of the other threads
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::microseconds(
+          FLAGS_pserver_pull_sparse_merge_window_us));
+      lock.lock();
+    }
+    std::map<std::pair<size_t, bool>, SparsePullBatch> batches;
+    batches.swap(_pull_sparse_batches);
+    bool stop = _pull_sparse_merge_stop;
+    lock.unlock();
+    for (auto &it : batches) {
+      auto &batch = it.second;
+      VLOG(3) << "merged " << batch.promises.size()
+              << " pull_sparse requests of table " << it.first.first << ", "
+              << batch.keys.size() << " keys";
+      SendPullSparse(batch.select_values.data(),
+                     it.first.first,
+                     batch.keys.data(),
+                     batch.keys.size(),
+                     it.first.second,
+                     batch.promises);
+    }
+    if (stop) {
+      return;
+    }
+    lock.lock();
+  }
+}
+
+void BrpcPsClient::StopPullSparseMerge() {
+  {
+    std::lock_guard<std::mutex> lock(_pull_sparse_merge_mutex);
+    _pull_sparse_merge_stop = true;
+  }
+  _pull_sparse_merge_cv.notify_all();
+  if (_pull_sparse_merge_thread.joinable()) {
+    _pull_sparse_merge_thread.join();
+  }
+}
+
+void BrpcPsClient::SendPullSparse(
+    float **select_values,
+    size_t table_id,
+    const uint64_t *keys,
+    size_t num,
+    bool is_training,
+    const std::vector<std::shared_ptr<std::promise<int32_t>>> &promises) {
   auto timer = std::make_shared<CostTimer>("pserver_client_pull_sparse");
   auto local_timer =
       std::make_shared<CostTimer>("pserver_client_pull_sparse_local");
@@ -1206,9 +1348,9 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
         closure->set_promise_value(ret);
       });
   closure->add_timer(timer);
-  auto promise = std::make_shared<std::promise<int32_t>>();
-  closure->add_promise(promise);
-  std::future<int> fut = promise->get_future();
+  for (auto promise : promises) {
+    closure->add_promise(promise);
+  }
 
   for (size_t i = 0; i < request_call_num; ++i) {
     auto &sorted_kvs = shard_sorted_kvs->at(i);
@@ -1255,11 +1397,11 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
                                       sizeof(uint32_t));
       PsService_Stub rpc_stub(GetCmdChannel(i));
       closure->cntl(i)->set_log_id(butil::gettimeofday_ms());
+      ++_pull_sparse_rpc_num;
       rpc_stub.service(
           closure->cntl(i), closure->request(i), closure->response(i), closure);
     }
   }
-  return fut;
 }
 
 // for GEO
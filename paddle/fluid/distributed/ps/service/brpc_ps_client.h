@@ -16,8 +16,12 @@
 
 #include <ThreadPool.h>
 
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "brpc/channel.h"
@@ -212,6 +216,7 @@ class BrpcPsClient : public PSClient {
     if (_async_push_sparse_thread.joinable()) {
       _async_push_sparse_thread.join();
     }
+    StopPullSparseMerge();
     if (_server_started) {
       _server.Stop(1000);
       _server.Join();
@@ -242,6 +247,9 @@ class BrpcPsClient : public PSClient {
 
   std::future<int32_t> Revert() override;
   std::future<int32_t> CheckSavePrePatchDone() override;
+  std::future<int32_t> PrefetchSparse(size_t table_id,
+                                      const uint64_t *keys,
+                                      size_t num) override;
 
   std::future<int32_t> StopServer() override;
 
@@ -267,6 +275,9 @@ class BrpcPsClient : public PSClient {
                                           const uint64_t *keys,
                                           size_t num,
                                           bool is_training);
+  // Number of pull_sparse requests sent to the servers, merged ones count
+  // once.
+  uint64_t PullSparseRpcNum() const { return _pull_sparse_rpc_num.load(); }
   virtual std::future<int32_t> PullSparseParam(float **select_values,
                                                size_t table_id,
                                                const uint64_t *keys,
@@ -367,6 +378,35 @@ class BrpcPsClient : public PSClient {
       _push_sparse_task_queue_map;
   std::unordered_map<uint32_t, uint32_t> _push_sparse_merge_count_map;
 
+  // PullSparse requests merged within pserver_pull_sparse_merge_window_us,
+  // per table and is_training. The merged keys are deduplicated per server
+  // by SendPullSparse, and the values are written to the select_values of
+  // every caller.
+  struct SparsePullBatch {
+    std::vector<uint64_t> keys;
+    std::vector<float *> select_values;
+    std::vector<std::shared_ptr<std::promise<int32_t>>> promises;
+  };
+  bool _merge_pull_sparse = false;
+  bool _pull_sparse_merge_stop = false;
+  std::map<std::pair<size_t, bool>, SparsePullBatch> _pull_sparse_batches;
+  std::mutex _pull_sparse_merge_mutex;
+  std::condition_variable _pull_sparse_merge_cv;
+  std::thread _pull_sparse_merge_thread;
+  std::atomic<uint64_t> _pull_sparse_rpc_num{0};
+
+  void PullSparseMergeConsume();
+  void StopPullSparseMerge();
+  // Sends one pull of the keys to each server, and sets the promises once
+  // the values are written to select_values.
+  void SendPullSparse(
+      float **select_values,
+      size_t table_id,
+      const uint64_t *keys,
+      size_t num,
+      bool is_training,
+      const std::vector<std::shared_ptr<std::promise<int32_t>>> &promises);
+
   std::thread _print_thread;
 
   int PushSparseAsyncShardMerge(
@@ -196,6 +196,8 @@ int32_t BrpcPsService::Initialize() {
   _service_handler_map[PS_PUSH_DENSE_TABLE] = &BrpcPsService::PushDense;
   _service_handler_map[PS_PULL_SPARSE_TABLE] = &BrpcPsService::PullSparse;
   _service_handler_map[PS_PUSH_SPARSE_TABLE] = &BrpcPsService::PushSparse;
+  _service_handler_map[PS_PREFETCH_SPARSE_TABLE] =
+      &BrpcPsService::PrefetchSparse;
   _service_handler_map[PS_SAVE_ONE_TABLE] = &BrpcPsService::SaveOneTable;
   _service_handler_map[PS_SAVE_ALL_TABLE] = &BrpcPsService::SaveAllTable;
   _service_handler_map[PS_SHRINK_TABLE] = &BrpcPsService::ShrinkTable;
@@ -596,6 +598,40 @@ int32_t BrpcPsService::PushSparse(Table *table,
   return 0;
 }
 
+int32_t BrpcPsService::PrefetchSparse(Table *table,
+                                      const PsRequestMessage &request,
+                                      PsResponseMessage &response,
+                                      brpc::Controller *cntl) {
+  platform::RecordEvent record_event(
+      "PsService->PrefetchSparse", platform::TracerEventType::Communication, 1);
+  CHECK_TABLE_EXIST(table, request, response)
+  auto &prefetch_data = request.data();
+  if (prefetch_data.empty()) {
+    return 0;
+  }
+  if (request.params_size() < 1) {
+    set_response_code(response,
+                      -1,
+                      "PsRequestMessage.params is required at "
+                      "least 1 for num of sparse_key");
+    return 0;
+  }
+  const uint32_t num =
+      *(reinterpret_cast<const uint32_t *>(request.params(0).c_str()));
+  if (prefetch_data.size() < num * sizeof(uint64_t)) {
+    set_response_code(response, -1, "prefetch sparse data is too short");
+    return 0;
+  }
+  // The table copies the keys and reads them in the background, the
+  // response does not wait for the prefetch.
+  if (table->PrefetchSparse(
+          reinterpret_cast<const uint64_t *>(prefetch_data.data()), num) !=
+      0) {
+    set_response_code(response, -1, "PrefetchSparse error");
+  }
+  return 0;
+}
+
 int32_t BrpcPsService::PrintTableStat(Table *table,
                                       const PsRequestMessage &request,
                                       PsResponseMessage &response,
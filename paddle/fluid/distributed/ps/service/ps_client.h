@@ -350,6 +350,18 @@ class PSClient {
     promise.set_value(-1);
     return fut;
   }
+
+  // Asks the servers to read the values of keys ahead of the pulls, e.g. the
+  // keys of the next pass. The future does not wait for the reads.
+  virtual std::future<int32_t> PrefetchSparse(size_t table_id UNUSED,
+                                              const uint64_t *keys UNUSED,
+                                              size_t num UNUSED) {
+    VLOG(0) << "Did not implement";
+    std::promise<int32_t> promise;
+    std::future<int> fut = promise.get_future();
+    promise.set_value(-1);
+    return fut;
+  }
   // add
   virtual std::shared_ptr<SparseShardValues> TakePassSparseReferedValues(
       const size_t &table_id UNUSED,
@@ -27,6 +27,8 @@
 namespace paddle {
 namespace distributed {
 
+class FeatureAdmissionPolicy;
+
 struct Region {
   Region() : data(NULL), size(0) {}
   Region(char* data, size_t data_num) : data(data), size(data_num) {}
@@ -136,6 +138,18 @@ class ValueAccessor {
   virtual bool CreateValue(int type UNUSED, const float* value UNUSED) {
     return true;
   }
+  // Returns whether the key pushed for the first time gets a value, see
+  // FeatureAdmissionParameter.
+  virtual bool Admit(uint64_t key UNUSED, const float* push_value UNUSED) {
+    return true;
+  }
+  virtual FeatureAdmissionPolicy* GetAdmissionPolicy() { return nullptr; }
+  // Returns whether the value can be deleted between two shrinks. Unlike
+  // Shrink it leaves the value unchanged. pressure >= 1 tightens the
+  // thresholds of the accessor when the table is above its memory target.
+  virtual bool Evict(float* value UNUSED, float pressure UNUSED) {
+    return false;
+  }
   // 从values中选取到select_values中
   virtual int32_t Select(float** select_values,
                          const float** values,
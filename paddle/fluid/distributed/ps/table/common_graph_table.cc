@@ -1777,6 +1777,7 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  csr_sampler.reset();
 }
 
 GraphShard::~GraphShard() { clear(); }
@@ -1792,6 +1793,7 @@ void GraphShard::delete_node(uint64_t id) {
   }
   node_location.erase(id);
   bucket.pop_back();
+  csr_sampler.reset();
 }
 GraphNode *GraphShard::add_graph_node(uint64_t id) {
   if (node_location.find(id) == node_location.end()) {
@@ -1837,6 +1839,30 @@ Node *GraphShard::find_node(uint64_t id) {
   return iter == node_location.end() ? nullptr : bucket[iter->second];
 }
 
+void GraphShard::build_csr_sampler(bool is_weighted) {
+  if (csr_sampler == nullptr) {
+    csr_sampler = std::make_unique<CsrNeighborSampler>();
+  }
+  csr_sampler->build(bucket, is_weighted);
+}
+
+CsrNeighborSampler *GraphShard::get_csr_sampler(uint64_t id,
+                                                bool is_weighted,
+                                                size_t *row) {
+  auto iter = node_location.find(id);
+  if (iter == node_location.end()) {
+    return nullptr;
+  }
+  *row = iter->second;
+  if (csr_sampler == nullptr ||
+      !csr_sampler->matches(*row, bucket[*row])) {
+    VLOG(1) << "rebuild the csr sampler of a shard of " << bucket.size()
+            << " nodes";
+    build_csr_sampler(is_weighted);
+  }
+  return csr_sampler.get();
+}
+
 GraphTable::~GraphTable() {  // NOLINT
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
   clear_graph();
@@ -2469,6 +2495,35 @@ int32_t GraphTable::load_nodes(const std::string &path,
 }
 
 int32_t GraphTable::build_sampler(int idx, std::string sample_type) {
+  if (sample_type == "alias" && !is_weighted_) {
+    // The random samplers draw uniformly from the edge blobs in place, which
+    // a CSR copy of the neighbors would only add memory to.
+    VLOG(0) << "edge type " << idx << " is unweighted, use random samplers";
+    sample_type = "random";
+  }
+  if (sample_type == "alias") {
+    auto &shards = edge_shards[idx];
+    std::vector<std::future<size_t>> tasks;
+    for (size_t i = 0; i < shards.size(); ++i) {
+      // Build on the thread pool that samples the shard.
+      auto &pool =
+          _shards_task_pool[get_thread_pool_index_by_shard_index(i +
+                                                                 shard_start)];
+      tasks.push_back(pool->enqueue([&shards, i, this]() -> size_t {
+        shards[i]->build_csr_sampler(is_weighted_);
+        return shards[i]->csr_sampler->memory_size();
+      }));
+    }
+    size_t memory_size = 0;
+    for (auto &task : tasks) {
+      memory_size += task.get();
+    }
+    csr_sampler_idx_.insert(idx);
+    VLOG(0) << "build csr sampler of edge type " << idx << " with "
+            << memory_size << " bytes";
+    return 0;
+  }
+  csr_sampler_idx_.erase(idx);
   for (auto &shard : edge_shards[idx]) {
     auto bucket = shard->get_bucket();
     for (auto item : bucket) {
@@ -2788,10 +2843,12 @@ int32_t GraphTable::random_sample_neighbors(
     id_list[index].emplace_back(idx, node_ids[idy], sample_size, need_weight);
   }
 
+  bool use_csr_sampler = csr_sampler_idx_.count(idx) > 0;
   for (size_t i = 0; i < seq_id.size(); i++) {
     if (seq_id[i].empty()) continue;
     tasks.push_back(_shards_task_pool[i]->enqueue([&, i, this]() -> int {
       uint64_t node_id;
+      std::vector<int> res;
       std::vector<std::pair<SampleKey, SampleResult>> r;
       LRUResponse response = LRUResponse::blocked;
       if (use_cache) {
@@ -2832,7 +2889,19 @@ int32_t GraphTable::random_sample_neighbors(
             continue;
           }
           std::shared_ptr<char> &buffer = buffers[idy];
-          std::vector<int> res = node->sample_k(sample_size, rng);
+          // A shard is only sampled by the task of its thread pool, which
+          // makes it safe to rebuild its csr sampler here.
+          CsrNeighborSampler *csr = nullptr;
+          size_t row = 0;
+          if (use_csr_sampler) {
+            csr = edge_shards[idx][node_id % shard_num - shard_start]
+                      ->get_csr_sampler(node_id, is_weighted_, &row);
+          }
+          if (csr != nullptr) {
+            csr->sample_k(row, sample_size, rng.get(), &res);
+          } else {
+            res = node->sample_k(sample_size, rng);
+          }
           actual_size =
               res.size() * (need_weight ? (Node::id_size + Node::weight_size)
                                         : Node::id_size);
@@ -2848,12 +2917,17 @@ int32_t GraphTable::random_sample_neighbors(
             buffer.reset(buffer_addr, char_del);
           }
           for (int &x : res) {
-            id = node->get_neighbor_id(x);
+            id = csr != nullptr ? csr->neighbor_id(row, x)
+                                : node->get_neighbor_id(x);
             memcpy(buffer_addr + offset, &id, Node::id_size);
             offset += Node::id_size;
             if (need_weight) {
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
-              weight = node->get_neighbor_weight(x);
+              if (csr != nullptr) {
+                weight = csr->neighbor_weight(row, x);
+              } else {
+                weight = node->get_neighbor_weight(x);
+              }
 #else
               weight = 1.0;
 #endif
@@ -41,6 +41,7 @@
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/graph/class_macro.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_sampler.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
 #include "paddle/fluid/distributed/ps/thirdparty/round_robin.h"
 #include "paddle/phi/core/utils/rw_lock.h"
@@ -132,6 +133,14 @@ class GraphShard {
   std::unordered_map<uint64_t, int> &get_node_location() {
     return node_location;
   }
+  // Builds the CSR neighbor sampler of the nodes in the bucket, see
+  // GraphTable::build_sampler.
+  void build_csr_sampler(bool is_weighted);
+  // Returns the CSR neighbor sampler, rebuilt if the node changed since it
+  // was built, or nullptr if the node is not in the shard.
+  CsrNeighborSampler *get_csr_sampler(uint64_t id,
+                                      bool is_weighted,
+                                      size_t *row);
 
   void shrink_to_fit() {
     bucket.shrink_to_fit();
@@ -158,6 +167,7 @@ class GraphShard {
  public:
   std::unordered_map<uint64_t, int> node_location;
   std::vector<Node *> bucket;
+  std::unique_ptr<CsrNeighborSampler> csr_sampler;
 };
 
 enum LRUResponse { ok = 0, blocked = 1, err = 2 };
@@ -768,6 +778,9 @@ class GraphTable : public Table {
   int next_partition;
 #endif
   virtual int32_t add_comm_edge(int idx, uint64_t src_id, uint64_t dst_id);
+  // sample_type is "random" or "weighted" for a sampler per node, or
+  // "alias" for a weighted CSR neighbor sampler per shard. "alias" only
+  // saves memory on weighted edges, and falls back to "random" otherwise.
   virtual int32_t build_sampler(int idx, std::string sample_type = "random");
   void set_slot_feature_separator(const std::string &ch);
   void set_feature_separator(const std::string &ch);
@@ -849,6 +862,8 @@ class GraphTable : public Table {
   int node_num_ = 1;
   int node_id_ = 0;
   bool is_weighted_ = false;
+  // The edge types sampled by CSR neighbor samplers.
+  std::unordered_set<int> csr_sampler_idx_;
 };
 }  // namespace distributed
 
@@ -42,6 +42,18 @@ int CtrCommonAccessor::Initialize() {
     _show_scale = true;
   }
 
+  const auto& admission_param = _config.admission_param();
+  if (!admission_param.name().empty()) {
+    auto* admission =
+        CREATE_PSCORE_CLASS(FeatureAdmissionPolicy, admission_param.name());
+    _admission.reset(admission);
+    PADDLE_ENFORCE_NOT_NULL(
+        _admission,
+        common::errors::InvalidArgument(
+            "Unknown feature admission policy %s.", admission_param.name()));
+    _admission->Initialize(admission_param);
+  }
+
   InitAccessorInfo();
   return 0;
 }
@@ -78,6 +90,17 @@ bool CtrCommonAccessor::Shrink(float* value) {
   return false;
 }
 
+bool CtrCommonAccessor::Evict(float* value, float pressure) {
+  auto delete_after_unseen_days =
+      _config.ctr_accessor_param().delete_after_unseen_days();
+  auto delete_threshold = _config.ctr_accessor_param().delete_threshold();
+  auto score = ShowClickScore(common_feature_value.Show(value),
+                              common_feature_value.Click(value));
+  auto unseen_days = common_feature_value.UnseenDays(value);
+  return score < delete_threshold * pressure ||
+         unseen_days > delete_after_unseen_days / pressure;
+}
+
 bool CtrCommonAccessor::SaveCache(float* value,
                                   int param,
                                   double global_cache_threshold) {
@@ -246,39 +269,65 @@ int32_t CtrCommonAccessor::Merge(float** update_values,
 int32_t CtrCommonAccessor::Update(float** update_values,
                                   const float** push_values,
                                   size_t num) {
+  // The sgd rules update the embeddings of all the items at once.
+  thread_local std::vector<float*> embed_w, embed_sgd, embedx_w, embedx_sgd;
+  thread_local std::vector<const float*> embed_g, embedx_g;
+  thread_local std::vector<float> scales;
+  embed_w.resize(num);
+  embed_sgd.resize(num);
+  embed_g.resize(num);
+  embedx_w.resize(num);
+  embedx_sgd.resize(num);
+  embedx_g.resize(num);
+  scales.resize(num);
   for (size_t value_item = 0; value_item < num; ++value_item) {
     float* update_value = update_values[value_item];
     const float* push_value = push_values[value_item];
-    float push_show = push_value[CtrCommonPushValue::ShowIndex()];
-    float push_click = push_value[CtrCommonPushValue::ClickIndex()];
-    float slot = push_value[CtrCommonPushValue::SlotIndex()];
-    update_value[common_feature_value.ShowIndex()] += push_show;
-    update_value[common_feature_value.ClickIndex()] += push_click;
-    update_value[common_feature_value.SlotIndex()] = slot;
-    update_value[common_feature_value.DeltaScoreIndex()] +=
-        (push_show - push_click) * _config.ctr_accessor_param().nonclk_coeff() +
-        push_click * _config.ctr_accessor_param().click_coeff();
-    update_value[common_feature_value.UnseenDaysIndex()] = 0;
-    // TODO(zhaocaibei123): add configure show_scale
-    if (!_show_scale) {
-      push_show = 1;
-    }
-    VLOG(3) << "accessor show scale:" << _show_scale
-            << ", push_show:" << push_show;
-    _embed_sgd_rule->UpdateValue(
-        update_value + common_feature_value.EmbedWIndex(),
-        update_value + common_feature_value.EmbedG2SumIndex(),
-        push_value + CtrCommonPushValue::EmbedGIndex(),
-        push_show);
-    _embedx_sgd_rule->UpdateValue(
-        update_value + common_feature_value.EmbedxWIndex(),
-        update_value + common_feature_value.EmbedxG2SumIndex(),
-        push_value + CtrCommonPushValue::EmbedxGIndex(),
-        push_show);
+    embed_w[value_item] = update_value + common_feature_value.EmbedWIndex();
+    embed_sgd[value_item] =
+        update_value + common_feature_value.EmbedG2SumIndex();
+    embed_g[value_item] = push_value + CtrCommonPushValue::EmbedGIndex();
+    embedx_w[value_item] = update_value + common_feature_value.EmbedxWIndex();
+    embedx_sgd[value_item] =
+        update_value + common_feature_value.EmbedxG2SumIndex();
+    embedx_g[value_item] = push_value + CtrCommonPushValue::EmbedxGIndex();
+    scales[value_item] = UpdateStat(update_value, push_value);
   }
+  _embed_sgd_rule->UpdateValue(
+      embed_w.data(), embed_sgd.data(), embed_g.data(), scales.data(), num);
+  _embedx_sgd_rule->UpdateValue(
+      embedx_w.data(), embedx_sgd.data(), embedx_g.data(), scales.data(), num);
   return 0;
 }
 
+float CtrCommonAccessor::UpdateStat(float* update_value,
+                                    const float* push_value) {
+  float push_show = push_value[CtrCommonPushValue::ShowIndex()];
+  float push_click = push_value[CtrCommonPushValue::ClickIndex()];
+  float slot = push_value[CtrCommonPushValue::SlotIndex()];
+  update_value[common_feature_value.ShowIndex()] += push_show;
+  update_value[common_feature_value.ClickIndex()] += push_click;
+  update_value[common_feature_value.SlotIndex()] = slot;
+  update_value[common_feature_value.DeltaScoreIndex()] +=
+      (push_show - push_click) * _config.ctr_accessor_param().nonclk_coeff() +
+      push_click * _config.ctr_accessor_param().click_coeff();
+  update_value[common_feature_value.UnseenDaysIndex()] = 0;
+  // TODO(zhaocaibei123): add configure show_scale
+  if (!_show_scale) {
+    push_show = 1;
+  }
+  VLOG(3) << "accessor show scale:" << _show_scale
+          << ", push_show:" << push_show;
+  return push_show;
+}
+
+bool CtrCommonAccessor::Admit(uint64_t key, const float* push_value) {
+  if (_admission == nullptr) {
+    return true;
+  }
+  return _admission->Admit(key, push_value[CtrCommonPushValue::ShowIndex()]);
+}
+
 bool CtrCommonAccessor::CreateValue(int stage, const float* value) {
   // stage == 0, pull
   // stage == 1, push
@@ -16,10 +16,12 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <memory>
 #include <vector>
 
 #include "paddle/fluid/distributed/common/registerer.h"
 #include "paddle/fluid/distributed/ps/table/accessor.h"
+#include "paddle/fluid/distributed/ps/table/feature_admission.h"
 #include "paddle/fluid/distributed/ps/table/sparse_sgd_rule.h"
 #include "paddle/fluid/distributed/the_one_ps.pb.h"
 
@@ -177,6 +179,15 @@ class CtrCommonAccessor : public ValueAccessor {
   std::string ParseToString(const float* value, int param) override;
   int32_t ParseFromString(const std::string& str, float* v) override;
   virtual bool CreateValue(int type, const float* value);
+  // Admits the keys by the show pushed, see FeatureAdmissionParameter.
+  bool Admit(uint64_t key, const float* push_value) override;
+  FeatureAdmissionPolicy* GetAdmissionPolicy() override {
+    return _admission.get();
+  }
+  // Evicts the values that Shrink would delete without its decay. The
+  // delete threshold is multiplied by pressure, and the unseen days after
+  // which a value is deleted are divided by it.
+  bool Evict(float* value, float pressure) override;
 
   // 这个接口目前只用来取show
   float GetField(float* value, const std::string& name) override {
@@ -187,7 +198,11 @@ class CtrCommonAccessor : public ValueAccessor {
     return 0.0;
   }
 
- private:
+ protected:
+  // Accumulates the show and click pushed into the value, and returns the
+  // scale of the gradients pushed.
+  float UpdateStat(float* value, const float* push_value);
+
   // float ShowClickScore(float show, float click);
 
   // SparseValueSGDRule* _embed_sgd_rule;
@@ -196,6 +211,7 @@ class CtrCommonAccessor : public ValueAccessor {
   float _show_click_decay_rate;
   int32_t _ssd_unseenday_threshold;
   bool _show_scale = false;
+  std::unique_ptr<FeatureAdmissionPolicy> _admission;
 
  public:  // TODO(zhaocaibei123): it should be private, but we make it public
           // for unit test
@@ -0,0 +1,376 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/ctr_low_precision_accessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "glog/logging.h"
+#include "paddle/fluid/distributed/common/local_random.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/phi/common/bfloat16.h"
+#include "paddle/phi/common/float16.h"
+#include "paddle/utils/string/string_helper.h"
+
+namespace paddle::distributed {
+
+namespace {
+
+constexpr float kInt8Max = 127.0f;
+
+// Rounds f to one of the two values of T around it, choosing each with the
+// probability of its closeness to f, so that the rounding is unbiased.
+// T is float16 or bfloat16, whose bits are sign and magnitude.
+template <typename T>
+T RoundStochastic(float f) {
+  const float max = static_cast<float>(std::numeric_limits<T>::max());
+  f = std::min(std::max(f, -max), max);
+  T nearest(f);
+  const float nearest_f = static_cast<float>(nearest);
+  if (nearest_f == f) {
+    return nearest;
+  }
+  // The neighbour of nearest on the other side of f.
+  const bool up = f > nearest_f;
+  T other = nearest;
+  if ((nearest.x & 0x7fff) == 0) {
+    other.x = up ? 0x0001 : 0x8001;
+  } else if (up == ((nearest.x & 0x8000) == 0)) {
+    ++other.x;
+  } else {
+    --other.x;
+  }
+  const float other_f = static_cast<float>(other);
+  const float p = (f - nearest_f) / (other_f - nearest_f);
+  return uniform_real<float>() < p ? other : nearest;
+}
+
+template <typename T>
+void StoreHalf(const float* w, int dim, bool stochastic, T* packed) {
+  const float max = static_cast<float>(std::numeric_limits<T>::max());
+  for (int i = 0; i < dim; ++i) {
+    packed[i] = stochastic ? RoundStochastic<T>(w[i])
+                           : T(std::min(std::max(w[i], -max), max));
+  }
+}
+
+template <typename T>
+void LoadHalf(const T* packed, int dim, float* w) {
+  for (int i = 0; i < dim; ++i) {
+    w[i] = static_cast<float>(packed[i]);
+  }
+}
+
+void StoreInt8(
+    const float* w, int dim, bool stochastic, float* scale, int8_t* packed) {
+  float max_abs = 0;
+  for (int i = 0; i < dim; ++i) {
+    max_abs = std::max(max_abs, std::fabs(w[i]));
+  }
+  *scale = max_abs > 0 ? max_abs / kInt8Max : 1.0f;
+  const float inv_scale = 1.0f / *scale;
+  for (int i = 0; i < dim; ++i) {
+    float x = w[i] * inv_scale;
+    x = stochastic ? std::floor(x + uniform_real<float>()) : std::round(x);
+    packed[i] =
+        static_cast<int8_t>(std::min(std::max(x, -kInt8Max), kInt8Max));
+  }
+}
+
+}  // namespace
+
+int CtrLowPrecisionAccessor::Initialize() {
+  const auto& storage = _config.ctr_accessor_param().embedx_storage();
+  if (storage == "fp16") {
+    _embedx_storage = EmbedxStorage::kFp16;
+  } else if (storage == "bf16") {
+    _embedx_storage = EmbedxStorage::kBf16;
+  } else if (storage == "int8") {
+    _embedx_storage = EmbedxStorage::kInt8;
+  } else {
+    PADDLE_THROW(common::errors::InvalidArgument(
+        "Unsupported embedx storage %s, expected fp16, bf16 or int8.",
+        storage));
+  }
+  return CtrCommonAccessor::Initialize();
+}
+
+void CtrLowPrecisionAccessor::InitAccessorInfo() {
+  CtrCommonAccessor::InitAccessorInfo();
+  auto& feature_value = low_precision_feature_value;
+  feature_value.embed_sgd_dim = common_feature_value.embed_sgd_dim;
+  feature_value.embedx_dim = common_feature_value.embedx_dim;
+  feature_value.embedx_sgd_dim = common_feature_value.embedx_sgd_dim;
+  bool is_int8 = _embedx_storage == EmbedxStorage::kInt8;
+  size_t embedx_bytes = feature_value.embedx_dim * (is_int8 ? 1 : 2);
+  feature_value.embedx_packed_dim =
+      (embedx_bytes + sizeof(float) - 1) / sizeof(float);
+  feature_value.embedx_scale_dim = is_int8 ? 1 : 0;
+
+  _accessor_info.dim = feature_value.Dim();
+  _accessor_info.size = feature_value.Size();
+  _accessor_info.mf_size = feature_value.embedx_dim * sizeof(float);
+}
+
+bool CtrLowPrecisionAccessor::NeedExtendMF(float* value) {
+  return low_precision_feature_value.EmbedxState(value) ==
+         kEmbedxMasterPending;
+}
+
+bool CtrLowPrecisionAccessor::HasMF(int size) {
+  return size > low_precision_feature_value.EmbedxMasterWIndex();
+}
+
+void CtrLowPrecisionAccessor::LoadEmbedx(const float* value, float* w) {
+  auto& feature_value = low_precision_feature_value;
+  const float* packed = value + feature_value.EmbedxWIndex();
+  switch (_embedx_storage) {
+    case EmbedxStorage::kFp16:
+      LoadHalf(reinterpret_cast<const phi::dtype::float16*>(packed),
+               feature_value.embedx_dim,
+               w);
+      break;
+    case EmbedxStorage::kBf16:
+      LoadHalf(reinterpret_cast<const phi::dtype::bfloat16*>(packed),
+               feature_value.embedx_dim,
+               w);
+      break;
+    case EmbedxStorage::kInt8: {
+      float scale = value[feature_value.EmbedxScaleIndex()];
+      auto* int8_packed = reinterpret_cast<const int8_t*>(packed);
+      for (int i = 0; i < feature_value.embedx_dim; ++i) {
+        w[i] = int8_packed[i] * scale;
+      }
+      break;
+    }
+  }
+}
+
+void CtrLowPrecisionAccessor::StoreEmbedx(const float* w,
+                                          bool stochastic,
+                                          float* value) {
+  auto& feature_value = low_precision_feature_value;
+  float* packed = feature_value.EmbedxW(value);
+  // Clears the padding of the last float.
+  if (feature_value.embedx_packed_dim > 0) {
+    packed[feature_value.embedx_packed_dim - 1] = 0;
+  }
+  switch (_embedx_storage) {
+    case EmbedxStorage::kFp16:
+      StoreHalf(w,
+                feature_value.embedx_dim,
+                stochastic,
+                reinterpret_cast<phi::dtype::float16*>(packed));
+      break;
+    case EmbedxStorage::kBf16:
+      StoreHalf(w,
+                feature_value.embedx_dim,
+                stochastic,
+                reinterpret_cast<phi::dtype::bfloat16*>(packed));
+      break;
+    case EmbedxStorage::kInt8:
+      StoreInt8(w,
+                feature_value.embedx_dim,
+                stochastic,
+                &feature_value.EmbedxScale(value),
+                reinterpret_cast<int8_t*>(packed));
+      break;
+  }
+}
+
+int32_t CtrLowPrecisionAccessor::Create(float** values, size_t num) {
+  auto& feature_value = low_precision_feature_value;
+  bool zero_init = _config.ctr_accessor_param().zero_init();
+  for (size_t value_item = 0; value_item < num; ++value_item) {
+    float* value = values[value_item];
+    value[common_feature_value.UnseenDaysIndex()] = 0;
+    value[common_feature_value.DeltaScoreIndex()] = 0;
+    value[common_feature_value.ShowIndex()] = 0;
+    value[common_feature_value.ClickIndex()] = 0;
+    value[common_feature_value.SlotIndex()] = -1;
+    _embed_sgd_rule->InitValue(value + common_feature_value.EmbedWIndex(),
+                               value + common_feature_value.EmbedG2SumIndex(),
+                               zero_init);
+    // The master copy is only used once the value is extended, but is
+    // initialized to keep the values deterministic.
+    float* embedx_w = feature_value.EmbedxMasterW(value);
+    _embedx_sgd_rule->InitValue(
+        embedx_w, feature_value.EmbedxG2Sum(value), false);
+    feature_value.EmbedxState(value) = kEmbedxLowPrecision;
+    StoreEmbedx(embedx_w, false, value);
+  }
+  return 0;
+}
+
+// from CtrLowPrecisionFeatureValue to CtrCommonPullValue
+int32_t CtrLowPrecisionAccessor::Select(float** select_values,
+                                        const float** values,
+                                        size_t num) {
+  auto& feature_value = low_precision_feature_value;
+  for (size_t value_item = 0; value_item < num; ++value_item) {
+    float* select_value = select_values[value_item];
+    const float* value = values[value_item];
+    select_value[CtrCommonPullValue::ShowIndex()] =
+        value[common_feature_value.ShowIndex()];
+    select_value[CtrCommonPullValue::ClickIndex()] =
+        value[common_feature_value.ClickIndex()];
+    select_value[CtrCommonPullValue::EmbedWIndex()] =
+        value[common_feature_value.EmbedWIndex()];
+    float* embedx_w = select_value + CtrCommonPullValue::EmbedxWIndex();
+    if (value[feature_value.EmbedxStateIndex()] == kEmbedxMaster) {
+      memcpy(embedx_w,
+             value + feature_value.EmbedxMasterWIndex(),
+             feature_value.embedx_dim * sizeof(float));
+    } else {
+      LoadEmbedx(value, embedx_w);
+    }
+  }
+  return 0;
+}
+
+// from CtrCommonPushValue to CtrLowPrecisionFeatureValue
+int32_t CtrLowPrecisionAccessor::Update(float** update_values,
+                                        const float** push_values,
+                                        size_t num) {
+  auto& feature_value = low_precision_feature_value;
+  const int embedx_dim = feature_value.embedx_dim;
+  thread_local std::vector<float*> embed_w, embed_sgd, embedx_w, embedx_sgd;
+  thread_local std::vector<const float*> embed_g, embedx_g;
+  thread_local std::vector<float> scales;
+  // fp32 embedx_w of the values without a master copy
+  thread_local std::vector<float> embedx_rows;
+  embed_w.resize(num);
+  embed_sgd.resize(num);
+  embed_g.resize(num);
+  embedx_w.resize(num);
+  embedx_sgd.resize(num);
+  embedx_g.resize(num);
+  scales.resize(num);
+  embedx_rows.resize(num * embedx_dim);
+  for (size_t value_item = 0; value_item < num; ++value_item) {
+    float* update_value = update_values[value_item];
+    const float* push_value = push_values[value_item];
+    float& state = feature_value.EmbedxState(update_value);
+    if (state == kEmbedxMasterPending) {
+      LoadEmbedx(update_value, feature_value.EmbedxMasterW(update_value));
+      state = kEmbedxMaster;
+    }
+    if (state == kEmbedxMaster) {
+      embedx_w[value_item] = feature_value.EmbedxMasterW(update_value);
+    } else {
+      embedx_w[value_item] = embedx_rows.data() + value_item * embedx_dim;
+      LoadEmbedx(update_value, embedx_w[value_item]);
+    }
+    embed_w[value_item] = update_value + common_feature_value.EmbedWIndex();
+    embed_sgd[value_item] =
+        update_value + common_feature_value.EmbedG2SumIndex();
+    embed_g[value_item] = push_value + CtrCommonPushValue::EmbedGIndex();
+    embedx_sgd[value_item] = feature_value.EmbedxG2Sum(update_value);
+    embedx_g[value_item] = push_value + CtrCommonPushValue::EmbedxGIndex();
+    scales[value_item] = UpdateStat(update_value, push_value);
+  }
+  _embed_sgd_rule->UpdateValue(
+      embed_w.data(), embed_sgd.data(), embed_g.data(), scales.data(), num);
+  _embedx_sgd_rule->UpdateValue(
+      embedx_w.data(), embedx_sgd.data(), embedx_g.data(), scales.data(), num);
+  for (size_t value_item = 0; value_item < num; ++value_item) {
+    float* update_value = update_values[value_item];
+    float& state = feature_value.EmbedxState(update_value);
+    if (state == kEmbedxMaster) {
+      StoreEmbedx(embedx_w[value_item], false, update_value);
+      continue;
+    }
+    StoreEmbedx(embedx_w[value_item], true, update_value);
+    if (ShowClickScore(common_feature_value.Show(update_value),
+                       common_feature_value.Click(update_value)) >=
+        _config.embedx_threshold()) {
+      state = kEmbedxMasterPending;
+    }
+  }
+  return 0;
+}
+
+std::string CtrLowPrecisionAccessor::ParseToString(const float* v,
+                                                   int param) {
+  auto& feature_value = low_precision_feature_value;
+  thread_local std::ostringstream os;
+  thread_local std::vector<float> embedx_w;
+  os.clear();
+  os.str("");
+  os << v[0] << " " << v[1] << " " << v[2] << " " << v[3] << " " << v[4] << " "
+     << v[5];
+  for (int i = feature_value.EmbedG2SumIndex();
+       i < feature_value.EmbedxStateIndex();
+       i++) {
+    os << " " << v[i];
+  }
+  embedx_w.resize(feature_value.embedx_dim);
+  if (v[feature_value.EmbedxStateIndex()] == kEmbedxMaster) {
+    memcpy(embedx_w.data(),
+           v + feature_value.EmbedxMasterWIndex(),
+           feature_value.embedx_dim * sizeof(float));
+  } else {
+    LoadEmbedx(v, embedx_w.data());
+  }
+  for (auto w : embedx_w) {
+    os << " " << w;
+  }
+  for (int i = 0; i < feature_value.embedx_sgd_dim; i++) {
+    os << " " << v[feature_value.EmbedxG2SumIndex() + i];
+  }
+  return os.str();
+}
+
+int CtrLowPrecisionAccessor::ParseFromString(const std::string& str,
+                                             float* value) {
+  auto& feature_value = low_precision_feature_value;
+  // in the layout of CtrCommonFeatureValue
+  thread_local std::vector<float> parsed;
+  parsed.resize(feature_value.Dim());
+  float* embedx_w = parsed.data() + common_feature_value.EmbedxWIndex();
+  float* embedx_g2sum =
+      parsed.data() + common_feature_value.EmbedxG2SumIndex();
+  _embedx_sgd_rule->InitValue(embedx_w, embedx_g2sum);
+  auto ret = paddle::string::str_to_float(str.data(), parsed.data());
+  PADDLE_ENFORCE_GE(
+      ret,
+      feature_value.EmbedxStateIndex(),
+      common::errors::InvalidArgument(
+          "Invalid return value. Expect more than %d. But recieved %d.",
+          feature_value.EmbedxStateIndex(),
+          ret));
+  memcpy(
+      value, parsed.data(), feature_value.EmbedxStateIndex() * sizeof(float));
+  memcpy(feature_value.EmbedxG2Sum(value),
+         embedx_g2sum,
+         feature_value.embedx_sgd_dim * sizeof(float));
+  StoreEmbedx(embedx_w, false, value);
+  if (ShowClickScore(common_feature_value.Show(value),
+                     common_feature_value.Click(value)) >=
+      _config.embedx_threshold()) {
+    memcpy(feature_value.EmbedxMasterW(value),
+           embedx_w,
+           feature_value.embedx_dim * sizeof(float));
+    feature_value.EmbedxState(value) = kEmbedxMaster;
+    return feature_value.Dim();
+  }
+  feature_value.EmbedxState(value) = kEmbedxLowPrecision;
+  return feature_value.EmbedxMasterWIndex();
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <stdint.h>
+
+#include <string>
+
+#include "paddle/fluid/distributed/ps/table/ctr_accessor.h"
+
+namespace paddle {
+namespace distributed {
+
+// CtrLowPrecisionAccessor is a CtrCommonAccessor storing embedx_w in fp16,
+// bf16 or int8 with a scale per row, see CtrAccessorParameter.embedx_storage.
+// The pull and push values are those of CtrCommonAccessor, pulls convert
+// embedx_w to fp32.
+//
+// Every key gets an embedx_w when it is created. Its updates are applied to
+// the fp32 values and rounded stochastically back to the storage type, so
+// that the updates smaller than the storage precision are kept on average.
+// Keys whose show click score reaches embedx_threshold are extended with an
+// fp32 master copy of embedx_w, which their updates are applied to, and the
+// stored embedx_w is rounded to the nearest from it. The optimizer states
+// stay in fp32 for all keys.
+//
+// With an adagrad embedx_sgd_param and embedx_dim 64 a CtrCommonAccessor
+// value takes 288 bytes, and a value here 164 bytes in fp16 or bf16, and 104
+// bytes in int8, plus 256 bytes for the keys with a master copy. Rounded to
+// the nearest, the stored embedx_w has a relative error of 2^-11 in fp16 and
+// of 2^-8 in bf16, and an absolute error of max(|embedx_w|) / 254 of its row
+// in int8. The stochastic rounding doubles these bounds.
+class CtrLowPrecisionAccessor : public CtrCommonAccessor {
+ public:
+  enum class EmbedxStorage { kFp16, kBf16, kInt8 };
+  // States of the embedx_w of a value.
+  static constexpr float kEmbedxLowPrecision = 0;
+  // The score reached embedx_threshold, and the table extended the value by
+  // a master copy, which the next update initializes.
+  static constexpr float kEmbedxMasterPending = 1;
+  static constexpr float kEmbedxMaster = 2;
+
+  struct CtrLowPrecisionFeatureValue {
+    /*
+       float slot;
+       float unseen_days;
+       float delta_score;
+       float show;
+       float click;
+       float embed_w;
+       std::vector<float> embed_g2sum;
+       float embedx_state;
+       float embedx_scale;  // int8 only
+       std::vector<float> embedx_g2sum;
+       std::vector<fp16, bf16 or int8> embedx_w;  // packed into floats
+       std::vector<float> embedx_master_w;  // only for extended values
+       */
+
+    int Dim() { return EmbedxMasterWIndex() + embedx_dim; }
+    int Size() { return Dim() * sizeof(float); }
+    int EmbedG2SumIndex() { return 6; }
+    int EmbedxStateIndex() { return EmbedG2SumIndex() + embed_sgd_dim; }
+    int EmbedxScaleIndex() { return EmbedxStateIndex() + 1; }
+    int EmbedxG2SumIndex() { return EmbedxScaleIndex() + embedx_scale_dim; }
+    int EmbedxWIndex() { return EmbedxG2SumIndex() + embedx_sgd_dim; }
+    int EmbedxMasterWIndex() { return EmbedxWIndex() + embedx_packed_dim; }
+
+    float& EmbedxState(float* val) { return val[EmbedxStateIndex()]; }
+    float& EmbedxScale(float* val) { return val[EmbedxScaleIndex()]; }
+    float* EmbedxG2Sum(float* val) { return val + EmbedxG2SumIndex(); }
+    float* EmbedxW(float* val) { return val + EmbedxWIndex(); }
+    float* EmbedxMasterW(float* val) { return val + EmbedxMasterWIndex(); }
+
+    int embed_sgd_dim;
+    int embedx_dim;
+    int embedx_sgd_dim;
+    // floats taken by the packed embedx_w
+    int embedx_packed_dim;
+    int embedx_scale_dim;
+  };
+
+  CtrLowPrecisionAccessor() {}
+  virtual ~CtrLowPrecisionAccessor() {}
+  int Initialize() override;
+  void InitAccessorInfo() override;
+  // Returns whether the update of the value promoted it to a master copy.
+  bool NeedExtendMF(float* value) override;
+  bool HasMF(int size) override;
+  int32_t Create(float** value, size_t num) override;
+  int32_t Select(float** select_values,
+                 const float** values,
+                 size_t num) override;
+  int32_t Update(float** values,
+                 const float** update_values,
+                 size_t num) override;
+  // The string of a value is that of CtrCommonAccessor with embedx_w in
+  // fp32, so that the models of the two accessors load into each other.
+  std::string ParseToString(const float* value, int param) override;
+  int32_t ParseFromString(const std::string& str, float* v) override;
+
+  // Converts the stored embedx_w of the value to fp32 in w.
+  void LoadEmbedx(const float* value, float* w);
+  // Stores w to the embedx_w of the value, rounding stochastically or to
+  // the nearest.
+  void StoreEmbedx(const float* w, bool stochastic, float* value);
+
+  EmbedxStorage embedx_storage() const { return _embedx_storage; }
+
+  CtrLowPrecisionFeatureValue low_precision_feature_value;
+
+ private:
+  EmbedxStorage _embedx_storage = EmbedxStorage::kFp16;
+};
+
+}  // namespace distributed
+}  // namespace paddle
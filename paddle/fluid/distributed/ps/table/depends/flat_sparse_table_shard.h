@@ -0,0 +1,460 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace paddle {
+namespace distributed {
+
+// FlatSparseTableShard is an alternative to SparseTableShard for tables that
+// hold hundreds of millions of feasigns. Instead of one node based hash map
+// entry plus one heap allocated std::vector per key, a value is a fixed header
+// followed by its floats, carved out of a slab of same capacity values, and
+// keys are found through an open addressing index whose slots are probed
+// sixteen at a time with one SSE2 compare over their control bytes.
+//
+// The index only stores (key, value pointer), so growing the index never moves
+// a value: a FlatFeatureValue* stays valid until its key is erased. The shard
+// is split into stripes by hash, each stripe with its own index and slabs, so
+// a rehash only touches one stripe.
+
+class FlatFeatureValue {
+ public:
+  float* data() { return reinterpret_cast<float*>(this + 1); }
+  const float* data() const { return reinterpret_cast<const float*>(this + 1); }
+  size_t size() const { return _size; }
+  size_t capacity() const { return _capacity; }
+  // Values live inline in their slab, so they can only shrink or grow back
+  // up to capacity here; FlatSparseTableShard::resize moves a value to a
+  // larger slab.
+  void resize(size_t size) {
+    CHECK_LE(size, _capacity) << "FlatFeatureValue can not grow in place";
+    _size = static_cast<uint32_t>(size);
+  }
+
+ private:
+  template <class KEY>
+  friend class FlatSparseTableShard;
+  friend class FlatValueSlab;
+
+  uint32_t _size;
+  uint32_t _capacity;
+};
+
+// Hands out FlatFeatureValue blocks of one capacity from large chunks and
+// recycles freed blocks through an intrusive free list.
+class FlatValueSlab {
+ public:
+  explicit FlatValueSlab(size_t capacity)
+      : _capacity(capacity),
+        _stride(sizeof(FlatFeatureValue) + capacity * sizeof(float)) {
+    _stride = (_stride + alignof(void*) - 1) / alignof(void*) * alignof(void*);
+    _values_per_chunk = std::max<size_t>(1, kChunkBytes / _stride);
+  }
+  FlatValueSlab(const FlatValueSlab&) = delete;
+  FlatValueSlab& operator=(const FlatValueSlab&) = delete;
+
+  size_t capacity() const { return _capacity; }
+
+  FlatFeatureValue* acquire() {
+    FlatFeatureValue* value = nullptr;
+    if (_free_list != nullptr) {
+      value = reinterpret_cast<FlatFeatureValue*>(_free_list);
+      _free_list = *reinterpret_cast<void**>(_free_list);
+    } else {
+      if (_chunks.empty() || _chunk_used == _values_per_chunk) {
+        _chunks.emplace_back(new char[_stride * _values_per_chunk]);
+        _chunk_used = 0;
+      }
+      value = reinterpret_cast<FlatFeatureValue*>(_chunks.back().get() +
+                                                  _stride * _chunk_used++);
+    }
+    value->_size = 0;
+    value->_capacity = static_cast<uint32_t>(_capacity);
+    return value;
+  }
+
+  void release(FlatFeatureValue* value) {
+    *reinterpret_cast<void**>(value) = _free_list;
+    _free_list = value;
+  }
+
+  void clear() {
+    _chunks.clear();
+    _chunk_used = 0;
+    _free_list = nullptr;
+  }
+
+ private:
+  static constexpr size_t kChunkBytes = 1 << 20;
+
+  size_t _capacity;
+  size_t _stride;
+  size_t _values_per_chunk;
+  std::vector<std::unique_ptr<char[]>> _chunks;
+  size_t _chunk_used = 0;
+  void* _free_list = nullptr;
+};
+
+template <class KEY>
+class FlatSparseTableShard {
+ public:
+  static constexpr size_t kStripeNumBits = 4;
+  static constexpr size_t kStripeNum = static_cast<size_t>(1)
+                                       << kStripeNumBits;
+  static constexpr size_t kGroupWidth = 16;
+
+ private:
+  static constexpr int8_t kEmpty = -128;  // 0b10000000
+  static constexpr int8_t kDeleted = -2;  // 0b11111110
+  static constexpr size_t kMinGroups = 1;
+
+  struct Slot {
+    KEY key;
+    FlatFeatureValue* value;
+  };
+
+  struct Stripe {
+    // ctrl has num_groups * kGroupWidth bytes, one per slot. A full slot
+    // stores the low 7 bits of its hash, so its byte is never negative.
+    std::unique_ptr<int8_t[]> ctrl;
+    std::unique_ptr<Slot[]> slots;
+    size_t num_groups = 0;
+    size_t size = 0;
+    size_t tombstones = 0;
+    std::vector<std::unique_ptr<FlatValueSlab>> slabs;
+  };
+
+ public:
+  struct iterator {
+    FlatSparseTableShard* shard;
+    size_t stripe;
+    size_t pos;
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return a.stripe == b.stripe && a.pos == b.pos;
+    }
+    friend bool operator!=(const iterator& a, const iterator& b) {
+      return !(a == b);
+    }
+    const KEY& key() const { return shard->_stripes[stripe].slots[pos].key; }
+    FlatFeatureValue& value() const {
+      return *shard->_stripes[stripe].slots[pos].value;
+    }
+    FlatFeatureValue* value_ptr() const {
+      return shard->_stripes[stripe].slots[pos].value;
+    }
+    iterator& operator++() {
+      ++pos;
+      shard->skip_to_full(&stripe, &pos);
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+  };
+
+  FlatSparseTableShard() = default;
+  explicit FlatSparseTableShard(size_t expect_size) { reserve(expect_size); }
+  FlatSparseTableShard(const FlatSparseTableShard&) = delete;
+  FlatSparseTableShard& operator=(const FlatSparseTableShard&) = delete;
+
+  bool empty() const { return size() == 0; }
+  size_t size() const {
+    size_t ret = 0;
+    for (size_t i = 0; i < kStripeNum; ++i) {
+      ret += _stripes[i].size;
+    }
+    return ret;
+  }
+  size_t bucket_count() const { return kStripeNum; }
+  size_t bucket_size(size_t stripe) const { return _stripes[stripe].size; }
+
+  // Pre-sizes every stripe for expect_size keys in total.
+  void reserve(size_t expect_size) {
+    for (size_t i = 0; i < kStripeNum; ++i) {
+      size_t need = expect_size / kStripeNum + 1;
+      if (need * 8 > _stripes[i].num_groups * kGroupWidth * 7) {
+        rehash(&_stripes[i], need);
+      }
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i < kStripeNum; ++i) {
+      Stripe& s = _stripes[i];
+      s.ctrl.reset();
+      s.slots.reset();
+      s.num_groups = 0;
+      s.size = 0;
+      s.tombstones = 0;
+      s.slabs.clear();
+    }
+  }
+
+  iterator begin() {
+    iterator it{this, 0, 0};
+    skip_to_full(&it.stripe, &it.pos);
+    return it;
+  }
+  iterator end() { return {this, kStripeNum, 0}; }
+
+  // Single owner API, same contract as SparseTableShard: the caller makes
+  // sure no other thread mutates the shard at the same time.
+  iterator find(const KEY& key) {
+    size_t hash = hash_key(key);
+    size_t stripe = compute_bucket(hash);
+    size_t pos = 0;
+    if (!find_in_stripe(_stripes[stripe], key, hash, &pos)) {
+      return end();
+    }
+    return {this, stripe, pos};
+  }
+
+  // Inserts key with a zero sized value of at least `capacity` floats. An
+  // existing value is returned unchanged.
+  std::pair<iterator, bool> emplace(const KEY& key, size_t capacity) {
+    size_t hash = hash_key(key);
+    size_t stripe = compute_bucket(hash);
+    size_t pos = 0;
+    bool inserted =
+        insert_in_stripe(&_stripes[stripe], key, hash, capacity, &pos);
+    return {{this, stripe, pos}, inserted};
+  }
+
+  // Moves the value of `it` into a slab of at least `size` floats when it
+  // does not fit in place. The old contents are kept.
+  FlatFeatureValue* resize(iterator it, size_t size) {
+    Slot& slot = _stripes[it.stripe].slots[it.pos];
+    slot.value = grow(&_stripes[it.stripe], slot.value, size);
+    return slot.value;
+  }
+
+  iterator erase(iterator it) {
+    erase_at(&_stripes[it.stripe], it.pos);
+    ++it;
+    return it;
+  }
+  void quick_erase(iterator it) { erase_at(&_stripes[it.stripe], it.pos); }
+  size_t erase(const KEY& key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    quick_erase(it);
+    return 1;
+  }
+
+  size_t compute_bucket(size_t hash) const {
+    return hash >> (sizeof(size_t) * 8 - kStripeNumBits);
+  }
+
+  static size_t hash_key(const KEY& key) {
+    // Feasigns of one shard share the same residue modulo the table shard
+    // number, so mix all bits before using them to pick a slot.
+    uint64_t h = static_cast<uint64_t>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+ private:
+  static int8_t hash_tag(size_t hash) {
+    return static_cast<int8_t>(hash & 0x7F);
+  }
+  // Group index bits sit between the tag and the stripe bits.
+  static size_t hash_group(size_t hash) { return hash >> 7; }
+
+  // Bit i is set when ctrl[i] == tag, i < kGroupWidth.
+  static uint32_t match_group(const int8_t* ctrl, int8_t tag) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      mask |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+    }
+    return mask;
+#endif
+  }
+
+  static int count_trailing_zeros(uint32_t mask) {
+    return __builtin_ctz(mask);
+  }
+
+  static bool find_in_stripe(const Stripe& s,
+                             const KEY& key,
+                             size_t hash,
+                             size_t* pos) {
+    if (s.num_groups == 0) {
+      return false;
+    }
+    const size_t group_mask = s.num_groups - 1;
+    const int8_t tag = hash_tag(hash);
+    size_t group = hash_group(hash) & group_mask;
+    for (size_t probe = 1;; ++probe) {
+      const int8_t* ctrl = s.ctrl.get() + group * kGroupWidth;
+      for (uint32_t m = match_group(ctrl, tag); m != 0; m &= m - 1) {
+        size_t i = group * kGroupWidth + count_trailing_zeros(m);
+        if (s.slots[i].key == key) {
+          *pos = i;
+          return true;
+        }
+      }
+      if (match_group(ctrl, kEmpty) != 0) {
+        return false;
+      }
+      // Triangular probing visits every group once when num_groups is a
+      // power of two.
+      group = (group + probe) & group_mask;
+    }
+  }
+
+  // Returns the first empty or deleted slot on the probe sequence of hash.
+  static size_t find_free(const Stripe& s, size_t hash) {
+    const size_t group_mask = s.num_groups - 1;
+    size_t group = hash_group(hash) & group_mask;
+    for (size_t probe = 1;; ++probe) {
+      const int8_t* ctrl = s.ctrl.get() + group * kGroupWidth;
+      uint32_t m = match_group(ctrl, kEmpty) | match_group(ctrl, kDeleted);
+      if (m != 0) {
+        return group * kGroupWidth + count_trailing_zeros(m);
+      }
+      group = (group + probe) & group_mask;
+    }
+  }
+
+  bool insert_in_stripe(Stripe* s,
+                        const KEY& key,
+                        size_t hash,
+                        size_t capacity,
+                        size_t* pos) {
+    if (find_in_stripe(*s, key, hash, pos)) {
+      return false;
+    }
+    // Keep at most 7/8 of the slots full or deleted so that every probe
+    // sequence ends on an empty slot quickly.
+    if ((s->size + s->tombstones + 1) * 8 > s->num_groups * kGroupWidth * 7) {
+      rehash(s, s->size + 1);
+    }
+    size_t i = find_free(*s, hash);
+    if (s->ctrl[i] == kDeleted) {
+      --s->tombstones;
+    }
+    s->ctrl[i] = hash_tag(hash);
+    s->slots[i].key = key;
+    s->slots[i].value = slab_for(s, capacity)->acquire();
+    ++s->size;
+    *pos = i;
+    return true;
+  }
+
+  void erase_at(Stripe* s, size_t pos) {
+    FlatFeatureValue* value = s->slots[pos].value;
+    slab_for(s, value->capacity())->release(value);
+    s->ctrl[pos] = kDeleted;
+    --s->size;
+    ++s->tombstones;
+  }
+
+  // Rebuilds the index of s for at least `need` keys, dropping tombstones.
+  // Only (key, value pointer) pairs move; values stay in their slabs.
+  void rehash(Stripe* s, size_t need) {
+    size_t num_groups = std::max(kMinGroups, s->num_groups);
+    while (need * 8 > num_groups * kGroupWidth * 7 / 2) {
+      num_groups <<= 1;
+    }
+    std::unique_ptr<int8_t[]> ctrl(new int8_t[num_groups * kGroupWidth]);
+    std::unique_ptr<Slot[]> slots(new Slot[num_groups * kGroupWidth]);
+    std::memset(ctrl.get(), kEmpty, num_groups * kGroupWidth);
+
+    std::swap(s->ctrl, ctrl);
+    std::swap(s->slots, slots);
+    size_t old_slot_num = s->num_groups * kGroupWidth;
+    s->num_groups = num_groups;
+    s->tombstones = 0;
+    for (size_t i = 0; i < old_slot_num; ++i) {
+      if (ctrl[i] < 0) {
+        continue;
+      }
+      size_t hash = hash_key(slots[i].key);
+      size_t j = find_free(*s, hash);
+      s->ctrl[j] = hash_tag(hash);
+      s->slots[j] = slots[i];
+    }
+  }
+
+  FlatValueSlab* slab_for(Stripe* s, size_t capacity) {
+    for (auto& slab : s->slabs) {
+      if (slab->capacity() == capacity) {
+        return slab.get();
+      }
+    }
+    s->slabs.emplace_back(new FlatValueSlab(capacity));
+    return s->slabs.back().get();
+  }
+
+  FlatFeatureValue* grow(Stripe* s, FlatFeatureValue* value, size_t size) {
+    if (size <= value->capacity()) {
+      value->resize(size);
+      return value;
+    }
+    FlatFeatureValue* new_value = slab_for(s, size)->acquire();
+    std::memcpy(
+        new_value->data(), value->data(), value->size() * sizeof(float));
+    new_value->_size = static_cast<uint32_t>(size);
+    slab_for(s, value->capacity())->release(value);
+    return new_value;
+  }
+
+  void skip_to_full(size_t* stripe, size_t* pos) {
+    while (*stripe < kStripeNum) {
+      const Stripe& s = _stripes[*stripe];
+      size_t slot_num = s.num_groups * kGroupWidth;
+      while (*pos < slot_num && s.ctrl[*pos] < 0) {
+        ++*pos;
+      }
+      if (*pos < slot_num) {
+        return;
+      }
+      ++*stripe;
+      *pos = 0;
+    }
+  }
+
+  Stripe _stripes[kStripeNum];
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,157 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include "glog/logging.h"
+#include "paddle/fluid/distributed/common/afs_warpper.h"
+#include "paddle/utils/string/string_helper.h"
+
+namespace paddle {
+namespace distributed {
+
+// Text shard files of the sparse tables, shared by MemorySparseTable and
+// MemoryFlatSparseTable. A line is the key and the value string of the
+// accessor converter, "<key> <value>".
+
+inline std::string TextShardFilePath(const std::string& table_path,
+                                     int shard_idx,
+                                     size_t file_idx,
+                                     bool compress) {
+  return ::paddle::string::format_string(compress ? "%s/part-%03d-%05d.gz"
+                                                  : "%s/part-%03d-%05d",
+                                         table_path.c_str(),
+                                         shard_idx,
+                                         file_idx);
+}
+
+// Reads the text shard file of channel_config, calling fn(key, value_str)
+// for every line. A failed read starts over from the first line, so fn must
+// overwrite the value of a key seen before.
+template <typename LineFn>
+void ReadTextShardFile(AfsClient* afs_client,
+                       const FsChannelConfig& channel_config,
+                       int max_retry,
+                       const std::string& table_name,
+                       LineFn&& fn) {
+  bool is_read_failed = false;
+  int retry_num = 0;
+  int err_no = 0;
+  do {
+    is_read_failed = false;
+    err_no = 0;
+    std::string line_data;
+    auto read_channel = afs_client->open_r(channel_config, 0, &err_no);
+    char* end = nullptr;
+    try {
+      while (read_channel->read_line(line_data) == 0 &&
+             line_data.size() > 1) {
+        uint64_t key = std::strtoul(line_data.data(), &end, 10);
+        fn(key, ++end);
+      }
+      read_channel->close();
+      if (err_no == -1) {
+        ++retry_num;
+        is_read_failed = true;
+        LOG(ERROR) << table_name << " load failed after read, retry it! path:"
+                   << channel_config.path << " , retry_num=" << retry_num;
+      }
+    } catch (...) {
+      ++retry_num;
+      is_read_failed = true;
+      LOG(ERROR) << table_name << " load failed, retry it! path:"
+                 << channel_config.path << " , retry_num=" << retry_num;
+    }
+    if (retry_num > max_retry) {
+      LOG(ERROR) << table_name << " load failed reach max limit!";
+      exit(-1);
+    }
+  } while (is_read_failed);
+}
+
+// Writes a text shard file to channel_config.path and returns the number of
+// lines. for_each(write) calls write(key, value_str) for every value to
+// save and stops early when it returns false. A failed write removes the
+// file and calls for_each again.
+template <typename ForEachFn>
+int64_t WriteTextShardFile(AfsClient* afs_client,
+                           const FsChannelConfig& channel_config,
+                           int max_retry,
+                           const std::string& table_name,
+                           ForEachFn&& for_each) {
+  bool is_write_failed = false;
+  int64_t feasign_size = 0;
+  int retry_num = 0;
+  int err_no = 0;
+  do {
+    err_no = 0;
+    feasign_size = 0;
+    is_write_failed = false;
+    auto write_channel =
+        afs_client->open_w(channel_config, 1024 * 1024 * 40, &err_no);
+    std::function<bool(uint64_t, const std::string&)> write =
+        [&](uint64_t key, const std::string& value) {
+          if (0 != write_channel->write_line(::paddle::string::format_string(
+                       "%lu %s", key, value.c_str()))) {
+            ++retry_num;
+            is_write_failed = true;
+            LOG(ERROR) << table_name << " save prefix failed, retry it! path:"
+                       << channel_config.path << " , retry_num=" << retry_num;
+            return false;
+          }
+          ++feasign_size;
+          return true;
+        };
+    for_each(write);
+    write_channel->close();
+    if (err_no == -1) {
+      ++retry_num;
+      is_write_failed = true;
+      LOG(ERROR) << table_name << " save prefix failed after write, retry it! "
+                 << "path:" << channel_config.path
+                 << " , retry_num=" << retry_num;
+    }
+    if (is_write_failed) {
+      afs_client->remove(channel_config.path);
+    }
+    if (retry_num > max_retry) {
+      LOG(ERROR) << table_name << " save prefix failed reach max limit!";
+      exit(-1);
+    }
+  } while (is_write_failed);
+  return feasign_size;
+}
+
+// Erases the values of shard the accessor shrinks and returns their number.
+template <typename Shard, typename Accessor>
+int64_t ShrinkShard(Accessor* accessor, Shard* shard) {
+  int64_t feasign_size = 0;
+  for (auto it = shard->begin(); it != shard->end();) {
+    if (accessor->Shrink(it.value().data())) {
+      it = shard->erase(it);
+      ++feasign_size;
+    } else {
+      ++it;
+    }
+  }
+  return feasign_size;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,288 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+struct SSDValueCacheStat {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t hit_bytes = 0;
+  uint64_t admits = 0;
+  uint64_t rejects = 0;
+  uint64_t evicts = 0;
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+
+  SSDValueCacheStat& operator+=(const SSDValueCacheStat& other) {
+    hits += other.hits;
+    misses += other.misses;
+    hit_bytes += other.hit_bytes;
+    admits += other.admits;
+    rejects += other.rejects;
+    evicts += other.evicts;
+    entries += other.entries;
+    bytes += other.bytes;
+    return *this;
+  }
+};
+
+// SSDValueCache keeps serialized feature values of keys that were moved from
+// the memory shard of SSDSparseTable to RocksDB, so that pulling them back
+// does not read the SSD. It is a write-through copy: every cached key is also
+// in RocksDB, and a key leaves the cache when it goes back to memory.
+//
+// Replacement is CLOCK. Admission is TinyLFU: a count-min sketch of 4 bit
+// counters estimates how often each key was looked up recently, and a new
+// value only replaces the CLOCK victim when its key is more frequent. The
+// sketch is halved periodically so that old popularity fades out.
+class SSDValueCache {
+ public:
+  explicit SSDValueCache(size_t capacity_bytes)
+      : _capacity_bytes(capacity_bytes) {
+    // About one counter per 64 cached bytes, at least 4096 per row.
+    size_t width = 4096;
+    while (width * 64 < capacity_bytes && width < (1UL << 24)) {
+      width <<= 1;
+    }
+    _sketch_mask = width - 1;
+    _sketch.assign(kSketchDepth * width, 0);
+    _sample_limit = width * 10;
+  }
+
+  // Moves the value of key out of the cache. Every call, hit or miss,
+  // counts as one access for admission.
+  bool Take(uint64_t key, std::string* value) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    RecordAccess(key);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      ++_stat.misses;
+      return false;
+    }
+    Entry& entry = _entries[it->second];
+    ++_stat.hits;
+    _stat.hit_bytes += entry.value.size();
+    _stat.bytes -= entry.value.size();
+    // the entry gets an empty string, which RemoveAt accounts for
+    value->clear();
+    value->swap(entry.value);
+    RemoveAt(it->second);
+    _index.erase(it);
+    return true;
+  }
+
+  bool Contains(uint64_t key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _index.count(key) > 0;
+  }
+
+  // Inserts or refreshes the value of key. When the cache is full the value
+  // is admitted only if its key is accessed more often than the victim's,
+  // unless force is set, e.g. for keys known to be pulled soon.
+  bool Put(uint64_t key, const char* data, size_t len, bool force = false) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      return RefreshAt(it->second, data, len);
+    }
+    if (len > _capacity_bytes) {
+      ++_stat.rejects;
+      return false;
+    }
+    if (_stat.bytes + len > _capacity_bytes && !force) {
+      size_t victim = NextVictim();
+      if (Frequency(key) <= Frequency(_entries[victim].key)) {
+        ++_stat.rejects;
+        return false;
+      }
+    }
+    EvictToFit(len);
+    size_t pos = 0;
+    if (!_free_slots.empty()) {
+      pos = _free_slots.back();
+      _free_slots.pop_back();
+    } else {
+      pos = _entries.size();
+      _entries.emplace_back();
+    }
+    Entry& entry = _entries[pos];
+    entry.key = key;
+    entry.value.assign(data, len);
+    entry.referenced = false;
+    entry.used = true;
+    _index[key] = pos;
+    ++_stat.admits;
+    ++_stat.entries;
+    _stat.bytes += len;
+    return true;
+  }
+
+  // Refreshes the value of key when it is cached, e.g. after the value on
+  // SSD changed, and returns whether it is still cached.
+  bool Update(uint64_t key, const char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return false;
+    }
+    return RefreshAt(it->second, data, len);
+  }
+
+  void Erase(uint64_t key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return;
+    }
+    RemoveAt(it->second);
+    _index.erase(it);
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _free_slots.clear();
+    _index.clear();
+    _hand = 0;
+    _stat.entries = 0;
+    _stat.bytes = 0;
+  }
+
+  SSDValueCacheStat GetStat() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stat;
+  }
+
+ private:
+  static constexpr size_t kSketchDepth = 4;
+  static constexpr uint8_t kMaxCount = 15;
+
+  struct Entry {
+    uint64_t key = 0;
+    std::string value;
+    bool referenced = false;
+    bool used = false;
+  };
+
+  size_t SketchIndex(uint64_t key, size_t row) const {
+    uint64_t h = (key + row) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 29;
+    return row * (_sketch_mask + 1) + (h & _sketch_mask);
+  }
+
+  void RecordAccess(uint64_t key) {
+    for (size_t row = 0; row < kSketchDepth; ++row) {
+      uint8_t& count = _sketch[SketchIndex(key, row)];
+      if (count < kMaxCount) {
+        ++count;
+      }
+    }
+    if (++_samples >= _sample_limit) {
+      for (auto& count : _sketch) {
+        count >>= 1;
+      }
+      _samples /= 2;
+    }
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      _entries[it->second].referenced = true;
+    }
+  }
+
+  uint8_t Frequency(uint64_t key) const {
+    uint8_t freq = kMaxCount;
+    for (size_t row = 0; row < kSketchDepth; ++row) {
+      freq = std::min(freq, _sketch[SketchIndex(key, row)]);
+    }
+    return freq;
+  }
+
+  // Advances the CLOCK hand to the first entry not referenced since the hand
+  // last passed it, clearing reference bits on the way. The cache must not
+  // be empty.
+  size_t NextVictim() {
+    while (true) {
+      if (_hand >= _entries.size()) {
+        _hand = 0;
+      }
+      Entry& entry = _entries[_hand];
+      if (entry.used) {
+        if (!entry.referenced) {
+          return _hand;
+        }
+        entry.referenced = false;
+      }
+      ++_hand;
+    }
+  }
+
+  void EvictToFit(size_t len) {
+    while (_stat.entries > 0 && _stat.bytes + len > _capacity_bytes) {
+      size_t victim = NextVictim();
+      _index.erase(_entries[victim].key);
+      RemoveAt(victim);
+      ++_stat.evicts;
+    }
+  }
+
+  bool RefreshAt(size_t pos, const char* data, size_t len) {
+    Entry& entry = _entries[pos];
+    uint64_t key = entry.key;
+    _stat.bytes -= entry.value.size();
+    entry.value.assign(data, len);
+    entry.referenced = true;
+    _stat.bytes += len;
+    EvictToFit(0);
+    return _index.count(key) > 0;
+  }
+
+  void RemoveAt(size_t pos) {
+    Entry& entry = _entries[pos];
+    _stat.bytes -= entry.value.size();
+    --_stat.entries;
+    std::string().swap(entry.value);
+    entry.used = false;
+    entry.referenced = false;
+    _free_slots.push_back(pos);
+  }
+
+  size_t _capacity_bytes;
+  std::vector<Entry> _entries;
+  std::vector<size_t> _free_slots;
+  std::unordered_map<uint64_t, size_t> _index;
+  size_t _hand = 0;
+
+  std::vector<uint8_t> _sketch;
+  size_t _sketch_mask;
+  size_t _samples = 0;
+  size_t _sample_limit;
+
+  SSDValueCacheStat _stat;
+  std::mutex _mutex;
+};
+
+}  // namespace distributed
+}  // namespace paddle
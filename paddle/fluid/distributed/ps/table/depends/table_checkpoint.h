@@ -0,0 +1,356 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "paddle/common/enforce.h"
+#include "paddle/fluid/distributed/common/afs_warpper.h"
+
+namespace paddle {
+namespace distributed {
+
+// Binary checkpoint files of tables.
+//
+// A file is a 24 byte header followed by chunks. Each chunk is a 16 byte
+// chunk header and the stored bytes, which are the raw records compressed
+// by the codec of the file, and carries the CRC32 of its stored bytes. The
+// file ends with an empty chunk, so a truncated file is detected.
+//
+// A record is a uint64_t key, a uint32_t value count and the float values;
+// records never span chunks, so chunks can be decoded independently.
+enum class CheckpointCodec : uint32_t { kNone = 0, kZlib = 1 };
+
+constexpr char kCheckpointMagic[8] = {'P', 'D', 'C', 'K', 'P', 'T', 0, 0};
+constexpr uint32_t kCheckpointVersion = 1;
+constexpr const char* kCheckpointSuffix = ".bin";
+
+inline bool IsCheckpointFile(const std::string& path) {
+  size_t len = strlen(kCheckpointSuffix);
+  return path.size() >= len &&
+         path.compare(path.size() - len, len, kCheckpointSuffix) == 0;
+}
+
+// Codecs available in this build are "none" and "zlib".
+inline CheckpointCodec ParseCheckpointCodec(const std::string& name) {
+  if (name == "none" || name.empty()) {
+    return CheckpointCodec::kNone;
+  } else if (name == "zlib") {
+    return CheckpointCodec::kZlib;
+  }
+  PADDLE_THROW(common::errors::InvalidArgument(
+      "Unknown checkpoint codec %s, expected none or zlib.", name));
+}
+
+// Returns the chunk size of FLAGS_pserver_checkpoint_chunk_size, which is
+// an int32 flag.
+inline uint32_t ParseCheckpointChunkSize(int32_t chunk_size) {
+  PADDLE_ENFORCE_GT(chunk_size,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The checkpoint chunk size should be positive, but "
+                        "received %d.",
+                        chunk_size));
+  return static_cast<uint32_t>(chunk_size);
+}
+
+struct CheckpointFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t codec;
+  uint32_t chunk_size;
+  uint32_t reserved;
+};
+
+struct CheckpointChunkHeader {
+  uint32_t raw_size;
+  uint32_t stored_size;
+  uint32_t record_num;
+  uint32_t crc;
+};
+
+class CheckpointWriter {
+ public:
+  CheckpointWriter(FsWriteChannel* channel,
+                   CheckpointCodec codec,
+                   uint32_t chunk_size)
+      : _channel(channel), _codec(codec), _chunk_size(chunk_size) {
+    _buffer.reserve(chunk_size);
+  }
+
+  // All methods return 0 on success and -1 on a write error.
+  int WriteHeader() {
+    CheckpointFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+    header.version = kCheckpointVersion;
+    header.codec = static_cast<uint32_t>(_codec);
+    header.chunk_size = _chunk_size;
+    return Write(&header, sizeof(header));
+  }
+
+  int Append(uint64_t key, const float* values, uint32_t num) {
+    size_t record_size =
+        sizeof(key) + sizeof(num) + static_cast<size_t>(num) * sizeof(float);
+    if (!_buffer.empty() && _buffer.size() + record_size > _chunk_size) {
+      if (FlushChunk() != 0) {
+        return -1;
+      }
+    }
+    _buffer.append(reinterpret_cast<const char*>(&key), sizeof(key));
+    _buffer.append(reinterpret_cast<const char*>(&num), sizeof(num));
+    _buffer.append(reinterpret_cast<const char*>(values), num * sizeof(float));
+    ++_record_num;
+    return 0;
+  }
+
+  // Flushes the last chunk and writes the end mark.
+  int Finish() {
+    if (!_buffer.empty() && FlushChunk() != 0) {
+      return -1;
+    }
+    CheckpointChunkHeader end;
+    memset(&end, 0, sizeof(end));
+    return Write(&end, sizeof(end));
+  }
+
+ private:
+  int FlushChunk() {
+    CheckpointChunkHeader chunk;
+    chunk.raw_size = static_cast<uint32_t>(_buffer.size());
+    chunk.record_num = _record_num;
+    const std::string* stored = &_buffer;
+    if (_codec == CheckpointCodec::kZlib) {
+      uLongf stored_size = compressBound(_buffer.size());
+      _compressed.resize(stored_size);
+      if (compress2(reinterpret_cast<Bytef*>(&_compressed[0]),
+                    &stored_size,
+                    reinterpret_cast<const Bytef*>(_buffer.data()),
+                    _buffer.size(),
+                    Z_BEST_SPEED) != Z_OK) {
+        return -1;
+      }
+      _compressed.resize(stored_size);
+      stored = &_compressed;
+    }
+    chunk.stored_size = static_cast<uint32_t>(stored->size());
+    chunk.crc = crc32(0L,
+                      reinterpret_cast<const Bytef*>(stored->data()),
+                      stored->size());
+    if (Write(&chunk, sizeof(chunk)) != 0 ||
+        Write(stored->data(), stored->size()) != 0) {
+      return -1;
+    }
+    _buffer.clear();
+    _record_num = 0;
+    return 0;
+  }
+
+  int Write(const void* data, size_t size) {
+    return _channel->write(static_cast<const char*>(data), size) == 0 ? 0
+                                                                        : -1;
+  }
+
+  FsWriteChannel* _channel;
+  CheckpointCodec _codec;
+  uint32_t _chunk_size;
+  uint32_t _record_num = 0;
+  std::string _buffer;
+  std::string _compressed;
+};
+
+class CheckpointReader {
+ public:
+  explicit CheckpointReader(FsReadChannel* channel) : _channel(channel) {}
+
+  // Returns 0 on success and -1 when the file is not a checkpoint file of a
+  // known version.
+  int ReadHeader() {
+    CheckpointFileHeader header;
+    if (!Read(&header, sizeof(header)) ||
+        memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0 ||
+        header.version > kCheckpointVersion ||
+        header.codec > static_cast<uint32_t>(CheckpointCodec::kZlib)) {
+      return -1;
+    }
+    _codec = static_cast<CheckpointCodec>(header.codec);
+    return 0;
+  }
+
+  // Returns 1 and points values into an internal buffer, valid until the
+  // next call, when a record is read; 0 at the end of the file; and -1 when
+  // the file is truncated or a chunk fails its CRC.
+  int Next(uint64_t* key, const float** values, uint32_t* num) {
+    while (_pos >= _raw.size()) {
+      int ret = ReadChunk();
+      if (ret <= 0) {
+        return ret;
+      }
+    }
+    if (_raw.size() - _pos < sizeof(*key) + sizeof(*num)) {
+      return -1;
+    }
+    memcpy(key, _raw.data() + _pos, sizeof(*key));
+    memcpy(num, _raw.data() + _pos + sizeof(*key), sizeof(*num));
+    _pos += sizeof(*key) + sizeof(*num);
+    size_t bytes = static_cast<size_t>(*num) * sizeof(float);
+    if (_raw.size() - _pos < bytes) {
+      return -1;
+    }
+    _values.resize(*num);
+    memcpy(_values.data(), _raw.data() + _pos, bytes);
+    _pos += bytes;
+    *values = _values.data();
+    return 1;
+  }
+
+ private:
+  int ReadChunk() {
+    CheckpointChunkHeader chunk;
+    if (!Read(&chunk, sizeof(chunk))) {
+      return -1;
+    }
+    if (chunk.raw_size == 0) {
+      return 0;
+    }
+    _stored.resize(chunk.stored_size);
+    if (!Read(&_stored[0], chunk.stored_size) ||
+        crc32(0L,
+              reinterpret_cast<const Bytef*>(_stored.data()),
+              _stored.size()) != chunk.crc) {
+      return -1;
+    }
+    if (_codec == CheckpointCodec::kZlib) {
+      _raw.resize(chunk.raw_size);
+      uLongf raw_size = chunk.raw_size;
+      if (uncompress(reinterpret_cast<Bytef*>(&_raw[0]),
+                     &raw_size,
+                     reinterpret_cast<const Bytef*>(_stored.data()),
+                     _stored.size()) != Z_OK ||
+          raw_size != chunk.raw_size) {
+        return -1;
+      }
+    } else {
+      if (chunk.stored_size != chunk.raw_size) {
+        return -1;
+      }
+      _raw.swap(_stored);
+    }
+    _pos = 0;
+    return 1;
+  }
+
+  bool Read(void* data, size_t size) {
+    return size == 0 ||
+           _channel->read(static_cast<char*>(data), size) ==
+               static_cast<int>(size);
+  }
+
+  FsReadChannel* _channel;
+  CheckpointCodec _codec = CheckpointCodec::kNone;
+  std::string _stored;
+  std::string _raw;
+  size_t _pos = 0;
+  std::vector<float> _values;
+};
+
+// Writes path as a binary checkpoint, retrying from scratch on failure like
+// the text format does. append(writer) appends the records and returns how
+// many were appended, or -1 on a write error.
+template <typename AppendFn>
+int64_t WriteCheckpointFile(AfsClient* afs_client,
+                            const std::string& path,
+                            CheckpointCodec codec,
+                            uint32_t chunk_size,
+                            int max_retry,
+                            AppendFn&& append) {
+  FsChannelConfig channel_config;
+  channel_config.path = path;
+  int retry_num = 0;
+  while (true) {
+    int err_no = 0;
+    auto write_channel =
+        afs_client->open_w(channel_config, 1024 * 1024 * 40, &err_no);
+    CheckpointWriter writer(write_channel.get(), codec, chunk_size);
+    int64_t record_num = -1;
+    if (writer.WriteHeader() == 0) {
+      record_num = append(&writer);
+      if (record_num >= 0 && writer.Finish() != 0) {
+        record_num = -1;
+      }
+    }
+    write_channel->close();
+    if (record_num >= 0 && err_no != -1) {
+      return record_num;
+    }
+    ++retry_num;
+    LOG(ERROR) << "save checkpoint failed, retry it! path:" << path
+               << " , retry_num=" << retry_num;
+    afs_client->remove(path);
+    if (retry_num > max_retry) {
+      LOG(ERROR) << "save checkpoint failed reach max limit!";
+      exit(-1);
+    }
+  }
+}
+
+// Reads the binary checkpoint at path, calling fn(key, values, num) for
+// every record, and returns the number of records. A damaged or partially
+// read file is read again from the beginning.
+template <typename RecordFn>
+int64_t ReadCheckpointFile(AfsClient* afs_client,
+                           const std::string& path,
+                           int max_retry,
+                           RecordFn&& fn) {
+  FsChannelConfig channel_config;
+  channel_config.path = path;
+  int retry_num = 0;
+  while (true) {
+    int err_no = 0;
+    auto read_channel = afs_client->open_r(channel_config, 0, &err_no);
+    CheckpointReader reader(read_channel.get());
+    int64_t record_num = 0;
+    int ret = reader.ReadHeader();
+    if (ret == 0) {
+      uint64_t key = 0;
+      const float* values = nullptr;
+      uint32_t num = 0;
+      while ((ret = reader.Next(&key, &values, &num)) > 0) {
+        fn(key, values, num);
+        ++record_num;
+      }
+    }
+    read_channel->close();
+    if (ret == 0 && err_no != -1) {
+      return record_num;
+    }
+    ++retry_num;
+    LOG(ERROR) << "load checkpoint failed, retry it! path:" << path
+               << " , retry_num=" << retry_num;
+    if (retry_num > max_retry) {
+      LOG(ERROR) << "load checkpoint failed reach max limit!";
+      exit(-1);
+    }
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,119 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/feature_admission.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "glog/logging.h"
+
+namespace paddle::distributed {
+
+void FeatureAdmissionPolicy::Initialize(
+    const FeatureAdmissionParameter &param) {
+  _name = param.name();
+  _threshold = param.threshold();
+  _width = std::max<uint32_t>(param.width(), 1);
+  _depth = std::max<uint32_t>(param.depth(), 1);
+  _decay_interval = param.decay_interval();
+}
+
+size_t FeatureAdmissionPolicy::Hash(uint64_t key, uint32_t i, size_t size) {
+  // splitmix64 of the key and the index of the hash.
+  uint64_t x = key + (i + 1) * 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x = x ^ (x >> 31);
+  return x % size;
+}
+
+void CountMinSketchAdmission::Initialize(
+    const FeatureAdmissionParameter &param) {
+  FeatureAdmissionPolicy::Initialize(param);
+  _counter_num = static_cast<size_t>(_width) * _depth;
+  _counters.reset(new std::atomic<uint32_t>[_counter_num]);
+  for (size_t i = 0; i < _counter_num; ++i) {
+    _counters[i].store(0, std::memory_order_relaxed);
+  }
+  VLOG(0) << "CountMinSketchAdmission threshold: " << _threshold
+          << ", sketch: " << _depth << " x " << _width;
+}
+
+uint32_t CountMinSketchAdmission::Estimate(uint64_t key) {
+  uint32_t count = std::numeric_limits<uint32_t>::max();
+  for (uint32_t i = 0; i < _depth; ++i) {
+    auto &counter = _counters[i * _width + Hash(key, i, _width)];
+    count = std::min(count, counter.load(std::memory_order_relaxed));
+  }
+  return count;
+}
+
+bool CountMinSketchAdmission::AdmitWork(uint64_t key, float show) {
+  size_t begin = 0, end = 0;
+  if (NextDecayRange(_counter_num, &begin, &end)) {
+    // Racing updates may be lost, which only makes the estimates smaller.
+    for (size_t i = begin; i < end; ++i) {
+      _counters[i].store(_counters[i].load(std::memory_order_relaxed) / 2,
+                         std::memory_order_relaxed);
+    }
+  }
+  uint32_t add = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(
+                                           std::max(show, 0.0f))));
+  uint32_t count = Estimate(key);
+  uint32_t target = count > std::numeric_limits<uint32_t>::max() - add
+                        ? std::numeric_limits<uint32_t>::max()
+                        : count + add;
+  // Conservative update: only the counters below the new estimate grow.
+  for (uint32_t i = 0; i < _depth; ++i) {
+    auto &counter = _counters[i * _width + Hash(key, i, _width)];
+    uint32_t old = counter.load(std::memory_order_relaxed);
+    while (old < target && !counter.compare_exchange_weak(
+                               old, target, std::memory_order_relaxed)) {
+    }
+  }
+  return target >= _threshold;
+}
+
+void BloomFilterAdmission::Initialize(const FeatureAdmissionParameter &param) {
+  FeatureAdmissionPolicy::Initialize(param);
+  _word_num = (static_cast<size_t>(_width) + 63) / 64;
+  _bits.reset(new std::atomic<uint64_t>[_word_num]);
+  for (size_t i = 0; i < _word_num; ++i) {
+    _bits[i].store(0, std::memory_order_relaxed);
+  }
+  VLOG(0) << "BloomFilterAdmission filter: " << _word_num * 64 << " bits, "
+          << _depth << " hashes";
+}
+
+bool BloomFilterAdmission::AdmitWork(uint64_t key, float show) {
+  size_t begin = 0, end = 0;
+  if (NextDecayRange(_word_num, &begin, &end)) {
+    for (size_t i = begin; i < end; ++i) {
+      _bits[i].store(0, std::memory_order_relaxed);
+    }
+  }
+  bool seen = true;
+  for (uint32_t i = 0; i < _depth; ++i) {
+    size_t bit = Hash(key, i, _word_num * 64);
+    uint64_t mask = 1ULL << (bit % 64);
+    uint64_t old =
+        _bits[bit / 64].fetch_or(mask, std::memory_order_relaxed);
+    seen = seen && (old & mask) != 0;
+  }
+  return seen;
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "paddle/fluid/distributed/common/registerer.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+
+namespace paddle {
+namespace distributed {
+
+// FeatureAdmissionPolicy decides whether a key pushed for the first time gets
+// a value in a sparse table, so that the keys seen only once or twice never
+// take the memory of a full value. The pushes of the rejected keys are
+// dropped, and their pulls return zeros.
+//
+// Admit is called concurrently by the shard threads of the table.
+class FeatureAdmissionPolicy {
+ public:
+  FeatureAdmissionPolicy() {}
+  virtual ~FeatureAdmissionPolicy() {}
+  virtual void Initialize(const FeatureAdmissionParameter& param);
+  // Records a push of the key with the given show, and returns whether the
+  // key is admitted.
+  bool Admit(uint64_t key, float show) {
+    bool admitted = AdmitWork(key, show);
+    (admitted ? _admitted_num : _rejected_num)
+        .fetch_add(1, std::memory_order_relaxed);
+    return admitted;
+  }
+  virtual bool AdmitWork(uint64_t key, float show) = 0;
+  // Returns the memory of the policy in bytes.
+  virtual size_t MemorySize() = 0;
+
+  const std::string& GetName() const { return _name; }
+  uint64_t AdmittedNum() const { return _admitted_num.load(); }
+  uint64_t RejectedNum() const { return _rejected_num.load(); }
+
+ protected:
+  // Returns the i-th hash of the key for a table of the given size.
+  static size_t Hash(uint64_t key, uint32_t i, size_t size);
+  // Sets [begin, end) to the slots of the size slots of the policy that the
+  // caller should decay, and returns whether there are any. The decay is
+  // spread over the checks, so that every slot is decayed once in every
+  // decay_interval checks and no check pays for the whole policy.
+  bool NextDecayRange(size_t size, size_t* begin, size_t* end) {
+    if (_decay_interval == 0) {
+      return false;
+    }
+    uint64_t step = _check_num.fetch_add(1, std::memory_order_relaxed) %
+                    _decay_interval;
+    size_t slice = (size + _decay_interval - 1) / _decay_interval;
+    if (step >= (size + slice - 1) / slice) {
+      return false;
+    }
+    *begin = step * slice;
+    *end = std::min(*begin + slice, size);
+    return true;
+  }
+
+  float _threshold;
+  uint32_t _width;
+  uint32_t _depth;
+  uint64_t _decay_interval;
+
+ private:
+  std::string _name;
+  std::atomic<uint64_t> _check_num{0};
+  std::atomic<uint64_t> _admitted_num{0};
+  std::atomic<uint64_t> _rejected_num{0};
+};
+
+REGISTER_PSCORE_REGISTERER(FeatureAdmissionPolicy);
+
+// Admits a key once the shows counted for it reach the threshold. The shows
+// are counted in a count-min sketch of depth rows of width counters, with
+// conservative updates, and every counter is halved once in decay_interval
+// checks so that the keys have to be seen recently.
+class CountMinSketchAdmission : public FeatureAdmissionPolicy {
+ public:
+  void Initialize(const FeatureAdmissionParameter& param) override;
+  bool AdmitWork(uint64_t key, float show) override;
+  size_t MemorySize() override { return _counter_num * sizeof(uint32_t); }
+  // Returns the shows counted for the key, an upper bound of the real ones.
+  uint32_t Estimate(uint64_t key);
+
+ private:
+  size_t _counter_num;
+  std::unique_ptr<std::atomic<uint32_t>[]> _counters;
+};
+
+// Admits a key the second time it is seen: the first time it is only added
+// to a bloom filter of width bits and depth hashes. Every word of the filter
+// is cleared once in decay_interval checks.
+class BloomFilterAdmission : public FeatureAdmissionPolicy {
+ public:
+  void Initialize(const FeatureAdmissionParameter& param) override;
+  bool AdmitWork(uint64_t key, float show) override;
+  size_t MemorySize() override { return _word_num * sizeof(uint64_t); }
+
+ private:
+  size_t _word_num;
+  std::unique_ptr<std::atomic<uint64_t>[]> _bits;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,230 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace paddle::distributed {
+
+namespace {
+// Up to this sample size, sampled indices are deduplicated by a linear scan.
+constexpr int kMaxScanSampleSize = 64;
+}  // namespace
+
+void CsrNeighborSampler::build(const std::vector<Node *> &nodes,
+                               bool is_weighted) {
+  size_t edge_num = 0;
+  for (auto *node : nodes) {
+    edge_num += node->get_neighbor_size();
+  }
+  row_ids_.clear();
+  offsets_.clear();
+  neighbor_ids_.clear();
+  weights_.clear();
+  row_ids_.reserve(nodes.size());
+  offsets_.reserve(nodes.size() + 1);
+  neighbor_ids_.reserve(edge_num);
+  if (is_weighted) {
+    weights_.reserve(edge_num);
+  }
+
+  offsets_.push_back(0);
+  for (auto *node : nodes) {
+    row_ids_.push_back(node->get_id());
+    int n = static_cast<int>(node->get_neighbor_size());
+    for (int i = 0; i < n; i++) {
+      neighbor_ids_.push_back(node->get_neighbor_id(i));
+      if (is_weighted) {
+        float weight = node->get_neighbor_weight(i);
+        weights_.push_back(weight);
+      }
+    }
+    offsets_.push_back(neighbor_ids_.size());
+  }
+
+  alias_prob_.assign(weights_.size(), 1.0);
+  alias_.assign(weights_.size(), 0);
+  if (is_weighted) {
+    for (size_t row = 0; row < node_num(); row++) {
+      build_alias(row);
+    }
+  }
+}
+
+// Vose's method of building a Walker alias table.
+void CsrNeighborSampler::build_alias(size_t row) {
+  const int n = degree(row);
+  const uint64_t base = offsets_[row];
+  double sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += weights_[base + i];
+  }
+  for (int i = 0; i < n; i++) {
+    alias_prob_[base + i] = 1.0;
+    alias_[base + i] = i;
+  }
+  if (n == 0 || sum <= 0) {
+    return;
+  }
+
+  thread_local std::vector<double> scaled;
+  thread_local std::vector<uint32_t> small, large;
+  scaled.resize(n);
+  small.clear();
+  large.clear();
+  for (int i = 0; i < n; i++) {
+    scaled[i] = weights_[base + i] * n / sum;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    uint32_t l = large.back();
+    small.pop_back();
+    large.pop_back();
+    alias_prob_[base + s] = scaled[s];
+    alias_[base + s] = l;
+    scaled[l] += scaled[s] - 1.0;
+    (scaled[l] < 1.0 ? small : large).push_back(l);
+  }
+  // The rest have probability 1 up to rounding errors.
+}
+
+void CsrNeighborSampler::sample_k(size_t row,
+                                  int k,
+                                  std::mt19937_64 *rng,
+                                  std::vector<int> *res) const {
+  res->clear();
+  const int n = degree(row);
+  if (k >= n) {
+    res->reserve(n);
+    for (int i = 0; i < n; i++) {
+      res->push_back(i);
+    }
+    return;
+  }
+  if (k <= 0) {
+    return;
+  }
+  if (weights_.empty()) {
+    sample_uniform(n, k, rng, res);
+    return;
+  }
+  // Rejecting the duplicated draws of the alias table gives the same
+  // distribution as drawing from the remaining neighbors, and is fast unless
+  // k is close to the number of neighbors with notable weights.
+  if (k <= kMaxScanSampleSize && 2 * k <= n &&
+      sample_alias(row, k, rng, res)) {
+    return;
+  }
+  res->clear();
+  sample_exact(row, k, rng, res);
+}
+
+void CsrNeighborSampler::sample_uniform(int n,
+                                        int k,
+                                        std::mt19937_64 *rng,
+                                        std::vector<int> *res) const {
+  res->reserve(k);
+  if (k <= kMaxScanSampleSize) {
+    // Floyd's algorithm.
+    for (int j = n - k; j < n; j++) {
+      int t = std::uniform_int_distribution<int>(0, j)(*rng);
+      if (std::find(res->begin(), res->end(), t) != res->end()) {
+        t = j;
+      }
+      res->push_back(t);
+    }
+    return;
+  }
+  // A partial Fisher-Yates shuffle.
+  thread_local std::vector<int> perm;
+  perm.resize(n);
+  for (int i = 0; i < n; i++) {
+    perm[i] = i;
+  }
+  for (int i = 0; i < k; i++) {
+    int t = std::uniform_int_distribution<int>(i, n - 1)(*rng);
+    std::swap(perm[i], perm[t]);
+    res->push_back(perm[i]);
+  }
+}
+
+bool CsrNeighborSampler::sample_alias(size_t row,
+                                      int k,
+                                      std::mt19937_64 *rng,
+                                      std::vector<int> *res) const {
+  const int n = degree(row);
+  const uint64_t base = offsets_[row];
+  std::uniform_int_distribution<int> pick(0, n - 1);
+  std::uniform_real_distribution<float> coin(0, 1.0);
+  res->reserve(k);
+  for (int tries = 8 * k + 64;
+       static_cast<int>(res->size()) < k && tries > 0;
+       tries--) {
+    int i = pick(*rng);
+    if (coin(*rng) >= alias_prob_[base + i]) {
+      i = static_cast<int>(alias_[base + i]);
+    }
+    if (std::find(res->begin(), res->end(), i) == res->end()) {
+      res->push_back(i);
+    }
+  }
+  return static_cast<int>(res->size()) == k;
+}
+
+// Efraimidis and Spirakis' weighted sampling without replacement, which
+// keeps the k neighbors of the largest log(u) / weight.
+void CsrNeighborSampler::sample_exact(size_t row,
+                                      int k,
+                                      std::mt19937_64 *rng,
+                                      std::vector<int> *res) const {
+  const int n = degree(row);
+  const uint64_t base = offsets_[row];
+  std::uniform_real_distribution<float> distrib(0, 1.0);
+  thread_local std::vector<std::pair<float, int>> keys;
+  keys.resize(n);
+  for (int i = 0; i < n; i++) {
+    float weight = weights_[base + i];
+    // 1 - u is in (0, 1], so its log is finite.
+    float key = weight > 0 ? std::log(1.0f - distrib(*rng)) / weight
+                           : -std::numeric_limits<float>::infinity();
+    keys[i] = {key, i};
+  }
+  std::partial_sort(keys.begin(),
+                    keys.begin() + k,
+                    keys.end(),
+                    [](const std::pair<float, int> &a,
+                       const std::pair<float, int> &b) {
+                      return a.first > b.first;
+                    });
+  res->reserve(k);
+  for (int i = 0; i < k; i++) {
+    res->push_back(keys[i].second);
+  }
+}
+
+size_t CsrNeighborSampler::memory_size() const {
+  return row_ids_.capacity() * sizeof(uint64_t) +
+         offsets_.capacity() * sizeof(uint64_t) +
+         neighbor_ids_.capacity() * sizeof(uint64_t) +
+         weights_.capacity() * sizeof(float) +
+         alias_prob_.capacity() * sizeof(float) +
+         alias_.capacity() * sizeof(uint32_t);
+}
+
+}  // namespace paddle::distributed
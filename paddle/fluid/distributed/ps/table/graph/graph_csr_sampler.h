@@ -0,0 +1,93 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+namespace paddle {
+namespace distributed {
+
+// CsrNeighborSampler keeps the neighbors of the nodes of a shard in one
+// compressed sparse row adjacency, row i holding the neighbors of the i-th
+// node it is built from. Weighted rows get a Walker alias table, so that a
+// weighted draw takes O(1) time.
+//
+// Per edge it stores the neighbor id, and for weighted graphs the weight and
+// the alias entry, i.e. 8 or 20 bytes, without any per node allocation. The
+// WeightedSampler tree takes two heap nodes of about 50 bytes per edge. On
+// unweighted graphs the RandomSampler, which samples the edge blob in place,
+// takes less, so GraphTable only builds it for weighted edges.
+class CsrNeighborSampler {
+ public:
+  void build(const std::vector<Node *> &nodes, bool is_weighted);
+
+  size_t node_num() const { return row_ids_.size(); }
+  size_t edge_num() const { return neighbor_ids_.size(); }
+  uint64_t row_id(size_t row) const { return row_ids_[row]; }
+  int degree(size_t row) const {
+    return static_cast<int>(offsets_[row + 1] - offsets_[row]);
+  }
+  uint64_t neighbor_id(size_t row, int i) const {
+    return neighbor_ids_[offsets_[row] + i];
+  }
+  float neighbor_weight(size_t row, int i) const {
+    return weights_.empty() ? 1.0 : weights_[offsets_[row] + i];
+  }
+  // Returns whether the row still matches the node it was built from.
+  bool matches(size_t row, Node *node) const {
+    return row < node_num() && row_ids_[row] == node->get_id() &&
+           static_cast<size_t>(degree(row)) == node->get_neighbor_size();
+  }
+
+  // Samples min(k, degree) distinct neighbors of the row proportionally to
+  // their weights, in the way WeightedSampler does, and stores their indices
+  // in the row to *res. The rows with at most k neighbors return all of
+  // them in order.
+  void sample_k(size_t row,
+                int k,
+                std::mt19937_64 *rng,
+                std::vector<int> *res) const;
+
+  size_t memory_size() const;
+
+ private:
+  void build_alias(size_t row);
+  void sample_uniform(int n,
+                      int k,
+                      std::mt19937_64 *rng,
+                      std::vector<int> *res) const;
+  bool sample_alias(size_t row,
+                    int k,
+                    std::mt19937_64 *rng,
+                    std::vector<int> *res) const;
+  void sample_exact(size_t row,
+                    int k,
+                    std::mt19937_64 *rng,
+                    std::vector<int> *res) const;
+
+  std::vector<uint64_t> row_ids_;
+  std::vector<uint64_t> offsets_;
+  std::vector<uint64_t> neighbor_ids_;
+  // The following are empty for unweighted graphs.
+  std::vector<float> weights_;
+  std::vector<float> alias_prob_;
+  std::vector<uint32_t> alias_;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -14,8 +14,25 @@
 
 #include "paddle/fluid/distributed/ps/table/memory_dense_table.h"
 
+#include "paddle/common/flags.h"
+#include "paddle/fluid/distributed/ps/table/depends/table_checkpoint.h"
 #include "paddle/fluid/platform/enforce.h"
 
+PD_DEFINE_bool(pserver_binary_checkpoint,
+               false,
+               "save sparse and dense table checkpoints (param 0 and 3) in "
+               "the binary chunked format instead of text");
+PD_DEFINE_string(pserver_checkpoint_codec,
+                 "none",
+                 "compression of binary checkpoint chunks, none or zlib");
+PD_DEFINE_int32(pserver_checkpoint_chunk_size,
+                4 << 20,
+                "raw bytes of records per binary checkpoint chunk");
+PD_DEFINE_bool(pserver_background_checkpoint,
+               false,
+               "write binary sparse table checkpoints in background from a "
+               "snapshot, so Save returns once the values are copied");
+
 namespace paddle::distributed {
 
 int FLAGS_pslib_table_save_max_retry_dense = 3;
@@ -228,6 +245,9 @@ int32_t MemoryDenseTable::Load(const std::string &path,
   for (auto ff : file_list) {
     VLOG(1) << "load dense table file list: " << ff;
   }
+  if (!file_list.empty() && IsCheckpointFile(file_list[0])) {
+    return LoadCheckpoint(file_list);
+  }
   size_t dim_num_per_file = _config.accessor().fea_dim() / file_list.size() + 1;
   // param_dim_ in last node != _config.accessor().fea_dim() / _shard_num + 1
   size_t dim_num_per_shard =
@@ -332,6 +352,9 @@ int32_t MemoryDenseTable::Save(const std::string &path,
   int save_param = atoi(param.c_str());
   uint32_t feasign_size;
   VLOG(0) << "MemoryDenseTable::save path " << path;
+  if (FLAGS_pserver_binary_checkpoint && (save_param == 0 || save_param == 3)) {
+    return SaveCheckpoint(path);
+  }
 
   FsChannelConfig channel_config;
   if (_config.compress_in_save()) {
@@ -342,6 +365,8 @@ int32_t MemoryDenseTable::Save(const std::string &path,
         "%s/part-%03d", TableDir(path).c_str(), _shard_idx);
   }
   _afs_client.remove(channel_config.path);
+  _afs_client.remove(paddle::string::format_string(
+      "%s/part-%03d%s", TableDir(path).c_str(), _shard_idx, kCheckpointSuffix));
   channel_config.converter = _value_accessor->Converter(save_param).converter;
   channel_config.deconverter =
       _value_accessor->Converter(save_param).deconverter;
@@ -424,4 +449,84 @@ int32_t MemoryDenseTable::Save(const std::string &path,
   return feasign_size;
 }
 
+int32_t MemoryDenseTable::SaveCheckpoint(const std::string &path) {
+  std::string file_path = paddle::string::format_string(
+      "%s/part-%03d%s", TableDir(path).c_str(), _shard_idx, kCheckpointSuffix);
+  _afs_client.remove(paddle::string::format_string(
+      "%s/part-%03d*", TableDir(path).c_str(), _shard_idx));
+  size_t start_dim_idx =
+      (_value_accessor->GetAccessorInfo().fea_dim / _shard_num + 1) *
+      _shard_idx;
+  const std::string &name = _config.common().name();
+  std::vector<float> row;
+  // Returns the number of rows saved, as the text format does.
+  int64_t feasign_size = WriteCheckpointFile(
+      &_afs_client,
+      file_path,
+      ParseCheckpointCodec(FLAGS_pserver_checkpoint_codec),
+      ParseCheckpointChunkSize(FLAGS_pserver_checkpoint_chunk_size),
+      FLAGS_pslib_table_save_max_retry_dense,
+      [&](CheckpointWriter *writer) -> int64_t {
+        for (int y = 0; y < param_dim_; ++y) {
+          row.clear();
+          if (name == "summary") {
+            row.push_back(values_[param_idx_][y]);
+          } else if (name == "adam_d2sum") {
+            row.push_back(values_[param_col_ids_[0]][y]);
+            row.push_back(0);
+            for (size_t x = 2; x < param_col_ids_.size(); ++x) {
+              row.push_back(values_[param_col_ids_[x]][y]);
+            }
+          } else {
+            for (size_t x = 0; x < param_col_ids_.size(); ++x) {
+              row.push_back(values_[param_col_ids_[x]][y]);
+            }
+          }
+          if (writer->Append(start_dim_idx + y, row.data(), row.size()) != 0) {
+            return -1;
+          }
+        }
+        return param_dim_;
+      });
+  LOG(INFO) << "DownpourDenseTable save checkpoint success, path:"
+            << file_path;
+  return static_cast<int32_t>(feasign_size);
+}
+
+int32_t MemoryDenseTable::LoadCheckpoint(
+    const std::vector<std::string> &file_list) {
+  // Rows are keyed by global dim, so every file is scanned and the number
+  // of servers may differ from the one that saved.
+  uint64_t start_dim_idx =
+      (_value_accessor->GetAccessorInfo().fea_dim / _shard_num + 1) *
+      _shard_idx;
+  uint64_t end_dim_idx = start_dim_idx + param_dim_;
+  for (auto &file : file_list) {
+    ReadCheckpointFile(
+        &_afs_client,
+        file,
+        FLAGS_pslib_table_save_max_retry_dense,
+        [&](uint64_t key, const float *row, uint32_t num) {
+          if (key < start_dim_idx || key >= end_dim_idx) {
+            return;
+          }
+          PADDLE_ENFORCE_EQ(
+              num,
+              param_col_ids_.size(),
+              phi::errors::InvalidArgument("Expected %d floats, but got %d.",
+                                           param_col_ids_.size(),
+                                           num));
+          for (size_t col_idx = 0; col_idx < num; ++col_idx) {
+            if (param_col_ids_[col_idx] < 0) {
+              continue;
+            }
+            values_[param_col_ids_[col_idx]][key - start_dim_idx] =
+                row[col_idx];
+          }
+        });
+    LOG(INFO) << "DownpourDenseTable load checkpoint success, path:" << file;
+  }
+  return 0;
+}
+
 }  // namespace paddle::distributed
@@ -66,6 +66,11 @@ class MemoryDenseTable : public Table {
 
  protected:
   int32_t _PushDense(const float* values, size_t num);
+  // Binary checkpoint of depends/table_checkpoint.h, whose records are the
+  // rows of the text format keyed by their global dim index. Returns the
+  // number of rows saved like the text format.
+  int32_t SaveCheckpoint(const std::string& path);
+  int32_t LoadCheckpoint(const std::vector<std::string>& file_list);
 
  private:
   const int task_pool_size_ = 10;
@@ -0,0 +1,434 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/memory_flat_sparse_table.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+
+#include "glog/logging.h"
+#include "paddle/common/flags.h"
+#include "paddle/fluid/distributed/common/cost_timer.h"
+#include "paddle/fluid/distributed/ps/table/depends/sparse_table_text_file.h"
+#include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/utils/string/string_helper.h"
+
+PD_DECLARE_bool(pserver_create_value_when_push);
+PD_DECLARE_bool(pserver_enable_create_feasign_randomly);
+PD_DECLARE_int32(pserver_table_save_max_retry);
+
+namespace paddle {
+namespace distributed {
+
+int32_t MemoryFlatSparseTable::Initialize() {
+  auto &profiler = CostProfiler::instance();
+  profiler.register_profiler("pserver_sparse_update_all");
+  profiler.register_profiler("pserver_sparse_select_all");
+  InitializeValue();
+  _shards_task_pool.resize(_task_pool_size);
+  for (auto &shards_task : _shards_task_pool) {
+    shards_task.reset(new ::ThreadPool(1));
+  }
+  VLOG(0) << "initalize MemoryFlatSparseTable succ";
+  return 0;
+}
+
+int32_t MemoryFlatSparseTable::InitializeValue() {
+  _sparse_table_shard_num = static_cast<int>(_config.shard_num());
+  _avg_local_shard_num = MemorySparseTable::sparse_local_shard_num(
+      _sparse_table_shard_num, _shard_num);
+  _real_local_shard_num = _avg_local_shard_num;
+  if (static_cast<int>(_real_local_shard_num * (_shard_idx + 1)) >
+      _sparse_table_shard_num) {
+    _real_local_shard_num =
+        _sparse_table_shard_num - _real_local_shard_num * _shard_idx;
+    _real_local_shard_num =
+        _real_local_shard_num < 0 ? 0 : _real_local_shard_num;
+  }
+  PADDLE_ENFORCE_EQ(
+      _config.enable_revert(),
+      false,
+      common::errors::Unimplemented(
+          "MemoryFlatSparseTable does not support enable_revert, use "
+          "MemorySparseTable instead."));
+  VLOG(1) << "memory flat sparse table _avg_local_shard_num: "
+          << _avg_local_shard_num
+          << " _real_local_shard_num: " << _real_local_shard_num
+          << " _task_pool_size:" << _task_pool_size;
+
+  _local_shards.reset(new shard_type[_real_local_shard_num]);
+  return 0;
+}
+
+template <typename Fn>
+void MemoryFlatSparseTable::RunByShard(const uint64_t *keys,
+                                       size_t num,
+                                       Fn &&fn) {
+  std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
+      _real_local_shard_num);
+  for (size_t i = 0; i < num; ++i) {
+    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
+    task_keys[shard_id].push_back({keys[i], i});
+  }
+  std::vector<std::future<int>> tasks(_real_local_shard_num);
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    tasks[shard_id] =
+        _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
+            [shard_id, &task_keys, &fn]() -> int {
+              fn(shard_id, task_keys[shard_id]);
+              return 0;
+            });
+  }
+  for (auto &task : tasks) {
+    task.wait();
+  }
+}
+
+int32_t MemoryFlatSparseTable::Pull(TableContext &context) {
+  CHECK(context.value_type == Sparse);
+  PADDLE_ENFORCE_EQ(context.use_ptr,
+                    false,
+                    common::errors::Unimplemented(
+                        "MemoryFlatSparseTable does not support pulling "
+                        "value pointers, use MemorySparseTable instead."));
+  return PullSparse(context.pull_context.values,
+                    context.pull_context.pull_value);
+}
+
+int32_t MemoryFlatSparseTable::Push(TableContext &context) {
+  CHECK(context.value_type == Sparse);
+  if (!context.use_ptr) {
+    return PushSparse(
+        context.push_context.keys, context.push_context.values, context.num);
+  } else {
+    return PushSparse(context.push_context.keys,
+                      context.push_context.ptr_values,
+                      context.num);
+  }
+}
+
+int32_t MemoryFlatSparseTable::PullSparse(float *pull_values,
+                                          const PullSparseValue &pull_value) {
+  CostTimer timer("pserver_sparse_select_all");
+  const size_t value_size =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  const size_t mf_value_size =
+      _value_accessor->GetAccessorInfo().mf_size / sizeof(float);
+  const size_t select_value_size =
+      _value_accessor->GetAccessorInfo().select_size / sizeof(float);
+
+  RunByShard(
+      pull_value.feasigns_,
+      pull_value.numel_,
+      [&](int shard_id,
+          const std::vector<std::pair<uint64_t, int>> &shard_keys) {
+        auto &local_shard = _local_shards[shard_id];
+        std::vector<float> data_buffer(value_size);
+        float *data_buffer_ptr = data_buffer.data();
+        for (auto &item : shard_keys) {
+          uint64_t key = item.first;
+          size_t data_size = value_size - mf_value_size;
+          auto itr = local_shard.find(key);
+          if (itr == local_shard.end()) {
+            if (FLAGS_pserver_create_value_when_push) {
+              memset(data_buffer_ptr, 0, sizeof(float) * data_size);
+            } else {
+              _value_accessor->Create(&data_buffer_ptr, 1);
+              auto &feature_value =
+                  local_shard.emplace(key, data_size).first.value();
+              feature_value.resize(data_size);
+              memcpy(feature_value.data(),
+                     data_buffer_ptr,
+                     data_size * sizeof(float));
+            }
+          } else {
+            data_size = itr.value().size();
+            memcpy(data_buffer_ptr,
+                   itr.value().data(),
+                   data_size * sizeof(float));
+          }
+          for (size_t mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
+            data_buffer_ptr[mf_idx] = 0.0;
+          }
+          float *select_data = pull_values + select_value_size * item.second;
+          _value_accessor->Select(
+              &select_data, (const float **)&data_buffer_ptr, 1);
+        }
+      });
+  return 0;
+}
+
+void MemoryFlatSparseTable::UpdateValue(shard_type *shard,
+                                        uint64_t key,
+                                        const float *update_data,
+                                        float *data_buffer) {
+  const size_t value_col =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  const size_t mf_value_col =
+      _value_accessor->GetAccessorInfo().mf_size / sizeof(float);
+  auto itr = shard->find(key);
+  if (itr == shard->end()) {
+    if (FLAGS_pserver_enable_create_feasign_randomly &&
+        !_value_accessor->CreateValue(1, update_data)) {
+      return;
+    }
+    size_t value_size = value_col - mf_value_col;
+    itr = shard->emplace(key, value_size).first;
+    itr.value().resize(value_size);
+    _value_accessor->Create(&data_buffer, 1);
+    memcpy(itr.value().data(), data_buffer, value_size * sizeof(float));
+  }
+
+  FlatFeatureValue *feature_value = itr.value_ptr();
+  float *value_data = feature_value->data();
+  size_t value_size = feature_value->size();
+  if (value_size == value_col) {
+    _value_accessor->Update(&value_data, &update_data, 1);
+    return;
+  }
+  // Update a full size copy, then write back only the part the value keeps
+  // unless the update asks for the mf part to be created.
+  memcpy(data_buffer, value_data, value_size * sizeof(float));
+  _value_accessor->Update(&data_buffer, &update_data, 1);
+  if (_value_accessor->NeedExtendMF(data_buffer)) {
+    feature_value = shard->resize(itr, value_col);
+    value_data = feature_value->data();
+    _value_accessor->Create(&value_data, 1);
+  }
+  memcpy(value_data, data_buffer, value_size * sizeof(float));
+}
+
+int32_t MemoryFlatSparseTable::PushSparse(const uint64_t *keys,
+                                          const float *values,
+                                          size_t num) {
+  CostTimer timer("pserver_sparse_update_all");
+  const size_t value_col =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  const size_t update_value_col =
+      _value_accessor->GetAccessorInfo().update_size / sizeof(float);
+  RunByShard(
+      keys,
+      num,
+      [&](int shard_id,
+          const std::vector<std::pair<uint64_t, int>> &shard_keys) {
+        std::vector<float> data_buffer(value_col);
+        for (auto &item : shard_keys) {
+          UpdateValue(&_local_shards[shard_id],
+                      item.first,
+                      values + item.second * update_value_col,
+                      data_buffer.data());
+        }
+      });
+  return 0;
+}
+
+int32_t MemoryFlatSparseTable::PushSparse(const uint64_t *keys,
+                                          const float **values,
+                                          size_t num) {
+  const size_t value_col =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  RunByShard(
+      keys,
+      num,
+      [&](int shard_id,
+          const std::vector<std::pair<uint64_t, int>> &shard_keys) {
+        std::vector<float> data_buffer(value_col);
+        for (auto &item : shard_keys) {
+          UpdateValue(&_local_shards[shard_id],
+                      item.first,
+                      values[item.second],
+                      data_buffer.data());
+        }
+      });
+  return 0;
+}
+
+int32_t MemoryFlatSparseTable::Load(const std::string &path,
+                                    const std::string &param) {
+  std::string table_path = TableDir(path);
+  auto file_list = _afs_client.list(table_path);
+  std::sort(file_list.begin(), file_list.end());
+
+  int load_param = atoi(param.c_str());
+  size_t expect_shard_num = _sparse_table_shard_num;
+  if (file_list.size() != expect_shard_num) {
+    LOG(WARNING) << "MemoryFlatSparseTable file_size:" << file_list.size()
+                 << " not equal to expect_shard_num:" << expect_shard_num;
+    return -1;
+  }
+  if (file_list.empty()) {
+    LOG(WARNING) << "MemoryFlatSparseTable load file is empty, path:" << path;
+    return -1;
+  }
+  PADDLE_ENFORCE_NE(load_param,
+                    5,
+                    common::errors::Unimplemented(
+                        "MemoryFlatSparseTable does not support patch model."));
+
+  size_t file_start_idx = _shard_idx * _avg_local_shard_num;
+  if (file_start_idx >= file_list.size()) {
+    return 0;
+  }
+  size_t feature_value_size =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    FsChannelConfig channel_config = {};
+    channel_config.path = file_list[file_start_idx + i];
+    channel_config.converter = _value_accessor->Converter(load_param).converter;
+    channel_config.deconverter =
+        _value_accessor->Converter(load_param).deconverter;
+
+    std::vector<float> data_buffer(feature_value_size);
+    auto &shard = _local_shards[i];
+    ReadTextShardFile(
+        &_afs_client,
+        channel_config,
+        FLAGS_pserver_table_save_max_retry,
+        "MemoryFlatSparseTable",
+        [&](uint64_t key, char *value_str) {
+          // The parsed size is only known after parsing, parse into a full
+          // size buffer and keep exactly that many floats in the shard.
+          int parse_size =
+              _value_accessor->ParseFromString(value_str, data_buffer.data());
+          auto itr = shard.find(key);
+          FlatFeatureValue *value = nullptr;
+          if (itr == shard.end()) {
+            value = shard.emplace(key, parse_size).first.value_ptr();
+          } else {
+            value = shard.resize(itr, parse_size);
+          }
+          value->resize(parse_size);
+          memcpy(value->data(), data_buffer.data(), parse_size * sizeof(float));
+        });
+  }
+  LOG(INFO) << "MemoryFlatSparseTable load success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
+int32_t MemoryFlatSparseTable::Save(const std::string &dirname,
+                                    const std::string &param) {
+  if (_real_local_shard_num == 0) {
+    return 0;
+  }
+  VLOG(0) << "MemoryFlatSparseTable::save dirname: " << dirname;
+  int save_param = atoi(param.c_str());
+  PADDLE_ENFORCE_NE(save_param,
+                    5,
+                    common::errors::Unimplemented(
+                        "MemoryFlatSparseTable does not support patch model."));
+
+  std::string table_path = TableDir(dirname);
+  _afs_client.remove(::paddle::string::format_string(
+      "%s/part-%03d-*", table_path.c_str(), _shard_idx));
+  std::atomic<uint32_t> feasign_size_all{0};
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    FsChannelConfig channel_config = {};
+    channel_config.path = TextShardFilePath(
+        table_path,
+        _shard_idx,
+        file_start_idx + i,
+        _config.compress_in_save() && (save_param == 0 || save_param == 3));
+    channel_config.converter = _value_accessor->Converter(save_param).converter;
+    channel_config.deconverter =
+        _value_accessor->Converter(save_param).deconverter;
+    auto &shard = _local_shards[i];
+    int64_t feasign_size = WriteTextShardFile(
+        &_afs_client,
+        channel_config,
+        FLAGS_pserver_table_save_max_retry,
+        "MemoryFlatSparseTable",
+        [&](const std::function<bool(uint64_t, const std::string &)> &write) {
+          for (auto it = shard.begin(); it != shard.end(); ++it) {
+            if (_value_accessor->Save(it.value().data(), save_param) &&
+                !write(it.key(),
+                       _value_accessor->ParseToString(it.value().data(),
+                                                      it.value().size()))) {
+              break;
+            }
+          }
+        });
+    feasign_size_all += feasign_size;
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
+    }
+    LOG(INFO) << "MemoryFlatSparseTable save prefix success, path: "
+              << channel_config.path << " feasign_size: " << feasign_size;
+  }
+  return 0;
+}
+
+int64_t MemoryFlatSparseTable::LocalSize() {
+  int64_t local_size = 0;
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    local_size += _local_shards[i].size();
+  }
+  return local_size;
+}
+
+int64_t MemoryFlatSparseTable::LocalMFSize() {
+  int64_t mf_size = 0;
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    auto &shard = _local_shards[i];
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      if (_value_accessor->HasMF(it.value().size())) {
+        ++mf_size;
+      }
+    }
+  }
+  return mf_size;
+}
+
+std::pair<int64_t, int64_t> MemoryFlatSparseTable::PrintTableStat() {
+  return {LocalSize(), LocalMFSize()};
+}
+
+int32_t MemoryFlatSparseTable::Shrink(const std::string &param) {
+  VLOG(0) << "MemoryFlatSparseTable::Shrink";
+  std::atomic<uint32_t> shrink_size_all{0};
+  omp_set_num_threads(_real_local_shard_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    shrink_size_all +=
+        ShrinkShard(_value_accessor.get(), &_local_shards[shard_id]);
+  }
+  VLOG(0) << "MemoryFlatSparseTable::Shrink success, shrink size:"
+          << shrink_size_all;
+  return 0;
+}
+
+void MemoryFlatSparseTable::Clear() {
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    _local_shards[i].clear();
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,96 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <ThreadPool.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/distributed/ps/table/accessor.h"
+#include "paddle/fluid/distributed/ps/table/common_table.h"
+#include "paddle/fluid/distributed/ps/table/depends/flat_sparse_table_shard.h"
+#include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
+
+namespace paddle {
+namespace distributed {
+
+// MemoryFlatSparseTable keeps the same sharding, accessor protocol and file
+// format as MemorySparseTable, but stores its feasigns in
+// FlatSparseTableShard. Select it with table_class: "MemoryFlatSparseTable".
+//
+// Patch models (save/load param 5), revert and the sparse table cache are
+// not supported, and neither is the pointer pull used by heter ps, whose
+// consumers read FixedFeatureValue.
+class MemoryFlatSparseTable : public Table {
+ public:
+  typedef FlatSparseTableShard<uint64_t> shard_type;
+  MemoryFlatSparseTable() {}
+  virtual ~MemoryFlatSparseTable() {}
+
+  int32_t Pull(TableContext& context) override;
+  int32_t Push(TableContext& context) override;
+
+  int32_t Initialize() override;
+  int32_t InitializeShard() override { return 0; }
+  int32_t InitializeValue();
+
+  int32_t Load(const std::string& path, const std::string& param) override;
+  int32_t Save(const std::string& path, const std::string& param) override;
+#if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
+  int32_t Save_v2(const std::string& path, const std::string& param) override {
+    return Save(path, param);
+  }
+#endif
+
+  int64_t LocalSize();
+  int64_t LocalMFSize();
+  std::pair<int64_t, int64_t> PrintTableStat() override;
+
+  int32_t PullSparse(float* values, const PullSparseValue& pull_value);
+  int32_t PushSparse(const uint64_t* keys, const float* values, size_t num);
+  int32_t PushSparse(const uint64_t* keys, const float** values, size_t num);
+
+  int32_t Flush() override { return 0; }
+  int32_t Shrink(const std::string& param) override;
+  void Clear() override;
+
+  void* GetShard(size_t shard_idx) override {
+    return &_local_shards[shard_idx];
+  }
+
+ protected:
+  // Groups keys by local shard and runs fn(shard_id, keys) on the shard
+  // task pools, keys being (feasign, index in the request) pairs.
+  template <typename Fn>
+  void RunByShard(const uint64_t* keys, size_t num, Fn&& fn);
+  // Applies one update to key, creating its value first when missing.
+  void UpdateValue(shard_type* shard,
+                   uint64_t key,
+                   const float* update_data,
+                   float* data_buffer);
+
+  int _task_pool_size = 24;
+  int _avg_local_shard_num;
+  int _real_local_shard_num;
+  int _sparse_table_shard_num;
+  std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
+  std::unique_ptr<shard_type[]> _local_shards;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -13,12 +13,14 @@
 // limitations under the License.
 
 #include <omp.h>
+#include <chrono>
 #include <sstream>
 
 #include "glog/logging.h"
 #include "paddle/fluid/distributed/common/cost_timer.h"
 #include "paddle/fluid/distributed/common/local_random.h"
 #include "paddle/fluid/distributed/common/topk_calculator.h"
+#include "paddle/fluid/distributed/ps/table/feature_admission.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/framework/io/fs.h"
@@ -38,9 +40,38 @@ PD_DEFINE_bool(pserver_enable_create_feasign_randomly,
 PD_DEFINE_int32(pserver_table_save_max_retry,
                 3,
                 "pserver_table_save_max_retry");
+PD_DECLARE_bool(pserver_binary_checkpoint);
+PD_DECLARE_string(pserver_checkpoint_codec);
+PD_DECLARE_int32(pserver_checkpoint_chunk_size);
+PD_DECLARE_bool(pserver_background_checkpoint);
 
 namespace paddle::distributed {
 
+namespace {
+
+// Values of one shard copied out for a background checkpoint.
+struct ShardSnapshot {
+  std::vector<uint64_t> keys;
+  std::vector<uint64_t> offsets{0};
+  std::vector<float> values;
+};
+
+// The number of keys of a push that are updated in place by one call of the
+// accessor, whose sgd rules then run across them.
+constexpr size_t kPushUpdateBatchSize = 64;
+
+// The largest factor the eviction pressure grows to above the memory target.
+constexpr float kMaxEvictionPressure = 1024.0f;
+
+struct EvictionResult {
+  int64_t evicted = 0;
+  int64_t scanned = 0;
+  int64_t scanned_bytes = 0;
+  int64_t size = 0;
+};
+
+}  // namespace
+
 int32_t MemorySparseTable::Initialize() {
   auto &profiler = CostProfiler::instance();
   profiler.register_profiler("pserver_sparse_update_all");
@@ -50,6 +81,20 @@ int32_t MemorySparseTable::Initialize() {
   for (auto &shards_task : _shards_task_pool) {
     shards_task.reset(new ::ThreadPool(1));
   }
+  _eviction_bucket.assign(_real_local_shard_num, 0);
+  const auto &eviction_param = _config.eviction_param();
+  if (eviction_param.interval_ms() > 0) {
+    _eviction_thread = std::thread([this, eviction_param]() {
+      auto interval = std::chrono::milliseconds(eviction_param.interval_ms());
+      std::unique_lock<std::mutex> lock(_eviction_stop_mutex);
+      while (!_eviction_stop_cv.wait_for(
+          lock, interval, [this] { return _eviction_stop; })) {
+        lock.unlock();
+        EvictStep();
+        lock.lock();
+      }
+    });
+  }
   VLOG(0) << "initalize MemorySparseTable succ";
   return 0;
 }
@@ -107,6 +152,8 @@ int32_t MemorySparseTable::InitializeValue() {
 
 int32_t MemorySparseTable::Load(const std::string &path,
                                 const std::string &param) {
+  WaitCheckpointDone();
+  std::lock_guard<std::mutex> eviction_lock(_eviction_mutex);
   std::string table_path = TableDir(path);
   auto file_list = _afs_client.list(table_path);
 
@@ -149,6 +196,21 @@ int32_t MemorySparseTable::Load(const std::string &path,
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < _real_local_shard_num; ++i) {
+    if (IsCheckpointFile(file_list[file_start_idx + i])) {
+      auto &shard = _local_shards[i];
+      int64_t feasign_size = ReadCheckpointFile(
+          &_afs_client,
+          file_list[file_start_idx + i],
+          FLAGS_pserver_table_save_max_retry,
+          [&shard](uint64_t key, const float *values, uint32_t num) {
+            auto &value = shard[key];
+            value.resize(num);
+            memcpy(value.data(), values, num * sizeof(float));
+          });
+      VLOG(1) << "MemorySparseTable::load " << file_list[file_start_idx + i]
+              << " feasign_size: " << feasign_size;
+      continue;
+    }
     FsChannelConfig channel_config = {};
     channel_config.path = file_list[file_start_idx + i];
     VLOG(1) << "MemorySparseTable::load begin load " << channel_config.path
@@ -157,45 +219,18 @@ int32_t MemorySparseTable::Load(const std::string &path,
     channel_config.deconverter =
         _value_accessor->Converter(load_param).deconverter;
 
-    bool is_read_failed = false;
-    int retry_num = 0;
-    int err_no = 0;
-    do {
-      is_read_failed = false;
-      err_no = 0;
-      std::string line_data;
-      auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
-      char *end = nullptr;
-      auto &shard = _local_shards[i];
-      try {
-        while (read_channel->read_line(line_data) == 0 &&
-               line_data.size() > 1) {
-          uint64_t key = std::strtoul(line_data.data(), &end, 10);
-          auto &value = shard[key];
-          value.resize(feature_value_size);
-          int parse_size =
-              _value_accessor->ParseFromString(++end, value.data());
-          value.resize(parse_size);
-        }
-        read_channel->close();
-        if (err_no == -1) {
-          ++retry_num;
-          is_read_failed = true;
-          LOG(ERROR)
-              << "MemorySparseTable load failed after read, retry it! path:"
-              << channel_config.path << " , retry_num=" << retry_num;
-        }
-      } catch (...) {
-        ++retry_num;
-        is_read_failed = true;
-        LOG(ERROR) << "MemorySparseTable load failed, retry it! path:"
-                   << channel_config.path << " , retry_num=" << retry_num;
-      }
-      if (retry_num > FLAGS_pserver_table_save_max_retry) {
-        LOG(ERROR) << "MemorySparseTable load failed reach max limit!";
-        exit(-1);
-      }
-    } while (is_read_failed);
+    auto &shard = _local_shards[i];
+    ReadTextShardFile(&_afs_client,
+                      channel_config,
+                      FLAGS_pserver_table_save_max_retry,
+                      "MemorySparseTable",
+                      [&](uint64_t key, char *value_str) {
+                        auto &value = shard[key];
+                        value.resize(feature_value_size);
+                        int parse_size = _value_accessor->ParseFromString(
+                            value_str, value.data());
+                        value.resize(parse_size);
+                      });
   }
   LOG(INFO) << "MemorySparseTable load success, path from "
             << file_list[file_start_idx] << " to "
@@ -315,6 +350,7 @@ void MemorySparseTable::CheckSavePrePatchDone() {
 
 int32_t MemorySparseTable::Save(const std::string &dirname,
                                 const std::string &param) {
+  std::lock_guard<std::mutex> eviction_lock(_eviction_mutex);
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
   // gpu graph mode
   if (_use_gpu_graph) {
@@ -332,6 +368,7 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
   VLOG(0) << "MemorySparseTable::save dirname: " << dirname;
   int save_param =
       atoi(param.c_str());  // checkpoint:0  xbox delta:1  xbox base:2
+  WaitCheckpointDone();
 
   // patch model
   if (save_param == 5) {
@@ -351,6 +388,11 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
       "%s/part-%03d-*", table_path.c_str(), _shard_idx));
   std::atomic<uint32_t> feasign_size_all{0};
 
+  if (FLAGS_pserver_binary_checkpoint && (save_param == 0 || save_param == 3)) {
+    _local_show_threshold = tk.top();
+    return SaveCheckpoint(table_path, save_param);
+  }
+
   size_t file_start_idx = _avg_local_shard_num * _shard_idx;
 
 #ifdef PADDLE_WITH_HETERPS
@@ -362,25 +404,14 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
 #pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < _real_local_shard_num; ++i) {
     FsChannelConfig channel_config = {};
-    if (_config.compress_in_save() && (save_param == 0 || save_param == 3)) {
-      channel_config.path =
-          ::paddle::string::format_string("%s/part-%03d-%05d.gz",
-                                          table_path.c_str(),
-                                          _shard_idx,
-                                          file_start_idx + i);
-    } else {
-      channel_config.path = ::paddle::string::format_string("%s/part-%03d-%05d",
-                                                            table_path.c_str(),
-                                                            _shard_idx,
-                                                            file_start_idx + i);
-    }
+    channel_config.path = TextShardFilePath(
+        table_path,
+        _shard_idx,
+        file_start_idx + i,
+        _config.compress_in_save() && (save_param == 0 || save_param == 3));
     channel_config.converter = _value_accessor->Converter(save_param).converter;
     channel_config.deconverter =
         _value_accessor->Converter(save_param).deconverter;
-    bool is_write_failed = false;
-    int feasign_size = 0;
-    int retry_num = 0;
-    int err_no = 0;
     auto &shard = _local_shards[i];
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
     // for incremental training, batch_model increase unseenday before save
@@ -390,51 +421,27 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
       }
     }
 #endif
-    do {
-      err_no = 0;
-      feasign_size = 0;
-      is_write_failed = false;
-      auto write_channel =
-          _afs_client.open_w(channel_config, 1024 * 1024 * 40, &err_no);
-      for (auto it = shard.begin(); it != shard.end(); ++it) {
-        if (_config.enable_sparse_table_cache() &&
-            (save_param == 1 || save_param == 2) &&
-            _value_accessor->Save(it.value().data(), 4)) {
-          CostTimer timer10("sprase table top push");
-          tk.push(i, _value_accessor->GetField(it.value().data(), "show"));
-        }
-
-        if (_value_accessor->Save(it.value().data(), save_param)) {
-          std::string format_value = _value_accessor->ParseToString(
-              it.value().data(), it.value().size());
-          if (0 != write_channel->write_line(::paddle::string::format_string(
-                       "%lu %s", it.key(), format_value.c_str()))) {
-            ++retry_num;
-            is_write_failed = true;
-            LOG(ERROR)
-                << "MemorySparseTable save prefix failed, retry it! path:"
-                << channel_config.path << " , retry_num=" << retry_num;
-            break;
+    int64_t feasign_size = WriteTextShardFile(
+        &_afs_client,
+        channel_config,
+        FLAGS_pserver_table_save_max_retry,
+        "MemorySparseTable",
+        [&](const std::function<bool(uint64_t, const std::string &)> &write) {
+          for (auto it = shard.begin(); it != shard.end(); ++it) {
+            if (_config.enable_sparse_table_cache() &&
+                (save_param == 1 || save_param == 2) &&
+                _value_accessor->Save(it.value().data(), 4)) {
+              CostTimer timer10("sprase table top push");
+              tk.push(i, _value_accessor->GetField(it.value().data(), "show"));
+            }
+            if (_value_accessor->Save(it.value().data(), save_param) &&
+                !write(it.key(),
+                       _value_accessor->ParseToString(it.value().data(),
+                                                      it.value().size()))) {
+              break;
+            }
           }
-          ++feasign_size;
-        }
-      }
-      write_channel->close();
-      if (err_no == -1) {
-        ++retry_num;
-        is_write_failed = true;
-        LOG(ERROR)
-            << "MemorySparseTable save prefix failed after write, retry it! "
-            << "path:" << channel_config.path << " , retry_num=" << retry_num;
-      }
-      if (is_write_failed) {
-        _afs_client.remove(channel_config.path);
-      }
-      if (retry_num > FLAGS_pserver_table_save_max_retry) {
-        LOG(ERROR) << "MemorySparseTable save prefix failed reach max limit!";
-        exit(-1);
-      }
-    } while (is_write_failed);
+        });
     feasign_size_all += feasign_size;
     if (!_use_gpu_graph) {
       for (auto it = shard.begin(); it != shard.end(); ++it) {
@@ -453,6 +460,126 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
   return 0;
 }
 
+int32_t MemorySparseTable::SaveCheckpoint(const std::string &table_path,
+                                          int save_param) {
+  CheckpointCodec codec =
+      ParseCheckpointCodec(FLAGS_pserver_checkpoint_codec);
+  uint32_t chunk_size =
+      ParseCheckpointChunkSize(FLAGS_pserver_checkpoint_chunk_size);
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+  std::vector<std::string> paths(_real_local_shard_num);
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    paths[i] = ::paddle::string::format_string("%s/part-%03d-%05d%s",
+                                               table_path.c_str(),
+                                               _shard_idx,
+                                               file_start_idx + i,
+                                               kCheckpointSuffix);
+  }
+  bool background = FLAGS_pserver_background_checkpoint;
+  auto snapshots = std::make_shared<std::vector<ShardSnapshot>>(
+      background ? _real_local_shard_num : 0);
+
+#ifdef PADDLE_WITH_HETERPS
+  int thread_num = _real_local_shard_num;
+#else
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+#endif
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    auto &shard = _local_shards[i];
+#if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
+    if (_use_gpu_graph && save_param == 3) {
+      for (auto it = shard.begin(); it != shard.end(); ++it) {
+        _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
+      }
+    }
+#endif
+    if (background) {
+      // Only copy here; encoding and IO run after Save returns.
+      auto &snapshot = (*snapshots)[i];
+      for (auto it = shard.begin(); it != shard.end(); ++it) {
+        if (_value_accessor->Save(it.value().data(), save_param)) {
+          snapshot.keys.push_back(it.key());
+          snapshot.values.insert(snapshot.values.end(),
+                                 it.value().data(),
+                                 it.value().data() + it.value().size());
+          snapshot.offsets.push_back(snapshot.values.size());
+        }
+      }
+    } else {
+      int64_t feasign_size = WriteCheckpointFile(
+          &_afs_client,
+          paths[i],
+          codec,
+          chunk_size,
+          FLAGS_pserver_table_save_max_retry,
+          [&](CheckpointWriter *writer) -> int64_t {
+            int64_t record_num = 0;
+            for (auto it = shard.begin(); it != shard.end(); ++it) {
+              if (!_value_accessor->Save(it.value().data(), save_param)) {
+                continue;
+              }
+              if (writer->Append(it.key(),
+                                 it.value().data(),
+                                 it.value().size()) != 0) {
+                return -1;
+              }
+              ++record_num;
+            }
+            return record_num;
+          });
+      LOG(INFO) << "MemorySparseTable save checkpoint success, path: "
+                << paths[i] << " feasign_size: " << feasign_size;
+    }
+    if (!_use_gpu_graph || save_param != 3) {
+      for (auto it = shard.begin(); it != shard.end(); ++it) {
+        _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
+      }
+    }
+  }
+  if (!background) {
+    return 0;
+  }
+
+  AfsClient *afs_client = &_afs_client;
+  _save_checkpoint_thread = std::thread([=]() {
+    omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < snapshots->size(); ++i) {
+      const auto &snapshot = (*snapshots)[i];
+      int64_t feasign_size = WriteCheckpointFile(
+          afs_client,
+          paths[i],
+          codec,
+          chunk_size,
+          FLAGS_pserver_table_save_max_retry,
+          [&snapshot](CheckpointWriter *writer) -> int64_t {
+            for (size_t j = 0; j < snapshot.keys.size(); ++j) {
+              uint64_t begin = snapshot.offsets[j];
+              if (writer->Append(snapshot.keys[j],
+                                 snapshot.values.data() + begin,
+                                 snapshot.offsets[j + 1] - begin) != 0) {
+                return -1;
+              }
+            }
+            return snapshot.keys.size();
+          });
+      LOG(INFO) << "MemorySparseTable save checkpoint success, path: "
+                << paths[i] << " feasign_size: " << feasign_size;
+    }
+  });
+  LOG(INFO) << "MemorySparseTable snapshot taken, writing "
+            << snapshots->size() << " files in background";
+  return 0;
+}
+
+void MemorySparseTable::WaitCheckpointDone() {
+  if (_save_checkpoint_thread.joinable()) {
+    _save_checkpoint_thread.join();
+  }
+}
+
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
 int32_t MemorySparseTable::Save_v2(const std::string &dirname,
                                    const std::string &param) {
@@ -1142,6 +1269,29 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
           auto &local_shard_new = _local_shards_new[shard_id];
           float data_buffer[value_col];  // NOLINT
           float *data_buffer_ptr = data_buffer;
+          std::vector<uint64_t> batch_keys;
+          std::vector<float *> batch_values;
+          std::vector<const float *> batch_updates;
+          auto update_batch = [&]() {
+            if (batch_values.empty()) {
+              return;
+            }
+            _value_accessor->Update(
+                batch_values.data(), batch_updates.data(), batch_values.size());
+            if (_config.enable_revert()) {
+              for (size_t i = 0; i < batch_keys.size(); ++i) {
+                FixedFeatureValue *feature_value_new =
+                    &(local_shard_new[batch_keys[i]]);
+                feature_value_new->resize(value_col);
+                memcpy(feature_value_new->data(),
+                       batch_values[i],
+                       value_col * sizeof(float));
+              }
+            }
+            batch_keys.clear();
+            batch_values.clear();
+            batch_updates.clear();
+          };
           for (auto &item : keys) {
             uint64_t key = item.first;
             uint64_t push_data_idx = item.second;
@@ -1153,6 +1303,9 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                   !_value_accessor->CreateValue(1, update_data)) {
                 continue;
               }
+              if (!_value_accessor->Admit(key, update_data)) {
+                continue;
+              }
               auto value_size = value_col - mf_value_col;
               auto &feature_value = local_shard[key];
               feature_value.resize(value_size);
@@ -1168,19 +1321,24 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
             size_t value_size = feature_value.size();
 
             if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accessor->Update(&value_data, &update_data, 1);
-            } else {
-              // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
-              _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
-
-              if (_value_accessor->NeedExtendMF(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
-                _value_accessor->Create(&value_data, 1);
+              batch_keys.push_back(key);
+              batch_values.push_back(value_data);
+              batch_updates.push_back(update_data);
+              if (batch_values.size() == kPushUpdateBatchSize) {
+                update_batch();
               }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              continue;
+            }
+            // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+            memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+            _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
+
+            if (_value_accessor->NeedExtendMF(data_buffer)) {
+              feature_value.resize(value_col);
+              value_data = feature_value.data();
+              _value_accessor->Create(&value_data, 1);
             }
+            memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
             if (_config.enable_revert()) {
               FixedFeatureValue *feature_value_new = &(local_shard_new[key]);
               auto new_size = feature_value.size();
@@ -1190,6 +1348,7 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                      new_size * sizeof(float));
             }
           }
+          update_batch();
           return 0;
         });
   }
@@ -1222,6 +1381,17 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
           auto &local_shard = _local_shards[shard_id];
           float data_buffer[value_col];  // NOLINT
           float *data_buffer_ptr = data_buffer;
+          std::vector<float *> batch_values;
+          std::vector<const float *> batch_updates;
+          auto update_batch = [&]() {
+            if (batch_values.empty()) {
+              return;
+            }
+            _value_accessor->Update(
+                batch_values.data(), batch_updates.data(), batch_values.size());
+            batch_values.clear();
+            batch_updates.clear();
+          };
           for (auto &item : keys) {
             uint64_t key = item.first;
             uint64_t push_data_idx = item.second;
@@ -1232,6 +1402,9 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                   !_value_accessor->CreateValue(1, update_data)) {
                 continue;
               }
+              if (!_value_accessor->Admit(key, update_data)) {
+                continue;
+              }
               auto value_size = value_col - mf_value_col;
               auto &feature_value = local_shard[key];
               feature_value.resize(value_size);
@@ -1245,7 +1418,11 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
             float *value_data = feature_value.data();
             size_t value_size = feature_value.size();
             if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accessor->Update(&value_data, &update_data, 1);
+              batch_values.push_back(value_data);
+              batch_updates.push_back(update_data);
+              if (batch_values.size() == kPushUpdateBatchSize) {
+                update_batch();
+              }
             } else {
               // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
               memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
@@ -1258,6 +1435,7 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
               memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
             }
           }
+          update_batch();
           return 0;
         });
   }
@@ -1272,23 +1450,14 @@ int32_t MemorySparseTable::Flush() { return 0; }
 
 int32_t MemorySparseTable::Shrink(const std::string &param) {
   VLOG(0) << "MemorySparseTable::Shrink";
+  std::lock_guard<std::mutex> eviction_lock(_eviction_mutex);
   std::atomic<uint32_t> shrink_size_all{0};
   int thread_num = _real_local_shard_num;
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    // Shrink
-    int feasign_size = 0;
-    auto &shard = _local_shards[shard_id];
-    for (auto it = shard.begin(); it != shard.end();) {
-      if (_value_accessor->Shrink(it.value().data())) {
-        it = shard.erase(it);
-        ++feasign_size;
-      } else {
-        ++it;
-      }
-    }
-    shrink_size_all += feasign_size;
+    shrink_size_all +=
+        ShrinkShard(_value_accessor.get(), &_local_shards[shard_id]);
   }
   VLOG(0) << "MemorySparseTable::Shrink success, shrink size:"
           << shrink_size_all;
@@ -1297,4 +1466,86 @@ int32_t MemorySparseTable::Shrink(const std::string &param) {
 
 void MemorySparseTable::Clear() { VLOG(0) << "clear coming soon"; }
 
+int64_t MemorySparseTable::EvictStep() {
+  std::lock_guard<std::mutex> eviction_lock(_eviction_mutex);
+  const auto &param = _config.eviction_param();
+  const int64_t budget = std::max<uint32_t>(param.shard_budget(), 1);
+  const float pressure = _eviction_pressure.load();
+  std::vector<std::future<EvictionResult>> tasks(_real_local_shard_num);
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    tasks[shard_id] = _shards_task_pool[shard_id % _task_pool_size]->enqueue(
+        [this, shard_id, budget, pressure]() -> EvictionResult {
+          auto &shard = _local_shards[shard_id];
+          size_t &bucket = _eviction_bucket[shard_id];
+          EvictionResult result;
+          // Whole buckets are scanned, since the iterators of a bucket do
+          // not survive the inserts of the pushes between two steps.
+          for (size_t i = 0;
+               i < shard.bucket_count() && result.scanned < budget;
+               ++i) {
+            for (auto it = shard.begin(bucket); it != shard.end(bucket);) {
+              ++result.scanned;
+              result.scanned_bytes += it.value().size() * sizeof(float);
+              if (_value_accessor->Evict(it.value().data(), pressure)) {
+                it = shard.erase(bucket, it);
+                ++result.evicted;
+              } else {
+                ++it;
+              }
+            }
+            bucket = (bucket + 1) % shard.bucket_count();
+          }
+          result.size = static_cast<int64_t>(shard.size());
+          return result;
+        });
+  }
+  EvictionResult total;
+  for (auto &task : tasks) {
+    auto result = task.get();
+    total.evicted += result.evicted;
+    total.scanned += result.scanned;
+    total.scanned_bytes += result.scanned_bytes;
+    total.size += result.size;
+  }
+  _evicted_num += total.evicted;
+
+  if (param.memory_target_mb() > 0 && total.scanned > 0) {
+    // The values of the scanned keys stand for all of them.
+    const double entry_bytes =
+        static_cast<double>(total.scanned_bytes) / total.scanned +
+        sizeof(uint64_t) + sizeof(void *) + sizeof(FixedFeatureValue);
+    const double memory = entry_bytes * total.size;
+    const double target = param.memory_target_mb() * 1024.0 * 1024.0;
+    if (memory > target) {
+      _eviction_pressure = std::min(pressure * 2, kMaxEvictionPressure);
+    } else if (memory < 0.9 * target) {
+      _eviction_pressure = std::max(pressure / 2, 1.0f);
+    }
+    VLOG(1) << "MemorySparseTable estimated memory: " << memory
+            << " bytes, target: " << target << " bytes";
+  }
+  VLOG(1) << "MemorySparseTable::EvictStep scanned: " << total.scanned
+          << ", evicted: " << total.evicted << ", size: " << total.size
+          << ", pressure: " << _eviction_pressure.load()
+          << ", evicted in total: " << _evicted_num.load();
+  auto *admission = _value_accessor->GetAdmissionPolicy();
+  if (admission != nullptr) {
+    VLOG(1) << admission->GetName()
+            << " admitted: " << admission->AdmittedNum()
+            << ", rejected: " << admission->RejectedNum();
+  }
+  return total.evicted;
+}
+
+void MemorySparseTable::StopEviction() {
+  {
+    std::lock_guard<std::mutex> lock(_eviction_stop_mutex);
+    _eviction_stop = true;
+  }
+  _eviction_stop_cv.notify_all();
+  if (_eviction_thread.joinable()) {
+    _eviction_thread.join();
+  }
+}
+
 }  // namespace paddle::distributed
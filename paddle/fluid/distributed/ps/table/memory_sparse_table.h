@@ -18,6 +18,8 @@
 #include <assert.h>
 #include <pthread.h>
 
+#include <atomic>
+#include <condition_variable>  // NOLINT
 #include <memory>
 #include <mutex>  // NOLINT
 #include <string>
@@ -29,6 +31,8 @@
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include "paddle/fluid/distributed/ps/table/depends/sparse_table_text_file.h"
+#include "paddle/fluid/distributed/ps/table/depends/table_checkpoint.h"
 #include "paddle/utils/string/string_helper.h"
 
 #define PSERVER_SAVE_SUFFIX ".shard"
@@ -40,7 +44,10 @@ class MemorySparseTable : public Table {
  public:
   typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
   MemorySparseTable() {}
-  virtual ~MemorySparseTable() {}
+  virtual ~MemorySparseTable() {
+    StopEviction();
+    WaitCheckpointDone();
+  }
 
   // unused method end
   static int32_t sparse_local_shard_num(uint32_t shard_num,
@@ -113,11 +120,29 @@ class MemorySparseTable : public Table {
 
   virtual void Revert();
   virtual void CheckSavePrePatchDone();
+  // Waits for the checkpoint written in background by the last Save, see
+  // FLAGS_pserver_background_checkpoint.
+  void WaitCheckpointDone();
+  // Deletes the values the accessor evicts, scanning at least shard_budget
+  // keys of every shard from where the last step stopped, on the thread of
+  // the shard. The background eviction thread runs a step every interval_ms
+  // and raises the eviction pressure while the table is above its memory
+  // target, see SparseEvictionParameter. Returns the number of evicted
+  // values.
+  int64_t EvictStep();
+  int64_t EvictedNum() const { return _evicted_num.load(); }
+  float EvictionPressure() const { return _eviction_pressure.load(); }
 
  protected:
+  // Saves checkpoint (param 0 or 3) in the binary chunked format of
+  // depends/table_checkpoint.h, one part-xxx-xxxxx.bin file per shard.
+  // Returns 0 like the text format, as the counts of a background save are
+  // not known when it returns.
+  int32_t SaveCheckpoint(const std::string& table_path, int save_param);
   virtual int32_t SavePatch(const std::string& path, int save_param);
   virtual int32_t LoadPatch(const std::vector<std::string>& file_list,
                             int save_param);
+  void StopEviction();
 
   int _task_pool_size = 24;
   int _avg_local_shard_num;
@@ -136,7 +161,21 @@ class MemorySparseTable : public Table {
   std::unique_ptr<shard_type[]> _local_shards_new;
   std::unique_ptr<shard_type[]> _local_shards_patch_model;
   std::thread _save_patch_model_thread;
+  std::thread _save_checkpoint_thread;
   bool _use_gpu_graph = false;
+
+  // for eviction
+  // Held by the eviction steps, and by Save, Load and Shrink which walk the
+  // shards outside of their threads.
+  std::mutex _eviction_mutex;
+  // The bucket of each shard the next eviction step starts from.
+  std::vector<size_t> _eviction_bucket;
+  std::atomic<float> _eviction_pressure{1.0f};
+  std::atomic<int64_t> _evicted_num{0};
+  std::thread _eviction_thread;
+  std::mutex _eviction_stop_mutex;
+  std::condition_variable _eviction_stop_cv;
+  bool _eviction_stop{false};
 };
 
 }  // namespace distributed
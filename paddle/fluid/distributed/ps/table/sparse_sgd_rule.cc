@@ -17,6 +17,7 @@
 #include "glog/logging.h"
 
 #include "paddle/common/flags.h"
+#include "paddle/phi/kernels/funcs/jit/kernels.h"
 
 PD_DEFINE_bool(enable_show_scale_gradient, true, "enable show scale gradient");
 
@@ -44,6 +45,7 @@ void SparseNaiveSGDRule::UpdateValueWork(float *w,
                                          float *sgd,
                                          const float *push_value,
                                          float scale) {
+#pragma omp simd
   for (size_t i = 0; i < _embedding_dim; ++i) {
     w[i] -= learning_rate_ * push_value[i];
     BoundValue(w[i]);
@@ -93,11 +95,13 @@ void SparseAdaGradSGDRule::UpdateValueWork(float *w,
                                            float scale) {
   float &g2sum = sgd[G2SumIndex()];
   double add_g2sum = 0;
+  // Hoisted so that the loop does not reload g2sum, which w may alias.
+  const double ratio = sqrt(_initial_g2sum / (_initial_g2sum + g2sum));
 
+#pragma omp simd reduction(+ : add_g2sum)
   for (size_t i = 0; i < _embedding_dim; i++) {
     double scaled_grad = grad[i] / scale;
-    w[i] -= learning_rate_ * scaled_grad *
-            sqrt(_initial_g2sum / (_initial_g2sum + g2sum));
+    w[i] -= learning_rate_ * scaled_grad * ratio;
     BoundValue(w[i]);
     add_g2sum += scaled_grad * scaled_grad;
   }
@@ -148,6 +152,7 @@ void StdAdaGradSGDRule::UpdateValueWork(float *w,
                                         float *sgd,
                                         const float *grad,
                                         float scale) {
+#pragma omp simd
   for (size_t i = 0; i < _embedding_dim; i++) {
     float &g2sum = sgd[G2SumIndex() + i];
     double scaled_grad = grad[i] / scale;
@@ -202,28 +207,46 @@ void SparseAdamSGDRule::UpdateValueWork(float *w,
                                         float *sgd,
                                         const float *grad,
                                         float scale) {
-  float *gsum = sgd + GSumIndex();
-  float *g2sum = sgd + G2SumIndex();
-  float *beta1_pow = sgd + Beta1PowIndex();
-  float *beta2_pow = sgd + Beta2PowIndex();
-  const float *g = grad;
-
-  float lr = learning_rate_;
-  float beta1_pow_ = *beta1_pow;
-  float beta2_pow_ = *beta2_pow;
+  UpdateValueBatchWork(&w, &sgd, &grad, &scale, 1);
+}
 
-  lr *= sqrt(1 - beta2_pow_) / (1 - beta1_pow_);
-  for (size_t i = 0; i < _embedding_dim; i++) {
-    // Calculation
-    gsum[i] = _beta1_decay_rate * gsum[i] + (1 - _beta1_decay_rate) * g[i];
-    g2sum[i] =
-        _beta2_decay_rate * g2sum[i] + (1 - _beta2_decay_rate) * g[i] * g[i];
-    w[i] = w[i] - lr * (gsum[i] / (sqrt(g2sum[i]) + _ada_epsilon));
-    BoundValue(w[i]);
+void SparseAdamSGDRule::UpdateValueBatchWork(float **w,
+                                             float **sgd,
+                                             const float **grad,
+                                             const float *scale,
+                                             size_t num) {
+  // The same kernel as the dense adam op, generated for the host ISA.
+  auto adam =
+      phi::jit::KernelFuncs<phi::jit::AdamTuple<float>, phi::CPUPlace>::Cache()
+          .At(phi::jit::adam_attr_t(_beta1_decay_rate, _beta2_decay_rate));
+  const int64_t numel = static_cast<int64_t>(_embedding_dim);
+  for (size_t k = 0; k < num; ++k) {
+    float *gsum = sgd[k] + GSumIndex();
+    float *g2sum = sgd[k] + G2SumIndex();
+    float *beta1_pow = sgd[k] + Beta1PowIndex();
+    float *beta2_pow = sgd[k] + Beta2PowIndex();
+
+    float lr = learning_rate_;
+    lr *= sqrt(1 - *beta2_pow) / (1 - *beta1_pow);
+    adam(_beta1_decay_rate,
+         _beta2_decay_rate,
+         -lr,
+         _ada_epsilon,
+         numel,
+         grad[k],
+         gsum,
+         g2sum,
+         w[k],
+         gsum,
+         g2sum,
+         w[k]);
+    for (size_t i = 0; i < _embedding_dim; i++) {
+      BoundValue(w[k][i]);
+    }
+    // update beta_pow_decay
+    (*beta1_pow) *= _beta1_decay_rate;
+    (*beta2_pow) *= _beta2_decay_rate;
   }
-  // update beta_pow_decay
-  (*beta1_pow) *= _beta1_decay_rate;
-  (*beta2_pow) *= _beta2_decay_rate;
 }
 
 void SparseAdamSGDRule::InitValueWork(float *value,
@@ -291,6 +314,7 @@ void SparseSharedAdamSGDRule::UpdateValueWork(float *w,
   lr *= sqrt(1 - beta2_pow_) / (1 - beta1_pow_);
   double sum_gsum = 0.0;
   double sum_g2sum = 0.0;
+#pragma omp simd reduction(+ : sum_gsum, sum_g2sum)
   for (size_t i = 0; i < _embedding_dim; i++) {
     // Calculation
     double new_gsum =
@@ -362,15 +386,18 @@ void SparseAdaGradV2SGDRule::UpdateValueWork(float *w,
   double add_g2sum = 0;
   float epsilon = 1e-8;
 
+#pragma omp simd reduction(+ : add_g2sum)
   for (size_t i = 0; i < _embedding_dim; i++) {
     double scaled_grad = grad[i] / scale;
     add_g2sum += scaled_grad * scaled_grad;
   }
   g2sum += add_g2sum / _embedding_dim;
 
+  const double denominator = sqrt(g2sum) + epsilon;
+#pragma omp simd
   for (size_t i = 0; i < _embedding_dim; i++) {
     double scaled_grad = grad[i] / scale;
-    w[i] -= learning_rate_ * scaled_grad / (sqrt(g2sum) + epsilon);
+    w[i] -= learning_rate_ * scaled_grad / denominator;
     BoundValue(w[i]);
   }
 }
@@ -51,6 +51,24 @@ class SparseValueSGDRule {
                    float scale = 1) {
     UpdateValueWork(w, sgd, push_value, scale);
   }
+  // Updates the values of num features at once, e.g. of the keys of a
+  // push, which lets the rules run their kernels across the batch.
+  void UpdateValue(float** w,
+                   float** sgd,
+                   const float** push_values,
+                   const float* scales,
+                   size_t num) {
+    UpdateValueBatchWork(w, sgd, push_values, scales, num);
+  }
+  virtual void UpdateValueBatchWork(float** w,
+                                    float** sgd,
+                                    const float** push_values,
+                                    const float* scales,
+                                    size_t num) {
+    for (size_t i = 0; i < num; ++i) {
+      UpdateValueWork(w[i], sgd[i], push_values[i], scales[i]);
+    }
+  }
   template <class T>
   void BoundValue(T& w) {  // NOLINT
     if (!(w >= _min_bound)) {
@@ -151,6 +169,11 @@ class SparseAdamSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** w,
+                                    float** sgd,
+                                    const float** push_values,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return _embedding_dim * 2 + 2; }
   size_t GSumIndex() { return 0; }
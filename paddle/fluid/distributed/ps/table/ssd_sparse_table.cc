@@ -14,6 +14,8 @@
 
 #include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
 
+#include <algorithm>
+
 #include "paddle/common/flags.h"
 #include "paddle/fluid/distributed/common/cost_timer.h"
 #include "paddle/fluid/distributed/common/local_random.h"
@@ -25,6 +27,10 @@ PD_DECLARE_bool(pserver_create_value_when_push);
 PD_DECLARE_bool(pserver_enable_create_feasign_randomly);
 PD_DEFINE_bool(pserver_open_strict_check, false, "pserver_open_strict_check");
 PD_DEFINE_int32(pserver_load_batch_size, 5000, "load batch size for ssd");
+PD_DEFINE_int32(pserver_ssd_cache_mb,
+                0,
+                "memory in MB of the value cache in front of rocksdb per "
+                "ssd sparse table, 0 to disable it");
 PHI_DEFINE_EXPORTED_string(rocksdb_path,
                            "database",
                            "path of sparse table rocksdb file");
@@ -36,6 +42,17 @@ int32_t SSDSparseTable::Initialize() {
   MemorySparseTable::Initialize();
   _db = ::paddle::distributed::RocksDBHandler::GetInstance();
   _db->initialize(FLAGS_rocksdb_path, _real_local_shard_num);
+  _shard_mutexes.reset(new std::mutex[_real_local_shard_num]);
+  if (FLAGS_pserver_ssd_cache_mb > 0 && _real_local_shard_num > 0) {
+    size_t shard_cache_bytes =
+        static_cast<size_t>(FLAGS_pserver_ssd_cache_mb) * 1024 * 1024 /
+        _real_local_shard_num;
+    for (int i = 0; i < _real_local_shard_num; ++i) {
+      _value_caches.emplace_back(new SSDValueCache(shard_cache_bytes));
+    }
+    _prefetch_pool.reset(
+        new ::ThreadPool(std::min(_real_local_shard_num, kPrefetchThreadNum)));
+  }
   VLOG(0) << "initialize SSDSparseTable succ";
   VLOG(0) << "SSD FLAGS_pserver_print_missed_key_num_every_push:"
           << FLAGS_pserver_print_missed_key_num_every_push;
@@ -107,13 +124,23 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                &missed_keys]() -> int {
                 auto& keys = task_keys[shard_id];
                 auto& local_shard = _local_shards[shard_id];
+                std::lock_guard<std::mutex> shard_guard(
+                    _shard_mutexes[shard_id]);
                 float data_buffer[value_size];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
+                uint64_t mem_hits = 0, ssd_hits = 0, ssd_read_bytes = 0;
                 for (size_t i = 0; i < keys.size(); ++i) {
                   uint64_t key = keys[i].first;
                   auto itr = local_shard.find(key);
                   size_t data_size = value_size - mf_value_size;
-                  if (itr == local_shard.end()) {
+                  FixedFeatureValue* cached = nullptr;
+                  if (itr == local_shard.end() &&
+                      (cached = TakeFromCache(shard_id, key)) != nullptr) {
+                    data_size = cached->size();
+                    memcpy(data_buffer_ptr,
+                           cached->data(),
+                           data_size * sizeof(float));
+                  } else if (itr == local_shard.end()) {
                     // pull rocksdb
                     std::string tmp_string("");
                     if (_db->get(shard_id,
@@ -134,6 +161,8 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                                data_size * sizeof(float));
                       }
                     } else {
+                      ++ssd_hits;
+                      ssd_read_bytes += tmp_string.size();
                       data_size = tmp_string.size() / sizeof(float);
                       memcpy(data_buffer_ptr,
                              ::paddle::string::str_to_float(tmp_string),
@@ -149,6 +178,7 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                                     sizeof(uint64_t));
                     }
                   } else {
+                    ++mem_hits;
                     data_size = itr.value().size();
                     memcpy(data_buffer_ptr,
                            itr.value().data(),
@@ -164,12 +194,16 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                   _value_accessor->Select(
                       &select_data, (const float**)&data_buffer_ptr, 1);
                 }
+                _mem_hits += mem_hits;
+                _ssd_hits += ssd_hits;
+                _ssd_read_bytes += ssd_read_bytes;
                 return 0;
               });
     }
     for (int i = 0; i < _real_local_shard_num; ++i) {
       tasks[i].wait();
     }
+    _ssd_misses += missed_keys.load();
     if (FLAGS_pserver_print_missed_key_num_every_push) {
       LOG(WARNING) << "total pull keys:" << num
                    << " missed_keys:" << missed_keys.load();
@@ -195,13 +229,22 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
     cur_ctx->reset();
     FixedFeatureValue* ret = nullptr;
     auto& local_shard = _local_shards[shard_id];
+    std::lock_guard<std::mutex> shard_guard(_shard_mutexes[shard_id]);
     float data_buffer[value_size];  // NOLINT
     float* data_buffer_ptr = data_buffer;
+    uint64_t mem_hits = 0, ssd_hits = 0, ssd_misses = 0, ssd_read_bytes = 0;
 
     for (size_t i = 0; i < num; ++i) {
       uint64_t key = pull_keys[i];
       auto itr = local_shard.find(key);
-      if (itr == local_shard.end()) {
+      if (itr == local_shard.end() &&
+          (ret = TakeFromCache(shard_id, key)) != nullptr) {
+        _value_accessor->UpdateTimeDecay(ret->data(), true);
+#ifdef PADDLE_WITH_PSLIB
+        _value_accessor->UpdatePassId(ret->data(), pass_id);
+#endif
+        pull_values[i] = reinterpret_cast<char*>(ret);
+      } else if (itr == local_shard.end()) {
         cur_ctx->batch_index.push_back(i);
         cur_ctx->batch_keys.emplace_back(
             reinterpret_cast<const char*>(&(pull_keys[i])), sizeof(uint64_t));
@@ -225,6 +268,7 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
               uint64_t cur_key = *(reinterpret_cast<uint64_t*>(
                   const_cast<char*>(cur_ctx->batch_keys[idx].data())));
               if (cur_ctx->status[idx].IsNotFound()) {
+                ++ssd_misses;
                 auto& feature_value = local_shard[cur_key];
                 int init_size = value_size - mf_value_size;
                 feature_value.resize(init_size);
@@ -234,6 +278,8 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
                        init_size * sizeof(float));
                 ret = &feature_value;
               } else {
+                ++ssd_hits;
+                ssd_read_bytes += cur_ctx->batch_values[idx].size();
                 int data_size =
                     cur_ctx->batch_values[idx].size() / sizeof(float);
                 // from rocksdb to mem
@@ -262,6 +308,7 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
           tasks.push_back(std::move(fut));
         }
       } else {
+        ++mem_hits;
         ret = itr.value_ptr();
         // int pull_data_idx = keys[i].second;
         _value_accessor->UpdateTimeDecay(ret->data(), true);
@@ -295,6 +342,7 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
         uint64_t cur_key = *(reinterpret_cast<uint64_t*>(
             const_cast<char*>(cur_ctx->batch_keys[idx].data())));
         if (cur_ctx->status[idx].IsNotFound()) {
+          ++ssd_misses;
           auto& feature_value = local_shard[cur_key];
           int init_size = value_size - mf_value_size;
           feature_value.resize(init_size);
@@ -304,6 +352,8 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
                  init_size * sizeof(float));
           ret = &feature_value;
         } else {
+          ++ssd_hits;
+          ssd_read_bytes += cur_ctx->batch_values[idx].size();
           int data_size = cur_ctx->batch_values[idx].size() / sizeof(float);
           // from rocksdb to mem
           auto& feature_value = local_shard[cur_key];
@@ -325,6 +375,10 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
       }
       cur_ctx->reset();
     }
+    _mem_hits += mem_hits;
+    _ssd_hits += ssd_hits;
+    _ssd_misses += ssd_misses;
+    _ssd_read_bytes += ssd_read_bytes;
   }
   return 0;
 }
@@ -359,6 +413,8 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                &task_keys]() -> int {
                 auto& keys = task_keys[shard_id];
                 auto& local_shard = _local_shards[shard_id];
+                std::lock_guard<std::mutex> shard_guard(
+                    _shard_mutexes[shard_id]);
                 float data_buffer[value_col];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
                 for (size_t i = 0; i < keys.size(); ++i) {
@@ -460,6 +516,8 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                   -> int {
                 auto& keys = task_keys[shard_id];
                 auto& local_shard = _local_shards[shard_id];
+                std::lock_guard<std::mutex> shard_guard(
+                    _shard_mutexes[shard_id]);
                 float data_buffer[value_col];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
                 for (size_t i = 0; i < keys.size(); ++i) {
@@ -515,6 +573,7 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
 }
 
 int32_t SSDSparseTable::Shrink(const std::string& param) {
+  WaitPrefetch();
   int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
@@ -537,6 +596,10 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
       if (_value_accessor->Shrink(
               ::paddle::string::str_to_float(it->value().data()))) {
         _db->del_data(i, it->key().data(), it->key().size());
+        if (!_value_caches.empty()) {
+          _value_caches[i]->Erase(
+              *reinterpret_cast<const uint64_t*>(it->key().data()));
+        }
         ssd_count++;
       } else {
         _db->put(i,
@@ -544,6 +607,14 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
                  it->key().size(),
                  it->value().data(),
                  it->value().size());
+        // the cached copy must see the decay, or the next pull takes the
+        // old value back to memory
+        if (!_value_caches.empty()) {
+          _value_caches[i]->Update(
+              *reinterpret_cast<const uint64_t*>(it->key().data()),
+              it->value().data(),
+              it->value().size());
+        }
       }
     }
     delete it;
@@ -555,6 +626,7 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
 }
 
 int32_t SSDSparseTable::UpdateTable() {
+  WaitPrefetch();
   int count = 0;
   for (int i = 0; i < _real_local_shard_num; ++i) {
     auto& shard = _local_shards[i];
@@ -566,6 +638,7 @@ int32_t SSDSparseTable::UpdateTable() {
                  sizeof(uint64_t),
                  reinterpret_cast<const char*>(it.value().data()),
                  it.value().size() * sizeof(float));
+        PutToCache(i, it.key(), it.value().data(), it.value().size());
         count++;
         it = shard.erase(it);
       } else {
@@ -588,6 +661,7 @@ int64_t SSDSparseTable::LocalSize() {
 
 int32_t SSDSparseTable::Save(const std::string& path,
                              const std::string& param) {
+  WaitPrefetch();
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
   // gpu graph mode
   if (_use_gpu_graph) {
@@ -2516,6 +2590,10 @@ int32_t SSDSparseTable::SaveCache(
 
 int32_t SSDSparseTable::Load(const std::string& path,
                              const std::string& param) {
+  WaitPrefetch();
+  for (auto& cache : _value_caches) {
+    cache->Clear();
+  }
   VLOG(0) << "LOAD FLAGS_rocksdb_path:" << FLAGS_rocksdb_path;
   std::string table_path = TableDir(path);
   auto file_list = _afs_client.list(table_path);
@@ -2942,10 +3020,144 @@ int32_t SSDSparseTable::LoadWithBinary(const std::string& path, int param) {
 
 std::pair<int64_t, int64_t> SSDSparseTable::PrintTableStat() {
   int64_t feasign_size = LocalSize();
+  TierStat stat = GetTierStat();
+  LOG(INFO) << "SSDSparseTable pull stat, mem hits: " << stat.mem_hits
+            << ", cache hits: " << stat.cache.hits
+            << ", cache hit bytes: " << stat.cache.hit_bytes
+            << ", ssd hits: " << stat.ssd_hits
+            << ", ssd read bytes: " << stat.ssd_read_bytes
+            << ", new keys: " << stat.ssd_misses
+            << "; cache entries: " << stat.cache.entries
+            << ", cache bytes: " << stat.cache.bytes
+            << ", admits: " << stat.cache.admits
+            << ", rejects: " << stat.cache.rejects
+            << ", evicts: " << stat.cache.evicts;
   return {feasign_size, -1};
 }
 
+SSDSparseTable::TierStat SSDSparseTable::GetTierStat() {
+  TierStat stat;
+  stat.mem_hits = _mem_hits.load();
+  stat.ssd_hits = _ssd_hits.load();
+  stat.ssd_misses = _ssd_misses.load();
+  stat.ssd_read_bytes = _ssd_read_bytes.load();
+  for (auto& cache : _value_caches) {
+    stat.cache += cache->GetStat();
+  }
+  return stat;
+}
+
+FixedFeatureValue* SSDSparseTable::TakeFromCache(int shard_id, uint64_t key) {
+  if (_value_caches.empty()) {
+    return nullptr;
+  }
+  std::string value;
+  if (!_value_caches[shard_id]->Take(key, &value)) {
+    return nullptr;
+  }
+  // from cache to mem, the ssd copy goes away as for a rocksdb hit
+  auto& feature_value = _local_shards[shard_id][key];
+  feature_value.resize(value.size() / sizeof(float));
+  memcpy(feature_value.data(), value.data(), value.size());
+  _db->del_data(shard_id, reinterpret_cast<char*>(&key), sizeof(uint64_t));
+  return &feature_value;
+}
+
+void SSDSparseTable::PutToCache(int shard_id,
+                                uint64_t key,
+                                const float* data,
+                                size_t num) {
+  if (_value_caches.empty()) {
+    return;
+  }
+  _value_caches[shard_id]->Put(
+      key, reinterpret_cast<const char*>(data), num * sizeof(float));
+}
+
+int32_t SSDSparseTable::PrefetchSparse(const uint64_t* keys, size_t num) {
+  if (_value_caches.empty()) {
+    return 0;
+  }
+  auto task_keys = std::make_shared<std::vector<std::vector<uint64_t>>>(
+      _real_local_shard_num);
+  for (size_t i = 0; i < num; ++i) {
+    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
+    (*task_keys)[shard_id].push_back(keys[i]);
+  }
+  std::lock_guard<std::mutex> guard(_prefetch_mutex);
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    if ((*task_keys)[shard_id].empty()) {
+      continue;
+    }
+    _prefetch_tasks.push_back(
+        _prefetch_pool->enqueue([this, shard_id, task_keys]() -> int {
+          return PrefetchShard(shard_id, &(*task_keys)[shard_id]);
+        }));
+  }
+  return 0;
+}
+
+int SSDSparseTable::PrefetchShard(int shard_id,
+                                  std::vector<uint64_t>* shard_keys) {
+  auto& keys = *shard_keys;
+  auto& local_shard = _local_shards[shard_id];
+  auto& cache = _value_caches[shard_id];
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  RocksDBItem item;
+  for (size_t begin = 0; begin < keys.size(); begin += 1024) {
+    item.reset();
+    size_t end = std::min(keys.size(), begin + 1024);
+    {
+      std::lock_guard<std::mutex> shard_guard(_shard_mutexes[shard_id]);
+      for (size_t i = begin; i < end; ++i) {
+        if (local_shard.find(keys[i]) == local_shard.end() &&
+            !cache->Contains(keys[i])) {
+          item.batch_keys.emplace_back(
+              reinterpret_cast<const char*>(&keys[i]), sizeof(uint64_t));
+        }
+      }
+    }
+    if (item.batch_keys.empty()) {
+      continue;
+    }
+    item.batch_values.resize(item.batch_keys.size());
+    item.status.resize(item.batch_keys.size());
+    _db->multi_get(shard_id,
+                   item.batch_keys.size(),
+                   item.batch_keys.data(),
+                   item.batch_values.data(),
+                   item.status.data());
+    // A pull may have moved the key to memory, and deleted it from
+    // rocksdb, while reading; only keys still on SSD go to the cache.
+    std::lock_guard<std::mutex> shard_guard(_shard_mutexes[shard_id]);
+    for (size_t idx = 0; idx < item.status.size(); ++idx) {
+      uint64_t key =
+          *reinterpret_cast<const uint64_t*>(item.batch_keys[idx].data());
+      if (!item.status[idx].ok() ||
+          local_shard.find(key) != local_shard.end()) {
+        continue;
+      }
+      _ssd_read_bytes += item.batch_values[idx].size();
+      cache->Put(key,
+                 item.batch_values[idx].data(),
+                 item.batch_values[idx].size(),
+                 true);
+    }
+  }
+  return 0;
+}
+
+void SSDSparseTable::WaitPrefetch() {
+  std::lock_guard<std::mutex> guard(_prefetch_mutex);
+  for (auto& task : _prefetch_tasks) {
+    task.wait();
+  }
+  _prefetch_tasks.clear();
+}
+
 int32_t SSDSparseTable::CacheTable(uint16_t pass_id) {
+  WaitPrefetch();
   std::lock_guard<std::mutex> guard(_table_mutex);
   VLOG(0) << "cache_table";
   std::atomic<uint32_t> count{0};
@@ -3059,6 +3271,8 @@ int32_t SSDSparseTable::CacheTable(uint16_t pass_id) {
                           << status.getState();
                   abort();
                 }
+                PutToCache(
+                    shard_id, tmp_key, tmp_value.data(), tmp_value.size());
               }
               status = sst_writer.Finish();
               if (!status.ok()) {
@@ -14,8 +14,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "paddle/common/flags.h"
 #include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+#include "paddle/fluid/distributed/ps/table/depends/ssd_value_cache.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
 
 namespace paddle {
@@ -81,12 +88,22 @@ class SSDSparseTable : public MemorySparseTable {
   int32_t PushSparse(const uint64_t* keys, const float* values, size_t num);
   int32_t PushSparse(const uint64_t* keys, const float** values, size_t num);
 
+  // Reads the values of keys that are only on SSD into the value cache in
+  // the background, see PS_PREFETCH_SPARSE_TABLE. Save, Load, Shrink,
+  // UpdateTable and CacheTable wait for pending prefetches first.
+  int32_t PrefetchSparse(const uint64_t* keys, size_t num) override;
+  void WaitPrefetch();
+
   int32_t Flush() override { return 0; }
   int32_t Shrink(const std::string& param) override;
   void Clear() override {
+    WaitPrefetch();
     for (int i = 0; i < _real_local_shard_num; ++i) {
       _local_shards[i].clear();
     }
+    for (auto& cache : _value_caches) {
+      cache->Clear();
+    }
   }
 
   int32_t Save(const std::string& path, const std::string& param) override;
@@ -130,13 +147,41 @@ class SSDSparseTable : public MemorySparseTable {
 
   void SetDayId(int day_id) override;
 
+  struct TierStat {
+    uint64_t mem_hits;
+    uint64_t ssd_hits;
+    uint64_t ssd_misses;
+    uint64_t ssd_read_bytes;
+    SSDValueCacheStat cache;
+  };
+  TierStat GetTierStat();
+
  private:
+  // Moves key from the value cache into the memory shard, returns nullptr
+  // when the cache is disabled or does not hold key.
+  FixedFeatureValue* TakeFromCache(int shard_id, uint64_t key);
+  void PutToCache(int shard_id, uint64_t key, const float* data, size_t num);
+  int PrefetchShard(int shard_id, std::vector<uint64_t>* shard_keys);
+
   RocksDBHandler* _db;
   int64_t _cache_tk_size;
   double _local_show_threshold{0.0};
   std::vector<paddle::framework::Channel<std::string>> _fs_channel;
   std::mutex _table_mutex;
   int _day_id = 0;
+
+  static constexpr int kPrefetchThreadNum = 8;
+  // Guards a memory shard against prefetch, which runs outside the shard
+  // task pools.
+  std::unique_ptr<std::mutex[]> _shard_mutexes;
+  std::vector<std::unique_ptr<SSDValueCache>> _value_caches;
+  std::unique_ptr<::ThreadPool> _prefetch_pool;
+  std::vector<std::future<int>> _prefetch_tasks;
+  std::mutex _prefetch_mutex;
+  std::atomic<uint64_t> _mem_hits{0};
+  std::atomic<uint64_t> _ssd_hits{0};
+  std::atomic<uint64_t> _ssd_misses{0};
+  std::atomic<uint64_t> _ssd_read_bytes{0};
 };
 
 }  // namespace distributed
@@ -761,6 +761,16 @@ void FleetWrapper::ShrinkSparseTable(int table_id, int threshold) {
   }
 }
 
+void FleetWrapper::PrefetchSparse(const uint64_t table_id,
+                                  const std::vector<uint64_t>& keys) {
+  auto ret = worker_ptr_->PrefetchSparse(table_id, keys.data(), keys.size());
+  ret.wait();
+  int32_t err_code = ret.get();
+  if (err_code == -1) {
+    LOG(ERROR) << "prefetch sparse table failed";
+  }
+}
+
 void FleetWrapper::ClearModel() {
   auto ret = pserver_ptr_->_worker_ptr->Clear();
   ret.wait();
@@ -271,6 +271,10 @@ class FleetWrapper {
   void ClearOneTable(const uint64_t table_id);
   // shrink sparse table
   void ShrinkSparseTable(int table_id, int threshold);
+  // Starts reading the values of keys, e.g. of the next pass, on the
+  // servers while the current pass trains.
+  void PrefetchSparse(const uint64_t table_id,
+                      const std::vector<uint64_t>& keys);
   // shrink dense table
   void ShrinkDenseTable(int table_id,
                         Scope* scope,
@@ -16,6 +16,7 @@ limitations under the License. */
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/common/registerer.h"
@@ -27,6 +28,8 @@ REGISTER_PSCORE_CLASS(SparseValueSGDRule, SparseAdaGradSGDRule);
 REGISTER_PSCORE_CLASS(SparseValueSGDRule, StdAdaGradSGDRule);
 REGISTER_PSCORE_CLASS(SparseValueSGDRule, SparseAdamSGDRule);
 REGISTER_PSCORE_CLASS(SparseValueSGDRule, SparseNaiveSGDRule);
+REGISTER_PSCORE_CLASS(FeatureAdmissionPolicy, CountMinSketchAdmission);
+REGISTER_PSCORE_CLASS(FeatureAdmissionPolicy, BloomFilterAdmission);
 
 TableAccessorParameter gen_param() {
   TableAccessorParameter param;
@@ -314,4 +317,86 @@ TEST(downpour_feature_value_accessor_test, test_string_related) {
     ASSERT_FLOAT_EQ(value[i], 0);
   }
 }
+
+TEST(downpour_feature_value_accessor_test, test_admit) {
+  float push_value[12] = {0};
+  CtrCommonAccessor::CtrCommonPushValue::Show(push_value) = 1;
+
+  TableAccessorParameter parameter = gen_param();
+  CtrCommonAccessor* acc = new CtrCommonAccessor();
+  ASSERT_EQ(acc->Configure(parameter), 0);
+  ASSERT_EQ(acc->Initialize(), 0);
+  ASSERT_EQ(acc->GetAdmissionPolicy(), nullptr);
+  ASSERT_TRUE(acc->Admit(1, push_value));
+
+  // A key is admitted once 3 shows are counted for it.
+  auto* admission_param = parameter.mutable_admission_param();
+  admission_param->set_name("CountMinSketchAdmission");
+  admission_param->set_threshold(3);
+  admission_param->set_width(1024);
+  acc = new CtrCommonAccessor();
+  ASSERT_EQ(acc->Configure(parameter), 0);
+  ASSERT_EQ(acc->Initialize(), 0);
+  ASSERT_FALSE(acc->Admit(1, push_value));
+  ASSERT_FALSE(acc->Admit(2, push_value));
+  ASSERT_FALSE(acc->Admit(1, push_value));
+  ASSERT_TRUE(acc->Admit(1, push_value));
+  CtrCommonAccessor::CtrCommonPushValue::Show(push_value) = 5;
+  ASSERT_TRUE(acc->Admit(3, push_value));
+  ASSERT_EQ(acc->GetAdmissionPolicy()->AdmittedNum(), 2UL);
+  ASSERT_EQ(acc->GetAdmissionPolicy()->RejectedNum(), 3UL);
+
+  // A key is admitted the second time it is seen.
+  admission_param->set_name("BloomFilterAdmission");
+  acc = new CtrCommonAccessor();
+  ASSERT_EQ(acc->Configure(parameter), 0);
+  ASSERT_EQ(acc->Initialize(), 0);
+  ASSERT_FALSE(acc->Admit(1, push_value));
+  ASSERT_FALSE(acc->Admit(2, push_value));
+  ASSERT_TRUE(acc->Admit(1, push_value));
+  ASSERT_TRUE(acc->Admit(2, push_value));
+}
+
+TEST(downpour_feature_value_accessor_test, test_admission_decay) {
+  // Two checks halve the two halves of the sketch, one half each.
+  FeatureAdmissionParameter param;
+  param.set_threshold(1000);
+  param.set_width(1024);
+  param.set_depth(1);
+  param.set_decay_interval(2);
+  CountMinSketchAdmission sketch;
+  sketch.Initialize(param);
+  ASSERT_EQ(sketch.MemorySize(), 1024 * sizeof(uint32_t));
+  ASSERT_FALSE(sketch.Admit(1, 100));
+  ASSERT_EQ(sketch.Estimate(1), 100U);
+  ASSERT_FALSE(sketch.Admit(2, 1));
+  ASSERT_FALSE(sketch.Admit(2, 1));
+  ASSERT_EQ(sketch.Estimate(1), 50U);
+  ASSERT_FALSE(sketch.Admit(2, 1));
+  ASSERT_FALSE(sketch.Admit(2, 1));
+  ASSERT_EQ(sketch.Estimate(1), 25U);
+}
+
+TEST(downpour_feature_value_accessor_test, test_evict) {
+  TableAccessorParameter parameter = gen_param();
+  parameter.mutable_ctr_accessor_param()->set_delete_threshold(0.8);
+  parameter.mutable_ctr_accessor_param()->set_delete_after_unseen_days(30);
+  CtrCommonAccessor* acc = new CtrCommonAccessor();
+  ASSERT_EQ(acc->Configure(parameter), 0);
+  ASSERT_EQ(acc->Initialize(), 0);
+
+  std::vector<float> value(acc->GetAccessorInfo().dim, 0);
+  acc->common_feature_value.Show(value.data()) = 10;
+  acc->common_feature_value.Click(value.data()) = 1;
+  acc->common_feature_value.UnseenDays(value.data()) = 10;
+  // The score is 9 * 0.2 + 1 = 2.8.
+  ASSERT_FALSE(acc->Evict(value.data(), 1));
+  ASSERT_FALSE(acc->Evict(value.data(), 2));
+  ASSERT_TRUE(acc->Evict(value.data(), 4));
+  // Unlike Shrink, Evict does not decay the value.
+  ASSERT_FLOAT_EQ(acc->common_feature_value.Show(value.data()), 10);
+
+  acc->common_feature_value.UnseenDays(value.data()) = 31;
+  ASSERT_TRUE(acc->Evict(value.data(), 1));
+}
 }  // namespace paddle::distributed
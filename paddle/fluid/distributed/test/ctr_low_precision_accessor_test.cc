@@ -0,0 +1,220 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/ctr_low_precision_accessor.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/common/registerer.h"
+#include "paddle/fluid/distributed/ps/table/sparse_sgd_rule.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+
+namespace paddle::distributed {
+REGISTER_PSCORE_CLASS(SparseValueSGDRule, SparseAdaGradSGDRule);
+REGISTER_PSCORE_CLASS(SparseValueSGDRule, SparseNaiveSGDRule);
+
+TableAccessorParameter gen_param(const std::string& storage) {
+  TableAccessorParameter param;
+  param.set_accessor_class("CtrLowPrecisionAccessor");
+  param.set_fea_dim(11);
+  param.set_embedx_dim(8);
+  param.set_embedx_threshold(1);
+  param.mutable_ctr_accessor_param()->set_nonclk_coeff(0.2);
+  param.mutable_ctr_accessor_param()->set_click_coeff(1);
+  param.mutable_ctr_accessor_param()->set_embedx_storage(storage);
+
+  param.mutable_embed_sgd_param()->set_name("SparseAdaGradSGDRule");
+  auto* adagrad_param = param.mutable_embed_sgd_param()->mutable_adagrad();
+  adagrad_param->set_learning_rate(0.1);
+  adagrad_param->set_initial_range(0.3);
+  adagrad_param->set_initial_g2sum(0.0);
+  adagrad_param->add_weight_bounds(-10.0);
+  adagrad_param->add_weight_bounds(10.0);
+
+  param.mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto* naive_param = param.mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  naive_param->add_weight_bounds(-10.0);
+  naive_param->add_weight_bounds(10.0);
+  return param;
+}
+
+// The largest error of an embedx_w of at most 1 rounded to the nearest.
+float max_error(const std::string& storage) {
+  if (storage == "fp16") {
+    return std::pow(2.0f, -11);
+  }
+  if (storage == "bf16") {
+    return std::pow(2.0f, -8);
+  }
+  return 1.0f / 254;
+}
+
+TEST(CtrLowPrecisionAccessor, test_create_select) {
+  for (std::string storage : {"fp16", "bf16", "int8"}) {
+    CtrLowPrecisionAccessor acc;
+    ASSERT_EQ(acc.Configure(gen_param(storage)), 0);
+    ASSERT_EQ(acc.Initialize(), 0);
+    auto& feature_value = acc.low_precision_feature_value;
+    auto info = acc.GetAccessorInfo();
+    ASSERT_EQ(info.dim, static_cast<size_t>(feature_value.Dim()));
+    ASSERT_EQ(info.mf_size, 8 * sizeof(float));
+    ASSERT_EQ(info.select_dim, 11UL);
+    ASSERT_EQ(info.update_dim, 12UL);
+    // Without the master copy a value is smaller than that of
+    // CtrCommonAccessor.
+    int base_dim = feature_value.EmbedxMasterWIndex();
+    ASSERT_LT(base_dim, acc.common_feature_value.Dim());
+    ASSERT_FALSE(acc.HasMF(base_dim));
+    ASSERT_TRUE(acc.HasMF(feature_value.Dim()));
+
+    std::vector<float> value(info.dim);
+    float* value_ptr = value.data();
+    acc.Create(&value_ptr, 1);
+    ASSERT_EQ(feature_value.EmbedxState(value_ptr),
+              CtrLowPrecisionAccessor::kEmbedxLowPrecision);
+    ASSERT_FALSE(acc.NeedExtendMF(value_ptr));
+
+    std::vector<float> embedx_w(8);
+    for (int i = 0; i < 8; ++i) {
+      embedx_w[i] = (i - 4) * 0.11f;
+    }
+    acc.StoreEmbedx(embedx_w.data(), false, value_ptr);
+    std::vector<float> select(info.select_dim);
+    float* select_ptr = select.data();
+    acc.Select(&select_ptr, (const float**)&value_ptr, 1);
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_NEAR(select[3 + i], embedx_w[i], max_error(storage)) << storage;
+    }
+  }
+}
+
+TEST(CtrLowPrecisionAccessor, test_stochastic_rounding) {
+  for (std::string storage : {"fp16", "bf16", "int8"}) {
+    CtrLowPrecisionAccessor acc;
+    ASSERT_EQ(acc.Configure(gen_param(storage)), 0);
+    ASSERT_EQ(acc.Initialize(), 0);
+    std::vector<float> value(acc.GetAccessorInfo().dim);
+    float* value_ptr = value.data();
+    acc.Create(&value_ptr, 1);
+
+    // Values between two values of the storage type, except the largest
+    // one, which fixes the int8 scale.
+    std::vector<float> embedx_w = {
+        0.1001f, -0.3337f, 0.0123f, 0.7771f, -0.0005f, 0.25f, 0.0f, 1.0f};
+    std::vector<double> sum(8, 0);
+    std::vector<float> loaded(8);
+    const int rounds = 20000;
+    for (int round = 0; round < rounds; ++round) {
+      acc.StoreEmbedx(embedx_w.data(), true, value_ptr);
+      acc.LoadEmbedx(value_ptr, loaded.data());
+      for (int i = 0; i < 8; ++i) {
+        ASSERT_NEAR(loaded[i], embedx_w[i], 2 * max_error(storage));
+        sum[i] += loaded[i];
+      }
+    }
+    // The rounding is unbiased.
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_NEAR(sum[i] / rounds, embedx_w[i], max_error(storage) / 20)
+          << storage << " " << i;
+    }
+  }
+}
+
+TEST(CtrLowPrecisionAccessor, test_update) {
+  for (std::string storage : {"fp16", "bf16", "int8"}) {
+    CtrLowPrecisionAccessor acc;
+    ASSERT_EQ(acc.Configure(gen_param(storage)), 0);
+    ASSERT_EQ(acc.Initialize(), 0);
+    auto& feature_value = acc.low_precision_feature_value;
+    auto info = acc.GetAccessorInfo();
+    std::vector<float> value(info.dim);
+    float* value_ptr = value.data();
+    acc.Create(&value_ptr, 1);
+    std::vector<float> embedx_w(8);
+    acc.LoadEmbedx(value_ptr, embedx_w.data());
+
+    // slot, show, click, embed_g, embedx_g
+    std::vector<float> push = {1, 1, 0, 0.1, 1, -1, 1, -1, 1, -1, 1, -1};
+    const float* push_ptr = push.data();
+    std::vector<float> select(info.select_dim);
+    float* select_ptr = select.data();
+
+    // A score of 0.2 keeps the value in low precision.
+    acc.Update(&value_ptr, &push_ptr, 1);
+    ASSERT_EQ(feature_value.EmbedxState(value_ptr),
+              CtrLowPrecisionAccessor::kEmbedxLowPrecision);
+    acc.Select(&select_ptr, (const float**)&value_ptr, 1);
+    for (int i = 0; i < 8; ++i) {
+      embedx_w[i] -= 0.1f * push[4 + i];
+      ASSERT_NEAR(select[3 + i], embedx_w[i], 2 * max_error(storage));
+    }
+
+    // A score of 1.2 asks the table to extend the value.
+    push[2] = 1;
+    acc.Update(&value_ptr, &push_ptr, 1);
+    ASSERT_TRUE(acc.NeedExtendMF(value_ptr));
+    acc.LoadEmbedx(value_ptr, embedx_w.data());
+
+    // The next update initializes the master copy from the stored embedx_w.
+    acc.Update(&value_ptr, &push_ptr, 1);
+    ASSERT_EQ(feature_value.EmbedxState(value_ptr),
+              CtrLowPrecisionAccessor::kEmbedxMaster);
+    acc.Select(&select_ptr, (const float**)&value_ptr, 1);
+    for (int i = 0; i < 8; ++i) {
+      embedx_w[i] -= 0.1f * push[4 + i];
+      ASSERT_NEAR(select[3 + i], embedx_w[i], 1e-6);
+      ASSERT_NEAR(
+          feature_value.EmbedxMasterW(value_ptr)[i], embedx_w[i], 1e-6);
+    }
+    ASSERT_FLOAT_EQ(acc.common_feature_value.Show(value_ptr), 3);
+    ASSERT_FLOAT_EQ(acc.common_feature_value.Click(value_ptr), 2);
+  }
+}
+
+TEST(CtrLowPrecisionAccessor, test_string_related) {
+  CtrLowPrecisionAccessor acc;
+  ASSERT_EQ(acc.Configure(gen_param("fp16")), 0);
+  ASSERT_EQ(acc.Initialize(), 0);
+  auto& feature_value = acc.low_precision_feature_value;
+  std::vector<float> value(acc.GetAccessorInfo().dim);
+  float* value_ptr = value.data();
+
+  // Values of CtrCommonAccessor with a score below embedx_threshold, and
+  // without or with embedx_w.
+  ASSERT_EQ(acc.ParseFromString("1 0 0 2 0 0.5 0.1", value_ptr),
+            feature_value.EmbedxMasterWIndex());
+  ASSERT_EQ(feature_value.EmbedxState(value_ptr),
+            CtrLowPrecisionAccessor::kEmbedxLowPrecision);
+  ASSERT_EQ(
+      acc.ParseFromString("1 0 0 2 0 0.5 0.1 1 2 3 4 5 6 7 0.125", value_ptr),
+      feature_value.EmbedxMasterWIndex());
+  ASSERT_EQ(acc.ParseToString(value_ptr, 0),
+            "1 0 0 2 0 0.5 0.1 1 2 3 4 5 6 7 0.125");
+
+  // A score above keeps embedx_w in fp32.
+  ASSERT_EQ(acc.ParseFromString("1 0 0 2 1 0.5 0.1 1 2 3 4 5 6 7 0.1001",
+                                value_ptr),
+            feature_value.Dim());
+  ASSERT_EQ(feature_value.EmbedxState(value_ptr),
+            CtrLowPrecisionAccessor::kEmbedxMaster);
+  ASSERT_EQ(acc.ParseToString(value_ptr, 0),
+            "1 0 0 2 1 0.5 0.1 1 2 3 4 5 6 7 0.1001");
+}
+
+}  // namespace paddle::distributed
@@ -14,9 +14,11 @@ limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
 
+#include <unordered_map>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/depends/flat_sparse_table_shard.h"
 
 namespace paddle::distributed {
 
@@ -45,4 +47,48 @@ TEST(BENCHMARK, LargeScaleKV) {
   ASSERT_FLOAT_EQ(value_data[3], 0.3);
 }
 
+TEST(FlatSparseTableShard, InsertFindErase) {
+  FlatSparseTableShard<uint64_t> shard;
+  std::unordered_map<uint64_t, float> expect;
+  // Keys of one table shard share their residue, like in MemorySparseTable.
+  for (uint64_t i = 0; i < 100000; ++i) {
+    uint64_t key = i * 37 + 5;
+    auto res = shard.emplace(key, 4);
+    ASSERT_TRUE(res.second);
+    auto &value = res.first.value();
+    value.resize(4);
+    value.data()[0] = static_cast<float>(i);
+    expect[key] = static_cast<float>(i);
+  }
+  ASSERT_FALSE(shard.emplace(5, 4).second);
+  ASSERT_EQ(shard.size(), expect.size());
+
+  // Growing a value keeps its contents and its key.
+  auto itr = shard.find(5 + 37 * 7);
+  ASSERT_TRUE(itr != shard.end());
+  FlatFeatureValue *grown = shard.resize(itr, 12);
+  ASSERT_EQ(grown->size(), 12UL);
+  ASSERT_FLOAT_EQ(grown->data()[0], 7.0);
+  ASSERT_EQ(shard.find(5 + 37 * 7).value_ptr(), grown);
+
+  for (auto it = shard.begin(); it != shard.end();) {
+    ASSERT_FLOAT_EQ(it.value().data()[0], expect[it.key()]);
+    if (it.key() % 2 == 0) {
+      expect.erase(it.key());
+      it = shard.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ASSERT_EQ(shard.size(), expect.size());
+  for (auto &kv : expect) {
+    auto it = shard.find(kv.first);
+    ASSERT_TRUE(it != shard.end());
+    ASSERT_FLOAT_EQ(it.value().data()[0], kv.second);
+  }
+  ASSERT_TRUE(shard.find(5 + 37) == shard.end());
+  shard.clear();
+  ASSERT_TRUE(shard.empty());
+}
+
 }  // namespace paddle::distributed
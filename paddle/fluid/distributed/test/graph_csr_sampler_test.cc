@@ -0,0 +1,122 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_sampler.h"
+
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+// Builds node i with the neighbors 100 * i + j of the weights weights[i][j].
+std::vector<std::unique_ptr<GraphNode>> BuildNodes(
+    const std::vector<std::vector<float>> &weights, bool is_weighted) {
+  std::vector<std::unique_ptr<GraphNode>> nodes;
+  for (size_t i = 0; i < weights.size(); i++) {
+    nodes.emplace_back(new GraphNode(i));
+    nodes.back()->build_edges(is_weighted);
+    for (size_t j = 0; j < weights[i].size(); j++) {
+      nodes.back()->add_edge(100 * i + j, weights[i][j]);
+    }
+  }
+  return nodes;
+}
+
+std::vector<Node *> NodePointers(
+    const std::vector<std::unique_ptr<GraphNode>> &nodes) {
+  std::vector<Node *> res;
+  for (auto &node : nodes) {
+    res.push_back(node.get());
+  }
+  return res;
+}
+
+TEST(CsrNeighborSampler, Build) {
+  auto nodes = BuildNodes({{1, 2, 3}, {}, {4}}, true);
+  CsrNeighborSampler sampler;
+  sampler.build(NodePointers(nodes), true);
+  ASSERT_EQ(sampler.node_num(), 3UL);
+  ASSERT_EQ(sampler.edge_num(), 4UL);
+  ASSERT_EQ(sampler.degree(0), 3);
+  ASSERT_EQ(sampler.degree(1), 0);
+  ASSERT_EQ(sampler.neighbor_id(0, 2), 2UL);
+  ASSERT_EQ(sampler.neighbor_id(2, 0), 200UL);
+  ASSERT_FLOAT_EQ(sampler.neighbor_weight(0, 1), 2);
+  ASSERT_TRUE(sampler.matches(2, nodes[2].get()));
+  ASSERT_FALSE(sampler.matches(1, nodes[2].get()));
+
+  // A node that gains an edge no longer matches its row.
+  nodes[2]->add_edge(201, 1);
+  ASSERT_FALSE(sampler.matches(2, nodes[2].get()));
+
+  // Rows of at most k neighbors return all of them.
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  sampler.sample_k(0, 3, &rng, &res);
+  ASSERT_EQ(res, std::vector<int>({0, 1, 2}));
+  sampler.sample_k(1, 3, &rng, &res);
+  ASSERT_TRUE(res.empty());
+}
+
+TEST(CsrNeighborSampler, SampleDistinct) {
+  std::mt19937_64 rng(0);
+  for (bool is_weighted : {false, true}) {
+    std::vector<float> weights;
+    for (int i = 0; i < 300; i++) {
+      weights.push_back(i % 7 + 1);
+    }
+    auto nodes = BuildNodes({weights}, is_weighted);
+    CsrNeighborSampler sampler;
+    sampler.build(NodePointers(nodes), is_weighted);
+    // Covers the scan, the shuffle and the exact paths.
+    for (int k : {1, 10, 64, 100, 299}) {
+      std::vector<int> res;
+      sampler.sample_k(0, k, &rng, &res);
+      ASSERT_EQ(res.size(), static_cast<size_t>(k));
+      std::set<int> distinct(res.begin(), res.end());
+      ASSERT_EQ(distinct.size(), res.size());
+      ASSERT_GE(*distinct.begin(), 0);
+      ASSERT_LT(*distinct.rbegin(), 300);
+    }
+  }
+}
+
+TEST(CsrNeighborSampler, SampleWeighted) {
+  // The neighbors of weight 0 are only sampled when nothing else is left.
+  auto nodes = BuildNodes({{0, 1, 0, 3, 0, 0}}, true);
+  CsrNeighborSampler sampler;
+  sampler.build(NodePointers(nodes), true);
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  std::vector<int> count(6, 0);
+  const int rounds = 20000;
+  for (int i = 0; i < rounds; i++) {
+    sampler.sample_k(0, 1, &rng, &res);
+    ASSERT_EQ(res.size(), 1UL);
+    count[res[0]]++;
+    sampler.sample_k(0, 2, &rng, &res);
+    std::set<int> distinct(res.begin(), res.end());
+    ASSERT_EQ(distinct, std::set<int>({1, 3}));
+  }
+  ASSERT_EQ(count[0] + count[2] + count[4] + count[5], 0);
+  ASSERT_NEAR(static_cast<double>(count[3]) / rounds, 0.75, 0.02);
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -13,10 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
+#include "paddle/fluid/distributed/ps/table/memory_flat_sparse_table.h"
 
 #include <ThreadPool.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
 
@@ -152,5 +155,209 @@ TEST(MemorySparseTable, SGD) {
   }
 }
 
+TEST(MemorySparseTable, AdmitAndEvict) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  table_config.mutable_eviction_param()->set_shard_budget(1);
+  FsClientParameter fs_config;
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_ctr_accessor_param()->set_nonclk_coeff(0.2);
+  accessor_config->mutable_ctr_accessor_param()->set_click_coeff(1);
+  accessor_config->mutable_ctr_accessor_param()->set_delete_threshold(0.8);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *admission_param = accessor_config->mutable_admission_param();
+  admission_param->set_name("CountMinSketchAdmission");
+  admission_param->set_threshold(2);
+  admission_param->set_width(1024);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  // Pushes a show and a click of the keys.
+  std::vector<uint64_t> keys = {0, 1, 2, 3, 4};
+  auto push = [&](float click) {
+    std::vector<float> values(keys.size() * (emb_dim + 4), 0);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      values[i * (emb_dim + 4) + 1] = 1;
+      values[i * (emb_dim + 4) + 2] = click;
+    }
+    ASSERT_EQ(table->PushSparse(keys.data(), values.data(), keys.size()), 0);
+  };
+
+  // The keys get values the second time they are pushed.
+  push(0);
+  ASSERT_EQ(table->LocalSize(), 0);
+  push(0);
+  ASSERT_EQ(table->LocalSize(), 5);
+
+  // The eviction steps scan at least a bucket of every shard, and sooner or
+  // later delete the values of score 0.2 below the delete threshold.
+  for (int i = 0; i < 64 && table->LocalSize() > 0; ++i) {
+    table->EvictStep();
+  }
+  ASSERT_EQ(table->LocalSize(), 0);
+  ASSERT_EQ(table->EvictedNum(), 5);
+
+  // Values of score 3 are kept.
+  push(1);
+  push(1);
+  push(1);
+  ASSERT_EQ(table->LocalSize(), 5);
+  for (int i = 0; i < 64; ++i) {
+    table->EvictStep();
+  }
+  ASSERT_EQ(table->LocalSize(), 5);
+  ASSERT_FLOAT_EQ(table->EvictionPressure(), 1);
+}
+
+TEST(MemorySparseTable, EvictAboveMemoryTarget) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  // The steps scan whole shards, and the table is soon above 1 MB.
+  table_config.mutable_eviction_param()->set_memory_target_mb(1);
+  FsClientParameter fs_config;
+  std::unique_ptr<MemorySparseTable> table(new MemorySparseTable());
+  table->SetShard(0, 1);
+
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_ctr_accessor_param()->set_nonclk_coeff(0.2);
+  accessor_config->mutable_ctr_accessor_param()->set_click_coeff(1);
+  accessor_config->mutable_ctr_accessor_param()->set_delete_threshold(0.8);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  // Three shows and clicks give the keys values of score 3, far above the
+  // delete threshold.
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 50000; ++i) {
+    keys.push_back(i);
+  }
+  std::vector<float> values(keys.size() * (emb_dim + 4), 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    values[i * (emb_dim + 4) + 1] = 1;
+    values[i * (emb_dim + 4) + 2] = 1;
+  }
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(table->PushSparse(keys.data(), values.data(), keys.size()), 0);
+  }
+  ASSERT_EQ(table->LocalSize(), static_cast<int64_t>(keys.size()));
+
+  // Nothing is evicted at the plain threshold, but the table is above its
+  // memory target and the pressure rises.
+  ASSERT_EQ(table->EvictStep(), 0);
+  ASSERT_EQ(table->LocalSize(), static_cast<int64_t>(keys.size()));
+  ASSERT_FLOAT_EQ(table->EvictionPressure(), 2);
+
+  // The pressure keeps doubling until the raised threshold is above the
+  // score of the values, which are then evicted.
+  float max_pressure = table->EvictionPressure();
+  for (int i = 0; i < 16 && table->LocalSize() > 0; ++i) {
+    table->EvictStep();
+    max_pressure = std::max(max_pressure, table->EvictionPressure());
+  }
+  ASSERT_EQ(table->LocalSize(), 0);
+  ASSERT_EQ(table->EvictedNum(), static_cast<int64_t>(keys.size()));
+  ASSERT_GE(max_pressure, 4);
+  // The step that emptied the table found it below its target.
+  ASSERT_LT(table->EvictionPressure(), max_pressure);
+}
+
+TEST(MemoryFlatSparseTable, SameAsMemorySparseTable) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_shard_num(10);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  // Low enough for the embedx of every key to be created by the pushes.
+  accessor_config->set_embedx_threshold(1);
+  accessor_config->mutable_ctr_accessor_param()->set_nonclk_coeff(0.2);
+  accessor_config->mutable_ctr_accessor_param()->set_click_coeff(1);
+  accessor_config->mutable_ctr_accessor_param()->set_base_threshold(0.5);
+  accessor_config->mutable_ctr_accessor_param()->set_delta_threshold(0.2);
+  accessor_config->mutable_ctr_accessor_param()->set_delta_keep_days(16);
+  accessor_config->mutable_ctr_accessor_param()->set_show_click_decay_rate(
+      0.99);
+  // A zero initial range makes the values of both tables deterministic.
+  for (auto *sgd_param : {accessor_config->mutable_embed_sgd_param(),
+                          accessor_config->mutable_embedx_sgd_param()}) {
+    sgd_param->set_name("SparseNaiveSGDRule");
+    auto *naive_param = sgd_param->mutable_naive();
+    naive_param->set_learning_rate(0.1);
+    naive_param->set_initial_range(0.0);
+    naive_param->add_weight_bounds(-10.0);
+    naive_param->add_weight_bounds(10.0);
+  }
+  FsClientParameter fs_config;
+
+  std::vector<std::unique_ptr<Table>> tables;
+  tables.emplace_back(new MemorySparseTable());
+  tables.emplace_back(new MemoryFlatSparseTable());
+  table_config.set_table_class("MemorySparseTable");
+  tables[0]->SetShard(0, 1);
+  ASSERT_EQ(tables[0]->Initialize(table_config, fs_config), 0);
+  table_config.set_table_class("MemoryFlatSparseTable");
+  tables[1]->SetShard(0, 1);
+  ASSERT_EQ(tables[1]->Initialize(table_config, fs_config), 0);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    keys.push_back(i * 7);
+  }
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto pull_value = PullSparseValue(keys, fres, emb_dim);
+  // slot, show, click, embed_g, embedx_g
+  std::vector<float> push_values;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    push_values.push_back(0);
+    push_values.push_back(10);
+    push_values.push_back(static_cast<float>(i % 3));
+    for (int k = 0; k < emb_dim + 1; ++k) {
+      push_values.push_back(0.01 * ((i + k) % 11));
+    }
+  }
+
+  std::vector<std::vector<float>> results(tables.size());
+  for (size_t t = 0; t < tables.size(); ++t) {
+    for (int round = 0; round < 3; ++round) {
+      TableContext push_context;
+      push_context.value_type = Sparse;
+      push_context.push_context.keys = keys.data();
+      push_context.push_context.values = push_values.data();
+      push_context.num = keys.size();
+      ASSERT_EQ(tables[t]->Push(push_context), 0);
+    }
+    results[t].resize(keys.size() * (emb_dim + 3));
+    TableContext pull_context;
+    pull_context.value_type = Sparse;
+    pull_context.pull_context.pull_value = pull_value;
+    pull_context.pull_context.values = results[t].data();
+    ASSERT_EQ(tables[t]->Pull(pull_context), 0);
+  }
+  for (size_t i = 0; i < results[0].size(); ++i) {
+    ASSERT_FLOAT_EQ(results[0][i], results[1][i]);
+  }
+  auto stat0 = tables[0]->PrintTableStat();
+  auto stat1 = tables[1]->PrintTableStat();
+  ASSERT_EQ(stat0.first, stat1.first);
+  ASSERT_EQ(stat0.second, stat1.second);
+}
+
 }  // namespace distributed
 }  // namespace paddle
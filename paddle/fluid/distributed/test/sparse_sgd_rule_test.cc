@@ -16,6 +16,7 @@ limitations under the License. */
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/the_one_ps.pb.h"
@@ -205,5 +206,69 @@ TEST(downpour_sparse_adam_test, test_init_and_update) {
     ASSERT_FLOAT_EQ(value[i], label[i]) << "i is " << i;
   }
 }
+
+void CheckBatchUpdate(SparseValueSGDRule* rule, size_t embed_dim) {
+  // Updating a batch of values, one of them twice, matches updating them
+  // one by one.
+  const size_t value_dim = embed_dim + rule->Dim();
+  const size_t num = 4;
+  std::vector<float> values(value_dim * num);
+  std::vector<float> labels(value_dim * num);
+  std::vector<float> grads(embed_dim * num);
+  for (size_t i = 0; i < num; ++i) {
+    rule->InitValue(values.data() + i * value_dim,
+                    values.data() + i * value_dim + embed_dim,
+                    false);
+    for (size_t j = 0; j < embed_dim; ++j) {
+      grads[i * embed_dim + j] = static_cast<float>(i + j) - 2.5f;
+    }
+  }
+  labels = values;
+  std::vector<size_t> items = {0, 1, 2, 1};
+  std::vector<float> scales = {1.0f, 2.0f, 0.5f, 3.0f};
+  std::vector<float*> w, sgd;
+  std::vector<const float*> push_values;
+  for (size_t k = 0; k < items.size(); ++k) {
+    float* label = labels.data() + items[k] * value_dim;
+    const float* grad = grads.data() + k * embed_dim;
+    rule->UpdateValue(label, label + embed_dim, grad, scales[k]);
+    w.push_back(values.data() + items[k] * value_dim);
+    sgd.push_back(w.back() + embed_dim);
+    push_values.push_back(grad);
+  }
+  rule->UpdateValue(
+      w.data(), sgd.data(), push_values.data(), scales.data(), items.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_FLOAT_EQ(values[i], labels[i]) << "i is " << i;
+  }
+}
+
+TEST(sparse_sgd_rule_test, test_batch_update) {
+  const size_t embed_dim = 13;
+  SparseCommonSGDRuleParameter param;
+  auto* adagrad_param = param.mutable_adagrad();
+  adagrad_param->set_learning_rate(0.1);
+  adagrad_param->set_initial_g2sum(0.2);
+  adagrad_param->set_initial_range(0.3);
+  auto* adam_param = param.mutable_adam();
+  adam_param->set_learning_rate(0.1);
+  adam_param->set_initial_range(0.3);
+  adam_param->set_beta1_decay_rate(0.9);
+  adam_param->set_beta2_decay_rate(0.999);
+  adam_param->set_ada_epsilon(1e-08);
+
+  SparseAdaGradSGDRule adagrad;
+  adagrad.LoadConfig(param, embed_dim);
+  CheckBatchUpdate(&adagrad, embed_dim);
+  StdAdaGradSGDRule std_adagrad;
+  std_adagrad.LoadConfig(param, embed_dim);
+  CheckBatchUpdate(&std_adagrad, embed_dim);
+  SparseAdamSGDRule adam;
+  adam.LoadConfig(param, embed_dim);
+  CheckBatchUpdate(&adam, embed_dim);
+  SparseSharedAdamSGDRule shared_adam;
+  shared_adam.LoadConfig(param, embed_dim);
+  CheckBatchUpdate(&shared_adam, embed_dim);
+}
 }  // namespace distributed
 }  // namespace paddle
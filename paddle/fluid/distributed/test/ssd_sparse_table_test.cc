@@ -0,0 +1,125 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+
+PD_DECLARE_int32(pserver_ssd_cache_mb);
+
+namespace paddle {
+namespace distributed {
+
+SSDSparseTable *CreateTable(int emb_dim) {
+  TableParameter table_config;
+  table_config.set_table_class("SSDSparseTable");
+  table_config.set_shard_num(10);
+  FsClientParameter fs_config;
+  SSDSparseTable *table = new SSDSparseTable();
+  table->SetShard(0, 1);
+
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  auto *ctr_param = accessor_config->mutable_ctr_accessor_param();
+  ctr_param->set_nonclk_coeff(0.2);
+  ctr_param->set_click_coeff(1);
+  ctr_param->set_delete_threshold(0.1);
+  ctr_param->set_show_click_decay_rate(0.5);
+  // every value goes to ssd in UpdateTable
+  ctr_param->set_ssd_unseenday_threshold(-1);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  EXPECT_EQ(table->Initialize(table_config, fs_config), 0);
+  return table;
+}
+
+TEST(SSDSparseTable, ShrinkDecaysCachedValues) {
+  int emb_dim = 8;
+  FLAGS_pserver_ssd_cache_mb = 1;
+  SSDSparseTable *table = CreateTable(emb_dim);
+
+  // push a show of 4 for every key
+  std::vector<uint64_t> keys = {0, 1, 2, 3, 4};
+  std::vector<float> push_values(keys.size() * (emb_dim + 4), 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    push_values[i * (emb_dim + 4) + 1] = 4;
+  }
+  ASSERT_EQ(
+      table->PushSparse(keys.data(), push_values.data(), keys.size()), 0);
+
+  // from memory to ssd, and to the value cache
+  ASSERT_EQ(table->UpdateTable(), 0);
+  ASSERT_EQ(table->LocalSize(), 0);
+  ASSERT_EQ(table->GetTierStat().cache.entries, keys.size());
+
+  // the shows are halved on ssd and in the cache
+  ASSERT_EQ(table->Shrink(""), 0);
+
+  std::vector<float> pull_values(keys.size() * (emb_dim + 3));
+  ASSERT_EQ(table->PullSparse(pull_values.data(), keys.data(), keys.size()),
+            0);
+  auto stat = table->GetTierStat();
+  ASSERT_EQ(stat.cache.hits, keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_FLOAT_EQ(pull_values[i * (emb_dim + 3)], 2);
+  }
+  ASSERT_EQ(table->LocalSize(), static_cast<int64_t>(keys.size()));
+  FLAGS_pserver_ssd_cache_mb = 0;
+}
+
+TEST(SSDSparseTable, PrefetchFillsValueCache) {
+  int emb_dim = 8;
+  FLAGS_pserver_ssd_cache_mb = 1;
+  SSDSparseTable *table = CreateTable(emb_dim);
+
+  std::vector<uint64_t> keys = {10, 11, 12, 13, 14};
+  std::vector<float> push_values(keys.size() * (emb_dim + 4), 0);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    push_values[i * (emb_dim + 4) + 1] = 4;
+  }
+  ASSERT_EQ(
+      table->PushSparse(keys.data(), push_values.data(), keys.size()), 0);
+  ASSERT_EQ(table->UpdateTable(), 0);
+  // drops memory and the value cache, the values stay on ssd only
+  table->Clear();
+  ASSERT_EQ(table->GetTierStat().cache.entries, 0UL);
+
+  ASSERT_EQ(table->PrefetchSparse(keys.data(), keys.size()), 0);
+  table->WaitPrefetch();
+  auto stat = table->GetTierStat();
+  ASSERT_EQ(stat.cache.entries, keys.size());
+  ASSERT_GT(stat.ssd_read_bytes, 0UL);
+
+  // the pull is served by the cache, not by rocksdb
+  std::vector<float> pull_values(keys.size() * (emb_dim + 3));
+  ASSERT_EQ(table->PullSparse(pull_values.data(), keys.data(), keys.size()),
+            0);
+  auto pulled = table->GetTierStat();
+  ASSERT_EQ(pulled.cache.hits, keys.size());
+  ASSERT_EQ(pulled.ssd_hits, stat.ssd_hits);
+  ASSERT_EQ(pulled.ssd_misses, stat.ssd_misses);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_FLOAT_EQ(pull_values[i * (emb_dim + 3)], 4);
+  }
+  FLAGS_pserver_ssd_cache_mb = 0;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,96 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/ssd_value_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle::distributed {
+
+TEST(SSDValueCache, TakeMovesValueOut) {
+  SSDValueCache cache(1024);
+  std::vector<float> value = {0.1, 0.2, 0.3};
+  ASSERT_TRUE(cache.Put(
+      7, reinterpret_cast<const char*>(value.data()), 3 * sizeof(float)));
+  ASSERT_TRUE(cache.Contains(7));
+
+  // the old content of out does not count
+  std::string out(100, 'x');
+  ASSERT_TRUE(cache.Take(7, &out));
+  ASSERT_EQ(out.size(), 3 * sizeof(float));
+  ASSERT_FLOAT_EQ(reinterpret_cast<const float*>(out.data())[2], 0.3);
+  ASSERT_FALSE(cache.Contains(7));
+  ASSERT_FALSE(cache.Take(7, &out));
+
+  auto stat = cache.GetStat();
+  ASSERT_EQ(stat.hits, 1UL);
+  ASSERT_EQ(stat.misses, 1UL);
+  ASSERT_EQ(stat.entries, 0UL);
+  ASSERT_EQ(stat.bytes, 0UL);
+}
+
+TEST(SSDValueCache, UpdateRefreshesCachedKeys) {
+  SSDValueCache cache(1024);
+  std::string value(16, 'a');
+  ASSERT_TRUE(cache.Put(1, value.data(), value.size()));
+
+  std::string updated(32, 'b');
+  ASSERT_TRUE(cache.Update(1, updated.data(), updated.size()));
+  // keys not cached are not added
+  ASSERT_FALSE(cache.Update(2, updated.data(), updated.size()));
+  ASSERT_FALSE(cache.Contains(2));
+  ASSERT_EQ(cache.GetStat().bytes, 32UL);
+
+  std::string out;
+  ASSERT_TRUE(cache.Take(1, &out));
+  ASSERT_EQ(out, updated);
+  ASSERT_EQ(cache.GetStat().bytes, 0UL);
+}
+
+TEST(SSDValueCache, FrequentKeysAreAdmitted) {
+  // Room for 4 values of 64 bytes.
+  SSDValueCache cache(256);
+  std::string value(64, 'x');
+  for (uint64_t key = 0; key < 4; ++key) {
+    ASSERT_TRUE(cache.Put(key, value.data(), value.size()));
+  }
+  // A key never looked up does not replace a cached one.
+  ASSERT_FALSE(cache.Put(100, value.data(), value.size()));
+  ASSERT_FALSE(cache.Contains(100));
+
+  // A key that keeps missing becomes more frequent than the cached ones.
+  std::string out;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_FALSE(cache.Take(100, &out));
+  }
+  ASSERT_TRUE(cache.Put(100, value.data(), value.size()));
+  ASSERT_TRUE(cache.Contains(100));
+
+  auto stat = cache.GetStat();
+  ASSERT_EQ(stat.entries, 4UL);
+  ASSERT_EQ(stat.bytes, 256UL);
+  ASSERT_EQ(stat.evicts, 1UL);
+  ASSERT_EQ(stat.rejects, 1UL);
+
+  // Forced puts always get in.
+  ASSERT_TRUE(cache.Put(200, value.data(), value.size(), true));
+  ASSERT_TRUE(cache.Contains(200));
+  cache.Clear();
+  ASSERT_EQ(cache.GetStat().bytes, 0UL);
+}
+
+}  // namespace paddle::distributed
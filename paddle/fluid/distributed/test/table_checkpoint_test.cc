@@ -0,0 +1,129 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/table_checkpoint.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle::distributed {
+
+namespace {
+
+std::shared_ptr<FILE> OpenTmpFile() {
+  return std::shared_ptr<FILE>(tmpfile(), [](FILE* fp) { fclose(fp); });
+}
+
+// Writes keys 0..num-1, key k having k % 7 + 1 values of k * 0.5.
+void WriteRecords(FILE* fp, CheckpointCodec codec, int num) {
+  FsWriteChannel channel;
+  channel.open(std::shared_ptr<FILE>(fp, [](FILE*) {}), FsChannelConfig());
+  CheckpointWriter writer(&channel, codec, 256);
+  ASSERT_EQ(writer.WriteHeader(), 0);
+  std::vector<float> values;
+  for (int k = 0; k < num; ++k) {
+    values.assign(k % 7 + 1, k * 0.5f);
+    ASSERT_EQ(writer.Append(k, values.data(), values.size()), 0);
+  }
+  ASSERT_EQ(writer.Finish(), 0);
+  fflush(fp);
+  rewind(fp);
+}
+
+// Returns the number of records read, or -1 when the file is rejected.
+int ReadRecords(FILE* fp) {
+  FsReadChannel channel;
+  channel.open(std::shared_ptr<FILE>(fp, [](FILE*) {}), FsChannelConfig());
+  CheckpointReader reader(&channel);
+  if (reader.ReadHeader() != 0) {
+    return -1;
+  }
+  uint64_t key = 0;
+  const float* values = nullptr;
+  uint32_t num = 0;
+  int count = 0;
+  int ret = 0;
+  while ((ret = reader.Next(&key, &values, &num)) > 0) {
+    EXPECT_EQ(key, static_cast<uint64_t>(count));
+    EXPECT_EQ(num, key % 7 + 1);
+    EXPECT_FLOAT_EQ(values[num - 1], key * 0.5f);
+    ++count;
+  }
+  return ret == 0 ? count : -1;
+}
+
+}  // namespace
+
+TEST(TableCheckpoint, RoundTrip) {
+  for (auto codec : {CheckpointCodec::kNone, CheckpointCodec::kZlib}) {
+    auto fp = OpenTmpFile();
+    WriteRecords(fp.get(), codec, 1000);
+    ASSERT_EQ(ReadRecords(fp.get()), 1000);
+  }
+}
+
+TEST(TableCheckpoint, EmptyFile) {
+  auto fp = OpenTmpFile();
+  WriteRecords(fp.get(), CheckpointCodec::kZlib, 0);
+  ASSERT_EQ(ReadRecords(fp.get()), 0);
+}
+
+TEST(TableCheckpoint, DetectsCorruption) {
+  auto fp = OpenTmpFile();
+  WriteRecords(fp.get(), CheckpointCodec::kNone, 100);
+  // Flip a byte in the payload of the first chunk.
+  long offset = sizeof(CheckpointFileHeader) +  // NOLINT
+                sizeof(CheckpointChunkHeader) + 5;
+  fseek(fp.get(), offset, SEEK_SET);
+  int c = fgetc(fp.get());
+  fseek(fp.get(), offset, SEEK_SET);
+  fputc(c ^ 0xff, fp.get());
+  fflush(fp.get());
+  rewind(fp.get());
+  ASSERT_EQ(ReadRecords(fp.get()), -1);
+}
+
+TEST(TableCheckpoint, DetectsTruncation) {
+  auto fp = OpenTmpFile();
+  WriteRecords(fp.get(), CheckpointCodec::kZlib, 100);
+  fseek(fp.get(), 0, SEEK_END);
+  long size = ftell(fp.get());  // NOLINT
+  std::vector<char> data(size - sizeof(CheckpointChunkHeader));
+  rewind(fp.get());
+  ASSERT_EQ(fread(data.data(), 1, data.size(), fp.get()), data.size());
+
+  auto truncated = OpenTmpFile();
+  fwrite(data.data(), 1, data.size(), truncated.get());
+  fflush(truncated.get());
+  rewind(truncated.get());
+  ASSERT_EQ(ReadRecords(truncated.get()), -1);
+}
+
+TEST(TableCheckpoint, ParseCodec) {
+  ASSERT_EQ(ParseCheckpointCodec("none"), CheckpointCodec::kNone);
+  ASSERT_EQ(ParseCheckpointCodec("zlib"), CheckpointCodec::kZlib);
+  ASSERT_TRUE(IsCheckpointFile("table/0/part-000-00001.bin"));
+  ASSERT_FALSE(IsCheckpointFile("table/0/part-000-00001.gz"));
+}
+
+TEST(TableCheckpoint, ParseChunkSize) {
+  ASSERT_EQ(ParseCheckpointChunkSize(4 << 20), 4U << 20);
+  ASSERT_THROW(ParseCheckpointChunkSize(0), common::enforce::EnforceNotMet);
+  ASSERT_THROW(ParseCheckpointChunkSize(-1), common::enforce::EnforceNotMet);
+}
+
+}  // namespace paddle::distributed
@@ -19,6 +19,9 @@ limitations under the License. */
 #define _LINUX
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <future>  // NOLINT
 #include <memory>
@@ -51,8 +54,6 @@ limitations under the License. */
 #include "paddle/common/flags.h"
 
 COMMON_DECLARE_int32(record_pool_max_size);
-COMMON_DECLARE_int32(slotpool_thread_num);
-COMMON_DECLARE_bool(enable_slotpool_wait_release);
 COMMON_DECLARE_bool(enable_slotrecord_reset_shrink);
 
 namespace paddle {
@@ -218,71 +219,103 @@ inline void free_slotrecord(SlotRecordObject* p) {
   free(p);
 }
 
+// Bounded multi-producer multi-consumer queue of pointers (Vyukov). Every
+// cell carries a sequence number telling whether it is ready for the next
+// push or pop, so producers and consumers never take a lock.
 template <class T>
-class SlotObjAllocator {
+class LockFreeBoundedQueue {
  public:
-  explicit SlotObjAllocator(std::function<void(T*)> deleter)
-      : free_nodes_(NULL), capacity_(0), deleter_(deleter) {}
-  ~SlotObjAllocator() { clear(); }
-
-  void clear() {
-    T* tmp = NULL;
-    while (free_nodes_ != NULL) {
-      tmp = reinterpret_cast<T*>(reinterpret_cast<void*>(free_nodes_));
-      free_nodes_ = free_nodes_->next;
-      deleter_(tmp);
-      --capacity_;
-    }
-    PADDLE_ENFORCE_EQ(capacity_,
-                      static_cast<size_t>(0),
-                      phi::errors::InvalidArgument(
-                          "There still are some nodes are not deleted"));
-  }
-  T* acquire(void) {
-    T* x = NULL;
-    x = reinterpret_cast<T*>(reinterpret_cast<void*>(free_nodes_));
-    free_nodes_ = free_nodes_->next;
-    --capacity_;
-    return x;
-  }
-  void release(T* x) {
-    Node* node = reinterpret_cast<Node*>(reinterpret_cast<void*>(x));
-    node->next = free_nodes_;
-    free_nodes_ = node;
-    ++capacity_;
-  }
-  size_t capacity(void) { return capacity_; }
+  explicit LockFreeBoundedQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool TryPush(T* value) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPop(T** value) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          *value = cell.value;
+          cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
 
  private:
-  struct alignas(T) Node {
-    union {
-      Node* next;
-      char data[sizeof(T)];
-    };
+  struct Cell {
+    std::atomic<size_t> seq;
+    T* value;
   };
-  Node* free_nodes_;  // a list
-  size_t capacity_;
-  std::function<void(T*)> deleter_ = nullptr;
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+struct SlotObjPoolStat {
+  uint64_t hits;      // records served from the pool
+  uint64_t misses;    // records allocated because the pool was empty
+  uint64_t recycled;  // records put back into the pool
+  uint64_t freed;     // records freed because the pool was full or disabled
+  int64_t cached;     // records held by the pool now
+  int64_t in_use;     // records got from the pool and not put back
 };
+
 static const int OBJPOOL_BLOCK_SIZE = 10000;
+// SlotObjPool recycles SlotRecords with their feasign buffers, whose
+// capacity is kept unless FLAGS_enable_slotrecord_reset_shrink is set.
+//
+// Each thread keeps a magazine of up to kMagazineSize records, so most get
+// and put calls touch no shared state. Full magazines are exchanged through
+// a lock-free depot. A pool must outlive the threads using it, which holds
+// for SlotRecordPool().
 class SlotObjPool {
  public:
+  static constexpr int kMagazineSize = 512;
+
   SlotObjPool()
-      : max_capacity_(FLAGS_record_pool_max_size), alloc_(free_slotrecord) {
-    ins_chan_ = MakeChannel<SlotRecord>();
-    ins_chan_->SetBlockSize(OBJPOOL_BLOCK_SIZE);
-    for (int i = 0; i < FLAGS_slotpool_thread_num; ++i) {
-      threads_.push_back(std::thread([this]() { run(); }));
-    }
-    disable_pool_ = false;
-    count_ = 0;
-  }
-  ~SlotObjPool() {
-    ins_chan_->Close();
-    for (auto& t : threads_) {
-      t.join();
-    }
-  }
+      : max_capacity_(FLAGS_record_pool_max_size),
+        depot_(FLAGS_record_pool_max_size / kMagazineSize + 1) {}
+  ~SlotObjPool() { clear(); }
   void disable_pool(bool disable) { disable_pool_ = disable; }
   void set_max_capacity(size_t max_capacity) { max_capacity_ = max_capacity; }
   void get(std::vector<SlotRecord>* output, int n) {
@@ -290,23 +323,31 @@ class SlotObjPool {
     return get(&(*output)[0], n);
   }
   void get(SlotRecord* output, int n) {
+    ThreadCache fallback;
+    ThreadCache* cache = GetThreadCache(&fallback);
     int size = 0;
-    mutex_.lock();
-    int left = static_cast<int>(alloc_.capacity());
-    if (left > 0) {
-      size = (left >= n) ? n : left;
-      for (int i = 0; i < size; ++i) {
-        output[i] = alloc_.acquire();
+    while (size < n) {
+      Magazine* mag = cache->loaded;
+      if (mag->size == 0) {
+        Magazine* full = nullptr;
+        if (!depot_.TryPop(&full)) {
+          break;
+        }
+        delete mag;
+        cache->loaded = mag = full;
       }
-    }
-    mutex_.unlock();
-    count_ += n;
-    if (size == n) {
-      return;
+      int num = std::min(n - size, mag->size);
+      mag->size -= num;
+      memcpy(output + size, mag->items + mag->size, num * sizeof(SlotRecord));
+      size += num;
     }
     for (int i = size; i < n; ++i) {
       output[i] = make_slotrecord();
     }
+    cached_ -= size;
+    hits_ += size;
+    misses_ += n - size;
+    count_ += n;
   }
   void put(std::vector<SlotRecord>* input) {
     size_t size = input->size();
@@ -317,68 +358,133 @@ class SlotObjPool {
     input->clear();
   }
   void put(SlotRecord* input, size_t size) {
-    PADDLE_ENFORCE_EQ(ins_chan_->WriteMove(size, input),
-                      size,
-                      phi::errors::InvalidArgument(
-                          "Incompatible size of input with given size"));
-  }
-  void run(void) {
-    std::vector<SlotRecord> input;
-    while (ins_chan_->ReadOnce(input, OBJPOOL_BLOCK_SIZE)) {
-      if (input.empty()) {
-        continue;
-      }
-      // over max capacity
-      size_t n = input.size();
-      count_ -= n;
-      if (disable_pool_ || n + capacity() > max_capacity_) {
-        for (auto& t : input) {
-          free_slotrecord(t);
-        }
-      } else {
-        for (auto& t : input) {
-          t->reset();
-        }
-        mutex_.lock();
-        for (auto& t : input) {
-          alloc_.release(t);
+    count_ -= size;
+    // over max capacity
+    int64_t room = disable_pool_ ? 0
+                                 : static_cast<int64_t>(max_capacity_) -
+                                       cached_.load(std::memory_order_relaxed);
+    size_t admit = room <= 0 ? 0 : std::min(size, static_cast<size_t>(room));
+    for (size_t i = admit; i < size; ++i) {
+      free_slotrecord(input[i]);
+    }
+    freed_ += size - admit;
+    if (admit == 0) {
+      return;
+    }
+    cached_ += admit;
+    recycled_ += admit;
+    ThreadCache fallback;
+    ThreadCache* cache = GetThreadCache(&fallback);
+    for (size_t i = 0; i < admit; ++i) {
+      Magazine* mag = cache->loaded;
+      if (mag->size == kMagazineSize) {
+        if (depot_.TryPush(mag)) {
+          cache->loaded = mag = new Magazine;
+        } else {
+          FreeRecords(mag);
         }
-        mutex_.unlock();
       }
-      input.clear();
+      input[i]->reset();
+      mag->items[mag->size++] = input[i];
     }
   }
+  // Frees the records in the depot and in the magazine of this thread.
+  // Unlike the pool with a shared free list, the records in the magazines
+  // of other threads are not freed, since only their threads touch them.
+  // They stay counted by capacity() and go to the depot when their threads
+  // exit, so a later clear() frees them.
   void clear(void) {
     platform::Timer timeline;
     timeline.Start();
-    mutex_.lock();
-    alloc_.clear();
-    mutex_.unlock();
-    // wait release channel data
-    if (FLAGS_enable_slotpool_wait_release) {
-      while (!ins_chan_->Empty()) {
-        sleep(1);
-      }
+    Magazine* mag = nullptr;
+    while (depot_.TryPop(&mag)) {
+      FreeRecords(mag);
+      delete mag;
+    }
+    ThreadCache* cache = GetThreadCache(nullptr);
+    if (cache != nullptr) {
+      FreeRecords(cache->loaded);
     }
     timeline.Pause();
+    auto pool_stat = stat();
     VLOG(3) << "clear slot pool data size=" << count_.load()
-            << ", span=" << timeline.ElapsedSec();
+            << ", span=" << timeline.ElapsedSec()
+            << ", hits=" << pool_stat.hits << ", misses=" << pool_stat.misses
+            << ", recycled=" << pool_stat.recycled
+            << ", freed=" << pool_stat.freed;
   }
   size_t capacity(void) {
-    mutex_.lock();
-    size_t total = alloc_.capacity();
-    mutex_.unlock();
-    return total;
+    int64_t cached = cached_.load(std::memory_order_relaxed);
+    return cached > 0 ? cached : 0;
+  }
+  SlotObjPoolStat stat(void) {
+    return {hits_.load(std::memory_order_relaxed),
+            misses_.load(std::memory_order_relaxed),
+            recycled_.load(std::memory_order_relaxed),
+            freed_.load(std::memory_order_relaxed),
+            cached_.load(std::memory_order_relaxed),
+            count_.load(std::memory_order_relaxed)};
   }
 
  private:
+  struct Magazine {
+    int size = 0;
+    SlotRecord items[kMagazineSize];
+  };
+  struct ThreadCache {
+    SlotObjPool* pool = nullptr;
+    Magazine* loaded = nullptr;
+    ~ThreadCache() {
+      if (pool != nullptr) {
+        pool->ReleaseThreadCache(this);
+      }
+    }
+  };
+
+  // Returns the cache of this thread, created on first use. A thread has one
+  // cache, owned by the first pool it used; other pools get fallback, a
+  // cache released when it goes out of scope, or nullptr if not given.
+  ThreadCache* GetThreadCache(ThreadCache* fallback) {
+    thread_local ThreadCache cache;
+    if (cache.pool == nullptr && fallback != nullptr) {
+      cache.pool = this;
+      cache.loaded = new Magazine;
+    }
+    if (cache.pool == this) {
+      return &cache;
+    }
+    if (fallback != nullptr) {
+      fallback->pool = this;
+      fallback->loaded = new Magazine;
+    }
+    return fallback;
+  }
+  void ReleaseThreadCache(ThreadCache* cache) {
+    if (cache->loaded->size == 0 || !depot_.TryPush(cache->loaded)) {
+      FreeRecords(cache->loaded);
+      delete cache->loaded;
+    }
+    cache->loaded = nullptr;
+    cache->pool = nullptr;
+  }
+  void FreeRecords(Magazine* mag) {
+    for (int i = 0; i < mag->size; ++i) {
+      free_slotrecord(mag->items[i]);
+    }
+    cached_ -= mag->size;
+    freed_ += mag->size;
+    mag->size = 0;
+  }
+
   size_t max_capacity_;
-  Channel<SlotRecord> ins_chan_;
-  std::vector<std::thread> threads_;
-  std::mutex mutex_;
-  SlotObjAllocator<SlotRecordObject> alloc_;
-  bool disable_pool_;
-  std::atomic<long> count_;  // NOLINT
+  LockFreeBoundedQueue<Magazine> depot_;
+  bool disable_pool_ = false;
+  std::atomic<long> count_{0};  // NOLINT
+  std::atomic<int64_t> cached_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> recycled_{0};
+  std::atomic<uint64_t> freed_{0};
 };
 
 inline SlotObjPool& SlotRecordPool() {
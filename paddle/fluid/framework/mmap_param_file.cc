@@ -0,0 +1,313 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/mmap_param_file.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "paddle/fluid/framework/convert_utils.h"
+#include "paddle/fluid/framework/tensor_util.h"
+#include "paddle/fluid/memory/allocation/mmap_allocator.h"
+#include "paddle/phi/common/port.h"
+
+namespace paddle::framework {
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'D', 'M', 'M', 'A', 'P', '\0', '\0'};
+constexpr uint32_t kAlignment = 64;
+
+struct MmapParamFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t tensor_num;
+  uint64_t index_offset;
+  uint64_t index_size;
+  char reserved[24];
+};
+static_assert(sizeof(MmapParamFileHeader) == 64,
+              "MmapParamFileHeader must be 64 bytes.");
+
+template <typename T>
+void WritePod(std::string* buf, const T& value) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Reads the index with bounds checks, so that a truncated or damaged file
+// fails with an error instead of reading past the mapping.
+class IndexReader {
+ public:
+  IndexReader(const char* data, size_t size, const std::string& file_path)
+      : data_(data), size_(size), file_path_(file_path) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    Check(sizeof(T));
+    std::memcpy(&value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return value;
+  }
+
+  std::string ReadString(size_t len) {
+    Check(len);
+    std::string value(data_ + pos_, len);
+    pos_ += len;
+    return value;
+  }
+
+ private:
+  void Check(size_t len) {
+    PADDLE_ENFORCE_LE(
+        len,
+        size_ - pos_,
+        common::errors::InvalidArgument(
+            "The index of parameter file %s is damaged.", file_path_));
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  const std::string& file_path_;
+};
+
+}  // namespace
+
+bool IsMmapParamFile(const std::string& file_path) {
+  std::ifstream fin(file_path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  if (!fin.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+void SaveMmapParamFile(const std::vector<const phi::DenseTensor*>& tensors,
+                       const std::vector<std::string>& names,
+                       const std::string& file_path,
+                       bool overwrite) {
+  PADDLE_ENFORCE_EQ(
+      tensors.size(),
+      names.size(),
+      common::errors::InvalidArgument(
+          "The number of tensors (%d) and names (%d) to save must be equal.",
+          tensors.size(),
+          names.size()));
+  PADDLE_ENFORCE_EQ(
+      FileExists(file_path) && !overwrite,
+      false,
+      common::errors::PreconditionNotMet(
+          "%s exists!, cannot save to it when overwrite is set to false.",
+          file_path));
+  MkDirRecursively(DirName(file_path).c_str());
+  std::ofstream fout(file_path, std::ios::binary);
+  PADDLE_ENFORCE_EQ(static_cast<bool>(fout),
+                    true,
+                    common::errors::Unavailable(
+                        "Cannot open %s to save variables.", file_path));
+
+  MmapParamFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  static const char kPadding[kAlignment] = {0};
+  uint64_t offset = sizeof(header);
+  std::string index;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const phi::DenseTensor* tensor = tensors[i];
+    PADDLE_ENFORCE_EQ(
+        tensor->IsInitialized(),
+        true,
+        common::errors::InvalidArgument(
+            "The Tensor %s to be saved is not initialized.", names[i]));
+    phi::DenseTensor cpu_tensor;
+    if (phi::is_cpu_place(tensor->place())) {
+      cpu_tensor.ShareDataWith(*tensor);
+    } else {
+      TensorCopySync(*tensor, phi::CPUPlace(), &cpu_tensor);
+    }
+    uint64_t bytes = cpu_tensor.numel() * phi::SizeOf(cpu_tensor.dtype());
+    fout.write(static_cast<const char*>(cpu_tensor.data()),
+               static_cast<std::streamsize>(bytes));
+
+    WritePod<uint64_t>(&index, names[i].size());
+    index.append(names[i]);
+    WritePod<int32_t>(&index,
+                      static_cast<int32_t>(TransToProtoVarType(
+                          cpu_tensor.dtype())));
+    auto dims = common::vectorize(tensor->dims());
+    WritePod<uint64_t>(&index, dims.size());
+    for (int64_t dim : dims) {
+      WritePod<int64_t>(&index, dim);
+    }
+    const auto& lod = tensor->lod();
+    WritePod<uint64_t>(&index, lod.size());
+    for (const auto& level : lod) {
+      WritePod<uint64_t>(&index, level.size());
+      for (size_t v : level) {
+        WritePod<uint64_t>(&index, v);
+      }
+    }
+    WritePod<uint64_t>(&index, offset);
+    WritePod<uint64_t>(&index, bytes);
+
+    offset += bytes;
+    uint64_t padding = (kAlignment - offset % kAlignment) % kAlignment;
+    fout.write(kPadding, static_cast<std::streamsize>(padding));
+    offset += padding;
+  }
+  fout.write(index.data(), static_cast<std::streamsize>(index.size()));
+
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kMmapParamFileVersion;
+  header.alignment = kAlignment;
+  header.tensor_num = tensors.size();
+  header.index_offset = offset;
+  header.index_size = index.size();
+  fout.seekp(0);
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fout.close();
+  PADDLE_ENFORCE_EQ(
+      static_cast<bool>(fout),
+      true,
+      common::errors::Unavailable("Failed to write variables to %s.",
+                                  file_path));
+}
+
+MmapParamFile::MmapParamFile(const std::string& file_path)
+    : file_path_(file_path) {
+#ifdef _WIN32
+  PADDLE_THROW(common::errors::Unimplemented(
+      "Memory mapped parameter files are not supported on Windows."));
+#else
+  mapping_ = memory::allocation::AllocateFileMemoryMapAllocation(file_path);
+  const char* base = static_cast<const char*>(mapping_->ptr());
+  size_t file_size = mapping_->size();
+
+  PADDLE_ENFORCE_GE(file_size,
+                    sizeof(MmapParamFileHeader),
+                    common::errors::InvalidArgument(
+                        "Parameter file %s is truncated.", file_path));
+  MmapParamFileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  PADDLE_ENFORCE_EQ(
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)),
+      0,
+      common::errors::InvalidArgument(
+          "%s is not a memory mapped parameter file.", file_path));
+  PADDLE_ENFORCE_LE(
+      header.version,
+      kMmapParamFileVersion,
+      common::errors::Unimplemented(
+          "Parameter file %s has version %d, but only version %d and below "
+          "are supported.",
+          file_path,
+          header.version,
+          kMmapParamFileVersion));
+  PADDLE_ENFORCE_EQ(
+      header.index_offset <= file_size &&
+          header.index_size <= file_size - header.index_offset,
+      true,
+      common::errors::InvalidArgument(
+          "The index of parameter file %s is out of range.", file_path));
+
+  IndexReader reader(base + header.index_offset, header.index_size, file_path);
+  entries_.resize(header.tensor_num);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    Entry& entry = entries_[i];
+    entry.name = reader.ReadString(reader.Read<uint64_t>());
+    entry.dtype = TransToPhiDataType(
+        static_cast<proto::VarType::Type>(reader.Read<int32_t>()));
+    entry.dims.resize(reader.Read<uint64_t>());
+    for (auto& dim : entry.dims) {
+      dim = reader.Read<int64_t>();
+    }
+    entry.lod.resize(reader.Read<uint64_t>());
+    for (auto& level : entry.lod) {
+      level.resize(reader.Read<uint64_t>());
+      for (auto& v : level) {
+        v = reader.Read<uint64_t>();
+      }
+    }
+    entry.offset = reader.Read<uint64_t>();
+    entry.bytes = reader.Read<uint64_t>();
+    PADDLE_ENFORCE_EQ(
+        entry.offset <= header.index_offset &&
+            entry.bytes <= header.index_offset - entry.offset,
+        true,
+        common::errors::InvalidArgument(
+            "The data of %s in parameter file %s is out of range.",
+            entry.name,
+            file_path));
+    name_to_idx_[entry.name] = i;
+  }
+#endif
+}
+
+void MmapParamFile::LoadTensor(size_t idx,
+                               const phi::Place& place,
+                               phi::DenseTensor* tensor) const {
+#ifndef _WIN32
+  PADDLE_ENFORCE_LT(
+      idx,
+      entries_.size(),
+      common::errors::OutOfRange(
+          "Parameter file %s holds %d tensors, but tensor %d is requested.",
+          file_path_,
+          entries_.size(),
+          idx));
+  const Entry& entry = entries_[idx];
+  auto dims = common::make_ddim(entry.dims);
+  PADDLE_ENFORCE_EQ(
+      static_cast<uint64_t>(common::product(dims)) * phi::SizeOf(entry.dtype),
+      entry.bytes,
+      common::errors::InvalidArgument(
+          "The data size of %s in parameter file %s does not match its shape.",
+          entry.name,
+          file_path_));
+
+  auto file = std::static_pointer_cast<
+      memory::allocation::FileMemoryMapAllocation>(mapping_);
+  auto holder =
+      std::make_shared<memory::allocation::FileMemoryMapViewAllocation>(
+          file, entry.offset, entry.bytes);
+  phi::DenseTensor mapped(holder, phi::DenseTensorMeta(entry.dtype, dims));
+  mapped.set_lod(entry.lod);
+
+  if (place.GetType() == phi::AllocationType::UNDEFINED ||
+      phi::is_cpu_place(place)) {
+    *tensor = mapped;
+  } else {
+    TensorCopySync(mapped, place, tensor);
+    tensor->set_lod(entry.lod);
+  }
+#endif
+}
+
+void MmapParamFile::LoadTensor(const std::string& name,
+                               const phi::Place& place,
+                               phi::DenseTensor* tensor) const {
+  auto it = name_to_idx_.find(name);
+  PADDLE_ENFORCE_NE(it,
+                    name_to_idx_.end(),
+                    common::errors::NotFound(
+                        "Tensor %s is not found in parameter file %s.",
+                        name,
+                        file_path_));
+  LoadTensor(it->second, place, tensor);
+}
+
+}  // namespace paddle::framework
@@ -0,0 +1,99 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/phi/core/allocator.h"
+#include "paddle/phi/core/dense_tensor.h"
+
+namespace paddle {
+namespace framework {
+
+/*
+ * A combined parameter file whose tensor data can be memory mapped.
+ *
+ * Layout (little endian):
+ *   header, 64 bytes:
+ *     char     magic[8]       "PDMMAP\0\0"
+ *     uint32_t version
+ *     uint32_t alignment      of every tensor data blob
+ *     uint64_t tensor_num
+ *     uint64_t index_offset
+ *     uint64_t index_size
+ *     reserved to 64 bytes
+ *   tensor data blobs, each starting at a multiple of alignment
+ *   index, one entry per tensor in saving order:
+ *     uint64_t name length, name
+ *     int32_t  data type (proto::VarType::Type)
+ *     uint64_t rank, int64_t dims[rank]
+ *     uint64_t lod level, per level: uint64_t size, uint64_t offsets[size]
+ *     uint64_t data offset, uint64_t data bytes
+ *
+ * Legacy combined files start with a uint32_t tensor version of 0, so the
+ * two formats are told apart by the magic.
+ */
+constexpr uint32_t kMmapParamFileVersion = 1;
+
+bool IsMmapParamFile(const std::string& file_path);
+
+// Saves tensors, which may live on any place, into file_path.
+void SaveMmapParamFile(const std::vector<const phi::DenseTensor*>& tensors,
+                       const std::vector<std::string>& names,
+                       const std::string& file_path,
+                       bool overwrite);
+
+class MmapParamFile {
+ public:
+  // Maps file_path and parses its index. Tensor data is not read.
+  explicit MmapParamFile(const std::string& file_path);
+
+  size_t size() const { return entries_.size(); }
+  const std::string& name(size_t idx) const { return entries_[idx].name; }
+  bool Has(const std::string& name) const {
+    return name_to_idx_.count(name) > 0;
+  }
+
+  // On CPU places the tensor shares the mapped pages, so nothing is read
+  // until the data is touched. Other places get a copy.
+  void LoadTensor(size_t idx,
+                  const phi::Place& place,
+                  phi::DenseTensor* tensor) const;
+  void LoadTensor(const std::string& name,
+                  const phi::Place& place,
+                  phi::DenseTensor* tensor) const;
+
+ private:
+  struct Entry {
+    std::string name;
+    phi::DataType dtype;
+    std::vector<int64_t> dims;
+    std::vector<std::vector<size_t>> lod;
+    uint64_t offset;
+    uint64_t bytes;
+  };
+
+  std::string file_path_;
+  std::shared_ptr<phi::Allocation> mapping_;
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, size_t> name_to_idx_;
+};
+
+}  // namespace framework
+}  // namespace paddle
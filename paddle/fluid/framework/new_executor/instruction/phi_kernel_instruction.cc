@@ -14,6 +14,7 @@
 
 #include "paddle/fluid/framework/new_executor/instruction/phi_kernel_instruction.h"
 
+#include "paddle/common/flags.h"
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
 #include "paddle/fluid/framework/new_executor/interpreter/stream_analyzer.h"
 #include "paddle/fluid/framework/new_executor/pir_adaptor/pir_adaptor_util.h"
@@ -33,6 +34,10 @@
 #include "paddle/pir/include/core/value.h"
 
 #include "paddle/fluid/framework/new_executor/instruction/instruction_util.h"
+
+COMMON_DECLARE_bool(pir_skip_stable_infer_meta);
+COMMON_DECLARE_bool(pir_capture_cpu_program);
+
 namespace paddle {
 namespace framework {
 
@@ -125,6 +130,12 @@ PhiKernelInstruction::PhiKernelInstruction(
         paddle::small_vector<phi::MetaTensor, phi::kInputSmallVectorSize>,
         paddle::small_vector<phi::MetaTensor, phi::kInputSmallVectorSize>,
         false>(op, *value_exec_info_, yaml_info_parser, &infer_meta_context_);
+    // The captured program replays the metas of the cache, so it is kept
+    // for capturing even if the instruction does not skip InferMeta.
+    skip_stable_infer_meta_ = FLAGS_pir_skip_stable_infer_meta;
+    if (FLAGS_pir_skip_stable_infer_meta || FLAGS_pir_capture_cpu_program) {
+      InitInferMetaCache(op);
+    }
   }
   VLOG(6) << "finish process infer meta context";
 
@@ -178,13 +189,119 @@ PhiKernelInstruction::PhiKernelInstruction(
 
 PhiKernelInstruction::~PhiKernelInstruction() { delete phi_kernel_; }
 
+void PhiKernelInstruction::InitInferMetaCache(pir::Operation* op) {
+  for (size_t i = 0; i < infer_meta_context_.AttrsSize(); ++i) {
+    const auto& attr = infer_meta_context_.AttrAt(i);
+    if (paddle::holds_alternative<phi::TensorRef>(attr) ||
+        paddle::holds_alternative<std::vector<phi::TensorRef>>(attr)) {
+      VLOG(6) << phi_op_name_ << " reads tensor values in InferMeta, "
+              << "skip caching its InferMeta.";
+      return;
+    }
+  }
+
+  Scope* inner_scope = value_exec_info_->GetScope();
+  std::vector<const phi::DenseTensor*> inputs;
+  for (size_t i = 0; i < op->num_operands(); ++i) {
+    pir::Value value = op->operand_source(i);
+    if (!IsInvalid(value)) {
+      continue;
+    }
+    auto* var = inner_scope->FindVar(value_exec_info_->GetVarName(value));
+    if (var != nullptr && var->IsType<phi::DenseTensor>()) {
+      inputs.push_back(&(var->Get<phi::DenseTensor>()));
+    } else if (var != nullptr && var->IsType<VariableRefArray>()) {
+      for (auto* item : var->Get<VariableRefArray>()) {
+        if (!item->IsType<phi::DenseTensor>()) {
+          return;
+        }
+        inputs.push_back(&(item->Get<phi::DenseTensor>()));
+      }
+    } else {
+      return;
+    }
+  }
+
+  std::vector<phi::DenseTensor*> outputs;
+  for (size_t i = 0; i < op->num_results(); ++i) {
+    pir::Value value = op->result(i);
+    if (!IsInvalid(value)) {
+      continue;
+    }
+    auto* var = inner_scope->FindVar(value_exec_info_->GetVarName(value));
+    if (var == nullptr || !var->IsType<phi::DenseTensor>()) {
+      return;
+    }
+    outputs.push_back(var->GetMutable<phi::DenseTensor>());
+  }
+
+  infer_meta_inputs_ = std::move(inputs);
+  infer_meta_outputs_ = std::move(outputs);
+  infer_meta_cacheable_ = true;
+  cached_input_metas_.resize(infer_meta_inputs_.size());
+  cached_output_metas_.resize(infer_meta_outputs_.size());
+}
+
+bool PhiKernelInstruction::InferMetaCacheHit() const {
+  for (size_t i = 0; i < infer_meta_inputs_.size(); ++i) {
+    const phi::DenseTensor* input = infer_meta_inputs_[i];
+    const InputMeta& cached = cached_input_metas_[i];
+    if (input->initialized() != cached.initialized ||
+        !(input->meta() == cached.meta)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PhiKernelInstruction::UpdateInferMetaCache() {
+  for (size_t i = 0; i < infer_meta_outputs_.size(); ++i) {
+    const phi::DenseTensorMeta& meta = infer_meta_outputs_[i]->meta();
+    if (!meta.valid()) {
+      // The output meta is only completed by the kernel, e.g. an undefined
+      // dtype, so it can not be restored without calling InferMeta.
+      VLOG(6) << phi_op_name_ << " produces incomplete output meta, "
+              << "skip caching its InferMeta.";
+      infer_meta_cacheable_ = false;
+      return;
+    }
+    cached_output_metas_[i] = meta;
+  }
+  infer_meta_cached_ = true;
+}
+
 void PhiKernelInstruction::Run() {
   VLOG(6) << "Begin run op " << phi_op_name_ << " infer meta.";
   if (infer_meta_interface_) {
-    platform::RecordEvent record_event("PhiKernelInstruction::infermeta",
-                                       platform::TracerEventType::UserDefined,
-                                       1);
-    infer_meta_interface_->infer_meta_(&(infer_meta_context_));
+    if (skip_stable_infer_meta_ && infer_meta_cached_ &&
+        InferMetaCacheHit()) {
+      for (size_t i = 0; i < infer_meta_outputs_.size(); ++i) {
+        // Outputs may be reshaped in place by later ops between two runs.
+        if (!(infer_meta_outputs_[i]->meta() == cached_output_metas_[i])) {
+          infer_meta_outputs_[i]->set_meta(cached_output_metas_[i]);
+        }
+      }
+      ++infer_meta_skipped_;
+    } else {
+      platform::RecordEvent record_event(
+          "PhiKernelInstruction::infermeta",
+          platform::TracerEventType::UserDefined,
+          1);
+      if (infer_meta_cacheable_) {
+        // Inputs are recorded first since in-place outputs overwrite them.
+        infer_meta_cached_ = false;
+        for (size_t i = 0; i < infer_meta_inputs_.size(); ++i) {
+          cached_input_metas_[i].meta = infer_meta_inputs_[i]->meta();
+          cached_input_metas_[i].initialized =
+              infer_meta_inputs_[i]->initialized();
+        }
+      }
+      infer_meta_interface_->infer_meta_(&(infer_meta_context_));
+      ++infer_meta_executed_;
+      if (infer_meta_cacheable_) {
+        UpdateInferMetaCache();
+      }
+    }
   }
   VLOG(6) << "End run op " << phi_op_name_ << " infer meta.";
   for (auto& pair : this->InplaceInfo()) {
@@ -14,7 +14,10 @@
 
 #pragma once
 
+#include <vector>
+
 #include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/phi/core/dense_tensor.h"
 
 namespace pir {
 class Operation;
@@ -52,7 +55,47 @@ class PhiKernelInstruction : public InstructionBase {
 
   const std::string& Name() const override { return phi_op_name_; }
 
+  // Number of InferMeta calls skipped by the shape-stable fast path.
+  size_t InferMetaSkippedCount() const { return infer_meta_skipped_; }
+
+  // Number of InferMeta calls actually executed.
+  size_t InferMetaExecutedCount() const { return infer_meta_executed_; }
+
+  // The InferMeta cache of the last run, used to capture the instruction
+  // into an interpreter::CapturedProgram.
+  bool InferMetaCached() const {
+    return infer_meta_cacheable_ && infer_meta_cached_;
+  }
+
+  const std::vector<const phi::DenseTensor*>& InferMetaInputs() const {
+    return infer_meta_inputs_;
+  }
+
+  const phi::DenseTensorMeta& CachedInputMeta(size_t i) const {
+    return cached_input_metas_[i].meta;
+  }
+
+  bool CachedInputInitialized(size_t i) const {
+    return cached_input_metas_[i].initialized;
+  }
+
+  const std::vector<phi::DenseTensor*>& InferMetaOutputs() const {
+    return infer_meta_outputs_;
+  }
+
+  const std::vector<phi::DenseTensorMeta>& CachedOutputMetas() const {
+    return cached_output_metas_;
+  }
+
+  phi::KernelContext* MutableKernelContext() { return &kernel_context_; }
+
  private:
+  void InitInferMetaCache(::pir::Operation* op);
+
+  bool InferMetaCacheHit() const;
+
+  void UpdateInferMetaCache();
+
   paddle::dialect::InferMetaInterface::Concept* infer_meta_interface_{
       nullptr};  // not owned
 
@@ -67,6 +110,36 @@ class PhiKernelInstruction : public InstructionBase {
   ::pir::Operation* op_{nullptr};  // not owned
 
   const ValueExecutionInfo* value_exec_info_;  // not owned
+
+  // Shape-stable fast path of InferMeta. When the metas of all inputs equal
+  // the ones seen by the last InferMeta call, the output metas it produced
+  // are restored instead of calling it again. Only ops whose inputs and
+  // outputs are all DenseTensors and whose InferMeta does not read tensor
+  // values (i.e. has no mutable attributes) are cacheable.
+  struct InputMeta {
+    phi::DenseTensorMeta meta;
+    bool initialized;
+  };
+
+  bool infer_meta_cacheable_{false};
+
+  bool infer_meta_cached_{false};
+
+  // Whether a cache hit skips InferMeta, see FLAGS_pir_skip_stable_infer_meta.
+  // Otherwise the cache is only kept for interpreter::CapturedProgram.
+  bool skip_stable_infer_meta_{false};
+
+  std::vector<const phi::DenseTensor*> infer_meta_inputs_;  // not owned
+
+  std::vector<phi::DenseTensor*> infer_meta_outputs_;  // not owned
+
+  std::vector<InputMeta> cached_input_metas_;
+
+  std::vector<phi::DenseTensorMeta> cached_output_metas_;
+
+  size_t infer_meta_skipped_{0};
+
+  size_t infer_meta_executed_{0};
 };
 
 }  // namespace framework
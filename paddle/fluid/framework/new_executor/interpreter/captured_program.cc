@@ -0,0 +1,103 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/captured_program.h"
+
+#include <unordered_set>
+
+#include "glog/logging.h"
+#include "paddle/fluid/framework/new_executor/instruction/instruction_util.h"
+#include "paddle/fluid/framework/new_executor/instruction/phi_kernel_instruction.h"
+#include "paddle/phi/core/kernel_factory.h"
+
+namespace paddle::framework::interpreter {
+
+std::unique_ptr<CapturedProgram> CapturedProgram::Capture(
+    const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+    const std::vector<size_t>& execute_order) {
+  std::unique_ptr<CapturedProgram> program(new CapturedProgram());
+  std::unordered_set<const phi::DenseTensor*> written;
+  std::unordered_set<const phi::DenseTensor*> read;
+  for (size_t instr_id : execute_order) {
+    InstructionBase* instr = instrs.at(instr_id).get();
+    if (instr->IsArtificial()) {
+      continue;
+    }
+    auto* phi_instr = dynamic_cast<PhiKernelInstruction*>(instr);
+    if (phi_instr == nullptr || !phi_instr->InferMetaCached()) {
+      VLOG(4) << "Can not capture instruction " << instr->Name() << "["
+              << instr_id << "], give up capturing the program.";
+      return nullptr;
+    }
+
+    // Tensors read before any instruction writes them come from outside the
+    // program. Their metas decide whether the captured run is still valid.
+    const auto& inputs = phi_instr->InferMetaInputs();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (written.count(inputs[i]) == 0 && read.insert(inputs[i]).second) {
+        program->input_metas_.push_back(
+            InputMeta{inputs[i],
+                      phi_instr->CachedInputMeta(i),
+                      phi_instr->CachedInputInitialized(i)});
+      }
+    }
+
+    Thunk thunk;
+    thunk.kernel = phi_instr->PhiKernel();
+    thunk.context = phi_instr->MutableKernelContext();
+    thunk.output_begin = program->output_metas_.size();
+    const auto& outputs = phi_instr->InferMetaOutputs();
+    const auto& output_metas = phi_instr->CachedOutputMetas();
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      program->output_metas_.push_back(OutputMeta{outputs[i], output_metas[i]});
+      written.insert(outputs[i]);
+    }
+    thunk.output_end = program->output_metas_.size();
+    thunk.inplace =
+        phi_instr->InplaceInfo().empty() ? nullptr : &phi_instr->InplaceInfo();
+    program->thunks_.push_back(thunk);
+  }
+  VLOG(4) << "Captured " << program->thunks_.size() << " kernels reading "
+          << program->input_metas_.size() << " tensors.";
+  return program;
+}
+
+bool CapturedProgram::Matches() const {
+  for (auto& input : input_metas_) {
+    if (input.tensor->initialized() != input.initialized ||
+        !(input.tensor->meta() == input.meta)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CapturedProgram::Replay() const {
+  for (auto& thunk : thunks_) {
+    for (size_t i = thunk.output_begin; i < thunk.output_end; ++i) {
+      auto& output = output_metas_[i];
+      if (!(output.tensor->meta() == output.meta)) {
+        output.tensor->set_meta(output.meta);
+      }
+    }
+    if (thunk.inplace != nullptr) {
+      for (auto& pair : *thunk.inplace) {
+        ShareVarBuffer(pair.first, pair.second);
+      }
+    }
+    (*thunk.kernel)(thunk.context);
+  }
+}
+
+}  // namespace paddle::framework::interpreter
@@ -0,0 +1,93 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "paddle/phi/core/dense_tensor.h"
+#include "paddle/utils/test_macros.h"
+
+namespace phi {
+class Kernel;
+class KernelContext;
+}  // namespace phi
+
+namespace paddle {
+namespace framework {
+class InstructionBase;
+class Variable;
+
+namespace interpreter {
+
+// A program captured from the phi kernel instructions of a PirInterpreter
+// after a run, in the spirit of a CUDA graph for CPU programs.
+//
+// Every instruction becomes a thunk of its kernel and its pre-bound kernel
+// context, so that a replay calls the kernels in the trace execution order
+// without InferMeta, profiling events, hooks or garbage collection. The
+// output metas InferMeta produced in the captured run are restored before
+// each kernel, as later instructions may reshape the same tensors in place.
+//
+// A replay is only valid while the tensors the program reads before writing
+// them, i.e. its feeds and parameters, have the metas of the captured run.
+// Intermediate tensors keep their buffers between replays, since there is no
+// garbage collection.
+class CapturedProgram {
+ public:
+  // Returns nullptr if an instruction can not be captured, i.e. it is not an
+  // artificial instruction or a phi kernel instruction with a valid InferMeta
+  // cache.
+  TEST_API static std::unique_ptr<CapturedProgram> Capture(
+      const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+      const std::vector<size_t>& execute_order);
+
+  // Returns whether the tensors read by the program have the captured metas.
+  TEST_API bool Matches() const;
+
+  TEST_API void Replay() const;
+
+  size_t Size() const { return thunks_.size(); }
+
+ private:
+  struct InputMeta {
+    const phi::DenseTensor* tensor;
+    phi::DenseTensorMeta meta;
+    bool initialized;
+  };
+
+  struct OutputMeta {
+    phi::DenseTensor* tensor;
+    phi::DenseTensorMeta meta;
+  };
+
+  struct Thunk {
+    const phi::Kernel* kernel;
+    phi::KernelContext* context;
+    // The range of the outputs of the thunk in output_metas_.
+    size_t output_begin;
+    size_t output_end;
+    const std::vector<std::pair<const Variable*, Variable*>>* inplace;
+  };
+
+  std::vector<Thunk> thunks_;
+  std::vector<InputMeta> input_metas_;
+  std::vector<OutputMeta> output_metas_;
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,102 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/cpu_thread_budget.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+#include "paddle/common/enforce.h"
+#include "paddle/phi/backends/cpu/cpu_context.h"
+
+namespace paddle::framework::interpreter {
+
+CpuThreadBudget::CpuThreadBudget(
+    int budget,
+    const std::map<size_t, std::set<size_t>>& downstream,
+    size_t instr_num,
+    phi::CPUContext* dev_ctx)
+    : budget_(budget), dev_ctx_(dev_ctx), widths_(instr_num, 1) {
+  PADDLE_ENFORCE_GT(budget,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The CPU thread budget should be positive, but "
+                        "received %d.",
+                        budget));
+
+  // The depth of an instruction is the length of the longest dependency
+  // chain reaching it.
+  std::vector<size_t> upstream_num(instr_num, 0);
+  for (auto& [instr_id, next_ids] : downstream) {
+    for (size_t next_id : next_ids) {
+      ++upstream_num[next_id];
+    }
+  }
+  std::vector<size_t> depths(instr_num, 0);
+  std::vector<size_t> order;
+  order.reserve(instr_num);
+  for (size_t i = 0; i < instr_num; ++i) {
+    if (upstream_num[i] == 0) {
+      order.push_back(i);
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    auto iter = downstream.find(order[i]);
+    if (iter == downstream.end()) {
+      continue;
+    }
+    for (size_t next_id : iter->second) {
+      depths[next_id] = std::max(depths[next_id], depths[order[i]] + 1);
+      if (--upstream_num[next_id] == 0) {
+        order.push_back(next_id);
+      }
+    }
+  }
+  PADDLE_ENFORCE_EQ(order.size(),
+                    instr_num,
+                    common::errors::PreconditionNotMet(
+                        "The dependencies of instructions have a cycle."));
+
+  std::map<size_t, size_t> depth_widths;
+  for (size_t depth : depths) {
+    ++depth_widths[depth];
+  }
+  size_t max_width = 1;
+  for (size_t i = 0; i < instr_num; ++i) {
+    widths_[i] = depth_widths[depths[i]];
+    max_width = std::max(max_width, widths_[i]);
+  }
+  inter_op_num_threads_ = std::min(max_width, static_cast<size_t>(budget_));
+  VLOG(4) << "CPU thread budget " << budget_ << ", max width " << max_width
+          << ", inter-op threads " << inter_op_num_threads_;
+}
+
+int CpuThreadBudget::Acquire(size_t instr_id) {
+  size_t running = running_.fetch_add(1, std::memory_order_relaxed) + 1;
+  size_t sharers = std::max(widths_[instr_id], running);
+  return std::max(1, budget_ / static_cast<int>(sharers));
+}
+
+IntraOpThreadsGuard::IntraOpThreadsGuard(CpuThreadBudget* budget,
+                                         size_t instr_id)
+    : budget_(budget) {
+  budget_->DeviceContext()->SetIntraOpNumThreads(budget_->Acquire(instr_id));
+}
+
+IntraOpThreadsGuard::~IntraOpThreadsGuard() {
+  budget_->Release();
+  budget_->DeviceContext()->SetIntraOpNumThreads(0);
+}
+
+}  // namespace paddle::framework::interpreter
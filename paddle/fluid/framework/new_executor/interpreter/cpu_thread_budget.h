@@ -0,0 +1,89 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "paddle/utils/test_macros.h"
+
+namespace phi {
+class CPUContext;
+}  // namespace phi
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+// Splits a fixed number of cores between the instructions a PirInterpreter
+// runs concurrently on CPU, so that inter-op and intra-op parallelism do not
+// oversubscribe the cores.
+//
+// The width of an instruction is the number of instructions at the same
+// depth of the dependency graph, i.e. those that may run at the same time as
+// it. The work queue gets as many threads as the widest depth, up to the
+// budget, and every instruction gets an equal share of the budget among the
+// wider of its depth and the instructions actually running, at least one
+// thread.
+class TEST_API CpuThreadBudget {
+ public:
+  CpuThreadBudget(int budget,
+                  const std::map<size_t, std::set<size_t>>& downstream,
+                  size_t instr_num,
+                  phi::CPUContext* dev_ctx);
+
+  int Budget() const { return budget_; }
+
+  phi::CPUContext* DeviceContext() const { return dev_ctx_; }
+
+  size_t InterOpNumThreads() const { return inter_op_num_threads_; }
+
+  size_t Width(size_t instr_id) const { return widths_[instr_id]; }
+
+  // Returns the intra-op thread number of an instruction about to run, which
+  // must be followed by Release once it finishes.
+  int Acquire(size_t instr_id);
+
+  void Release() { running_.fetch_sub(1, std::memory_order_relaxed); }
+
+ private:
+  int budget_;
+  phi::CPUContext* dev_ctx_;
+  size_t inter_op_num_threads_{1};
+  std::vector<size_t> widths_;
+  std::atomic<size_t> running_{0};
+};
+
+// Bounds the intra-op threads of the calling thread while an instruction
+// runs.
+class IntraOpThreadsGuard {
+ public:
+  IntraOpThreadsGuard(CpuThreadBudget* budget, size_t instr_id);
+
+  ~IntraOpThreadsGuard();
+
+  IntraOpThreadsGuard(const IntraOpThreadsGuard&) = delete;
+  IntraOpThreadsGuard& operator=(const IntraOpThreadsGuard&) = delete;
+
+ private:
+  CpuThreadBudget* budget_;
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,116 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/critical_path_scheduler.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+#include "paddle/common/enforce.h"
+
+namespace paddle::framework::interpreter {
+
+namespace {
+
+// Instructions measured to run faster than this are run inline, roughly the
+// cost of waking up another worker.
+constexpr double kTinyInstructionUs = 10.0;
+// The first run is not measured, since it allocates most of the memory.
+constexpr size_t kProfileRunNum = 3;
+
+}  // namespace
+
+CriticalPathScheduler::CriticalPathScheduler(
+    const std::map<size_t, std::set<size_t>>& downstream, size_t instr_num)
+    : downstream_(instr_num),
+      critical_paths_(instr_num, 0),
+      tiny_(instr_num, false),
+      elapsed_ns_(instr_num, 0) {
+  std::vector<size_t> upstream_num(instr_num, 0);
+  for (auto& [instr_id, next_ids] : downstream) {
+    for (size_t next_id : next_ids) {
+      downstream_[instr_id].push_back(next_id);
+      ++upstream_num[next_id];
+    }
+  }
+
+  std::vector<size_t> order;
+  order.reserve(instr_num);
+  for (size_t i = 0; i < instr_num; ++i) {
+    if (upstream_num[i] == 0) {
+      order.push_back(i);
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (size_t next_id : downstream_[order[i]]) {
+      if (--upstream_num[next_id] == 0) {
+        order.push_back(next_id);
+      }
+    }
+  }
+  PADDLE_ENFORCE_EQ(order.size(),
+                    instr_num,
+                    common::errors::PreconditionNotMet(
+                        "The dependencies of instructions have a cycle."));
+  reverse_order_.assign(order.rbegin(), order.rend());
+
+  SetCosts(std::vector<double>(instr_num, 1.0));
+}
+
+void CriticalPathScheduler::SetCosts(const std::vector<double>& costs_us) {
+  for (size_t instr_id : reverse_order_) {
+    double longest_next = 0;
+    for (size_t next_id : downstream_[instr_id]) {
+      longest_next = std::max(longest_next, critical_paths_[next_id]);
+    }
+    critical_paths_[instr_id] = costs_us[instr_id] + longest_next;
+  }
+}
+
+void CriticalPathScheduler::BeginRun() {
+  profiling_ = run_num_ >= 1 && run_num_ <= kProfileRunNum;
+  busy_ns_ = 0;
+  dispatched_ = 0;
+  inlined_ = 0;
+}
+
+SchedulingStat CriticalPathScheduler::EndRun(double wall_us,
+                                             size_t worker_num) {
+  ++run_num_;
+  if (profiling_ && run_num_ == kProfileRunNum + 1) {
+    std::vector<double> costs_us(elapsed_ns_.size());
+    size_t tiny_num = 0;
+    for (size_t i = 0; i < elapsed_ns_.size(); ++i) {
+      costs_us[i] = elapsed_ns_[i] / 1000.0 / kProfileRunNum;
+      tiny_[i] = costs_us[i] < kTinyInstructionUs;
+      tiny_num += tiny_[i];
+    }
+    SetCosts(costs_us);
+    elapsed_ns_.clear();
+    elapsed_ns_.shrink_to_fit();
+    VLOG(4) << "Update critical paths with measured costs, " << tiny_num
+            << " of " << costs_us.size() << " instructions are run inline";
+  }
+  profiling_ = false;
+
+  SchedulingStat stat;
+  stat.wall_us = wall_us;
+  stat.busy_us = busy_ns_ / 1000.0;
+  stat.idle_us = std::max(0.0, wall_us * worker_num - stat.busy_us);
+  stat.dispatched = dispatched_;
+  stat.inlined = inlined_;
+  return stat;
+}
+
+}  // namespace paddle::framework::interpreter
@@ -0,0 +1,106 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "paddle/utils/test_macros.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+// Scheduling statistics of one run in multi-thread mode.
+struct SchedulingStat {
+  double wall_us{0};
+  // Time the workers spent running instructions, and the rest of
+  // wall_us * worker_num.
+  double busy_us{0};
+  double idle_us{0};
+  // Instructions handed to the work queue, and those run by the worker that
+  // made them ready instead.
+  size_t dispatched{0};
+  size_t inlined{0};
+};
+
+// Orders ready instructions by the length of their critical path, i.e. the
+// largest total cost of a dependency chain starting from them, so that the
+// longest chain starts first.
+//
+// Costs start as one per instruction, so the first critical paths are the
+// depths of the dependency graph. The execution time of every instruction is
+// measured in a few runs after the first one, which allocates, and the
+// averages replace the costs. From then on instructions cheaper than the
+// hand-off to another worker are run inline by the worker that made them
+// ready, so chains of tiny instructions run as one task.
+class TEST_API CriticalPathScheduler {
+ public:
+  CriticalPathScheduler(const std::map<size_t, std::set<size_t>>& downstream,
+                        size_t instr_num);
+
+  double CriticalPath(size_t instr_id) const {
+    return critical_paths_[instr_id];
+  }
+
+  bool IsTiny(size_t instr_id) const { return tiny_[instr_id]; }
+
+  bool IsProfiling() const { return profiling_; }
+
+  // Replaces the costs and updates the critical paths.
+  void SetCosts(const std::vector<double>& costs_us);
+
+  void BeginRun();
+
+  // Thread safe as long as every instruction runs once per run.
+  void RecordInstruction(size_t instr_id, int64_t elapsed_ns) {
+    elapsed_ns_[instr_id] += elapsed_ns;
+  }
+
+  void RecordTask(int64_t busy_ns) {
+    busy_ns_.fetch_add(busy_ns, std::memory_order_relaxed);
+  }
+
+  void RecordDispatch() {
+    dispatched_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RecordInline() { inlined_.fetch_add(1, std::memory_order_relaxed); }
+
+  SchedulingStat EndRun(double wall_us, size_t worker_num);
+
+ private:
+  std::vector<std::vector<size_t>> downstream_;
+  // Instructions in reverse topological order.
+  std::vector<size_t> reverse_order_;
+  std::vector<double> critical_paths_;
+  std::vector<bool> tiny_;
+
+  size_t run_num_{0};
+  bool profiling_{false};
+  std::vector<int64_t> elapsed_ns_;
+
+  std::atomic<int64_t> busy_ns_{0};
+  std::atomic<size_t> dispatched_{0};
+  std::atomic<size_t> inlined_{0};
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
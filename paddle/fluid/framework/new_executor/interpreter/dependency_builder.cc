@@ -770,6 +770,17 @@ void PirDependencyBuilder::ShareDependencyFrom(
   is_build_ = true;
 }
 
+void PirDependencyBuilder::LoadDependency(
+    std::map<size_t, std::set<size_t>> downstream_map,
+    std::vector<std::vector<bool>> happens_before) {
+  op_num_ = happens_before.size();
+  op_downstream_map_ = std::make_shared<std::map<size_t, std::set<size_t>>>(
+      std::move(downstream_map));
+  op_happens_before_ = std::make_shared<std::vector<std::vector<bool>>>(
+      std::move(happens_before));
+  is_build_ = true;
+}
+
 void DependencyBuilderSimplify::GetAllbehind() {
   auto update_op_happen_before = [this](size_t prior_op_idx,
                                         size_t posterior_op_idx) {
@@ -124,6 +124,11 @@ class PirDependencyBuilder : public DependencyBuilder {
 
   void ShareDependencyFrom(const PirDependencyBuilder& src);
 
+  // Restores the dependency of the same instructions built before, e.g. by
+  // another process.
+  void LoadDependency(std::map<size_t, std::set<size_t>> downstream_map,
+                      std::vector<std::vector<bool>> happens_before);
+
   bool IsSameDeviceContext(size_t op1, size_t op2) const {
     return &((instructions_)[op1]->DeviceContext()) ==
            &((instructions_)[op2]->DeviceContext());
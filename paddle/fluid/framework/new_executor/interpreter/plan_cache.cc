@@ -0,0 +1,344 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/plan_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "glog/logging.h"
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/pir/include/core/block.h"
+#include "paddle/pir/include/core/ir_printer.h"
+
+PD_DECLARE_bool(new_executor_sequential_run);
+PD_DECLARE_bool(add_dependency_for_communication_op);
+
+namespace paddle::framework::interpreter {
+
+namespace {
+
+// Bumped whenever the file layout or the analysis changes.
+constexpr char kPlanMagic[8] = {'P', 'D', 'P', 'L', 'A', 'N', '0', '2'};
+
+class Fnv1aHash {
+ public:
+  void Update(const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ULL;
+    }
+  }
+
+  void Update(const std::string& str) {
+    Update(str.data(), str.size());
+    // Separates consecutive strings.
+    Update(static_cast<uint64_t>(str.size()));
+  }
+
+  void Update(uint64_t value) { Update(&value, sizeof(value)); }
+
+  uint64_t Digest() const { return hash_; }
+
+ private:
+  uint64_t hash_{14695981039346656037ULL};
+};
+
+class PlanWriter {
+ public:
+  void Write(uint64_t value) {
+    data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  std::string* mutable_data() { return &data_; }
+
+ private:
+  std::string data_;
+};
+
+class PlanReader {
+ public:
+  PlanReader(const std::string& data, size_t pos) : data_(data), pos_(pos) {}
+
+  bool Read(uint64_t* value) {
+    if (data_.size() - pos_ < sizeof(*value)) {
+      return false;
+    }
+    std::memcpy(value, data_.data() + pos_, sizeof(*value));
+    pos_ += sizeof(*value);
+    return true;
+  }
+
+  // Reads an instruction id, which must be less than instr_num.
+  bool ReadId(size_t instr_num, size_t* id) {
+    uint64_t value = 0;
+    if (!Read(&value) || value >= instr_num) {
+      return false;
+    }
+    *id = static_cast<size_t>(value);
+    return true;
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+ private:
+  const std::string& data_;
+  size_t pos_;
+};
+
+std::string PlanPath(const std::string& dir, uint64_t key) {
+  std::stringstream ss;
+  ss << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+     << ".plan";
+  return ss.str();
+}
+
+}  // namespace
+
+uint64_t ComputePlanKey(
+    const ::pir::Block& block,
+    const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+    const phi::Place& place) {
+  Fnv1aHash hash;
+  hash.Update(std::string(kPlanMagic, sizeof(kPlanMagic)));
+
+  std::stringstream program;
+  ::pir::IrPrinter(program).PrintBlock(block);
+  hash.Update(program.str());
+
+  // Variable ids come from the scope, which may hold variables created
+  // before the program.
+  hash.Update(static_cast<uint64_t>(instrs.size()));
+  for (auto& instr : instrs) {
+    hash.Update(instr->Name());
+    for (auto* var_map : {&instr->Inputs(), &instr->Outputs()}) {
+      std::vector<int> var_ids;
+      for (auto& [value, ids] : *var_map) {
+        var_ids.insert(var_ids.end(), ids.begin(), ids.end());
+      }
+      std::sort(var_ids.begin(), var_ids.end());
+      hash.Update(static_cast<uint64_t>(var_ids.size()));
+      for (int var_id : var_ids) {
+        hash.Update(static_cast<uint64_t>(var_id));
+      }
+    }
+  }
+
+  hash.Update(place.DebugString());
+  hash.Update(static_cast<uint64_t>(FLAGS_new_executor_sequential_run));
+  hash.Update(static_cast<uint64_t>(FLAGS_add_dependency_for_communication_op));
+  return hash.Digest();
+}
+
+std::string SerializeCompiledPlan(uint64_t key, const CompiledPlan& plan) {
+  PlanWriter writer;
+  writer.mutable_data()->append(kPlanMagic, sizeof(kPlanMagic));
+  writer.Write(key);
+  size_t instr_num = plan.happens_before.size();
+  writer.Write(instr_num);
+
+  writer.Write(plan.downstream_map.size());
+  for (auto& [instr_id, next_ids] : plan.downstream_map) {
+    writer.Write(instr_id);
+    writer.Write(next_ids.size());
+    for (size_t next_id : next_ids) {
+      writer.Write(next_id);
+    }
+  }
+
+  // The matrix is written as rows of 64-bit words.
+  size_t word_num = (instr_num + 63) / 64;
+  for (auto& row : plan.happens_before) {
+    for (size_t word = 0; word < word_num; ++word) {
+      uint64_t bits = 0;
+      for (size_t i = word * 64; i < std::min(instr_num, word * 64 + 64); ++i) {
+        if (row[i]) {
+          bits |= uint64_t{1} << (i - word * 64);
+        }
+      }
+      writer.Write(bits);
+    }
+  }
+
+  writer.Write(plan.trace_execute_order.size());
+  for (size_t instr_id : plan.trace_execute_order) {
+    writer.Write(instr_id);
+  }
+
+  writer.Write(plan.waiter_recorders.size());
+  for (auto& [waiter_id, recorder_ids] : plan.waiter_recorders) {
+    writer.Write(waiter_id);
+    writer.Write(recorder_ids.size());
+    for (size_t recorder_id : recorder_ids) {
+      writer.Write(recorder_id);
+    }
+  }
+  return std::move(*writer.mutable_data());
+}
+
+bool DeserializeCompiledPlan(const std::string& data,
+                             uint64_t key,
+                             size_t instr_num,
+                             CompiledPlan* plan) {
+  if (data.size() < sizeof(kPlanMagic) ||
+      data.compare(0, sizeof(kPlanMagic), kPlanMagic, sizeof(kPlanMagic)) !=
+          0) {
+    return false;
+  }
+  PlanReader reader(data, sizeof(kPlanMagic));
+  uint64_t value = 0;
+  if (!reader.Read(&value) || value != key) {
+    return false;
+  }
+  if (!reader.Read(&value) || value != instr_num) {
+    return false;
+  }
+
+  CompiledPlan result;
+  uint64_t entry_num = 0;
+  if (!reader.Read(&entry_num) || entry_num > instr_num) {
+    return false;
+  }
+  for (uint64_t entry = 0; entry < entry_num; ++entry) {
+    size_t instr_id = 0;
+    uint64_t next_num = 0;
+    if (!reader.ReadId(instr_num, &instr_id) || !reader.Read(&next_num) ||
+        next_num > instr_num) {
+      return false;
+    }
+    auto& next_ids = result.downstream_map[instr_id];
+    for (uint64_t i = 0; i < next_num; ++i) {
+      size_t next_id = 0;
+      if (!reader.ReadId(instr_num, &next_id)) {
+        return false;
+      }
+      next_ids.insert(next_id);
+    }
+  }
+
+  size_t word_num = (instr_num + 63) / 64;
+  result.happens_before.assign(instr_num, std::vector<bool>(instr_num, false));
+  for (auto& row : result.happens_before) {
+    for (size_t word = 0; word < word_num; ++word) {
+      uint64_t bits = 0;
+      if (!reader.Read(&bits)) {
+        return false;
+      }
+      for (size_t i = word * 64; i < std::min(instr_num, word * 64 + 64); ++i) {
+        row[i] = (bits >> (i - word * 64)) & 1;
+      }
+    }
+  }
+
+  uint64_t order_num = 0;
+  if (!reader.Read(&order_num) || order_num != instr_num) {
+    return false;
+  }
+  std::vector<bool> ordered(instr_num, false);
+  result.trace_execute_order.reserve(instr_num);
+  for (uint64_t i = 0; i < order_num; ++i) {
+    size_t instr_id = 0;
+    if (!reader.ReadId(instr_num, &instr_id) || ordered[instr_id]) {
+      return false;
+    }
+    ordered[instr_id] = true;
+    result.trace_execute_order.push_back(instr_id);
+  }
+
+  // The event ids run over two steps of the instructions.
+  const size_t event_id_num = 2 * instr_num;
+  if (!reader.Read(&entry_num) || entry_num > event_id_num) {
+    return false;
+  }
+  for (uint64_t entry = 0; entry < entry_num; ++entry) {
+    size_t waiter_id = 0;
+    uint64_t recorder_num = 0;
+    if (!reader.ReadId(event_id_num, &waiter_id) ||
+        !reader.Read(&recorder_num) || recorder_num > event_id_num) {
+      return false;
+    }
+    auto& recorder_ids = result.waiter_recorders[waiter_id];
+    for (uint64_t i = 0; i < recorder_num; ++i) {
+      size_t recorder_id = 0;
+      if (!reader.ReadId(event_id_num, &recorder_id)) {
+        return false;
+      }
+      recorder_ids.insert(recorder_id);
+    }
+  }
+
+  if (!reader.AtEnd()) {
+    return false;
+  }
+  *plan = std::move(result);
+  return true;
+}
+
+bool LoadCompiledPlan(const std::string& dir,
+                      uint64_t key,
+                      size_t instr_num,
+                      CompiledPlan* plan) {
+  std::string path = PlanPath(dir, key);
+  std::ifstream fin(path, std::ios::binary);
+  if (!fin.is_open()) {
+    VLOG(4) << "No compiled plan " << path;
+    return false;
+  }
+  std::string data((std::istreambuf_iterator<char>(fin)),
+                   std::istreambuf_iterator<char>());
+  if (!DeserializeCompiledPlan(data, key, instr_num, plan)) {
+    LOG(WARNING) << "Ignore the invalid compiled plan " << path;
+    return false;
+  }
+  VLOG(4) << "Load the compiled plan " << path;
+  return true;
+}
+
+void SaveCompiledPlan(const std::string& dir,
+                      uint64_t key,
+                      const CompiledPlan& plan) {
+  std::string path = PlanPath(dir, key);
+  std::stringstream tmp_path;
+  tmp_path << path << ".tmp."
+           << std::hash<std::thread::id>()(std::this_thread::get_id()) << "."
+           << std::chrono::steady_clock::now().time_since_epoch().count();
+
+  std::string data = SerializeCompiledPlan(key, plan);
+  {
+    std::ofstream fout(tmp_path.str(), std::ios::binary | std::ios::trunc);
+    fout.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!fout.good()) {
+      LOG(WARNING) << "Failed to write the compiled plan " << tmp_path.str();
+      fout.close();
+      std::remove(tmp_path.str().c_str());
+      return;
+    }
+  }
+  if (std::rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Failed to rename the compiled plan to " << path;
+    std::remove(tmp_path.str().c_str());
+    return;
+  }
+  VLOG(4) << "Save the compiled plan " << path;
+}
+
+}  // namespace paddle::framework::interpreter
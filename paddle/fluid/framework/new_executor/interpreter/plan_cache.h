@@ -0,0 +1,84 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "paddle/phi/common/place.h"
+#include "paddle/utils/test_macros.h"
+
+namespace pir {
+class Block;
+}  // namespace pir
+
+namespace paddle {
+namespace framework {
+class InstructionBase;
+
+namespace interpreter {
+
+// The analysis results of a PirInterpreter that only depend on its program,
+// so that other processes running the same program can skip the analysis.
+struct CompiledPlan {
+  std::map<size_t, std::set<size_t>> downstream_map;
+  std::vector<std::vector<bool>> happens_before;
+  std::vector<size_t> trace_execute_order;
+  // The instructions every waiter instruction waits for the events of, see
+  // PirStreamAnalyzer::GetWaiterRecorders. The ids run over two steps of the
+  // instructions, so they are less than twice the instruction number.
+  std::map<size_t, std::set<size_t>> waiter_recorders;
+};
+
+// Returns the key of the compiled plan of the instructions built from block.
+// It covers the printed program, which holds the stream of every op, the
+// variables every instruction reads and writes, the place and the flags the
+// analysis depends on.
+uint64_t ComputePlanKey(
+    const ::pir::Block& block,
+    const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+    const phi::Place& place);
+
+TEST_API std::string SerializeCompiledPlan(uint64_t key,
+                                           const CompiledPlan& plan);
+
+// Returns false if data is not a well-formed plan of key with instr_num
+// instructions.
+TEST_API bool DeserializeCompiledPlan(const std::string& data,
+                                      uint64_t key,
+                                      size_t instr_num,
+                                      CompiledPlan* plan);
+
+// Loads the plan of key from the cache directory dir, returns false if it is
+// missing or invalid.
+TEST_API bool LoadCompiledPlan(const std::string& dir,
+                               uint64_t key,
+                               size_t instr_num,
+                               CompiledPlan* plan);
+
+// Saves the plan of key to the cache directory dir. The file is written
+// under a temporary name and renamed, so that concurrent processes never
+// read a partial plan. Failures are only logged.
+TEST_API void SaveCompiledPlan(const std::string& dir,
+                               uint64_t key,
+                               const CompiledPlan& plan);
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
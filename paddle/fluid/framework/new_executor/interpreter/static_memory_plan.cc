@@ -0,0 +1,383 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <set>
+
+#include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/fluid/framework/new_executor/instruction/phi_kernel_instruction.h"
+#include "paddle/fluid/framework/variable.h"
+#include "paddle/fluid/memory/malloc.h"
+
+namespace paddle::framework::interpreter {
+
+namespace {
+
+constexpr size_t kArenaAlignment = 256;
+// Plans of all signatures are dropped once there are more, e.g. for inputs
+// of varying sequence length.
+constexpr size_t kMaxPlanNum = 32;
+
+size_t AlignUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+size_t BlockSize(const MemoryBlock& block, size_t alignment) {
+  return AlignUp(std::max<size_t>(block.bytes, 1), alignment);
+}
+
+// A part of the arena of a plan, held by a tensor as its holder.
+class ArenaViewAllocation : public phi::Allocation {
+ public:
+  ArenaViewAllocation(const std::shared_ptr<phi::Allocation>& arena,
+                      size_t offset,
+                      size_t size)
+      : phi::Allocation(static_cast<uint8_t*>(arena->ptr()) + offset,
+                        size,
+                        arena->place()),
+        arena_(arena) {}
+
+ private:
+  std::shared_ptr<phi::Allocation> arena_;
+};
+
+}  // namespace
+
+size_t AssignMemoryOffsets(std::vector<MemoryBlock>* blocks,
+                           size_t alignment) {
+  std::vector<size_t> order(blocks->size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    const MemoryBlock& a = (*blocks)[lhs];
+    const MemoryBlock& b = (*blocks)[rhs];
+    if (a.bytes != b.bytes) {
+      return a.bytes > b.bytes;
+    }
+    if (a.def != b.def) {
+      return a.def < b.def;
+    }
+    return a.var_id < b.var_id;
+  });
+
+  // Indices of the placed blocks, sorted by offset.
+  std::vector<size_t> placed;
+  size_t arena_size = 0;
+  for (size_t idx : order) {
+    MemoryBlock& block = (*blocks)[idx];
+    size_t size = BlockSize(block, alignment);
+    size_t best_offset = std::numeric_limits<size_t>::max();
+    size_t best_gap = std::numeric_limits<size_t>::max();
+    size_t prev_end = 0;
+    for (size_t other_idx : placed) {
+      const MemoryBlock& other = (*blocks)[other_idx];
+      if (other.last_use < block.def || block.last_use < other.def) {
+        continue;
+      }
+      if (other.offset >= prev_end) {
+        size_t gap = other.offset - prev_end;
+        if (gap >= size && gap < best_gap) {
+          best_gap = gap;
+          best_offset = prev_end;
+        }
+      }
+      prev_end = std::max(prev_end, other.offset + BlockSize(other, alignment));
+    }
+    if (best_offset == std::numeric_limits<size_t>::max()) {
+      best_offset = prev_end;
+    }
+    block.offset = best_offset;
+    arena_size = std::max(arena_size, best_offset + size);
+
+    auto pos = std::upper_bound(placed.begin(),
+                                placed.end(),
+                                block.offset,
+                                [&](size_t offset, size_t other_idx) {
+                                  return offset < (*blocks)[other_idx].offset;
+                                });
+    placed.insert(pos, idx);
+  }
+  return arena_size;
+}
+
+StaticMemoryPlanner::StaticMemoryPlanner(
+    const phi::Place& place,
+    const std::vector<Variable*>& vars,
+    const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+    const std::vector<size_t>& execute_order,
+    const std::unordered_set<size_t>& skip_var_ids)
+    : place_(place),
+      vars_(vars),
+      skip_var_ids_(skip_var_ids),
+      bound_(vars.size(), false) {
+  if (!phi::is_cpu_place(place_) && !phi::is_gpu_place(place_)) {
+    VLOG(4) << "Static memory plan does not support " << place_;
+    enabled_ = false;
+    return;
+  }
+
+  const phi::DeviceContext* device_context = nullptr;
+  std::unordered_set<size_t> written_var_ids;
+  for (size_t pos = 0; pos < execute_order.size(); ++pos) {
+    const InstructionBase* instr = instrs.at(execute_order[pos]).get();
+    instr_pos_[instr->Id()] = pos;
+    for (size_t var_id : instr->GCCheckVars()) {
+      last_use_pos_[var_id] = pos;
+    }
+    for (auto& item : instr->Outputs()) {
+      written_var_ids.insert(item.second.begin(), item.second.end());
+    }
+    // Blocks are reused in the order of the trace, which other streams do
+    // not follow.
+    if (phi::is_gpu_place(place_) &&
+        instr->DeviceContext().GetPlace() == place_) {
+      if (device_context != nullptr &&
+          device_context != &instr->DeviceContext()) {
+        VLOG(4) << "Static memory plan does not support multiple streams";
+        enabled_ = false;
+        return;
+      }
+      device_context = &instr->DeviceContext();
+    }
+  }
+
+  std::set<size_t> signature_var_ids;
+  for (auto& instr : instrs) {
+    for (auto& item : instr->Inputs()) {
+      for (auto var_id : item.second) {
+        if (!written_var_ids.count(var_id) && !skip_var_ids_.count(var_id) &&
+            DenseTensorOf(var_id) != nullptr) {
+          signature_var_ids.insert(var_id);
+        }
+      }
+    }
+  }
+  signature_var_ids_.assign(signature_var_ids.begin(),
+                            signature_var_ids.end());
+}
+
+phi::DenseTensor* StaticMemoryPlanner::DenseTensorOf(size_t var_id) const {
+  Variable* var = vars_.at(var_id);
+  if (var == nullptr || !var->IsType<phi::DenseTensor>()) {
+    return nullptr;
+  }
+  return var->GetMutable<phi::DenseTensor>();
+}
+
+std::vector<int64_t> StaticMemoryPlanner::ShapeSignature() const {
+  std::vector<int64_t> signature;
+  for (size_t var_id : signature_var_ids_) {
+    const phi::DenseTensor* tensor = DenseTensorOf(var_id);
+    const auto& dims = tensor->dims();
+    signature.push_back(dims.size());
+    for (int i = 0; i < dims.size(); ++i) {
+      signature.push_back(dims[i]);
+    }
+    signature.push_back(static_cast<int64_t>(tensor->dtype()));
+  }
+  return signature;
+}
+
+void StaticMemoryPlanner::BeforeRun() {
+  recording_ = false;
+  std::vector<int64_t> signature = ShapeSignature();
+  auto it = plans_.find(signature);
+  if (it != plans_.end()) {
+    Bind(&it->second);
+    return;
+  }
+
+  Unbind();
+  if (plans_.size() >= kMaxPlanNum) {
+    VLOG(4) << "Too many shape signatures, drop all static memory plans";
+    plans_.clear();
+  }
+  VLOG(4) << "Record static memory plan of a new shape signature";
+  recording_ = true;
+  recording_signature_ = std::move(signature);
+  candidates_.clear();
+  invalid_var_ids_.clear();
+  holder_owners_.clear();
+}
+
+void StaticMemoryPlanner::BeforeInstruction(const InstructionBase& instr) {
+  fresh_outputs_.clear();
+  if (dynamic_cast<const PhiKernelInstruction*>(&instr) == nullptr) {
+    return;
+  }
+  // Only outputs allocated by the kernel itself are candidates, which
+  // excludes tensors filled by the caller, such as feeds.
+  for (auto& item : instr.Outputs()) {
+    for (auto var_id : item.second) {
+      const phi::DenseTensor* tensor = DenseTensorOf(var_id);
+      if (tensor != nullptr && tensor->Holder() == nullptr &&
+          !candidates_.count(var_id) && !invalid_var_ids_.count(var_id) &&
+          !skip_var_ids_.count(var_id) && last_use_pos_.count(var_id)) {
+        fresh_outputs_.insert(var_id);
+      }
+    }
+  }
+}
+
+void StaticMemoryPlanner::AfterInstruction(const InstructionBase& instr) {
+  std::unordered_map<const phi::Allocation*, size_t> input_holders;
+  for (auto& item : instr.Inputs()) {
+    for (auto var_id : item.second) {
+      const phi::DenseTensor* tensor = DenseTensorOf(var_id);
+      if (tensor != nullptr && tensor->Holder() != nullptr) {
+        input_holders[tensor->Holder().get()] = var_id;
+      }
+    }
+  }
+
+  size_t pos = instr_pos_.at(instr.Id());
+  for (auto& item : instr.Outputs()) {
+    for (auto var_id : item.second) {
+      const phi::DenseTensor* tensor = DenseTensorOf(var_id);
+      if (tensor == nullptr || tensor->Holder() == nullptr) {
+        continue;
+      }
+      const phi::Allocation* holder = tensor->Holder().get();
+      auto input = input_holders.find(holder);
+      if (input != input_holders.end() &&
+          input->second != static_cast<size_t>(var_id)) {
+        Invalidate(var_id);
+        Invalidate(input->second);
+      }
+      auto owner = holder_owners_.find(holder);
+      if (owner != holder_owners_.end() &&
+          owner->second != static_cast<size_t>(var_id)) {
+        const phi::DenseTensor* other = DenseTensorOf(owner->second);
+        if (other->Holder().get() == holder) {
+          Invalidate(var_id);
+          Invalidate(owner->second);
+        }
+      }
+      holder_owners_[holder] = var_id;
+
+      size_t bytes = tensor->numel() * phi::SizeOf(tensor->dtype());
+      if (fresh_outputs_.count(var_id) && !invalid_var_ids_.count(var_id) &&
+          tensor->place() == place_ && tensor->meta().offset == 0) {
+        candidates_[var_id] =
+            MemoryBlock{static_cast<size_t>(var_id), pos, 0, bytes};
+      } else if (candidates_.count(var_id)) {
+        // Written again by an inplace instruction.
+        auto& block = candidates_.at(var_id);
+        block.bytes = std::max(block.bytes, bytes);
+      }
+    }
+  }
+  fresh_outputs_.clear();
+}
+
+void StaticMemoryPlanner::AfterRun() {
+  if (recording_) {
+    recording_ = false;
+    Plan plan;
+    for (auto& [var_id, block] : candidates_) {
+      block.last_use = last_use_pos_.at(var_id);
+      if (block.last_use >= block.def) {
+        plan.blocks.push_back(block);
+      }
+    }
+    plan.arena_size = AssignMemoryOffsets(&plan.blocks, kArenaAlignment);
+    VLOG(4) << "Static memory plan binds " << plan.blocks.size()
+            << " tensors to an arena of " << plan.arena_size << " bytes";
+    plans_[recording_signature_] = std::move(plan);
+    candidates_.clear();
+    invalid_var_ids_.clear();
+    holder_owners_.clear();
+    return;
+  }
+
+  if (active_plan_ == nullptr) {
+    return;
+  }
+  // A tensor not holding its block any more either outgrew it, so the
+  // kernel allocated a larger holder of its own, or shares the buffer of
+  // another tensor, so it can not be planned.
+  bool changed = false;
+  std::vector<MemoryBlock> blocks;
+  for (size_t i = 0; i < active_plan_->blocks.size(); ++i) {
+    MemoryBlock block = active_plan_->blocks[i];
+    const auto& holder = DenseTensorOf(block.var_id)->Holder();
+    if (holder == nullptr || holder == views_[i]) {
+      blocks.push_back(block);
+    } else if (holder.use_count() == 1) {
+      block.bytes = std::max(block.bytes, holder->size());
+      blocks.push_back(block);
+      changed = true;
+    } else {
+      VLOG(4) << "Var " << block.var_id
+              << " shares its buffer, remove it from static memory plan";
+      changed = true;
+    }
+  }
+  if (changed) {
+    Plan* plan = active_plan_;
+    Unbind();
+    plan->blocks = std::move(blocks);
+    plan->arena_size = AssignMemoryOffsets(&plan->blocks, kArenaAlignment);
+    VLOG(4) << "Static memory plan grows to " << plan->arena_size << " bytes";
+  }
+}
+
+void StaticMemoryPlanner::Invalidate(size_t var_id) {
+  invalid_var_ids_.insert(var_id);
+  candidates_.erase(var_id);
+}
+
+void StaticMemoryPlanner::Bind(Plan* plan) {
+  if (active_plan_ != plan) {
+    Unbind();
+    active_plan_ = plan;
+    if (plan->arena_size > 0) {
+      arena_ = memory::AllocShared(place_, plan->arena_size);
+    }
+    for (auto& block : plan->blocks) {
+      views_.emplace_back(std::make_shared<ArenaViewAllocation>(
+          arena_, block.offset, block.bytes));
+      bound_[block.var_id] = true;
+    }
+  }
+  for (size_t i = 0; i < plan->blocks.size(); ++i) {
+    phi::DenseTensor* tensor = DenseTensorOf(plan->blocks[i].var_id);
+    if (tensor->Holder() != views_[i]) {
+      tensor->clear();
+      tensor->ResetHolder(views_[i]);
+    }
+  }
+}
+
+void StaticMemoryPlanner::Unbind() {
+  if (active_plan_ == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < active_plan_->blocks.size(); ++i) {
+    size_t var_id = active_plan_->blocks[i].var_id;
+    phi::DenseTensor* tensor = DenseTensorOf(var_id);
+    if (tensor->Holder() == views_[i]) {
+      tensor->clear();
+    }
+    bound_[var_id] = false;
+  }
+  views_.clear();
+  arena_.reset();
+  active_plan_ = nullptr;
+}
+
+}  // namespace paddle::framework::interpreter
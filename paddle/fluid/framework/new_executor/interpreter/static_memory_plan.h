@@ -0,0 +1,146 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/phi/common/place.h"
+#include "paddle/phi/core/allocator.h"
+#include "paddle/phi/core/dense_tensor.h"
+#include "paddle/utils/test_macros.h"
+
+namespace paddle {
+namespace framework {
+class InstructionBase;
+class Variable;
+
+namespace interpreter {
+
+// A tensor of the static memory plan. def and last_use are the positions,
+// in the execution order, of the instruction that first writes the tensor
+// and of the one after which the garbage collector would free it.
+struct MemoryBlock {
+  size_t var_id;
+  size_t def;
+  size_t last_use;
+  size_t bytes;
+  size_t offset{0};
+};
+
+// Assigns every block an offset in one arena, so that blocks whose lifetimes
+// overlap never overlap in the arena. Blocks are placed from the largest one,
+// each into the smallest gap between the already placed blocks it overlaps
+// with that fits it. Offsets are multiples of alignment. Returns the size of
+// the arena.
+TEST_API size_t AssignMemoryOffsets(std::vector<MemoryBlock>* blocks,
+                                    size_t alignment);
+
+// Static memory plan of a PirInterpreter running in trace mode.
+//
+// The first run with a new shape signature, i.e. the dims and dtypes of the
+// tensors the program reads but does not write, runs as usual while the
+// planner records the size of every intermediate DenseTensor written by a
+// phi kernel. Later runs with the same signature bind those tensors to fixed
+// offsets of one pre-allocated arena before running, and the garbage
+// collector leaves them alone, so that steady-state runs neither allocate
+// nor free intermediates.
+//
+// Lifetimes come from the garbage collection analysis of the interpreter,
+// so a tensor shares memory only with tensors the garbage collector would
+// have freed before it is written. Tensors sharing buffers with other
+// tensors are never planned.
+class StaticMemoryPlanner {
+ public:
+  StaticMemoryPlanner(
+      const phi::Place& place,
+      const std::vector<Variable*>& vars,
+      const std::vector<std::unique_ptr<InstructionBase>>& instrs,
+      const std::vector<size_t>& execute_order,
+      const std::unordered_set<size_t>& skip_var_ids);
+
+  bool IsEnabled() const { return enabled_; }
+
+  bool IsRecording() const { return recording_; }
+
+  bool IsBound(size_t var_id) const { return bound_[var_id]; }
+
+  size_t ArenaSize() const { return arena_ ? arena_->size() : 0; }
+
+  // Returns the number of tensors bound to the arena.
+  size_t BoundNum() const { return views_.size(); }
+
+  // Binds the tensors of the plan of the current shape signature, or starts
+  // recording a plan for it.
+  void BeforeRun();
+
+  // Records the instruction, only called while recording.
+  void BeforeInstruction(const InstructionBase& instr);
+  void AfterInstruction(const InstructionBase& instr);
+
+  // Finishes the recorded plan, or adjusts the bound one to tensors that
+  // outgrew their block.
+  void AfterRun();
+
+  // Detaches the bound tensors from the arena. Must be called before the
+  // variables are run without the planner, since tensors sharing the arena
+  // are only safe in the planned execution order.
+  void Unbind();
+
+ private:
+  struct Plan {
+    std::vector<MemoryBlock> blocks;
+    size_t arena_size{0};
+  };
+
+  phi::DenseTensor* DenseTensorOf(size_t var_id) const;
+
+  std::vector<int64_t> ShapeSignature() const;
+
+  void Invalidate(size_t var_id);
+
+  void Bind(Plan* plan);
+
+  phi::Place place_;
+  bool enabled_{true};
+  std::vector<Variable*> vars_;
+  std::vector<size_t> signature_var_ids_;
+  std::unordered_map<size_t, size_t> instr_pos_;
+  std::unordered_map<size_t, size_t> last_use_pos_;
+  std::unordered_set<size_t> skip_var_ids_;
+
+  std::map<std::vector<int64_t>, Plan> plans_;
+
+  // The bound plan.
+  Plan* active_plan_{nullptr};
+  std::shared_ptr<phi::Allocation> arena_;
+  std::vector<std::shared_ptr<phi::Allocation>> views_;
+  std::vector<bool> bound_;
+
+  // The plan being recorded.
+  bool recording_{false};
+  std::vector<int64_t> recording_signature_;
+  std::unordered_map<size_t, MemoryBlock> candidates_;
+  std::unordered_set<size_t> invalid_var_ids_;
+  std::unordered_map<const phi::Allocation*, size_t> holder_owners_;
+  std::unordered_set<size_t> fresh_outputs_;
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -864,6 +864,35 @@ void PirStreamAnalyzer::ShareEventInfoFrom(const PirStreamAnalyzer& src) {
   is_event_info_build_ = true;
 }
 
+std::map<size_t, std::set<size_t>> PirStreamAnalyzer::GetWaiterRecorders()
+    const {
+  std::map<size_t, std::set<size_t>> waiter_recorders;
+  for (auto& context_item : *event_info_) {
+    for (auto& [waiter_instr_id, recorder_instr_ids] : context_item.second) {
+      waiter_recorders[waiter_instr_id].insert(recorder_instr_ids.begin(),
+                                               recorder_instr_ids.end());
+    }
+  }
+  return waiter_recorders;
+}
+
+void PirStreamAnalyzer::LoadEventInfo(
+    const std::vector<std::unique_ptr<paddle::framework::InstructionBase>>&
+        instructions,
+    const std::map<size_t, std::set<size_t>>& waiter_recorders) {
+  // The ids run over two steps of the instructions, as in ConstructEvents.
+  const size_t instr_num = instructions.size();
+  event_info_->clear();
+  for (auto& [waiter_instr_id, recorder_instr_ids] : waiter_recorders) {
+    for (size_t recorder_instr_id : recorder_instr_ids) {
+      const DeviceContext* context =
+          &instructions.at(recorder_instr_id % instr_num)->DeviceContext();
+      (*event_info_)[context][waiter_instr_id].insert(recorder_instr_id);
+    }
+  }
+  is_event_info_build_ = true;
+}
+
 std::shared_ptr<
     std::map<const DeviceContext*, std::map<size_t, std::set<size_t>>>>
 PirStreamAnalyzer::GetEventInfo() const {
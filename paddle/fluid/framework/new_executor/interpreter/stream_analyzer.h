@@ -144,6 +144,18 @@ class PirStreamAnalyzer {
 
   void ShareEventInfoFrom(const PirStreamAnalyzer& src);
 
+  // Returns the recorders every waiter waits for, over all the device
+  // contexts. The device context of an event is the one of its recorder, so
+  // LoadEventInfo rebuilds the event info from them.
+  std::map<size_t, std::set<size_t>> GetWaiterRecorders() const;
+
+  // Sets the event info from GetWaiterRecorders of the same instructions, so
+  // that ConstructEvents skips the analysis.
+  void LoadEventInfo(
+      const std::vector<std::unique_ptr<paddle::framework::InstructionBase>>&
+          instructions,
+      const std::map<size_t, std::set<size_t>>& waiter_recorders);
+
   void SetForceEventsToWaitInfo(
       std::unordered_map<std::string, std::shared_ptr<EventInter>>*
           program_force_events_to_wait) {
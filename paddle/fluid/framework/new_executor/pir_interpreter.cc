@@ -22,11 +22,13 @@
 #include "paddle/fluid/framework/details/nan_inf_utils.h"
 #include "paddle/fluid/framework/details/share_tensor_buffer_functor.h"
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
+#include "paddle/fluid/framework/new_executor/interpreter/plan_cache.h"
 #include "paddle/fluid/framework/new_executor/interpreter/static_build.h"
 #include "paddle/fluid/framework/operator.h"
 #include "paddle/fluid/platform/device/gpu/gpu_info.h"
 #include "paddle/fluid/platform/profiler/event_tracing.h"
 #include "paddle/fluid/platform/profiler/supplement_tracing.h"
+#include "paddle/phi/backends/cpu/cpu_context.h"
 #include "paddle/phi/common/place.h"
 #include "paddle/phi/core/kernel_context.h"
 #include "paddle/phi/core/os_info.h"
@@ -88,6 +90,11 @@ COMMON_DECLARE_bool(dynamic_static_unified_comm);
 COMMON_DECLARE_bool(enable_pir_in_executor);
 COMMON_DECLARE_bool(enable_pir_in_executor_trace_run);
 COMMON_DECLARE_bool(enable_collect_shape);
+COMMON_DECLARE_bool(pir_static_memory_plan);
+COMMON_DECLARE_bool(pir_critical_path_schedule);
+COMMON_DECLARE_int32(pir_cpu_thread_budget);
+COMMON_DECLARE_string(pir_plan_cache_dir);
+COMMON_DECLARE_bool(pir_capture_cpu_program);
 COMMON_DECLARE_int32(low_precision_op_list);
 
 #define CREATE_INSTR(instr_name)                                   \
@@ -186,10 +193,17 @@ PirInterpreter::PirInterpreter(const phi::Place& place,
         vec_instruction_base_[lhs]->GetSchedulingPriority();
     SchedulingPriority rhs_scheduling_priority =
         vec_instruction_base_[rhs]->GetSchedulingPriority();
-    if (lhs_scheduling_priority == rhs_scheduling_priority) {
-      return lhs > rhs;
+    if (lhs_scheduling_priority != rhs_scheduling_priority) {
+      return lhs_scheduling_priority > rhs_scheduling_priority;
     }
-    return lhs_scheduling_priority > rhs_scheduling_priority;
+    if (critical_path_scheduler_) {
+      double lhs_critical_path = critical_path_scheduler_->CriticalPath(lhs);
+      double rhs_critical_path = critical_path_scheduler_->CriticalPath(rhs);
+      if (lhs_critical_path != rhs_critical_path) {
+        return lhs_critical_path < rhs_critical_path;
+      }
+    }
+    return lhs > rhs;
   };
 
   PrepareForCUDAGraphCapture();
@@ -277,10 +291,17 @@ PirInterpreter::PirInterpreter(
         vec_instruction_base_[lhs]->GetSchedulingPriority();
     SchedulingPriority rhs_scheduling_priority =
         vec_instruction_base_[rhs]->GetSchedulingPriority();
-    if (lhs_scheduling_priority == rhs_scheduling_priority) {
-      return lhs > rhs;
+    if (lhs_scheduling_priority != rhs_scheduling_priority) {
+      return lhs_scheduling_priority > rhs_scheduling_priority;
+    }
+    if (critical_path_scheduler_) {
+      double lhs_critical_path = critical_path_scheduler_->CriticalPath(lhs);
+      double rhs_critical_path = critical_path_scheduler_->CriticalPath(rhs);
+      if (lhs_critical_path != rhs_critical_path) {
+        return lhs_critical_path < rhs_critical_path;
+      }
     }
-    return lhs_scheduling_priority > rhs_scheduling_priority;
+    return lhs > rhs;
   };
 
   PrepareForCUDAGraphCapture();
@@ -357,6 +378,8 @@ void PirInterpreter::reset_scope(Scope* new_scope) {
        i++) {
     refs_[i]->ResetVariable(value_exe_info_->GetVarList()[i]);
   }
+  // The plan refers to the variables of the old scope.
+  static_memory_planner_.reset();
 }
 
 const Scope* PirInterpreter::local_scope() const { return local_scope_; }
@@ -391,6 +414,18 @@ std::tuple<double, double> PirInterpreter::InterpreterRunTime() {
   return std::make_tuple(start_time, end_time);
 }
 
+std::tuple<size_t, size_t> PirInterpreter::InferMetaStat() const {
+  size_t skipped = 0, executed = 0;
+  for (auto& instr : vec_instruction_base_) {
+    auto* phi_instr = dynamic_cast<PhiKernelInstruction*>(instr.get());
+    if (phi_instr != nullptr) {
+      skipped += phi_instr->InferMetaSkippedCount();
+      executed += phi_instr->InferMetaExecutedCount();
+    }
+  }
+  return std::make_tuple(skipped, executed);
+}
+
 const interpreter::PirDependencyBuilder&
 PirInterpreter::GetPirDependencyBuilder() const {
   return ir_dependency_builder_;
@@ -768,6 +803,7 @@ void PirInterpreter::AnalyseExecuteOrderForTrace(
 
 void PirInterpreter::BuildInstruction() {
   VLOG(6) << "Build Instructions for pir ... ";
+  captured_program_.reset();
   vec_instruction_base_.clear();
   size_t op_idx = 0;
   for (auto& op : *ir_block_) {
@@ -1267,6 +1303,13 @@ void PirInterpreter::CheckGC(InstructionBase* instr) {
       continue;
     }
 
+    if (is_ready && static_memory_planner_ &&
+        static_memory_planner_->IsBound(var_id)) {
+      VLOG(6) << value_exe_info_->GetNameById(static_cast<int>(var_id))
+              << " is bound by static memory plan, skip gc";
+      continue;
+    }
+
     if (is_ready) {
       VLOG(6) << "Async delete variable with name : "
               << value_exe_info_->GetNameById(static_cast<int>(var_id));
@@ -1471,10 +1514,7 @@ paddle::framework::FetchList PirInterpreter::Run(
     PreAnalysis();
     VLOG(4) << "Done PreAnalysis";
 
-    if (FLAGS_enable_pir_in_executor_trace_run || onednn_op_num_ ||
-        execution_config_.used_for_inference ||
-        ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
-         (sync_op_num_ == 0))) {
+    if (UseTraceRun()) {
       LOG_FIRST_N(INFO, 1) << "pir interpreter is running by trace mode ...";
       TraceRunImpl();
     } else {
@@ -1486,10 +1526,7 @@ paddle::framework::FetchList PirInterpreter::Run(
     is_build_ = true;
     is_shared_results_build_ = true;
   } else {
-    if (FLAGS_enable_pir_in_executor_trace_run || onednn_op_num_ ||
-        execution_config_.used_for_inference ||
-        ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
-         (sync_op_num_ == 0))) {
+    if (UseTraceRun()) {
       TraceRunImpl();
     } else {
       MultiThreadRunImpl();
@@ -1500,6 +1537,11 @@ paddle::framework::FetchList PirInterpreter::Run(
     ClearLoDTensorArrayInLocalScope();
   }
 
+  if (VLOG_IS_ON(4)) {
+    auto [skipped, executed] = InferMetaStat();
+    VLOG(4) << "InferMeta skipped: " << skipped << ", executed: " << executed;
+  }
+
   // return Fetch Tensors
   Scope* inner_scope = InnerScope();
   framework::FetchList fetch_res;
@@ -1556,10 +1598,7 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
     VLOG(4) << "Done PreAnalysis";
 
     // Run
-    if (FLAGS_enable_pir_in_executor_trace_run || onednn_op_num_ ||
-        execution_config_.used_for_inference ||
-        ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
-         (sync_op_num_ == 0))) {
+    if (UseTraceRun()) {
       LOG_FIRST_N(INFO, 1) << "pir interpreter is running by trace mode ...";
       TraceRunImpl();
     } else {
@@ -1571,10 +1610,7 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
     is_build_ = true;
     is_shared_results_build_ = true;
   } else {
-    if (FLAGS_enable_pir_in_executor_trace_run || onednn_op_num_ ||
-        execution_config_.used_for_inference ||
-        ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
-         (sync_op_num_ == 0))) {
+    if (UseTraceRun()) {
       TraceRunImpl();
     } else {
       MultiThreadRunImpl();
@@ -1585,6 +1621,11 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
     ClearLoDTensorArrayInLocalScope();
   }
 
+  if (VLOG_IS_ON(4)) {
+    auto [skipped, executed] = InferMetaStat();
+    VLOG(4) << "InferMeta skipped: " << skipped << ", executed: " << executed;
+  }
+
   framework::FetchList fetch_res;
   if (need_fetch) {
     // return Fetch Tensors
@@ -1601,17 +1642,81 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
   return fetch_res;
 }
 
+bool PirInterpreter::UseTraceRun() const {
+  // oneDNN instructions keep per-thread states, so they always run in trace
+  // mode. Otherwise a CPU thread budget asks for the multi-thread mode.
+  if (onednn_op_num_) {
+    return true;
+  }
+  if (cpu_thread_budget_) {
+    return false;
+  }
+  return FLAGS_enable_pir_in_executor_trace_run ||
+         execution_config_.used_for_inference ||
+         ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
+          (sync_op_num_ == 0));
+}
+
 void PirInterpreter::TraceRunImpl() {
+  if (captured_program_) {
+    if (FLAGS_pir_capture_cpu_program && captured_program_->Matches()) {
+      VLOG(4) << "Replay the captured program";
+      try {
+        captured_program_->Replay();
+      } catch (...) {
+        captured_program_.reset();
+        throw;
+      }
+      ++captured_replay_count_;
+      return;
+    }
+    VLOG(4) << "Drop the captured program";
+    captured_program_.reset();
+  }
+
   // lazy initialization of gc, do not create gc is the program only run once
   if (!gc_) {
     gc_ = CreateInterpreterCoreGarbageCollector(place_, vec_instruction_base_);
   }
 
   interpreter::ResetAtomicGuard guard(&deps_, &refs_);
+
+  if (FLAGS_pir_static_memory_plan && !static_memory_planner_) {
+    std::unordered_set<size_t> parameter_var_ids;
+    for (auto& name : parameter_var_names_) {
+      int var_id = value_exe_info_->GetIdByName(name);
+      if (var_id != -1) {
+        parameter_var_ids.insert(var_id);
+      }
+    }
+    static_memory_planner_ =
+        std::make_unique<interpreter::StaticMemoryPlanner>(
+            place_,
+            value_exe_info_->GetVarList(),
+            vec_instruction_base_,
+            trace_execute_order_,
+            parameter_var_ids);
+  } else if (!FLAGS_pir_static_memory_plan && static_memory_planner_) {
+    static_memory_planner_->Unbind();
+    static_memory_planner_.reset();
+  }
+  bool use_static_memory_plan =
+      static_memory_planner_ && static_memory_planner_->IsEnabled();
+  if (use_static_memory_plan) {
+    static_memory_planner_->BeforeRun();
+  }
+
   VLOG(4) << "Tracing Instruction List";
 
   TraceRunInstructionList(vec_instruction_base_);
   VLOG(4) << "Done TraceRunInstructionList";
+  if (use_static_memory_plan) {
+    static_memory_planner_->AfterRun();
+  }
+  if (CanCaptureProgram()) {
+    captured_program_ = interpreter::CapturedProgram::Capture(
+        vec_instruction_base_, trace_execute_order_);
+  }
 #ifdef PADDLE_WITH_CUSTOM_DEVICE
   if (phi::is_custom_place(place_)) {
     phi::DeviceContextPool::Instance().Get(place_)->Wait();
@@ -1619,6 +1724,16 @@ void PirInterpreter::TraceRunImpl() {
 #endif
 }
 
+bool PirInterpreter::CanCaptureProgram() const {
+  // The replay skips everything RunInstructionBase does around the kernels,
+  // so it is only used when none of that is needed.
+  return FLAGS_pir_capture_cpu_program && phi::is_cpu_place(place_) &&
+         !static_memory_planner_ && pir_input_hookfuncs_.empty() &&
+         pir_output_hookfuncs_.empty() && !enable_job_schedule_profiler_ &&
+         !FLAGS_enable_collect_shape && !FLAGS_check_nan_inf &&
+         !FLAGS_benchmark;
+}
+
 void PirInterpreter::MultiThreadRunImpl() {
   // lazy initialization of gc, do not create gc is the program only run once
   if (!gc_) {
@@ -1626,6 +1741,10 @@ void PirInterpreter::MultiThreadRunImpl() {
   }
 
   interpreter::ResetAtomicGuard guard(&deps_, &refs_);
+  if (static_memory_planner_) {
+    static_memory_planner_->Unbind();
+    static_memory_planner_.reset();
+  }
   VLOG(4) << "Multi Thread Run Instruction List";
 
   async_work_queue_ = GetWorkQueue();
@@ -1719,6 +1838,11 @@ void PirInterpreter::MultiThreadRunInstructionList(
     }
   }
 
+  auto run_start = std::chrono::steady_clock::now();
+  if (critical_path_scheduler_) {
+    critical_path_scheduler_->BeginRun();
+  }
+
   for (size_t i = 0; i < dependency_count_->size(); ++i) {
     if ((*dependency_count_)[i] == 0) {
       // NOTE(zhiqiu): hot fix for jit input var
@@ -1726,6 +1850,9 @@ void PirInterpreter::MultiThreadRunInstructionList(
       if (FLAGS_new_executor_serial_run) {
         RunInstructionBaseAsync(i);
       } else {
+        if (critical_path_scheduler_) {
+          critical_path_scheduler_->RecordDispatch();
+        }
         async_work_queue_->AddTask(vec_instr.at(i)->KernelType(),
                                    [this, i] { RunInstructionBaseAsync(i); });
       }
@@ -1771,6 +1898,21 @@ void PirInterpreter::MultiThreadRunInstructionList(
     VLOG(1) << "Logged deps for " << logged_times.get() << " times";
   }
 
+  if (critical_path_scheduler_) {
+    double wall_us = std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - run_start)
+                         .count();
+    last_scheduling_stat_ = critical_path_scheduler_->EndRun(
+        wall_us,
+        execution_config_.host_num_threads +
+            execution_config_.device_num_threads);
+    VLOG(4) << "Scheduling stat: wall " << last_scheduling_stat_.wall_us
+            << "us, busy " << last_scheduling_stat_.busy_us << "us, idle "
+            << last_scheduling_stat_.idle_us << "us, dispatched "
+            << last_scheduling_stat_.dispatched << ", inlined "
+            << last_scheduling_stat_.inlined;
+  }
+
   if (UNLIKELY(exception_holder_.IsCaught())) {
     VLOG(1) << "Exception caught " << exception_holder_.Type();
     // Graceful exit when the executor encountered a fatal error.
@@ -1795,6 +1937,7 @@ void PirInterpreter::RunInstructionBaseAsync(size_t instr_id) {
   // scheduling, the priority order involved cross-thread scheduling is not
   // guaranteed. Only Ops scheduled by the same AddTask call have the guarantee
   // of priority order.
+  auto* scheduler = critical_path_scheduler_.get();
   SchedulingQueue ready_ops(ir_instruction_scheduling_priority_less);
   ready_ops.push(instr_id);
   while (!ready_ops.empty()) {
@@ -1802,7 +1945,29 @@ void PirInterpreter::RunInstructionBaseAsync(size_t instr_id) {
     ready_ops.pop();
     auto* instr_node = vec_instruction_base_.at(instr_id).get();
 
-    RunInstructionBase(instr_node);
+    std::unique_ptr<interpreter::IntraOpThreadsGuard> threads_guard;
+    if (cpu_thread_budget_) {
+      threads_guard = std::make_unique<interpreter::IntraOpThreadsGuard>(
+          cpu_thread_budget_.get(), instr_id);
+    }
+
+    if (scheduler) {
+      // Recorded before the instruction is counted as finished, since the
+      // main thread collects the records once all instructions finish.
+      auto start = std::chrono::steady_clock::now();
+      RunInstructionBase(instr_node);
+      int64_t elapsed_ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+      scheduler->RecordTask(elapsed_ns);
+      if (scheduler->IsProfiling()) {
+        scheduler->RecordInstruction(instr_id, elapsed_ns);
+      }
+    } else {
+      RunInstructionBase(instr_node);
+    }
+    threads_guard.reset();
 
     if (UNLIKELY(exception_holder_.IsCaught())) {
       VLOG(4) << "Exception caught";
@@ -1835,6 +2000,12 @@ void PirInterpreter::RunNextInstructions(InstructionBase* instr,
     return deps_[next_id]->CheckAndDecrease();
   };
 
+  if (critical_path_scheduler_ &&
+      instr->KernelType() != OpFuncType::kGpuAsync) {
+    RunNextInstructionsByCriticalPath(instr, IsReady, reserved_next_ops);
+    return;
+  }
+
   for (size_t next_instr_id : instr->NextInstrsInDifferenceThread()) {
     if (IsReady(next_instr_id)) {
       async_work_queue_->AddTask(
@@ -1850,6 +2021,53 @@ void PirInterpreter::RunNextInstructions(InstructionBase* instr,
   }
 }
 
+void PirInterpreter::RunNextInstructionsByCriticalPath(
+    InstructionBase* instr,
+    const std::function<bool(size_t)>& is_ready,
+    SchedulingQueue* reserved_next_ops) {
+  std::vector<size_t> ready_ids;
+  for (size_t next_instr_id : instr->NextInstrsInSameThread()) {
+    if (is_ready(next_instr_id)) {
+      ready_ids.push_back(next_instr_id);
+    }
+  }
+  for (size_t next_instr_id : instr->NextInstrsInDifferenceThread()) {
+    if (is_ready(next_instr_id)) {
+      ready_ids.push_back(next_instr_id);
+    }
+  }
+
+  // This worker continues with the ready host instruction on the longest
+  // critical path, and with the tiny ones, which cost less than waking up
+  // another worker. The others are dispatched.
+  auto* scheduler = critical_path_scheduler_.get();
+  auto IsHost = [this](size_t id) {
+    return vec_instruction_base_[id]->KernelType() != OpFuncType::kGpuAsync;
+  };
+  size_t continued_id = ready_ids.size();
+  for (size_t i = 0; i < ready_ids.size(); ++i) {
+    if (IsHost(ready_ids[i]) &&
+        (continued_id == ready_ids.size() ||
+         scheduler->CriticalPath(ready_ids[i]) >
+             scheduler->CriticalPath(ready_ids[continued_id]))) {
+      continued_id = i;
+    }
+  }
+  for (size_t i = 0; i < ready_ids.size(); ++i) {
+    size_t next_instr_id = ready_ids[i];
+    if (i == continued_id ||
+        (IsHost(next_instr_id) && scheduler->IsTiny(next_instr_id))) {
+      scheduler->RecordInline();
+      reserved_next_ops->push(next_instr_id);
+    } else {
+      scheduler->RecordDispatch();
+      async_work_queue_->AddTask(
+          vec_instruction_base_[next_instr_id]->KernelType(),
+          [this, next_instr_id]() { RunInstructionBaseAsync(next_instr_id); });
+    }
+  }
+}
+
 void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
   platform::RecordEvent instruction_event(
       instr_node->Name(), platform::TracerEventType::Operator, 1);
@@ -1896,11 +2114,19 @@ void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
     }
 
     if (!instr_node->IsArtificial()) {
+      bool record_memory =
+          static_memory_planner_ && static_memory_planner_->IsRecording();
+      if (record_memory) {
+        static_memory_planner_->BeforeInstruction(*instr_node);
+      }
       {
         platform::RecordEvent record(
             "InstrRun", platform::TracerEventType::UserDefined, 10);
         instr_node->Run();
       }
+      if (record_memory) {
+        static_memory_planner_->AfterInstruction(*instr_node);
+      }
 
       if (FLAGS_benchmark) {
         instr_node->DeviceContext().Wait();
@@ -1968,10 +2194,33 @@ void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
 }
 
 void PirInterpreter::PreAnalysis() {
+  // Dependencies shared by another interpreter are not cached.
+  bool use_plan_cache =
+      !FLAGS_pir_plan_cache_dir.empty() && !is_shared_results_build_;
+  uint64_t plan_key = 0;
+  interpreter::CompiledPlan plan;
+  bool plan_loaded = false;
+  if (use_plan_cache) {
+    plan_key =
+        interpreter::ComputePlanKey(*ir_block_, vec_instruction_base_, place_);
+    plan_loaded = interpreter::LoadCompiledPlan(FLAGS_pir_plan_cache_dir,
+                                                plan_key,
+                                                vec_instruction_base_.size(),
+                                                &plan);
+    if (plan_loaded) {
+      ir_dependency_builder_.LoadDependency(std::move(plan.downstream_map),
+                                            std::move(plan.happens_before));
+    }
+  }
+
   BuildInstructionDependences();
   VLOG(4) << "Done BuildInstructionDependences";
 
   ir_stream_analyzer_.SetForceEventsToWaitInfo(force_events_to_wait_);
+  if (plan_loaded) {
+    ir_stream_analyzer_.LoadEventInfo(vec_instruction_base_,
+                                      plan.waiter_recorders);
+  }
   ir_stream_analyzer_.ConstructEvents(vec_instruction_base_);
   VLOG(4) << "Done ConstructEvents";
 
@@ -1990,9 +2239,48 @@ void PirInterpreter::PreAnalysis() {
     }
   }
 
-  AnalyseExecuteOrderForTrace(ir_dependency_builder_.OpDownstreamMap(),
-                              ir_instruction_scheduling_priority_less);
-  VLOG(4) << "Done AnalyseExecuteOrderForTrace";
+  compiled_plan_loaded_ = plan_loaded;
+  if (plan_loaded) {
+    trace_execute_order_ = std::move(plan.trace_execute_order);
+  } else {
+    AnalyseExecuteOrderForTrace(ir_dependency_builder_.OpDownstreamMap(),
+                                ir_instruction_scheduling_priority_less);
+    VLOG(4) << "Done AnalyseExecuteOrderForTrace";
+    if (use_plan_cache) {
+      auto [downstream_map, happens_before] =
+          ir_dependency_builder_.GetDependency();
+      plan.downstream_map = *downstream_map;
+      plan.happens_before = *happens_before;
+      plan.trace_execute_order = trace_execute_order_;
+      plan.waiter_recorders = ir_stream_analyzer_.GetWaiterRecorders();
+      interpreter::SaveCompiledPlan(FLAGS_pir_plan_cache_dir, plan_key, plan);
+    }
+  }
+
+  // Built after the trace order is analysed, so that it only changes the
+  // multi-thread mode.
+  if (FLAGS_pir_critical_path_schedule) {
+    critical_path_scheduler_ =
+        std::make_unique<interpreter::CriticalPathScheduler>(
+            ir_dependency_builder_.OpDownstreamMap(),
+            vec_instruction_base_.size());
+    VLOG(4) << "Done CriticalPathScheduler";
+  }
+
+  if (FLAGS_pir_cpu_thread_budget > 0 && phi::is_cpu_place(place_)) {
+    cpu_thread_budget_ = std::make_unique<interpreter::CpuThreadBudget>(
+        FLAGS_pir_cpu_thread_budget,
+        ir_dependency_builder_.OpDownstreamMap(),
+        vec_instruction_base_.size(),
+        static_cast<phi::CPUContext*>(
+            phi::DeviceContextPool::Instance().Get(place_)));
+    // A shared work queue keeps its threads.
+    if (async_work_queue_ == nullptr) {
+      execution_config_.host_num_threads =
+          cpu_thread_budget_->InterOpNumThreads();
+    }
+    VLOG(4) << "Done CpuThreadBudget";
+  }
 
   UpdateSyncOpNum();
   VLOG(4) << "Done UpdateSyncOpNum";
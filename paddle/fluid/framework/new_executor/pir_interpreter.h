@@ -15,6 +15,10 @@
 #pragma once
 #include <memory>
 #include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/fluid/framework/new_executor/interpreter/captured_program.h"
+#include "paddle/fluid/framework/new_executor/interpreter/cpu_thread_budget.h"
+#include "paddle/fluid/framework/new_executor/interpreter/critical_path_scheduler.h"
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
 #include "paddle/fluid/framework/new_executor/interpreter_base_impl.h"
 #include "paddle/pir/include/core/value.h"
 
@@ -72,6 +76,30 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   std::tuple<double, double> InterpreterRunTime() override;
 
+  // Returns the number of InferMeta calls skipped and executed by the phi
+  // kernel instructions since they were built.
+  std::tuple<size_t, size_t> InferMetaStat() const;
+
+  // Returns the number of runs replayed by the captured program, see
+  // FLAGS_pir_capture_cpu_program.
+  size_t CapturedReplayCount() const { return captured_replay_count_; }
+
+  // Returns whether the analysis of the program was loaded from
+  // FLAGS_pir_plan_cache_dir instead of being run.
+  bool CompiledPlanLoaded() const { return compiled_plan_loaded_; }
+
+  // Returns the static memory planner, or nullptr if it is not used, see
+  // FLAGS_pir_static_memory_plan.
+  const interpreter::StaticMemoryPlanner* GetStaticMemoryPlanner() const {
+    return static_memory_planner_.get();
+  }
+
+  // Returns the scheduling statistics of the last multi-thread run, only
+  // collected with FLAGS_pir_critical_path_schedule.
+  const interpreter::SchedulingStat& LastSchedulingStat() const {
+    return last_scheduling_stat_;
+  }
+
   std::shared_ptr<std::vector<size_t>> GetDependencyCount() const override;
 
   bool IsSharedResultsBuild() const override;
@@ -187,6 +215,23 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   std::unique_ptr<InterpreterCoreGarbageCollector> gc_;
 
+  // Only used in trace mode, see FLAGS_pir_static_memory_plan.
+  std::unique_ptr<interpreter::StaticMemoryPlanner> static_memory_planner_;
+
+  // Only used in multi-thread mode, see FLAGS_pir_critical_path_schedule.
+  std::unique_ptr<interpreter::CriticalPathScheduler> critical_path_scheduler_;
+  interpreter::SchedulingStat last_scheduling_stat_;
+
+  // Only used on CPU, see FLAGS_pir_cpu_thread_budget.
+  std::unique_ptr<interpreter::CpuThreadBudget> cpu_thread_budget_;
+
+  // Only used in trace mode on CPU, see FLAGS_pir_capture_cpu_program.
+  std::unique_ptr<interpreter::CapturedProgram> captured_program_;
+  size_t captured_replay_count_{0};
+
+  // See FLAGS_pir_plan_cache_dir.
+  bool compiled_plan_loaded_{false};
+
   // last_live_ops_[i] contains the id of operators that last access the i-th
   // var
   std::map<size_t, std::set<size_t>> last_live_ops_;
@@ -224,8 +269,12 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   void BuildInstructionDependences();
 
+  bool UseTraceRun() const;
+
   void TraceRunImpl();
 
+  bool CanCaptureProgram() const;
+
   void TraceRunInstructionList(
       const std::vector<std::unique_ptr<InstructionBase>>& vec_instr);
 
@@ -239,6 +288,11 @@ class PirInterpreter : public InterpreterBaseImpl {
   void RunNextInstructions(InstructionBase* instr,
                            SchedulingQueue* reserved_next_ops);
 
+  void RunNextInstructionsByCriticalPath(
+      InstructionBase* instr,
+      const std::function<bool(size_t)>& is_ready,
+      SchedulingQueue* reserved_next_ops);
+
   void RunInstructionBase(InstructionBase* instr_node);
 
   void RecordMemcpyD2H(InstructionBase* instr_node);
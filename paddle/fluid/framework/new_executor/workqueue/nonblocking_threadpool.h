@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
@@ -101,12 +104,15 @@ class ThreadPoolTempl {
     }
   }
 
-  void AddTask(std::function<void()> fn) {
-    AddTaskWithHint(std::move(fn), 0, num_threads_);
+  // fn can be any void() callable, small ones are queued without allocation.
+  template <typename F>
+  void AddTask(F&& fn) {
+    AddTaskWithHint(std::forward<F>(fn), 0, num_threads_);
   }
 
-  void AddTaskWithHint(std::function<void()> fn, int start, int limit) {
-    Task t = env_.CreateTask(std::move(fn));
+  template <typename F>
+  void AddTaskWithHint(F&& fn, int start, int limit) {
+    Task t = env_.CreateTask(std::forward<F>(fn));
     PerThread* pt = GetPerThread();
     if (pt->pool == this) {
       // Worker thread of this pool, push onto the thread's queue.
@@ -256,12 +262,12 @@ class ThreadPoolTempl {
     pt->thread_id = thread_id;
     Queue& q = thread_data_[thread_id].queue;
     EventCount::Waiter* waiter = ec_.GetWaiter(thread_id);
-    // TODO(dvyukov,rmlarsen): The time spent in NonEmptyQueueIndex() is
-    // proportional to num_threads_ and we assume that new work is scheduled at
-    // a constant rate, so we set spin_count to 5000 / num_threads_. The
-    // constant was picked based on a fair dice roll, tune it.
-    const int spin_count =
-        allow_spinning_ && num_threads_ > 0 ? 5000 / num_threads_ : 0;
+    // The time spent in NonEmptyQueueIndex() is proportional to num_threads_,
+    // so spin_count starts at 5000 / num_threads_. It is then tuned by the
+    // measured latency of new work, see AdaptSpinCount.
+    const int max_spin_count =
+        allow_spinning_ && num_threads_ > 0 ? 4 * 5000 / num_threads_ : 0;
+    int spin_count = max_spin_count / 4;
     if (num_threads_ == 1) {
       // For num_threads_ == 1 there is no point in going through the expensive
       // steal loop. Moreover, since NonEmptyQueueIndex() calls PopBack() on the
@@ -276,11 +282,15 @@ class ThreadPoolTempl {
             t = q.PopFront();
           }
         }
+        bool found_by_spinning = static_cast<bool>(t.f);
+        uint64_t parked_us = 0;
         if (!t.f) {
-          if (!WaitForWork(waiter, &t)) {
+          if (!WaitForWork(waiter, &t, &parked_us)) {
             return;
           }
         }
+        AdaptSpinCount(
+            found_by_spinning, parked_us, max_spin_count, &spin_count);
         if (t.f) {
           env_.ExecuteTask(t);
         }
@@ -302,11 +312,15 @@ class ThreadPoolTempl {
                   }
                 }
               }
+              bool found_by_spinning = static_cast<bool>(t.f);
+              uint64_t parked_us = 0;
               if (!t.f) {
-                if (!WaitForWork(waiter, &t)) {
+                if (!WaitForWork(waiter, &t, &parked_us)) {
                   return;
                 }
               }
+              AdaptSpinCount(
+                  found_by_spinning, parked_us, max_spin_count, &spin_count);
             }
           }
         }
@@ -362,10 +376,33 @@ class ThreadPoolTempl {
   // Steals work from any other thread in the pool.
   Task GlobalSteal() { return Steal(0, num_threads_); }
 
+  // Spinning pays off when new work follows shortly after a worker runs out
+  // of it, and only burns CPU otherwise. So spin_count is doubled when
+  // spinning finds work or the worker is woken up soon after it parks, and
+  // halved when it stays parked for long.
+  void AdaptSpinCount(bool found_by_spinning,
+                      uint64_t parked_us,
+                      int max_spin_count,
+                      int* spin_count) {
+    if (!allow_spinning_ || always_spinning_) {
+      return;
+    }
+    constexpr int kMinSpinCount = 16;
+    constexpr uint64_t kShortParkUs = 50;
+    if (found_by_spinning || (parked_us > 0 && parked_us < kShortParkUs)) {
+      *spin_count = std::min(*spin_count * 2, max_spin_count);
+    } else if (parked_us >= kShortParkUs) {
+      *spin_count = std::max(*spin_count / 2, kMinSpinCount);
+    }
+  }
+
   // WaitForWork blocks until new work is available (returns true), or if it is
   // time to exit (returns false). Can optionally return a task to execute in t
-  // (in such case t.f != nullptr on return).
-  bool WaitForWork(EventCount::Waiter* waiter, Task* t) {
+  // (in such case t.f != nullptr on return). If the thread parked, the time
+  // it parked for is returned in parked_us.
+  bool WaitForWork(EventCount::Waiter* waiter,
+                   Task* t,
+                   uint64_t* parked_us = nullptr) {
     assert(t != nullptr && !t->f);
     // We already did best-effort emptiness check in Steal, so prepare for
     // blocking.
@@ -423,7 +460,16 @@ class ThreadPoolTempl {
     // Wait for work
     platform::RecordEvent record(
         "WaitForWork", platform::TracerEventType::UserDefined, 10);
+    auto park_start = std::chrono::steady_clock::now();
     ec_.CommitWait(waiter);
+    if (parked_us != nullptr) {
+      // Counts at least 1us, 0 means the thread did not park.
+      *parked_us = std::max<uint64_t>(
+          1,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - park_start)
+              .count());
+    }
     blocked_--;
     return true;
   }
@@ -12,18 +12,23 @@
 // operations on back of the queue can be done by multiple threads concurrently.
 //
 // Algorithm outline:
-// All remote threads operating on the queue back are serialized by a mutex.
-// This ensures that at most two threads access state: owner and one remote
-// thread (Size aside). The algorithm ensures that the occupied region of the
-// underlying array is logically continuous (can wraparound, but no stray
-// occupied elements). Owner operates on one end of this region, remote thread
-// operates on the other end. Synchronization between these threads
-// (potential consumption of the last element and take up of the last empty
-// element) happens by means of state variable in each element. States are:
-// empty, busy (in process of insertion of removal) and ready. Threads claim
-// elements (empty->busy and ready->busy transitions) by means of a CAS
-// operation. The finishing transition (busy->empty and busy->ready) are done
-// with plain store as the element is exclusively owned by the current thread.
+// The algorithm ensures that the occupied region of the underlying array is
+// logically continuous (can wraparound, but no stray occupied elements).
+// Owner operates on one end of this region, remote threads operate on the
+// other end. Synchronization between these threads (potential consumption of
+// the last element and take up of the last empty element) happens by means
+// of state variable in each element. States are: empty, busy (in process of
+// insertion of removal) and ready. Threads claim elements (empty->busy and
+// ready->busy transitions) by means of a CAS operation. The finishing
+// transition (busy->empty and busy->ready) are done with plain store as the
+// element is exclusively owned by the current thread.
+//
+// Remote threads are not serialized. A remote thread first claims the element
+// at the back, then moves back_ past it by a CAS operation. If the CAS fails,
+// another remote thread has moved back_ in between, so the claim is reverted
+// and the operation is retried. Every removal increments the modification
+// counter of back_, so a CAS never succeeds on a back_ that was moved away
+// and back.
 //
 // Note: we could permit only pointers as elements, then we would not need
 // separate state variable as null/non-null pointer value would serve as state,
@@ -31,7 +36,8 @@
 // (and this is designed to store std::function<()>).
 //
 // What changed by PaddlePaddle
-//   1. Use paddle::memory::SpinLock instead of std::mutex to protect back_.
+//   1. Make operations on back of the queue lock-free instead of protecting
+//      back_ with a mutex.
 //   2. Make front_/back_ aligned to get better performance.
 //   3. Replace Eigen utils with std utils.
 
@@ -40,11 +46,9 @@
 #include <atomic>
 #include <cassert>
 #include <cstdint>
-#include <mutex>
 #include <vector>
 
 #include "paddle/fluid/framework/new_executor/workqueue/workqueue_utils.h"
-#include "paddle/fluid/memory/allocation/spin_lock.h"
 
 namespace paddle {
 namespace framework {
@@ -107,19 +111,32 @@ class RunQueue {
   // PushBack adds w at the end of the queue.
   // If queue is full returns w, otherwise returns default-constructed Work.
   Work PushBack(Work w) {
-    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
-    unsigned back = back_.load(std::memory_order_relaxed);
-    Elem* e = &array_[(back - 1) & kMask];
-    uint8_t s = e->state.load(std::memory_order_relaxed);
-    if (s != kEmpty || !e->state.compare_exchange_strong(
-                           s, kBusy, std::memory_order_acquire)) {
-      return w;
+    for (;;) {
+      unsigned back = back_.load(std::memory_order_acquire);
+      Elem* e = &array_[(back - 1) & kMask];
+      uint8_t s = e->state.load(std::memory_order_relaxed);
+      if (s == kReady) {
+        if (back_.load(std::memory_order_acquire) == back) {
+          // The queue is full.
+          return w;
+        }
+        continue;
+      }
+      if (s != kEmpty || !e->state.compare_exchange_strong(
+                             s, kBusy, std::memory_order_acquire)) {
+        // Another thread is inserting or removing the element.
+        continue;
+      }
+      unsigned new_back = ((back - 1) & kMask2) | (back & ~kMask2);
+      if (!back_.compare_exchange_strong(
+              back, new_back, std::memory_order_acq_rel)) {
+        e->state.store(kEmpty, std::memory_order_release);
+        continue;
+      }
+      e->w = std::move(w);
+      e->state.store(kReady, std::memory_order_release);
+      return Work();
     }
-    back = ((back - 1) & kMask2) | (back & ~kMask2);
-    back_.store(back, std::memory_order_relaxed);
-    e->w = std::move(w);
-    e->state.store(kReady, std::memory_order_release);
-    return Work();
   }
 
   // PopBack removes and returns the last elements in the queue.
@@ -128,54 +145,42 @@ class RunQueue {
       return Work();
     }
 
-    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
-    unsigned back = back_.load(std::memory_order_relaxed);
-    Elem* e = &array_[back & kMask];
-    uint8_t s = e->state.load(std::memory_order_relaxed);
-    if (s != kReady || !e->state.compare_exchange_strong(
-                           s, kBusy, std::memory_order_acquire)) {
-      return Work();
+    for (;;) {
+      unsigned back = back_.load(std::memory_order_acquire);
+      Elem* e = &array_[back & kMask];
+      uint8_t s = e->state.load(std::memory_order_relaxed);
+      if (s != kReady || !e->state.compare_exchange_strong(
+                             s, kBusy, std::memory_order_acquire)) {
+        // The queue is empty, or another thread is taking the element.
+        return Work();
+      }
+      if (!back_.compare_exchange_strong(back,
+                                         back + 1 + (kSize << 1),
+                                         std::memory_order_acq_rel)) {
+        e->state.store(kReady, std::memory_order_release);
+        continue;
+      }
+      Work w = std::move(e->w);
+      e->state.store(kEmpty, std::memory_order_release);
+      return w;
     }
-    Work w = std::move(e->w);
-    e->state.store(kEmpty, std::memory_order_release);
-    back_.store(back + 1 + (kSize << 1), std::memory_order_relaxed);
-    return w;
   }
 
   // PopBackHalf removes and returns half last elements in the queue.
   // Returns number of elements removed.
   unsigned PopBackHalf(std::vector<Work>* result) {
-    if (Empty()) {
-      return 0;
-    }
-
-    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
-    unsigned back = back_.load(std::memory_order_relaxed);
     unsigned size = Size();
-    unsigned mid = back;
-    if (size > 1) mid = back + (size - 1) / 2;
     unsigned n = 0;
-    unsigned start = 0;
-    for (; static_cast<int>(mid - back) >= 0; mid--) {
-      Elem* e = &array_[mid & kMask];
-      uint8_t s = e->state.load(std::memory_order_relaxed);
-      if (n == 0) {
-        if (s != kReady || !e->state.compare_exchange_strong(
-                               s, kBusy, std::memory_order_acquire))
-          continue;
-        start = mid;
-      } else {
-        // Note: no need to store temporal kBusy, we exclusively own these
-        // elements.
-        assert(s == kReady);
+    // The elements are removed one by one, as other threads may take elements
+    // from the back concurrently.
+    for (unsigned i = 0; i < (size + 1) / 2; ++i) {
+      Work w = PopBack();
+      if (!w.f) {
+        break;
       }
-      result->push_back(std::move(e->w));
-      e->state.store(kEmpty, std::memory_order_release);
+      result->push_back(std::move(w));
       n++;
     }
-    if (n != 0) {
-      back_.store(start + 1 + (kSize << 1), std::memory_order_relaxed);
-    }
     return n;
   }
 
@@ -216,7 +221,6 @@ class RunQueue {
   // modification counters.
   alignas(64) std::atomic<unsigned> front_;
   alignas(64) std::atomic<unsigned> back_;
-  paddle::memory::SpinLock mutex_;
   Elem array_[kSize];
 
   // SizeOrNotEmpty returns current queue size; if NeedSizeEstimate is false,
@@ -0,0 +1,143 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace paddle {
+namespace framework {
+
+// SmallTask is a move-only void() callable for the work queues. Callables of
+// at most kInlineSize bytes are stored inline, so that neither creating nor
+// queueing a task allocates. Larger ones are stored on the heap. Together
+// with the state of a RunQueue element, a SmallTask fills one cache line.
+class SmallTask {
+ public:
+  static constexpr size_t kInlineSize = 48;
+
+  SmallTask() = default;
+
+  SmallTask(std::nullptr_t) {}  // NOLINT
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, SmallTask>::value &&
+                !std::is_same<std::decay_t<F>, std::nullptr_t>::value>>
+  SmallTask(F&& f) {  // NOLINT
+    using Callable = std::decay_t<F>;
+    if constexpr (std::is_same<Callable, std::function<void()>>::value) {
+      if (!f) {
+        return;
+      }
+    }
+    if constexpr (IsInline<Callable>()) {
+      new (storage_) Callable(std::forward<F>(f));
+      ops_ = &InlineOps<Callable>::kOps;
+    } else {
+      *reinterpret_cast<Callable**>(storage_) =
+          new Callable(std::forward<F>(f));
+      ops_ = &HeapOps<Callable>::kOps;
+    }
+  }
+
+  SmallTask(SmallTask&& other) noexcept { MoveFrom(&other); }
+
+  SmallTask& operator=(SmallTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  SmallTask(const SmallTask&) = delete;
+  SmallTask& operator=(const SmallTask&) = delete;
+
+  ~SmallTask() { Reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // The work queues run tasks through const references.
+  void operator()() const { ops_->invoke(storage_); }
+
+  void Reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  template <typename Callable>
+  static constexpr bool IsInline() {
+    return sizeof(Callable) <= kInlineSize &&
+           alignof(Callable) <= alignof(void*) &&
+           std::is_nothrow_move_constructible<Callable>::value;
+  }
+
+ private:
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Move constructs dst from src and destroys src.
+    void (*relocate)(void* dst, void* src);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename Callable>
+  struct InlineOps {
+    static void Invoke(void* storage) {
+      (*static_cast<Callable*>(storage))();
+    }
+    static void Relocate(void* dst, void* src) {
+      new (dst) Callable(std::move(*static_cast<Callable*>(src)));
+      static_cast<Callable*>(src)->~Callable();
+    }
+    static void Destroy(void* storage) {
+      static_cast<Callable*>(storage)->~Callable();
+    }
+    static constexpr Ops kOps{&Invoke, &Relocate, &Destroy};
+  };
+
+  template <typename Callable>
+  struct HeapOps {
+    static void Invoke(void* storage) {
+      (**static_cast<Callable**>(storage))();
+    }
+    static void Relocate(void* dst, void* src) {
+      *static_cast<Callable**>(dst) = *static_cast<Callable**>(src);
+    }
+    static void Destroy(void* storage) {
+      delete *static_cast<Callable**>(storage);
+    }
+    static constexpr Ops kOps{&Invoke, &Relocate, &Destroy};
+  };
+
+  void MoveFrom(SmallTask* other) {
+    if (other->ops_ != nullptr) {
+      other->ops_->relocate(storage_, other->storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  alignas(void*) mutable unsigned char storage_[kInlineSize];
+  const Ops* ops_{nullptr};
+};
+
+}  // namespace framework
+}  // namespace paddle
@@ -11,13 +11,16 @@
 
 #include <functional>
 #include <thread>
+#include <utility>
+
+#include "paddle/fluid/framework/new_executor/workqueue/small_task.h"
 
 namespace paddle {
 namespace framework {
 
 struct StlThreadEnvironment {
   struct Task {
-    std::function<void()> f;
+    SmallTask f;
   };
 
   // EnvThread constructor must start the thread,
@@ -43,7 +46,10 @@ struct StlThreadEnvironment {
   EnvThread* CreateThread(std::function<void()> f) {
     return new EnvThread(std::move(f));
   }
-  Task CreateTask(std::function<void()> f) { return Task{std::move(f)}; }
+  template <typename F>
+  Task CreateTask(F&& f) {
+    return Task{SmallTask(std::forward<F>(f))};
+  }
   void ExecuteTask(const Task& t) { t.f(); }
 };
 
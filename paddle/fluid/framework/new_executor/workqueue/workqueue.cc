@@ -69,8 +69,11 @@ class WorkQueueImpl : public WorkQueue {
                                  platform::TracerEventType::UserDefined,
                                  10 /*level*/);
     if (tracker_ != nullptr) {
-      fn = [task = std::move(fn),
-            raii = CounterGuard<TaskTracker>(tracker_)]() mutable { task(); };
+      // Assigning the wrapper to fn would allocate, the task stores it inline.
+      queue_->AddTask(
+          [task = std::move(fn),
+           raii = CounterGuard<TaskTracker>(tracker_)]() mutable { task(); });
+      return;
     }
     queue_->AddTask(std::move(fn));
   }
@@ -173,8 +176,10 @@ void WorkQueueGroupImpl::AddTask(size_t queue_idx, std::function<void()> fn) {
       common::errors::NotFound("Workqueue of index %d is not initialized.",
                                queue_idx));
   if (queues_options_.at(queue_idx).track_task) {
-    fn = [task = std::move(fn),
-          raii = CounterGuard<TaskTracker>(tracker_)]() mutable { task(); };
+    queues_[queue_idx]->AddTask(
+        [task = std::move(fn),
+         raii = CounterGuard<TaskTracker>(tracker_)]() mutable { task(); });
+    return;
   }
   queues_[queue_idx]->AddTask(std::move(fn));
 }
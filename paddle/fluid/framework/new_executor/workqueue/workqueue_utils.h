@@ -42,11 +42,12 @@ class CounterGuard {
     }
   }
 
-  CounterGuard(CounterGuard&& other) : counter_holder_(other.counter_holder_) {
+  CounterGuard(CounterGuard&& other) noexcept
+      : counter_holder_(other.counter_holder_) {
     other.counter_holder_ = nullptr;
   }
 
-  CounterGuard& operator=(CounterGuard&& other) {
+  CounterGuard& operator=(CounterGuard&& other) noexcept {
     counter_holder_ = other.counter_holder_;
     other.counter_holder_ = nullptr;
     return *this;
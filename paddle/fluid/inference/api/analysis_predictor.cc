@@ -37,6 +37,7 @@
 #include "paddle/fluid/framework/op_proto_maker.h"
 #include "paddle/fluid/framework/operator.h"
 #include "paddle/fluid/framework/scope.h"
+#include "paddle/fluid/framework/tensor_util.h"
 #include "paddle/fluid/framework/transfer_scope_cache.h"
 #include "paddle/fluid/framework/var_type_traits.h"
 #include "paddle/fluid/framework/version.h"
@@ -50,6 +51,7 @@
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
 #include "paddle/fluid/inference/api/paddle_inference_pass.h"
 #include "paddle/fluid/inference/api/resource_manager.h"
+#include "paddle/fluid/inference/api/shared_weight_registry.h"
 #include "paddle/fluid/inference/utils/io_utils.h"
 #include "paddle/fluid/inference/utils/model_utils.h"
 #include "paddle/fluid/inference/utils/singleton.h"
@@ -507,6 +509,11 @@ bool AnalysisPredictor::Init(
     }
   }
 
+  // Clones share the weights through the root scope already.
+  if (config_.shared_weights_enabled() && !status_is_cloned_) {
+    ShareWeights();
+  }
+
   // Get the feed_target_names and fetch_target_names
 
   PrepareFeedFetch();
@@ -2595,26 +2602,12 @@ AnalysisPredictor::GetOutputTypes() {
   return output_type;
 }
 
-std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetInputTensor(
-    const std::string &name) {
-  framework::Scope *scope = nullptr;
-#if defined(PADDLE_WITH_DISTRIBUTE) && defined(PADDLE_WITH_PSCORE)
-  if (config_.dist_config().use_dist_model()) {  // NOLINT
-    scope = scope_.get();
-  } else {
-    scope = executor_->GetScope();
-  }
-#else
-  scope = executor_->GetScope();
-#endif
-  PADDLE_ENFORCE_NOT_NULL(
-      scope->FindVar(name),
-      common::errors::PreconditionNotMet(
-          "The variable named %s is not found in the scope of the executor.",
-          name));
+
+std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::CreateZeroCopyTensor(
+    framework::Scope *scope, const std::string &name, bool is_input) {
   std::unique_ptr<ZeroCopyTensor> res(new ZeroCopyTensor(
       static_cast<void *>(scope), this->GetDeviceContexts()));
-  res->input_or_output_ = true;
+  res->input_or_output_ = is_input;
   res->SetName(name);
   if (phi::is_cpu_place(place_)) {  // NOLINT
     res->SetPlace(PaddlePlace::kCPU);
@@ -2637,6 +2630,26 @@ std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetInputTensor(
   return res;
 }
 
+std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetInputTensor(
+    const std::string &name) {
+  framework::Scope *scope = nullptr;
+#if defined(PADDLE_WITH_DISTRIBUTE) && defined(PADDLE_WITH_PSCORE)
+  if (config_.dist_config().use_dist_model()) {  // NOLINT
+    scope = scope_.get();
+  } else {
+    scope = executor_->GetScope();
+  }
+#else
+  scope = executor_->GetScope();
+#endif
+  PADDLE_ENFORCE_NOT_NULL(
+      scope->FindVar(name),
+      common::errors::PreconditionNotMet(
+          "The variable named %s is not found in the scope of the executor.",
+          name));
+  return CreateZeroCopyTensor(scope, name, true);
+}
+
 std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetOutputTensor(
     const std::string &name) {
   framework::Scope *scope;  // NOLINT
@@ -2654,29 +2667,110 @@ std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetOutputTensor(
       common::errors::PreconditionNotMet(
           "The variable named %s is not found in the scope of the executor.",
           name));
-  std::unique_ptr<ZeroCopyTensor> res(new ZeroCopyTensor(
-      static_cast<void *>(scope), this->GetDeviceContexts()));
-  res->input_or_output_ = false;
-  res->SetName(name);
-  if (phi::is_cpu_place(place_)) {  // NOLINT
-    res->SetPlace(PaddlePlace::kCPU);
-  } else if (phi::is_ipu_place(place_)) {
-    // Currently, IPUPlace's tensor copy between cpu and ipu has been set in
-    // IpuBackend.
-    res->SetPlace(PaddlePlace::kCPU);
-  } else if (phi::is_xpu_place(place_)) {
-    auto xpu_place = place_;
-    res->SetPlace(PaddlePlace::kXPU, xpu_place.GetDeviceId());
-  } else if (phi::is_custom_place(place_)) {
-    auto custom_place = place_;
-    res->SetPlace(PaddlePlace::kCUSTOM,
-                  custom_place.GetDeviceId(),
-                  custom_place.GetDeviceType());
-  } else {
-    auto gpu_place = place_;
-    res->SetPlace(PaddlePlace::kGPU, gpu_place.GetDeviceId());
+  return CreateZeroCopyTensor(scope, name, false);
+}
+
+AnalysisPredictor::AsyncBuffer *AnalysisPredictor::WaitAsyncBuffer(
+    int buffer_id) {
+  PADDLE_ENFORCE_EQ(
+      buffer_id >= 0 && buffer_id < kAsyncBufferNum,
+      true,
+      common::errors::InvalidArgument(
+          "The async buffer id should be in [0, %d), but received %d.",
+          kAsyncBufferNum,
+          buffer_id));
+  auto &buffer = async_buffers_[buffer_id];
+  if (buffer.done.valid()) {
+    buffer.done.wait();
+  }
+  return &buffer;
+}
+
+std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetAsyncInputTensor(
+    const std::string &name, int buffer_id) {
+  auto input_names = GetInputNames();
+  PADDLE_ENFORCE_NE(
+      std::find(input_names.begin(), input_names.end(), name),
+      input_names.end(),
+      common::errors::InvalidArgument(
+          "The variable named %s is not an input of the model.", name));
+  auto *buffer = WaitAsyncBuffer(buffer_id);
+  if (buffer->inputs == nullptr) {
+    buffer->inputs = std::make_unique<framework::Scope>();
   }
-  return res;
+  buffer->inputs->Var(name)->GetMutable<phi::DenseTensor>();
+  return CreateZeroCopyTensor(buffer->inputs.get(), name, true);
+}
+
+std::unique_ptr<ZeroCopyTensor> AnalysisPredictor::GetAsyncOutputTensor(
+    const std::string &name, int buffer_id) {
+  auto *buffer = WaitAsyncBuffer(buffer_id);
+  PADDLE_ENFORCE_EQ(
+      buffer->outputs != nullptr && buffer->outputs->FindVar(name) != nullptr,
+      true,
+      common::errors::PreconditionNotMet(
+          "The output named %s of async buffer %d is not found, please call "
+          "RunAsync on the buffer before getting its outputs.",
+          name,
+          buffer_id));
+  return CreateZeroCopyTensor(buffer->outputs.get(), name, false);
+}
+
+std::future<bool> AnalysisPredictor::RunAsync(int buffer_id) {
+  auto *buffer = WaitAsyncBuffer(buffer_id);
+  PADDLE_ENFORCE_NOT_NULL(
+      buffer->inputs,
+      common::errors::PreconditionNotMet(
+          "The inputs of async buffer %d are not set, please fill them with "
+          "GetAsyncInputHandle before calling RunAsync.",
+          buffer_id));
+  if (async_run_queue_ == nullptr) {
+    // One thread keeps the runs in order and leaves the caller free to fill
+    // the other buffer while a run is in flight.
+    async_run_queue_ = framework::CreateSingleThreadedWorkQueue(
+        framework::WorkQueueOptions("AsyncRun",
+                                    /*num_threads=*/1,
+                                    /*allow_spinning=*/false,
+                                    /*track_task=*/false));
+  }
+  buffer->done =
+      async_run_queue_
+          ->AddAwaitableTask([this, buffer] { return RunAsyncBuffer(buffer); })
+          .share();
+  std::shared_future<bool> done = buffer->done;
+  return std::async(std::launch::deferred, [done] { return done.get(); });
+}
+
+bool AnalysisPredictor::RunAsyncBuffer(AsyncBuffer *buffer) {
+  framework::Scope *scope = executor_->GetScope();
+  // The inputs are shared rather than copied, the buffer keeps them alive
+  // until its next run.
+  for (auto &name : buffer->inputs->LocalVarNames()) {
+    auto *var = scope->FindVar(name);
+    PADDLE_ENFORCE_NOT_NULL(
+        var,
+        common::errors::PreconditionNotMet(
+            "The variable named %s is not found in the scope of the executor.",
+            name));
+    auto &input = buffer->inputs->FindVar(name)->Get<phi::DenseTensor>();
+    auto *tensor = var->GetMutable<phi::DenseTensor>();
+    tensor->ShareDataWith(input);
+    tensor->set_lod(input.lod());
+  }
+  if (!ZeroCopyRun()) {
+    return false;
+  }
+  // The outputs are copied, as the next run writes the executor's outputs
+  // while the caller reads this buffer.
+  if (buffer->outputs == nullptr) {
+    buffer->outputs = std::make_unique<framework::Scope>();
+  }
+  for (auto &name : GetOutputNames()) {
+    auto &output = scope->FindVar(name)->Get<phi::DenseTensor>();
+    auto *tensor = buffer->outputs->Var(name)->GetMutable<phi::DenseTensor>();
+    framework::TensorCopySync(output, output.place(), tensor);
+  }
+  return true;
 }
 
 bool AnalysisPredictor::ZeroCopyRun(bool switch_stream) {
@@ -3129,6 +3223,31 @@ bool AnalysisPredictor::LoadParameters() {
   return true;
 }
 
+void AnalysisPredictor::ShareWeights() {
+  auto &registry = inference::SharedWeightRegistry::Instance();
+  std::string model_key = inference::SharedWeightRegistry::ModelKey(
+      config_.prog_file(), config_.params_file(), config_.model_from_memory());
+  size_t num_shared = 0;
+  size_t num_weights = 0;
+  // The weights are in the root scope, or in the sub scope for pir models.
+  for (auto *scope : {scope_.get(), sub_scope_}) {
+    for (auto &name : scope->LocalVarNames()) {
+      auto *var = scope->FindLocalVar(name);
+      if (!var->IsType<phi::DenseTensor>() ||
+          !var->Get<phi::DenseTensor>().initialized()) {
+        continue;
+      }
+      ++num_weights;
+      if (registry.Share(
+              model_key, name, var->GetMutable<phi::DenseTensor>())) {
+        ++num_shared;
+      }
+    }
+  }
+  LOG(INFO) << "Share " << num_shared << " of " << num_weights
+            << " weights with the other predictors of the model.";
+}
+
 uint64_t AnalysisPredictor::TryShrinkMemory() {
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   if (config_.use_gpu()) {
@@ -3214,6 +3333,8 @@ bool AnalysisPredictor::SaveTrtCalibToDisk() {
 #endif
 
 AnalysisPredictor::~AnalysisPredictor() {  // NOLINT
+  // Finish the pending async runs before tearing down their executor.
+  async_run_queue_.reset();
 #ifdef PADDLE_WITH_TENSORRT
   if (config_.tensorrt_engine_enabled() &&
       config_.tensorrt_precision_mode_ == AnalysisConfig::Precision::kInt8 &&
@@ -3708,8 +3829,22 @@ std::map<std::string, DataType> Predictor::GetOutputTypes() {
   return predictor_->GetOutputTypes();
 }
 
+std::unique_ptr<Tensor> Predictor::GetAsyncInputHandle(const std::string &name,
+                                                      int buffer_id) {
+  return predictor_->GetAsyncInputTensor(name, buffer_id);
+}
+
+std::unique_ptr<Tensor> Predictor::GetAsyncOutputHandle(
+    const std::string &name, int buffer_id) {
+  return predictor_->GetAsyncOutputTensor(name, buffer_id);
+}
+
 bool Predictor::Run() { return predictor_->ZeroCopyRun(); }
 
+std::future<bool> Predictor::RunAsync(int buffer_id) {
+  return predictor_->RunAsync(buffer_id);
+}
+
 bool Predictor::Run(const std::vector<paddle::Tensor> &inputs,
                     std::vector<paddle::Tensor> *outputs) {
   return predictor_->Run(inputs, outputs);
@@ -15,12 +15,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "paddle/fluid/framework/naive_executor.h"
+#include "paddle/fluid/framework/new_executor/workqueue/workqueue.h"
 #include "paddle/fluid/framework/op_compatible_info.h"
 #include "paddle/fluid/inference/analysis/analyzer.h"
 #include "paddle/fluid/inference/api/api_impl.h"
@@ -214,6 +217,34 @@ class AnalysisPredictor : public PaddlePredictor {
   ///
   bool ZeroCopyRun(bool switch_stream = false) override;
 
+  ///
+  /// \brief Get the Input Tensor object of an async buffer
+  ///
+  /// \param[in] name input name
+  /// \param[in] buffer_id async buffer id, 0 or 1
+  /// \return input tensor
+  ///
+  std::unique_ptr<ZeroCopyTensor> GetAsyncInputTensor(const std::string &name,
+                                                      int buffer_id) override;
+  ///
+  /// \brief Get the Output Tensor object of an async buffer
+  ///
+  /// \param[in] name output name
+  /// \param[in] buffer_id async buffer id, 0 or 1
+  /// \return output tensor
+  ///
+  std::unique_ptr<ZeroCopyTensor> GetAsyncOutputTensor(const std::string &name,
+                                                       int buffer_id) override;
+
+  ///
+  /// \brief Run the prediction engine in the background on the inputs of an
+  /// async buffer, and copy the outputs to it
+  ///
+  /// \param buffer_id async buffer id, 0 or 1
+  /// \return A future of whether the function executed successfully
+  ///
+  std::future<bool> RunAsync(int buffer_id) override;
+
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   // Note: Can only be used under thread_local semantics.
   bool ExpRunWithExternalStream(const gpuStream_t stream);
@@ -391,6 +422,11 @@ class AnalysisPredictor : public PaddlePredictor {
   /// \return Whether the function executed successfully
   ///
   bool LoadParameters();
+  ///
+  /// \brief Share the weights that are identical to the ones of the other
+  /// predictors of the same model through SharedWeightRegistry.
+  ///
+  void ShareWeights();
 
   ///
   /// \brief Save or Load pir model parameters.
@@ -519,6 +555,12 @@ class AnalysisPredictor : public PaddlePredictor {
   void InitResourceManager(void *stream);
   std::string GetOptimizedModelPath();
   void ClearExtraParams();
+  std::unique_ptr<ZeroCopyTensor> CreateZeroCopyTensor(
+      framework::Scope *scope, const std::string &name, bool is_input);
+  // Waits for the last RunAsync of the buffer and returns the buffer.
+  struct AsyncBuffer;
+  AsyncBuffer *WaitAsyncBuffer(int buffer_id);
+  bool RunAsyncBuffer(AsyncBuffer *buffer);
 
 #if defined(PADDLE_WITH_DISTRIBUTE) && defined(PADDLE_WITH_PSCORE)
   // fleet exe related
@@ -628,6 +670,18 @@ class AnalysisPredictor : public PaddlePredictor {
   std::map<phi::Place, std::shared_future<std::unique_ptr<phi::DeviceContext>>>
       device_contexts_;
 
+  // Double-buffered inputs and outputs of RunAsync. Each buffer keeps its
+  // tensors in a scope of its own, named after the feeds and fetches, and
+  // the future of its last run. The runs execute on one background thread.
+  struct AsyncBuffer {
+    std::unique_ptr<framework::Scope> inputs;
+    std::unique_ptr<framework::Scope> outputs;
+    std::shared_future<bool> done;
+  };
+  static constexpr int kAsyncBufferNum = 2;
+  std::array<AsyncBuffer, kAsyncBufferNum> async_buffers_;
+  std::unique_ptr<framework::WorkQueue> async_run_queue_;
+
 #if defined(PADDLE_WITH_DISTRIBUTE) && defined(PADDLE_WITH_PSCORE)
   // fleet executor related
   distributed::FleetExecutorDesc executor_desc_;
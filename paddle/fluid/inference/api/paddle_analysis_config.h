@@ -893,6 +893,24 @@ struct PD_INFER_DECL AnalysisConfig {
   ///
   void UseOptimizedModel(bool x = true) { use_optimized_model_ = x; }
 
+  ///
+  /// \brief Control whether to share the weights with the other predictors
+  /// of the same model in this process. After the analysis passes, every
+  /// weight that is identical to one of a living predictor of the same
+  /// model is replaced by a reference to it, so that the predictors keep
+  /// one copy of the weights unless a pass changed them, e.g. fused or cast
+  /// them differently. The shared weights must not be modified.
+  ///
+  /// \param x whether to share the weights.
+  ///
+  void EnableSharedWeights(bool x = true) { use_shared_weights_ = x; }
+  ///
+  /// \brief A boolean state telling whether the weights are shared.
+  ///
+  /// \return bool Whether the weights are shared.
+  ///
+  bool shared_weights_enabled() const { return use_shared_weights_; }
+
   ///
   /// \brief Control whether to debug IR graph analysis phase.
   /// This will generate DOT files for visualizing the computation graph after
@@ -1317,6 +1335,8 @@ struct PD_INFER_DECL AnalysisConfig {
 
   bool use_optimized_model_{false};
 
+  bool use_shared_weights_{false};
+
   bool use_new_executor_{false};
 
   bool specify_input_name_{false};
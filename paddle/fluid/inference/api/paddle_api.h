@@ -23,6 +23,7 @@
  */
 
 #include <cassert>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -298,6 +299,42 @@ class PD_INFER_DECL PaddlePredictor {
   /// \return Whether the run is successful
   virtual bool ZeroCopyRun(bool switch_stream = false) { return false; }
 
+  /// \brief Get the input ZeroCopyTensor by name of the async buffer
+  /// buffer_id, which RunAsync(buffer_id) feeds to the network. Waits until
+  /// the previous RunAsync of the buffer finished.
+  /// \param name The input tensor name.
+  /// \param buffer_id The async buffer, 0 or 1.
+  /// \return Return the corresponding input ZeroCopyTensor.
+  virtual std::unique_ptr<ZeroCopyTensor> GetAsyncInputTensor(
+      const std::string& name, int buffer_id) {
+    return nullptr;
+  }
+
+  /// \brief Get the output ZeroCopyTensor by name of the async buffer
+  /// buffer_id, which holds the outputs of the last RunAsync(buffer_id).
+  /// Waits until that run finished.
+  /// \param name The output tensor name.
+  /// \param buffer_id The async buffer, 0 or 1.
+  /// \return Return the corresponding output ZeroCopyTensor.
+  virtual std::unique_ptr<ZeroCopyTensor> GetAsyncOutputTensor(
+      const std::string& name, int buffer_id) {
+    return nullptr;
+  }
+
+  /// \brief Run the network on the inputs of the async buffer buffer_id in
+  /// the background, and copy the outputs to the buffer. With the two
+  /// buffers, the caller fills the inputs of the next batch and reads the
+  /// outputs of the previous one while a batch runs. Runs execute in the
+  /// order they are submitted. The predictor must not run synchronously
+  /// while async runs are pending.
+  /// \param buffer_id The async buffer, 0 or 1.
+  /// \return A future of whether the run is successful.
+  virtual std::future<bool> RunAsync(int buffer_id) {
+    std::promise<bool> result;
+    result.set_value(false);
+    return result.get_future();
+  }
+
   ///
   /// \brief Clear the intermediate tensors of the predictor
   ///
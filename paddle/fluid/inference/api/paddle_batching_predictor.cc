@@ -0,0 +1,329 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/paddle_batching_predictor.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <utility>
+
+#include "paddle/common/enforce.h"
+
+namespace paddle {
+
+namespace {
+
+size_t NumElements(const std::vector<int> &dims) {
+  size_t numel = 1;
+  for (int dim : dims) {
+    numel *= dim;
+  }
+  return numel;
+}
+
+// Copies a sample of src_dims into the zero-filled dst of dst_dims, where
+// every dimension of dst_dims is not less than the one of src_dims.
+void CopyPadded(const char *src,
+                const int *src_dims,
+                const int *dst_dims,
+                size_t rank,
+                size_t elem_size,
+                char *dst) {
+  if (rank == 0) {
+    std::memcpy(dst, src, elem_size);
+    return;
+  }
+  if (rank == 1) {
+    std::memcpy(dst, src, src_dims[0] * elem_size);
+    return;
+  }
+  size_t src_stride = elem_size;
+  size_t dst_stride = elem_size;
+  for (size_t i = 1; i < rank; ++i) {
+    src_stride *= src_dims[i];
+    dst_stride *= dst_dims[i];
+  }
+  for (int i = 0; i < src_dims[0]; ++i) {
+    CopyPadded(src + i * src_stride,
+               src_dims + 1,
+               dst_dims + 1,
+               rank - 1,
+               elem_size,
+               dst + i * dst_stride);
+  }
+}
+
+}  // namespace
+
+BatchingPredictor::BatchingPredictor(std::unique_ptr<PaddlePredictor> predictor,
+                                     const BatchingConfig &config)
+    : config_(config) {
+  PADDLE_ENFORCE_NOT_NULL(
+      predictor,
+      common::errors::InvalidArgument("The predictor should not be null."));
+  PADDLE_ENFORCE_GT(config_.max_batch_size,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The max batch size should be greater than 0, but "
+                        "received %d.",
+                        config_.max_batch_size));
+  PADDLE_ENFORCE_GT(config_.num_predictors,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The number of predictors should be greater than 0, "
+                        "but received %d.",
+                        config_.num_predictors));
+  for (auto &item : config_.shape_buckets) {
+    std::sort(item.second.begin(), item.second.end());
+  }
+
+  predictors_.push_back(std::move(predictor));
+  for (int i = 1; i < config_.num_predictors; ++i) {
+    auto clone = predictors_.front()->Clone();
+    PADDLE_ENFORCE_NOT_NULL(
+        clone,
+        common::errors::PreconditionNotMet(
+            "Failed to clone the predictor for batching, the predictor should "
+            "support Clone when num_predictors is greater than 1."));
+    predictors_.push_back(std::move(clone));
+  }
+  for (auto &item : predictors_) {
+    workers_.emplace_back(&BatchingPredictor::WorkerLoop, this, item.get());
+  }
+}
+
+BatchingPredictor::~BatchingPredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+std::future<std::vector<PaddleTensor>> BatchingPredictor::Run(
+    std::vector<PaddleTensor> inputs) {
+  std::unique_ptr<Request> request(new Request);
+  for (auto &input : inputs) {
+    PADDLE_ENFORCE_EQ(
+        !input.shape.empty() && input.shape[0] == 1,
+        true,
+        common::errors::InvalidArgument(
+            "The input %s of a request should hold one sample, i.e. its "
+            "dimension 0 should be 1.",
+            input.name));
+    PADDLE_ENFORCE_EQ(input.lod.empty(),
+                      true,
+                      common::errors::Unimplemented(
+                          "The input %s has LoD, which is not supported by "
+                          "the batching predictor.",
+                          input.name));
+    std::vector<int> shape(input.shape.begin() + 1, input.shape.end());
+    auto it = config_.shape_buckets.find(input.name);
+    if (it != config_.shape_buckets.end() && !shape.empty()) {
+      auto bucket =
+          std::lower_bound(it->second.begin(), it->second.end(), shape[0]);
+      if (bucket != it->second.end()) {
+        shape[0] = *bucket;
+      }
+    }
+    request->shapes.push_back(std::move(shape));
+  }
+  request->inputs = std::move(inputs);
+  auto outputs = request->outputs.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    request->enqueue_time = std::chrono::steady_clock::now();
+    queue_.push_back(std::move(request));
+  }
+  cv_.notify_all();
+  return outputs;
+}
+
+BatchingStats BatchingPredictor::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void BatchingPredictor::WorkerLoop(PaddlePredictor *predictor) {
+  for (;;) {
+    auto batch = NextBatch();
+    if (batch.empty()) {
+      return;
+    }
+    try {
+      RunBatch(predictor, &batch);
+    } catch (...) {
+      auto error = std::current_exception();
+      for (auto &request : batch) {
+        request->outputs.set_exception(error);
+      }
+    }
+  }
+}
+
+std::vector<std::unique_ptr<BatchingPredictor::Request>>
+BatchingPredictor::NextBatch() {
+  auto same_batch = [](const Request &a, const Request &b) {
+    if (a.shapes != b.shapes) {
+      return false;
+    }
+    for (size_t i = 0; i < a.inputs.size(); ++i) {
+      if (a.inputs[i].dtype != b.inputs[i].dtype) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const size_t max_batch_size = config_.max_batch_size;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return {};
+    }
+
+    // Wait for the batch of the oldest request to fill up or time out.
+    // Stopping runs the queued requests without waiting.
+    Request *head = queue_.front().get();
+    auto deadline = head->enqueue_time +
+                    std::chrono::microseconds(config_.batch_timeout_us);
+    auto batch_size = [&] {
+      return std::count_if(
+          queue_.begin(), queue_.end(), [&](const auto &request) {
+            return same_batch(*request, *head);
+          });
+    };
+    while (!stop_ && static_cast<size_t>(batch_size()) < max_batch_size &&
+           cv_.wait_until(lock, deadline) == std::cv_status::no_timeout) {
+      if (queue_.empty() || queue_.front().get() != head) {
+        break;
+      }
+    }
+    if (queue_.empty() || queue_.front().get() != head) {
+      // Another worker has taken the request.
+      continue;
+    }
+
+    std::vector<std::unique_ptr<Request>> batch;
+    for (auto it = queue_.begin();
+         it != queue_.end() && batch.size() < max_batch_size;) {
+      if (same_batch(**it, *head)) {
+        batch.push_back(std::move(*it));
+        it = queue_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto &request : batch) {
+      double delay_us = std::chrono::duration<double, std::micro>(
+                            now - request->enqueue_time)
+                            .count();
+      stats_.total_queue_delay_us += delay_us;
+      stats_.max_queue_delay_us = std::max(stats_.max_queue_delay_us, delay_us);
+    }
+    stats_.num_requests += batch.size();
+    stats_.num_batches += 1;
+    stats_.total_batch_fill +=
+        static_cast<double>(batch.size()) / max_batch_size;
+    VLOG(4) << "Batched " << batch.size() << " requests, " << queue_.size()
+            << " requests are left in the queue.";
+    if (!queue_.empty()) {
+      cv_.notify_all();
+    }
+    return batch;
+  }
+}
+
+void BatchingPredictor::RunBatch(PaddlePredictor *predictor,
+                                 std::vector<std::unique_ptr<Request>> *batch) {
+  const Request &head = *batch->front();
+  const int batch_size = static_cast<int>(batch->size());
+
+  std::vector<PaddleTensor> inputs(head.inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const std::vector<int> &shape = head.shapes[i];
+    auto &input = inputs[i];
+    input.name = head.inputs[i].name;
+    input.dtype = head.inputs[i].dtype;
+    input.shape.push_back(batch_size);
+    input.shape.insert(input.shape.end(), shape.begin(), shape.end());
+
+    const size_t elem_size = PaddleDtypeSize(input.dtype);
+    const size_t sample_bytes = NumElements(shape) * elem_size;
+    input.data = PaddleBuf(sample_bytes * batch_size);
+    std::memset(input.data.data(), 0, input.data.length());
+    for (int j = 0; j < batch_size; ++j) {
+      const PaddleTensor &sample = (*batch)[j]->inputs[i];
+      std::vector<int> dims(sample.shape.begin() + 1, sample.shape.end());
+      PADDLE_ENFORCE_GE(
+          sample.data.length(),
+          NumElements(dims) * elem_size,
+          common::errors::InvalidArgument(
+              "The data of the input %s is smaller than its shape.",
+              sample.name));
+      CopyPadded(static_cast<const char *>(sample.data.data()),
+                 dims.data(),
+                 shape.data(),
+                 dims.size(),
+                 elem_size,
+                 static_cast<char *>(input.data.data()) + j * sample_bytes);
+    }
+  }
+
+  std::vector<PaddleTensor> outputs;
+  PADDLE_ENFORCE_EQ(
+      predictor->Run(inputs, &outputs, batch_size),
+      true,
+      common::errors::PreconditionNotMet(
+          "Failed to run a batch of %d requests.", batch_size));
+
+  std::vector<std::vector<PaddleTensor>> results(batch_size);
+  for (auto &output : outputs) {
+    PADDLE_ENFORCE_EQ(
+        !output.shape.empty() && output.shape[0] == batch_size,
+        true,
+        common::errors::InvalidArgument(
+            "The output %s should have the batch size %d as its dimension 0.",
+            output.name,
+            batch_size));
+    const size_t sample_bytes = output.data.length() / batch_size;
+    for (int j = 0; j < batch_size; ++j) {
+      PaddleTensor result;
+      result.name = output.name;
+      result.dtype = output.dtype;
+      result.shape = output.shape;
+      result.shape[0] = 1;
+      result.data = PaddleBuf(sample_bytes);
+      std::memcpy(result.data.data(),
+                  static_cast<const char *>(output.data.data()) +
+                      j * sample_bytes,
+                  sample_bytes);
+      results[j].push_back(std::move(result));
+    }
+  }
+  for (int j = 0; j < batch_size; ++j) {
+    (*batch)[j]->outputs.set_value(std::move(results[j]));
+  }
+}
+
+}  // namespace paddle
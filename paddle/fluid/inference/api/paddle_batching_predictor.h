@@ -0,0 +1,156 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+///
+/// \file paddle_batching_predictor.h
+///
+/// \brief A dynamic batching frontend of PaddlePredictor, which coalesces
+/// single requests into batches and runs them on a pool of predictors.
+///
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "paddle_api.h"  // NOLINT
+
+namespace paddle {
+
+///
+/// \brief Configuration of BatchingPredictor.
+///
+struct PD_INFER_DECL BatchingConfig {
+  /// The largest number of requests coalesced into one batch.
+  int max_batch_size{32};
+  /// The longest time in microseconds the oldest request of a batch waits
+  /// for more requests before the batch runs.
+  int64_t batch_timeout_us{1000};
+  /// The number of predictors running batches concurrently, i.e. the given
+  /// predictor and num_predictors - 1 clones of it.
+  int num_predictors{1};
+  /// The ascending length buckets of variable-length inputs by input name.
+  /// Dimension 1 of these inputs is padded with zeros up to the smallest
+  /// bucket not less than it, and kept as is beyond the largest bucket.
+  /// Requests are only batched together if all of their inputs have the
+  /// same shapes after padding.
+  std::map<std::string, std::vector<int>> shape_buckets;
+};
+
+///
+/// \brief Statistics of BatchingPredictor since its creation.
+///
+struct PD_INFER_DECL BatchingStats {
+  uint64_t num_requests{0};
+  uint64_t num_batches{0};
+  /// The total and the longest time in microseconds requests waited from
+  /// Run to the start of their batch.
+  double total_queue_delay_us{0};
+  double max_queue_delay_us{0};
+  /// The sum of batch size / max_batch_size over the batches.
+  double total_batch_fill{0};
+
+  double AvgQueueDelayUs() const {
+    return num_requests == 0 ? 0 : total_queue_delay_us / num_requests;
+  }
+  double AvgBatchFill() const {
+    return num_batches == 0 ? 0 : total_batch_fill / num_batches;
+  }
+};
+
+///
+/// \class BatchingPredictor
+///
+/// \brief BatchingPredictor accepts single requests from many threads and
+/// coalesces them into batches of up to max_batch_size requests, or of the
+/// requests that arrived within batch_timeout_us of the oldest one. Each
+/// batch runs on one of the num_predictors predictors, and every request
+/// gets its own slice of the outputs.
+///
+/// Every input of a request holds one sample, i.e. its dimension 0 is 1,
+/// and every output of the predictor must have the batch size as its
+/// dimension 0. Inputs with LoD are not supported.
+///
+/// Example:
+/// \code{cpp}
+/// paddle::BatchingConfig batching_config;
+/// batching_config.max_batch_size = 16;
+/// batching_config.num_predictors = 4;
+/// paddle::BatchingPredictor batching(
+///     paddle::CreatePaddlePredictor(config), batching_config);
+/// std::future<std::vector<paddle::PaddleTensor>> outputs =
+///     batching.Run(std::move(inputs));
+/// \endcode
+///
+class PD_INFER_DECL BatchingPredictor {
+ public:
+  BatchingPredictor(std::unique_ptr<PaddlePredictor> predictor,
+                    const BatchingConfig& config);
+  BatchingPredictor(const BatchingPredictor&) = delete;
+  BatchingPredictor& operator=(const BatchingPredictor&) = delete;
+
+  /// \brief Run the requests that are queued and stop the predictors.
+  ~BatchingPredictor();
+
+  ///
+  /// \brief Queue one request.
+  ///
+  /// \param[in] inputs The inputs of one sample, in the order of the inputs
+  /// of the predictor.
+  /// \return A future of the outputs of the sample, which holds the error if
+  /// its batch failed.
+  ///
+  std::future<std::vector<PaddleTensor>> Run(std::vector<PaddleTensor> inputs);
+
+  /// \brief Get the queue delay and batch fill statistics.
+  BatchingStats GetStats() const;
+
+ private:
+  struct Request {
+    std::vector<PaddleTensor> inputs;
+    // The shapes of the inputs after padding, without dimension 0. Requests
+    // of one batch have the same padded shapes and dtypes.
+    std::vector<std::vector<int>> shapes;
+    std::chrono::steady_clock::time_point enqueue_time;
+    std::promise<std::vector<PaddleTensor>> outputs;
+  };
+
+  void WorkerLoop(PaddlePredictor* predictor);
+  // Waits for the next batch and removes it from the queue. Returns an empty
+  // batch once the predictor is stopped and the queue is drained.
+  std::vector<std::unique_ptr<Request>> NextBatch();
+  void RunBatch(PaddlePredictor* predictor,
+                std::vector<std::unique_ptr<Request>>* batch);
+
+  BatchingConfig config_;
+  std::vector<std::unique_ptr<PaddlePredictor>> predictors_;
+  std::vector<std::thread> workers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  bool stop_{false};
+  BatchingStats stats_;
+};
+
+}  // namespace paddle
@@ -22,6 +22,7 @@ limitations under the License. */
 #pragma once
 
 #include <cassert>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -140,6 +141,35 @@ class PD_INFER_DECL Predictor {
   bool Run(const std::vector<paddle::Tensor>& inputs,
            std::vector<paddle::Tensor>* outputs);
 
+  ///
+  /// \brief Get the Input Tensor object of an async buffer
+  ///
+  /// \param[in] name input name
+  /// \param[in] buffer_id the async buffer, 0 or 1
+  /// \return input tensor
+  ///
+  std::unique_ptr<Tensor> GetAsyncInputHandle(const std::string& name,
+                                              int buffer_id);
+
+  ///
+  /// \brief Get the Output Tensor object of an async buffer
+  ///
+  /// \param[in] name output name
+  /// \param[in] buffer_id the async buffer, 0 or 1
+  /// \return output tensor
+  ///
+  std::unique_ptr<Tensor> GetAsyncOutputHandle(const std::string& name,
+                                               int buffer_id);
+
+  ///
+  /// \brief Run the prediction engine in the background on an async buffer,
+  /// so that the caller can fill one buffer while the other one runs
+  ///
+  /// \param[in] buffer_id the async buffer, 0 or 1
+  /// \return A future of whether the function executed successfully
+  ///
+  std::future<bool> RunAsync(int buffer_id);
+
   ///
   /// \brief Get the output names
   ///
@@ -0,0 +1,116 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/shared_weight_registry.h"
+
+#include <sys/stat.h>
+
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+#include "glog/logging.h"
+#include "paddle/fluid/framework/tensor_util.h"
+
+namespace paddle {
+namespace inference {
+
+namespace {
+
+std::string FileKey(const std::string& path) {
+  std::ostringstream os;
+  os << path;
+  struct stat info;
+  if (stat(path.c_str(), &info) == 0) {
+    os << ':' << info.st_size << ':' << info.st_mtime;
+  }
+  return os.str();
+}
+
+bool SameBytes(const phi::DenseTensor& a, const phi::DenseTensor& b) {
+  if (a.data() == b.data()) {
+    return true;
+  }
+  size_t size = a.numel() * phi::SizeOf(a.dtype());
+  if (phi::is_cpu_place(a.place())) {
+    return std::memcmp(a.data(), b.data(), size) == 0;
+  }
+  phi::DenseTensor cpu_a;
+  phi::DenseTensor cpu_b;
+  framework::TensorCopySync(a, phi::CPUPlace(), &cpu_a);
+  framework::TensorCopySync(b, phi::CPUPlace(), &cpu_b);
+  return std::memcmp(cpu_a.data(), cpu_b.data(), size) == 0;
+}
+
+}  // namespace
+
+SharedWeightRegistry& SharedWeightRegistry::Instance() {
+  static SharedWeightRegistry* registry = new SharedWeightRegistry;
+  return *registry;
+}
+
+std::string SharedWeightRegistry::ModelKey(const std::string& prog_file,
+                                           const std::string& params_file,
+                                           bool model_from_memory) {
+  if (model_from_memory) {
+    // A hash collision only groups the weights of two models, which are
+    // still compared byte by byte before they are shared.
+    std::hash<std::string> hash;
+    return "memory:" + std::to_string(hash(prog_file)) + ":" +
+           std::to_string(hash(params_file));
+  }
+  return FileKey(prog_file) + ";" + FileKey(params_file);
+}
+
+bool SharedWeightRegistry::Share(const std::string& model_key,
+                                 const std::string& name,
+                                 phi::DenseTensor* tensor) {
+  if (!tensor->initialized()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& weight = weights_[model_key + "\n" + name];
+  auto holder = weight.holder.lock();
+  if (holder == nullptr) {
+    weight.holder = tensor->Holder();
+    weight.meta = tensor->meta();
+    return false;
+  }
+  phi::DenseTensor registered(holder, weight.meta);
+  if (registered.dtype() != tensor->dtype() ||
+      registered.dims() != tensor->dims() ||
+      registered.layout() != tensor->layout() ||
+      registered.place() != tensor->place() ||
+      !SameBytes(registered, *tensor)) {
+    VLOG(4) << "The weight " << name << " differs from the shared one.";
+    return false;
+  }
+  tensor->ShareDataWith(registered);
+  return true;
+}
+
+size_t SharedWeightRegistry::Size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = weights_.begin(); it != weights_.end();) {
+    if (it->second.holder.expired()) {
+      it = weights_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return weights_.size();
+}
+
+}  // namespace inference
+}  // namespace paddle
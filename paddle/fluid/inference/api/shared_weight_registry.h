@@ -0,0 +1,75 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "paddle/phi/core/dense_tensor.h"
+#include "paddle/utils/test_macros.h"
+
+namespace paddle {
+namespace inference {
+
+// SharedWeightRegistry lets the predictors of one model in a process keep a
+// single copy of their weights.
+//
+// The registry only holds weak references to the weights, keyed by the model
+// and the weight name, so a weight is freed with the last predictor using
+// it. A predictor offers every weight after its analysis passes. A weight
+// identical to the registered one of a living predictor, in meta, place and
+// bytes, is replaced by a reference to it. A weight that differs, e.g.
+// because the predictor fused or cast it in another way, stays private to
+// the predictor. Only the offered weights that are not shared need memory of
+// their own, which is copy-on-write at the granularity of the passes.
+//
+// The shared weights must be treated as read-only.
+class SharedWeightRegistry {
+ public:
+  TEST_API static SharedWeightRegistry& Instance();
+
+  // Identifies the weights of a model by the path, size and modification
+  // time of its files, or by the content of its buffers if it is loaded from
+  // memory.
+  TEST_API static std::string ModelKey(const std::string& prog_file,
+                                       const std::string& params_file,
+                                       bool model_from_memory);
+
+  // Shares *tensor with the weight `name` of the model if they are
+  // identical, otherwise registers *tensor as the weight unless it is still
+  // held by another predictor. Returns whether *tensor is shared.
+  TEST_API bool Share(const std::string& model_key,
+                      const std::string& name,
+                      phi::DenseTensor* tensor);
+
+  // Returns the number of weights that are alive.
+  TEST_API size_t Size();
+
+ private:
+  SharedWeightRegistry() = default;
+
+  struct Weight {
+    std::weak_ptr<phi::Allocation> holder;
+    phi::DenseTensorMeta meta;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Weight> weights_;
+};
+
+}  // namespace inference
+}  // namespace paddle
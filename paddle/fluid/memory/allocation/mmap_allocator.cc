@@ -18,6 +18,8 @@
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cstdlib>
 
 #include <atomic>
@@ -325,6 +327,39 @@ std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
   return std::make_shared<MemoryMapReaderAllocation>(ptr, size, ipc_name);
 }
 
+FileMemoryMapAllocation::~FileMemoryMapAllocation() {
+  if (munmap(this->ptr(), this->size()) == -1) {
+    LOG(WARNING) << "could not unmap the file " << file_name_ << ": "
+                 << strerror(errno);
+  }
+}
+
+std::shared_ptr<FileMemoryMapAllocation> AllocateFileMemoryMapAllocation(
+    const std::string &file_name) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  PADDLE_ENFORCE_NE(
+      fd,
+      -1,
+      common::errors::Unavailable(
+          "Open file %s failed: %s.", file_name.c_str(), strerror(errno)));
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1 || file_stat.st_size <= 0) {
+    close(fd);
+    PADDLE_THROW(common::errors::Unavailable(
+        "File %s is empty or cannot be inspected.", file_name.c_str()));
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  PADDLE_ENFORCE_NE(ptr,
+                    MAP_FAILED,
+                    common::errors::Unavailable(
+                        "Memory map file %s failed: %s.",
+                        file_name.c_str(),
+                        strerror(errno)));
+  return std::make_shared<FileMemoryMapAllocation>(ptr, size, file_name);
+}
+
 MemoryMapFdSet &MemoryMapFdSet::Instance() {  // NOLINT
   static MemoryMapFdSet set;
   return set;
@@ -154,6 +154,45 @@ std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
 std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
     const std::string &ipc_name, size_t size);
 
+// FileMemoryMapAllocation maps a whole regular file with MAP_PRIVATE, e.g. a
+// parameter file. Pages are read from the page cache on first touch, and
+// writes go to private copy-on-write pages instead of the file.
+class FileMemoryMapAllocation : public Allocation {
+ public:
+  explicit FileMemoryMapAllocation(void *ptr,
+                                   size_t size,
+                                   std::string file_name)
+      : Allocation(ptr, size, phi::CPUPlace()),
+        file_name_(std::move(file_name)) {}
+
+  inline const std::string &file_name() const { return file_name_; }
+
+  ~FileMemoryMapAllocation() override;
+
+ private:
+  std::string file_name_;
+};
+
+// A range of a FileMemoryMapAllocation, which keeps the whole mapping alive
+// as long as any tensor holds one of its ranges.
+class FileMemoryMapViewAllocation : public Allocation {
+ public:
+  explicit FileMemoryMapViewAllocation(
+      std::shared_ptr<FileMemoryMapAllocation> file,
+      size_t offset,
+      size_t size)
+      : Allocation(static_cast<uint8_t *>(file->ptr()) + offset,
+                   size,
+                   phi::CPUPlace()),
+        file_(std::move(file)) {}
+
+ private:
+  std::shared_ptr<FileMemoryMapAllocation> file_;
+};
+
+std::shared_ptr<FileMemoryMapAllocation> AllocateFileMemoryMapAllocation(
+    const std::string &file_name);
+
 class MemoryMapFdSet {
  public:
   static MemoryMapFdSet &Instance();  // NOLINT
@@ -111,6 +111,25 @@ void IR_API SaveCombineFunction(const std::vector<const phi::DenseTensor*>& x,
                                 bool save_as_fp16,
                                 bool save_to_memory);
 
+/**
+ * @brief Save the given tensor list into a memory mapped parameter file, in
+ * which every tensor data is aligned so that it can be loaded without copy.
+ *
+ * @param[in] x                 The tensor list to be saved.
+ * @param[in] names             The names of the tensors.
+ * @param[in] file_path         The path of the file to be written.
+ * @param[in] overwrite         If the file already exists, this flag determines
+ *                              whether to overwrite the existing file.
+ *
+ * @return void。
+ *
+ */
+void IR_API
+SaveMmapCombineFunction(const std::vector<const phi::DenseTensor*>& x,
+                        const std::vector<std::string>& names,
+                        const std::string& file_path,
+                        bool overwrite);
+
 /**
  * @brief Save the given tensor into a single file at the specified file path
  * with its name.
@@ -132,6 +151,27 @@ void IR_API LoadFunction(const std::string& file_path,
                          phi::DenseTensor* out,
                          phi::Place place = phi::Place());
 
+/**
+ * @brief Load the tensors of a memory mapped parameter file, which is written
+ * by paddle::framework::SaveMmapParamFile. CPU tensors share the mapped
+ * pages instead of copying them. LoadCombineFunction calls it when it
+ * detects such a file.
+ *
+ * @param[in] file_path         The path of the file to be read.
+ * @param[in] names             The names of the tensors.
+ * @param[out] out              The tensor to be loaded.
+ * @param[in] load_as_fp16      If the flag is true, the tensor will be loaded
+ * as fp16 type.
+ *
+ * @return void。
+ *
+ */
+void IR_API LoadMmapCombineFunction(const std::string& file_path,
+                                    const std::vector<std::string>& names,
+                                    std::vector<phi::DenseTensor*>* out,
+                                    bool load_as_fp16,
+                                    phi::Place place = phi::Place());
+
 /**
  * @brief Save the given tensor into a single file at the specified file path
  * with its name.
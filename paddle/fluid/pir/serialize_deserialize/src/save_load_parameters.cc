@@ -15,6 +15,7 @@ limitations under the License. */
 
 #include "glog/logging.h"
 #include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/mmap_param_file.h"
 #include "paddle/fluid/pir/serialize_deserialize/include/interface.h"
 #include "paddle/phi/common/port.h"
 #include "paddle/phi/kernels/funcs/data_type_transform.h"
@@ -150,6 +151,21 @@ void SaveCombineFunction(const std::vector<const phi::DenseTensor*>& x,
   VLOG(6) << "save combine done ";
 }
 
+void SaveMmapCombineFunction(const std::vector<const phi::DenseTensor*>& x,
+                             const std::vector<std::string>& names,
+                             const std::string& file_path,
+                             bool overwrite) {
+  PADDLE_ENFORCE_GT(x.size(),
+                    0UL,
+                    common::errors::InvalidArgument(
+                        "The number of variables to be saved is %d, expect "
+                        "it to be greater than 0.",
+                        x.size()));
+  VLOG(6) << "save mmap combine path: " << file_path;
+  paddle::framework::SaveMmapParamFile(x, names, file_path, overwrite);
+  VLOG(6) << "save mmap combine done ";
+}
+
 void LoadFunction(const std::string& file_path,
                   int64_t seek,
                   const std::vector<int64_t>& shape,
@@ -186,11 +202,59 @@ void LoadFunction(const std::string& file_path,
   }
 }
 
+void LoadMmapCombineFunction(const std::string& file_path,
+                             const std::vector<std::string>& names,
+                             std::vector<phi::DenseTensor*>* out,
+                             bool load_as_fp16,
+                             phi::Place place) {
+  paddle::framework::MmapParamFile param_file(file_path);
+  PADDLE_ENFORCE_EQ(
+      param_file.size(),
+      out->size(),
+      common::errors::Unavailable(
+          "Parameter file %s holds %d variables, but %d are loaded. Not "
+          "allowed to load partial data via load_combine_op, please use "
+          "load_op instead.",
+          file_path,
+          param_file.size(),
+          out->size()));
+  PADDLE_ENFORCE_EQ(
+      names.size(),
+      out->size(),
+      common::errors::InvalidArgument(
+          "The number of names is %d, but %d variables are loaded.",
+          names.size(),
+          out->size()));
+  PADDLE_ENFORCE_GT(out->size(),
+                    0UL,
+                    common::errors::InvalidArgument(
+                        "The number of variables to be loaded is %d, expect "
+                        "it to be greater than 0.",
+                        out->size()));
+  const phi::DeviceContext* dev_ctx = GetDeviceContext(*(out->at(0)), place);
+  for (size_t i = 0; i < out->size(); i++) {
+    auto tensor = out->at(i);
+    // The file may be saved in another order, tensors are found by name.
+    param_file.LoadTensor(names[i], dev_ctx->GetPlace(), tensor);
+
+    auto in_dtype = tensor->dtype();
+    auto out_dtype = load_as_fp16 ? phi::DataType::FLOAT16 : in_dtype;
+    if (in_dtype != out_dtype) {
+      auto cast_in = *tensor;
+      *tensor = CastTensorType(dev_ctx, cast_in, out_dtype);
+    }
+  }
+}
+
 void LoadCombineFunction(const std::string& file_path,
                          const std::vector<std::string>& names,
                          std::vector<phi::DenseTensor*>* out,
                          bool load_as_fp16,
                          phi::Place place) {
+  if (paddle::framework::IsMmapParamFile(file_path)) {
+    LoadMmapCombineFunction(file_path, names, out, load_as_fp16, place);
+    return;
+  }
   std::ifstream fin(file_path, std::ios::binary);
   PADDLE_ENFORCE_EQ(static_cast<bool>(fin),
                     true,
@@ -872,6 +872,10 @@ void BindAnalysisConfig(py::module *m) {
       .def("use_optimized_model",
            &AnalysisConfig::UseOptimizedModel,
            py::arg("x") = true)
+      .def("enable_shared_weights",
+           &AnalysisConfig::EnableSharedWeights,
+           py::arg("x") = true)
+      .def("shared_weights_enabled", &AnalysisConfig::shared_weights_enabled)
       .def("enable_memory_optim",
            &AnalysisConfig::EnableMemoryOptim,
            py::arg("x") = true)
@@ -146,6 +146,8 @@ void BindIO(pybind11::module *m) {
 
   m->def("save_combine_func", &pir::SaveCombineFunction);
 
+  m->def("save_mmap_combine_func", &pir::SaveMmapCombineFunction);
+
   m->def("load_func", &Load<phi::CPUPlace>);
   m->def("load_func", &Load<phi::CustomPlace>);
   m->def("load_func", &Load<phi::XPUPlace>);
@@ -14,6 +14,14 @@
 
 #include "paddle/phi/backends/cpu/cpu_context.h"
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(PADDLE_WITH_MKLML)
+#include "paddle/phi/backends/dynload/mklml.h"
+#endif
+
 #include "paddle/phi/common/place.h"
 #include "paddle/phi/core/enforce.h"
 
@@ -24,6 +32,16 @@
 
 namespace phi {
 
+namespace {
+
+thread_local int intra_op_num_threads = 0;
+#if defined(_OPENMP)
+// The OpenMP thread number of the calling thread before it was bounded.
+thread_local int unbounded_omp_num_threads = 0;
+#endif
+
+}  // namespace
+
 struct CPUContext::Impl {
   Impl() : place_(CPUPlace()) {}
 
@@ -75,6 +93,32 @@ Eigen::DefaultDevice* CPUContext::eigen_device() const {
 
 const Place& CPUContext::GetPlace() const { return impl_->place_; }
 
+void CPUContext::SetIntraOpNumThreads(int num_threads) {
+  PADDLE_ENFORCE_GE(num_threads,
+                    0,
+                    phi::errors::InvalidArgument(
+                        "The intra-op thread number should be non-negative, "
+                        "but received %d.",
+                        num_threads));
+  if (num_threads == intra_op_num_threads) {
+    return;
+  }
+#if defined(_OPENMP)
+  if (intra_op_num_threads == 0) {
+    unbounded_omp_num_threads = omp_get_max_threads();
+  }
+  omp_set_num_threads(num_threads > 0 ? num_threads
+                                      : unbounded_omp_num_threads);
+#endif
+#if defined(PADDLE_WITH_MKLML)
+  // MKL may run its own thread pool, 0 falls back to its global setting.
+  phi::dynload::MKL_Set_Num_Threads_Local(num_threads);
+#endif
+  intra_op_num_threads = num_threads;
+}
+
+int CPUContext::GetIntraOpNumThreads() const { return intra_op_num_threads; }
+
 void CPUContext::SetEigenDevice(Eigen::DefaultDevice* device) {
   impl_->eigen_device_ = device;
 }
@@ -35,6 +35,14 @@ class PADDLE_API CPUContext : public DeviceContext,
   Eigen::DefaultDevice* eigen_device() const;
   const Place& GetPlace() const override;
 
+  // The number of threads a kernel may use for intra-op parallelism, 0 means
+  // unbounded. It is set per calling thread, since the context is shared by
+  // the instructions an executor runs concurrently on different threads, and
+  // also bounds the OpenMP teams forked by the calling thread and, with
+  // MKLML, the threads of MKL routines it calls.
+  void SetIntraOpNumThreads(int num_threads);
+  int GetIntraOpNumThreads() const;
+
   static const char* name() { return "CPUContext"; }
 
  protected:
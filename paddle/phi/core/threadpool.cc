@@ -14,6 +14,17 @@
 
 #include "paddle/phi/core/threadpool.h"
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <thread>
 
 #include "glog/logging.h"
@@ -24,9 +35,102 @@ COMMON_DECLARE_int32(dist_threadpool_size);
 PD_DEFINE_int32(io_threadpool_size,
                 100,
                 "number of threads used for doing IO, default 100");
+PD_DEFINE_bool(threadpool_bind_cpu,
+               false,
+               "whether to pin the threads of phi::ThreadPool to CPUs, "
+               "filling one NUMA node before the next, default false");
 
 namespace phi {
 
+namespace {
+
+// Rounds an idle worker polls the queues before it goes to sleep.
+constexpr int kSpinRounds = 64;
+// Upper bound of chunks per thread created by ParallelFor.
+constexpr int64_t kChunksPerThread = 4;
+
+// The pool and the worker index the current thread belongs to, used to route
+// tasks submitted from inside the pool to the worker's own deque.
+thread_local ThreadPool* current_pool = nullptr;
+thread_local int current_worker_id = -1;
+
+#if defined(__linux__)
+// Parses a sysfs cpu list such as "0-3,8-11".
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    char* next = nullptr;
+    int64_t lo = std::strtol(item.c_str(), &next, 10);
+    if (next == item.c_str()) {
+      continue;
+    }
+    int64_t hi = lo;
+    if (*next == '-') {
+      hi = std::strtol(next + 1, nullptr, 10);
+    }
+    for (int64_t cpu = lo; cpu <= hi; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  return cpus;
+}
+
+// Returns the CPUs this process may run on, grouped by NUMA node, so that
+// consecutive workers are placed on the same node.
+std::vector<int> NumaOrderedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return cpus;
+  }
+  std::vector<bool> seen(CPU_SETSIZE, false);
+  for (int node = 0;; ++node) {
+    std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) +
+                      "/cpulist");
+    if (!fin.is_open()) {
+      break;
+    }
+    std::string line;
+    std::getline(fin, line);
+    for (int cpu : ParseCpuList(line)) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) &&
+          !seen[cpu]) {
+        seen[cpu] = true;
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  // CPUs without NUMA information, or all of them if sysfs is unavailable.
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed) && !seen[cpu]) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+void BindThreadToCpu(std::thread* thread, int cpu) {
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  int ret =
+      pthread_setaffinity_np(thread->native_handle(), sizeof(cpuset), &cpuset);
+  if (ret != 0) {
+    LOG(WARNING) << "Failed to bind thread pool worker to cpu " << cpu
+                 << ", error code " << ret;
+  }
+}
+#else
+std::vector<int> NumaOrderedCpus() { return std::vector<int>(); }
+
+void BindThreadToCpu(std::thread* thread, int cpu) {}
+#endif
+
+}  // namespace
+
 std::unique_ptr<ThreadPool> ThreadPool::threadpool_(nullptr);
 std::once_flag ThreadPool::init_flag_;
 
@@ -51,11 +155,21 @@ void ThreadPool::Init() {
   }
 }
 
-ThreadPool::ThreadPool(int num_threads) : running_(true) {
-  threads_.resize(num_threads);
-  for (auto& thread : threads_) {
-    // TODO(Yancey1989): binding the thread on the specify CPU number
-    thread = std::make_unique<std::thread>([this] { ThreadPool::TaskLoop(); });
+ThreadPool::ThreadPool(int num_threads) {
+  workers_.resize(num_threads);
+  for (auto& worker : workers_) {
+    worker = std::make_unique<Worker>();
+  }
+  std::vector<int> cpus;
+  if (FLAGS_threadpool_bind_cpu) {
+    cpus = NumaOrderedCpus();
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    auto& thread = workers_[i]->thread;
+    thread = std::make_unique<std::thread>([this, i] { TaskLoop(i); });
+    if (!cpus.empty()) {
+      BindThreadToCpu(thread.get(), cpus[i % cpus.size()]);
+    }
   }
 }
 
@@ -67,36 +181,207 @@ ThreadPool::~ThreadPool() {
   }
   scheduled_.notify_all();
 
-  for (auto& t : threads_) {
-    t->join();
-    t.reset(nullptr);
+  for (auto& worker : workers_) {
+    worker->thread->join();
+    worker->thread.reset(nullptr);
+  }
+
+  // A task that raced with the shutdown is dropped, its future reports
+  // broken_promise.
+  for (auto& worker : workers_) {
+    while (Closure* task = worker->local.Pop()) {
+      delete task;
+    }
+    for (Closure* task : worker->inbox) {
+      delete task;
+    }
+    worker->inbox.clear();
+  }
+}
+
+void ThreadPool::Schedule(std::unique_ptr<Closure> closure) {
+  if (!running_) {
+    PADDLE_THROW(
+        phi::errors::Unavailable("Task is enqueued into stopped ThreadPool."));
+  }
+  if (current_pool == this &&
+      workers_[current_worker_id]->local.Push(closure.get())) {
+    closure.release();
+  } else {
+    Worker* worker =
+        current_pool == this
+            ? workers_[current_worker_id].get()
+            : workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) %
+                       workers_.size()]
+                  .get();
+    std::lock_guard<std::mutex> lock(worker->inbox_mutex);
+    worker->inbox.push_back(closure.release());
+  }
+  pending_.fetch_add(1);
+  num_scheduled_.fetch_add(1);
+  if (num_sleeping_.load() > 0) {
+    // Taking the lock orders this notify after a worker that has announced
+    // itself as sleeping has actually started waiting.
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    scheduled_.notify_one();
   }
 }
 
-void ThreadPool::TaskLoop() {
+ThreadPool::Closure* ThreadPool::FindTask(int worker_id, bool wait_for_inbox) {
+  Worker* self = workers_[worker_id].get();
+  if (Closure* task = self->local.Pop()) {
+    return task;
+  }
+  {
+    std::lock_guard<std::mutex> lock(self->inbox_mutex);
+    if (!self->inbox.empty()) {
+      Closure* task = self->inbox.front();
+      self->inbox.pop_front();
+      return task;
+    }
+  }
+  // Visit the nearest workers first. When the workers are bound with
+  // FLAGS_threadpool_bind_cpu, neighbours share a NUMA node.
+  int num_workers = static_cast<int>(workers_.size());
+  for (int i = 1; i < num_workers; ++i) {
+    Worker* victim = workers_[(worker_id + i) % num_workers].get();
+    if (Closure* task = victim->local.Steal()) {
+      return task;
+    }
+    std::unique_lock<std::mutex> lock(victim->inbox_mutex, std::defer_lock);
+    if (wait_for_inbox) {
+      lock.lock();
+    } else {
+      lock.try_lock();
+    }
+    if (lock.owns_lock() && !victim->inbox.empty()) {
+      Closure* task = victim->inbox.front();
+      victim->inbox.pop_front();
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void ThreadPool::TaskLoop(int worker_id) {
+  current_pool = this;
+  current_worker_id = worker_id;
   while (true) {
-    Task task;
+    // A task scheduled after this point wakes the worker below even if the
+    // search misses it.
+    uint64_t seen = num_scheduled_.load();
+    Closure* task = FindTask(worker_id);
+    for (int i = 0; task == nullptr && i < kSpinRounds; ++i) {
+      std::this_thread::yield();
+      if (pending_.load(std::memory_order_relaxed) > 0) {
+        task = FindTask(worker_id);
+      }
+    }
+    if (task == nullptr && pending_.load() > 0) {
+      // Look once more past the inbox locks held by other workers.
+      task = FindTask(worker_id, /*wait_for_inbox=*/true);
+    }
 
-    {
+    if (task == nullptr) {
+      // Tasks still counted in pending_ were taken by other workers, or are
+      // left to the owner of a deque after a lost steal race. Sleep until a
+      // new task is scheduled instead of spinning on the count.
       std::unique_lock<std::mutex> lock(mutex_);
-      scheduled_.wait(
-          lock, [this] { return !this->tasks_.empty() || !this->running_; });
-
-      if (!running_ && tasks_.empty()) {
+      num_sleeping_.fetch_add(1);
+      scheduled_.wait(lock, [this, seen] {
+        return num_scheduled_.load() != seen || !running_;
+      });
+      num_sleeping_.fetch_sub(1);
+      if (!running_ && pending_.load() <= 0) {
         return;
       }
+      continue;
+    }
 
-      if (tasks_.empty()) {
-        PADDLE_THROW(
-            phi::errors::Unavailable("Current thread has no task to Run."));
-      }
+    pending_.fetch_sub(1);
+    // run the task
+    std::unique_ptr<Closure> owned_task(task);
+    owned_task->Run();
+  }
+}
 
-      // pop a task from the task queue
-      task = std::move(tasks_.front());
-      tasks_.pop();
+void ThreadPool::ParallelForRange(
+    int64_t begin,
+    int64_t end,
+    int64_t grain,
+    const std::function<void(int64_t, int64_t)>& fn) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max<int64_t>(grain, 1);
+  const int64_t total = end - begin;
+  // A few chunks per thread let fast threads pick up the slack of slow ones.
+  int64_t num_chunks =
+      std::min((total + grain - 1) / grain,
+               static_cast<int64_t>(NumThreads() + 1) * kChunksPerThread);
+  if (num_chunks <= 1) {
+    fn(begin, end);
+    return;
+  }
+  const int64_t chunk_size = (total + num_chunks - 1) / num_chunks;
+  num_chunks = (total + chunk_size - 1) / chunk_size;
+
+  struct State {
+    std::atomic<int64_t> next{0};
+    std::atomic<int64_t> done{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+
+  // fn is only touched after a chunk is claimed, and the caller does not
+  // return before every claimed chunk is done, so helpers that start late
+  // never see a dangling fn.
+  auto run_chunks = [state, begin, end, chunk_size, num_chunks, &fn]() {
+    int64_t finished = 0;
+    while (true) {
+      int64_t chunk = state->next.fetch_add(1);
+      if (chunk >= num_chunks) {
+        break;
+      }
+      if (!state->failed) {
+        int64_t chunk_begin = begin + chunk * chunk_size;
+        int64_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        try {
+          fn(chunk_begin, chunk_end);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (!state->failed) {
+            state->error = std::current_exception();
+            state->failed = true;
+          }
+        }
+      }
+      ++finished;
     }
-    // run the task
-    task();
+    if (finished > 0 &&
+        state->done.fetch_add(finished) + finished == num_chunks) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->finished.notify_all();
+    }
+  };
+
+  int64_t num_helpers =
+      std::min(num_chunks - 1, static_cast<int64_t>(NumThreads()));
+  for (int64_t i = 0; i < num_helpers; ++i) {
+    Schedule(MakeClosure(run_chunks));
+  }
+  run_chunks();
+
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock,
+                         [&] { return state->done.load() == num_chunks; });
+  }
+  if (state->error) {
+    std::rethrow_exception(state->error);
   }
 }
 
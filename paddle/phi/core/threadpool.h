@@ -14,18 +14,21 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>  // NOLINT
+#include <deque>
 #include <functional>
 #include <future>  // NOLINT
 #include <memory>
 #include <mutex>  // NOLINT
-#include <queue>
 #include <thread>  // NOLINT
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "paddle/common/macros.h"  // for DISABLE_COPY_AND_ASSIGN
 #include "paddle/phi/core/enforce.h"
+#include "paddle/phi/core/utils/work_stealing_deque.h"
 
 namespace phi {
 
@@ -34,8 +37,10 @@ struct ExceptionHandler {
   explicit ExceptionHandler(
       std::future<std::unique_ptr<common::enforce::EnforceNotMet>>&& f)
       : future_(std::move(f)) {}
-  void operator()() const {
-    auto ex = this->future_.get();
+  void operator()() const { Rethrow(this->future_.get()); }
+
+  static void Rethrow(
+      const std::unique_ptr<common::enforce::EnforceNotMet>& ex) {
     if (ex != nullptr) {
       PADDLE_THROW(phi::errors::Fatal(
           "The exception is thrown inside the thread pool. You "
@@ -46,8 +51,18 @@ struct ExceptionHandler {
   }
 };
 
-// ThreadPool maintains a queue of tasks, and runs them using a fixed
-// number of threads.
+// ThreadPool runs tasks using a fixed number of threads.
+//
+// Every worker owns a lock-free WorkStealingDeque for tasks submitted from
+// inside the pool and a mutex-protected inbox for tasks submitted from
+// outside. External submissions are spread over the inboxes round-robin, so
+// concurrent producers contend on different locks instead of one global
+// queue. An idle worker first drains its own queues and then steals from its
+// neighbours before going to sleep.
+//
+// Tasks submitted from outside the pool to the same worker run in FIFO order,
+// which keeps single-thread pools sequential. Tasks submitted from a worker
+// run on that worker in LIFO order unless they are stolen.
 class ThreadPool {
  public:
   explicit ThreadPool(int num_threads);
@@ -65,48 +80,118 @@ class ThreadPool {
   // std::future::wait().
   template <typename Callback>
   std::future<void> Run(Callback fn) {
-    auto f = this->RunAndGetException(fn);
-    return std::async(std::launch::deferred, ExceptionHandler(std::move(f)));
+    std::packaged_task<void()> task(
+        [fn]() { ExceptionHandler::Rethrow(CatchException(fn)); });
+    std::future<void> f = task.get_future();
+    Schedule(MakeClosure(std::move(task)));
+    return f;
   }
 
   template <typename Callback>
   std::future<std::unique_ptr<common::enforce::EnforceNotMet>>
   RunAndGetException(Callback fn) {
     Task task([fn]() -> std::unique_ptr<common::enforce::EnforceNotMet> {
-      try {
-        fn();
-      } catch (common::enforce::EnforceNotMet& ex) {
-        return std::unique_ptr<common::enforce::EnforceNotMet>(
-            new common::enforce::EnforceNotMet(ex));
-      } catch (const std::exception& e) {
-        PADDLE_THROW(phi::errors::Fatal(
-            "Unexpected exception is caught in thread pool. All "
-            "throwable exception in Paddle should be an EnforceNotMet."
-            "The exception is:\n %s.",
-            e.what()));
-      }
-      return nullptr;
+      return CatchException(fn);
     });
     std::future<std::unique_ptr<common::enforce::EnforceNotMet>> f =
         task.get_future();
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      if (!running_) {
-        PADDLE_THROW(phi::errors::Unavailable(
-            "Task is enqueued into stopped ThreadPool."));
-      }
-      tasks_.push(std::move(task));
-    }
-    scheduled_.notify_one();
+    Schedule(MakeClosure(std::move(task)));
     return f;
   }
 
+  // ParallelFor calls fn(i) for every i in [begin, end). The range is cut
+  // into chunks of at least `grain` iterations which are claimed by the
+  // calling thread and by up to num_threads helper tasks through a shared
+  // counter, so no future is created per chunk. It blocks until every
+  // iteration has finished and rethrows the first exception raised by fn.
+  // It is safe to call from inside a task of the same pool.
+  template <typename Function>
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain, Function fn) {
+    ParallelForRange(begin,
+                     end,
+                     grain,
+                     [&fn](int64_t chunk_begin, int64_t chunk_end) {
+                       for (int64_t i = chunk_begin; i < chunk_end; ++i) {
+                         fn(i);
+                       }
+                     });
+  }
+
+  // Same as ParallelFor but fn is called once per chunk as
+  // fn(chunk_begin, chunk_end).
+  TEST_API void ParallelForRange(
+      int64_t begin,
+      int64_t end,
+      int64_t grain,
+      const std::function<void(int64_t, int64_t)>& fn);
+
+  int NumThreads() const { return static_cast<int>(workers_.size()); }
+
  private:
   DISABLE_COPY_AND_ASSIGN(ThreadPool);
 
+  // Type-erased unit of work stored in the worker queues.
+  class Closure {
+   public:
+    virtual ~Closure() = default;
+    virtual void Run() = 0;
+  };
+
+  template <typename Fn>
+  class ClosureImpl : public Closure {
+   public:
+    explicit ClosureImpl(Fn fn) : fn_(std::move(fn)) {}
+    void Run() override { fn_(); }
+
+   private:
+    Fn fn_;
+  };
+
+  // Calls fn and returns the EnforceNotMet it throws, if any.
+  template <typename Callback>
+  static std::unique_ptr<common::enforce::EnforceNotMet> CatchException(
+      const Callback& fn) {
+    try {
+      fn();
+    } catch (common::enforce::EnforceNotMet& ex) {
+      return std::unique_ptr<common::enforce::EnforceNotMet>(
+          new common::enforce::EnforceNotMet(ex));
+    } catch (const std::exception& e) {
+      PADDLE_THROW(phi::errors::Fatal(
+          "Unexpected exception is caught in thread pool. All "
+          "throwable exception in Paddle should be an EnforceNotMet."
+          "The exception is:\n %s.",
+          e.what()));
+    }
+    return nullptr;
+  }
+
+  template <typename Fn>
+  static std::unique_ptr<Closure> MakeClosure(Fn&& fn) {
+    return std::unique_ptr<Closure>(
+        new ClosureImpl<typename std::decay<Fn>::type>(std::forward<Fn>(fn)));
+  }
+
+  struct Worker {
+    WorkStealingDeque<Closure> local;
+    std::mutex inbox_mutex;
+    std::deque<Closure*> inbox;
+    std::unique_ptr<std::thread> thread;
+  };
+
+  // Schedule takes the ownership of closure and hands it to a worker. A
+  // worker thread of this pool pushes onto its own deque, other threads
+  // push into the inbox of the next worker in round-robin order.
+  TEST_API void Schedule(std::unique_ptr<Closure> closure);
+
   // The constructor starts threads to run TaskLoop, which retrieves
-  // and runs tasks from the queue.
-  void TaskLoop();
+  // and runs tasks from the queues.
+  void TaskLoop(int worker_id);
+
+  // Returns a task from the queues of worker_id, or one stolen from the
+  // other workers, or nullptr if none is found. The inboxes of the other
+  // workers are skipped while locked, unless wait_for_inbox is set.
+  Closure* FindTask(int worker_id, bool wait_for_inbox = false);
 
   // Init is called by GetInstance.
   static void Init();
@@ -115,11 +200,16 @@ class ThreadPool {
   static std::unique_ptr<ThreadPool> threadpool_;
   static std::once_flag init_flag_;
 
-  std::vector<std::unique_ptr<std::thread>> threads_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<uint64_t> next_worker_{0};
 
-  std::queue<Task> tasks_;
+  // Number of tasks sitting in any queue.
+  std::atomic<int64_t> pending_{0};
+  // Number of tasks ever scheduled. An idle worker sleeps until it changes.
+  std::atomic<uint64_t> num_scheduled_{0};
+  std::atomic<int> num_sleeping_{0};
+  std::atomic<bool> running_{true};
   std::mutex mutex_;
-  bool running_;
   std::condition_variable scheduled_;
 };
 
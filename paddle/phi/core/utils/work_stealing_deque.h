@@ -0,0 +1,127 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "paddle/common/macros.h"
+
+namespace phi {
+
+// WorkStealingDeque is a fixed-capacity Chase-Lev deque of pointers.
+//
+// The owner thread pushes and pops at the bottom end (LIFO), any other thread
+// may steal from the top end (FIFO). Push/Pop never block and Steal is a
+// single CAS, so the owner only pays for synchronization when the deque is
+// almost empty and it races with a thief.
+//
+// The buffer does not grow: Push returns false when the deque is full and the
+// caller is expected to fall back to another queue. This keeps the deque free
+// of the deferred reclamation a growable Chase-Lev buffer would need.
+//
+// Reference: "Correct and Efficient Work-Stealing for Weak Memory Models",
+// N. M. Le, A. Pop, A. Cohen, F. Zappa Nardelli, PPoPP 2013.
+template <typename T>
+class WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(size_t capacity_log2 = 10)
+      : capacity_(static_cast<int64_t>(1) << capacity_log2),
+        mask_(capacity_ - 1),
+        buffer_(new std::atomic<T*>[capacity_]) {
+    for (int64_t i = 0; i < capacity_; ++i) {
+      buffer_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // Owner only. Returns false if the deque is full.
+  bool Push(T* item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= capacity_) {
+      return false;
+    }
+    buffer_[b & mask_].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Returns nullptr if the deque is empty or the last element
+  // was taken by a concurrent Steal.
+  T* Pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item = buffer_[b & mask_].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last element, race against thieves for it.
+      if (!top_.compare_exchange_strong(t,
+                                        t + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. Returns nullptr if the deque is empty or the steal lost a
+  // race; callers treat both the same way and move to the next victim.
+  T* Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    T* item = buffer_[t & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // Approximate, may be stale as soon as it returns.
+  bool Empty() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b <= t;
+  }
+
+  int64_t Capacity() const { return capacity_; }
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(WorkStealingDeque);
+
+  const int64_t capacity_;
+  const int64_t mask_;
+  std::unique_ptr<std::atomic<T*>[]> buffer_;
+  // top_ and bottom_ are written by different threads, keep them on
+  // separate cache lines.
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+};
+
+}  // namespace phi
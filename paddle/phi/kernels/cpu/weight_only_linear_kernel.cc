@@ -0,0 +1,441 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/kernels/weight_only_linear_kernel.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+#include <vector>
+
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/kernels/funcs/blas/blas.h"
+#include "paddle/phi/kernels/funcs/cpu_simd_utils.h"
+
+namespace phi {
+
+// The CPU kernel consumes the row major layout that weight_quantize produces
+// for arch = 70: the int8 data is [k, n] (two int4 packed per byte along n),
+// stored with an unsigned bias of 128 (int8) or 8 (int4), and the columns are
+// interleaved inside every 32 bit word. Instead of undoing the interleave, the
+// kernel decodes 16 columns at a time into fp32 lanes in storage order,
+// accumulates in that order and only maps lanes back to columns when storing
+// the output. The weight is never dequantized to memory on the decode path.
+namespace {
+
+constexpr int kWeightOnlyBlockN = 16;
+constexpr int kWeightOnlyBlockM = 4;
+// Above this many rows the weight is dequantized once and handed to BLAS.
+constexpr int64_t kWeightOnlyGemmMinM = 32;
+
+// Column (within a block of 16) held by each decoded lane.
+constexpr int kInt8LaneToCol[kWeightOnlyBlockN] = {
+    0, 2, 1, 3, 4, 6, 5, 7, 8, 10, 9, 11, 12, 14, 13, 15};
+// int4 lanes are the low nibbles of the 8 bytes followed by the high ones.
+constexpr int kInt4LaneToCol[kWeightOnlyBlockN] = {
+    0, 4, 1, 5, 8, 12, 9, 13, 2, 6, 3, 7, 10, 14, 11, 15};
+
+template <int bits>
+inline const int* LaneToCol() {
+  return bits == 8 ? kInt8LaneToCol : kInt4LaneToCol;
+}
+
+// Decodes 16 weights of one row of the block into fp32, in lane order.
+template <int bits>
+inline void DecodeWeightBlock(const uint8_t* src, float* dst) {
+  if (bits == 8) {
+    for (int i = 0; i < kWeightOnlyBlockN; ++i) {
+      dst[i] = static_cast<float>(static_cast<int>(src[i]) - 128);
+    }
+  } else {
+    for (int i = 0; i < kWeightOnlyBlockN / 2; ++i) {
+      dst[i] = static_cast<float>(static_cast<int>(src[i] & 0x0F) - 8);
+      dst[i + 8] = static_cast<float>(static_cast<int>(src[i] >> 4) - 8);
+    }
+  }
+}
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+// The 16 signed weights of one row of the block as int8 lanes.
+template <int bits>
+inline __m128i LoadWeightBlock(const uint8_t* src) {
+  if (bits == 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    return _mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(0x80)));
+  } else {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i lo = _mm_and_si128(v, mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    return _mm_sub_epi8(_mm_unpacklo_epi64(lo, hi), _mm_set1_epi8(8));
+  }
+}
+#endif
+
+// out[m0 : m0 + MB, nb : nb + 16] for MB rows of x, accumulating every
+// group of k in fp32 before applying its scale.
+template <typename T, int bits, int MB>
+void WeightOnlyMicroKernel(const float* x,
+                           const uint8_t* weight,
+                           const float* scale,
+                           const float* bias,
+                           int64_t m0,
+                           int64_t nb,
+                           int64_t n,
+                           int64_t k,
+                           int64_t group,
+                           T* out) {
+  const int64_t row_bytes = n * bits / 8;
+  const uint8_t* w = weight + nb * bits / 8;
+  const float* xr[MB];
+  for (int r = 0; r < MB; ++r) {
+    xr[r] = x + (m0 + r) * k;
+  }
+  alignas(64) float acc[MB][kWeightOnlyBlockN];
+
+#if defined(__AVX512F__)
+  __m512 vacc[MB];
+  for (int r = 0; r < MB; ++r) {
+    vacc[r] = _mm512_setzero_ps();
+  }
+  for (int64_t g0 = 0; g0 < k; g0 += group) {
+    __m512 part[MB];
+    for (int r = 0; r < MB; ++r) {
+      part[r] = _mm512_setzero_ps();
+    }
+    for (int64_t kk = g0; kk < g0 + group; ++kk) {
+      __m512 wv = _mm512_cvtepi32_ps(
+          _mm512_cvtepi8_epi32(LoadWeightBlock<bits>(w + kk * row_bytes)));
+      for (int r = 0; r < MB; ++r) {
+        part[r] = _mm512_fmadd_ps(_mm512_set1_ps(xr[r][kk]), wv, part[r]);
+      }
+    }
+    __m512 s = _mm512_loadu_ps(scale + (g0 / group) * n + nb);
+    for (int r = 0; r < MB; ++r) {
+      vacc[r] = _mm512_fmadd_ps(part[r], s, vacc[r]);
+    }
+  }
+  for (int r = 0; r < MB; ++r) {
+    _mm512_store_ps(acc[r], vacc[r]);
+  }
+#elif defined(__AVX2__)
+  __m256 vacc[MB][2];
+  for (int r = 0; r < MB; ++r) {
+    vacc[r][0] = _mm256_setzero_ps();
+    vacc[r][1] = _mm256_setzero_ps();
+  }
+  for (int64_t g0 = 0; g0 < k; g0 += group) {
+    __m256 part[MB][2];
+    for (int r = 0; r < MB; ++r) {
+      part[r][0] = _mm256_setzero_ps();
+      part[r][1] = _mm256_setzero_ps();
+    }
+    for (int64_t kk = g0; kk < g0 + group; ++kk) {
+      __m128i wb = LoadWeightBlock<bits>(w + kk * row_bytes);
+      __m256 w0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(wb));
+      __m256 w1 =
+          _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(wb, 8)));
+      for (int r = 0; r < MB; ++r) {
+        __m256 xv = _mm256_set1_ps(xr[r][kk]);
+#ifdef __FMA__
+        part[r][0] = _mm256_fmadd_ps(xv, w0, part[r][0]);
+        part[r][1] = _mm256_fmadd_ps(xv, w1, part[r][1]);
+#else
+        part[r][0] = _mm256_add_ps(part[r][0], _mm256_mul_ps(xv, w0));
+        part[r][1] = _mm256_add_ps(part[r][1], _mm256_mul_ps(xv, w1));
+#endif
+      }
+    }
+    const float* s = scale + (g0 / group) * n + nb;
+    __m256 s0 = _mm256_loadu_ps(s);
+    __m256 s1 = _mm256_loadu_ps(s + 8);
+    for (int r = 0; r < MB; ++r) {
+      vacc[r][0] = _mm256_add_ps(vacc[r][0], _mm256_mul_ps(part[r][0], s0));
+      vacc[r][1] = _mm256_add_ps(vacc[r][1], _mm256_mul_ps(part[r][1], s1));
+    }
+  }
+  for (int r = 0; r < MB; ++r) {
+    _mm256_store_ps(acc[r], vacc[r][0]);
+    _mm256_store_ps(acc[r] + 8, vacc[r][1]);
+  }
+#else
+  alignas(64) float part[MB][kWeightOnlyBlockN];
+  alignas(64) float wv[kWeightOnlyBlockN];
+  std::memset(acc, 0, sizeof(acc));
+  for (int64_t g0 = 0; g0 < k; g0 += group) {
+    std::memset(part, 0, sizeof(part));
+    for (int64_t kk = g0; kk < g0 + group; ++kk) {
+      DecodeWeightBlock<bits>(w + kk * row_bytes, wv);
+      for (int r = 0; r < MB; ++r) {
+        funcs::VecAxpy(xr[r][kk], wv, part[r], kWeightOnlyBlockN);
+      }
+    }
+    const float* s = scale + (g0 / group) * n + nb;
+    for (int r = 0; r < MB; ++r) {
+      for (int i = 0; i < kWeightOnlyBlockN; ++i) {
+        acc[r][i] += part[r][i] * s[i];
+      }
+    }
+  }
+#endif
+
+  const int* lane_to_col = LaneToCol<bits>();
+  for (int r = 0; r < MB; ++r) {
+    T* y = out + (m0 + r) * n + nb;
+    for (int i = 0; i < kWeightOnlyBlockN; ++i) {
+      int col = lane_to_col[i];
+      float v = acc[r][i] + (bias ? bias[nb + col] : 0.f);
+      y[col] = static_cast<T>(v);
+    }
+  }
+}
+
+template <typename T, int bits>
+void WeightOnlyGemv(const float* x,
+                    const uint8_t* weight,
+                    const float* scale,
+                    const float* bias,
+                    int64_t m,
+                    int64_t n,
+                    int64_t k,
+                    int64_t group,
+                    T* out) {
+  const int64_t num_blocks = n / kWeightOnlyBlockN;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    int64_t nb = b * kWeightOnlyBlockN;
+    int64_t m0 = 0;
+    for (; m0 + kWeightOnlyBlockM <= m; m0 += kWeightOnlyBlockM) {
+      WeightOnlyMicroKernel<T, bits, kWeightOnlyBlockM>(
+          x, weight, scale, bias, m0, nb, n, k, group, out);
+    }
+    switch (m - m0) {
+      case 3:
+        WeightOnlyMicroKernel<T, bits, 3>(
+            x, weight, scale, bias, m0, nb, n, k, group, out);
+        break;
+      case 2:
+        WeightOnlyMicroKernel<T, bits, 2>(
+            x, weight, scale, bias, m0, nb, n, k, group, out);
+        break;
+      case 1:
+        WeightOnlyMicroKernel<T, bits, 1>(
+            x, weight, scale, bias, m0, nb, n, k, group, out);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Dequantizes the whole weight to a row major fp32 [k, n] matrix, for the
+// compute bound case where the weight is reused by many rows of x.
+template <int bits>
+void DequantizeWeight(const uint8_t* weight,
+                      const float* scale,
+                      int64_t n,
+                      int64_t k,
+                      int64_t group,
+                      float* out) {
+  const int64_t row_bytes = n * bits / 8;
+  const int* lane_to_col = LaneToCol<bits>();
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t kk = 0; kk < k; ++kk) {
+    float wv[kWeightOnlyBlockN];
+    const float* s = scale + (kk / group) * n;
+    for (int64_t nb = 0; nb < n; nb += kWeightOnlyBlockN) {
+      DecodeWeightBlock<bits>(weight + kk * row_bytes + nb * bits / 8, wv);
+      for (int i = 0; i < kWeightOnlyBlockN; ++i) {
+        out[kk * n + nb + lane_to_col[i]] = wv[i] * s[nb + i];
+      }
+    }
+  }
+}
+
+template <typename T, int bits, typename Context>
+void WeightOnlyLinearCPUImpl(const Context& dev_ctx,
+                             const float* x,
+                             const uint8_t* weight,
+                             const float* scale,
+                             const float* bias,
+                             int64_t m,
+                             int64_t n,
+                             int64_t k,
+                             int64_t group,
+                             T* out) {
+  if (m < kWeightOnlyGemmMinM) {
+    WeightOnlyGemv<T, bits>(x, weight, scale, bias, m, n, k, group, out);
+    return;
+  }
+  std::vector<float> weight_fp32(k * n);
+  DequantizeWeight<bits>(weight, scale, n, k, group, weight_fp32.data());
+  std::vector<float> out_fp32(m * n);
+  auto blas = phi::funcs::GetBlas<Context, float>(dev_ctx);
+  blas.GEMM(CblasNoTrans,
+            CblasNoTrans,
+            m,
+            n,
+            k,
+            1.f,
+            x,
+            weight_fp32.data(),
+            0.f,
+            out_fp32.data());
+  for (int64_t i = 0; i < m; ++i) {
+    float* row = out_fp32.data() + i * n;
+    if (bias) {
+      for (int64_t j = 0; j < n; ++j) {
+        row[j] += bias[j];
+      }
+    }
+    funcs::CvtFromFloat<T>(row, out + i * n, n);
+  }
+}
+
+// Copies a scale or bias of element type T or float into fp32.
+template <typename T>
+std::vector<float> ToFloatVector(const DenseTensor& t) {
+  std::vector<float> out(t.numel());
+  if (t.dtype() == phi::DataType::FLOAT32) {
+    funcs::CvtToFloat<float>(t.data<float>(), out.data(), t.numel());
+  } else {
+    funcs::CvtToFloat<T>(t.data<T>(), out.data(), t.numel());
+  }
+  return out;
+}
+
+}  // namespace
+
+template <typename T, typename Context>
+void WeightOnlyLinearKernel(const Context& dev_ctx,
+                            const DenseTensor& x,
+                            const DenseTensor& weight,
+                            const paddle::optional<DenseTensor>& bias,
+                            const DenseTensor& weight_scale,
+                            const std::string& weight_dtype,
+                            const int32_t arch,
+                            const int32_t group_size,
+                            DenseTensor* out) {
+  PADDLE_ENFORCE_EQ(
+      arch,
+      70,
+      common::errors::Unimplemented(
+          "The CPU weight_only_linear only supports the row major weight "
+          "layout, please quantize the weight with arch=70, but got arch=%d.",
+          arch));
+  PADDLE_ENFORCE_EQ(
+      weight_dtype == "int8" || weight_dtype == "int4",
+      true,
+      common::errors::InvalidArgument(
+          "The weight_dtype must be 'int8' or 'int4', but got %s.",
+          weight_dtype));
+
+  dev_ctx.template Alloc<T>(out);
+  const int64_t n =
+      group_size > 0 ? weight_scale.dims()[1] : weight_scale.dims()[0];
+  const int64_t k = x.dims()[x.dims().size() - 1];
+  const int64_t m = x.numel() / k;
+  if (m == 0) return;
+  const int64_t group = group_size > 0 ? group_size : k;
+
+  PADDLE_ENFORCE_EQ(
+      n % kWeightOnlyBlockN,
+      0,
+      common::errors::InvalidArgument(
+          "The out features of weight_only_linear must be a multiple of %d on "
+          "CPU, but got %d.",
+          kWeightOnlyBlockN,
+          n));
+  PADDLE_ENFORCE_EQ(k % group,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The in features (%d) must be a multiple of "
+                        "group_size (%d).",
+                        k,
+                        group));
+  const int64_t weight_bytes = weight_dtype == "int8" ? k * n : k * n / 2;
+  PADDLE_ENFORCE_EQ(
+      weight.numel(),
+      weight_bytes,
+      common::errors::InvalidArgument(
+          "The weight of weight_only_linear holds %d bytes, but %d are "
+          "expected for a [%d, %d] %s weight.",
+          weight.numel(),
+          weight_bytes,
+          n,
+          k,
+          weight_dtype));
+
+  std::vector<float> x_fp32(m * k);
+  funcs::CvtToFloat<T>(x.data<T>(), x_fp32.data(), m * k);
+
+  // Scales are reordered to the lane order of the decoded weight blocks.
+  std::vector<float> scale = ToFloatVector<T>(weight_scale);
+  std::vector<float> lane_scale(scale.size());
+  const int* lane_to_col =
+      weight_dtype == "int8" ? LaneToCol<8>() : LaneToCol<4>();
+  for (size_t base = 0; base < scale.size(); base += kWeightOnlyBlockN) {
+    for (int i = 0; i < kWeightOnlyBlockN; ++i) {
+      lane_scale[base + i] = scale[base + lane_to_col[i]];
+    }
+  }
+  std::vector<float> bias_fp32;
+  if (bias) {
+    bias_fp32 = ToFloatVector<T>(bias.get());
+  }
+
+  const uint8_t* weight_data =
+      reinterpret_cast<const uint8_t*>(weight.data<int8_t>());
+  const float* bias_data = bias ? bias_fp32.data() : nullptr;
+  if (weight_dtype == "int8") {
+    WeightOnlyLinearCPUImpl<T, 8>(dev_ctx,
+                                  x_fp32.data(),
+                                  weight_data,
+                                  lane_scale.data(),
+                                  bias_data,
+                                  m,
+                                  n,
+                                  k,
+                                  group,
+                                  out->data<T>());
+  } else {
+    WeightOnlyLinearCPUImpl<T, 4>(dev_ctx,
+                                  x_fp32.data(),
+                                  weight_data,
+                                  lane_scale.data(),
+                                  bias_data,
+                                  m,
+                                  n,
+                                  k,
+                                  group,
+                                  out->data<T>());
+  }
+}
+
+}  // namespace phi
+
+PD_REGISTER_KERNEL(weight_only_linear,
+                   CPU,
+                   ALL_LAYOUT,
+                   phi::WeightOnlyLinearKernel,
+                   float,
+                   phi::dtype::float16,
+                   phi::dtype::bfloat16) {}
@@ -0,0 +1,189 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include "paddle/phi/common/bfloat16.h"
+#include "paddle/phi/common/float16.h"
+
+// Small fp32 building blocks for CPU fused kernels that keep low precision
+// data in memory and accumulate in fp32. The SIMD width follows the flags the
+// translation unit is compiled with (AVX512F, AVX/FMA, or scalar), so these
+// helpers are always safe to call on the build machine's ISA.
+
+namespace phi {
+namespace funcs {
+
+// dst[i] = float(src[i]), i < n
+template <typename T>
+inline void CvtToFloat(const T* src, float* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    dst[i] = static_cast<float>(src[i]);
+  }
+}
+
+template <>
+inline void CvtToFloat<float>(const float* src, float* dst, int64_t n) {
+  std::memcpy(dst, src, n * sizeof(float));
+}
+
+template <>
+inline void CvtToFloat<phi::dtype::bfloat16>(const phi::dtype::bfloat16* src,
+                                             float* dst,
+                                             int64_t n) {
+  // bfloat16 is the high half of a float.
+  const uint16_t* raw = reinterpret_cast<const uint16_t*>(src);
+  int64_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= n; i += 16) {
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(raw + i));
+    __m512i w = _mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16);
+    _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(w));
+  }
+#elif defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i));
+    __m256i w = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+    _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(w));
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t bits = static_cast<uint32_t>(raw[i]) << 16;
+    std::memcpy(dst + i, &bits, sizeof(float));
+  }
+}
+
+template <>
+inline void CvtToFloat<phi::dtype::float16>(const phi::dtype::float16* src,
+                                            float* dst,
+                                            int64_t n) {
+  int64_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= n; i += 16) {
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+  }
+#elif defined(__F16C__)
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = static_cast<float>(src[i]);
+  }
+}
+
+// dst[i] = T(src[i]), i < n, rounding to nearest.
+template <typename T>
+inline void CvtFromFloat(const float* src, T* dst, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    dst[i] = static_cast<T>(src[i]);
+  }
+}
+
+template <>
+inline void CvtFromFloat<float>(const float* src, float* dst, int64_t n) {
+  std::memcpy(dst, src, n * sizeof(float));
+}
+
+// sum(x[i] * y[i]), i < n
+inline float VecDot(const float* x, const float* y, int64_t n) {
+  int64_t i = 0;
+  float sum = 0.f;
+#if defined(__AVX512F__)
+  __m512 acc = _mm512_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), acc);
+  }
+  sum = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+#ifdef __FMA__
+    acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc);
+#else
+    acc = _mm256_add_ps(
+        acc, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#endif
+  }
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc),
+                         _mm256_extractf128_ps(acc, 1));
+  lo = _mm_hadd_ps(lo, lo);
+  lo = _mm_hadd_ps(lo, lo);
+  sum = _mm_cvtss_f32(lo);
+#endif
+  for (; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+// y[i] += alpha * x[i], i < n
+inline void VecAxpy(float alpha, const float* x, float* y, int64_t n) {
+  int64_t i = 0;
+#if defined(__AVX512F__)
+  __m512 a = _mm512_set1_ps(alpha);
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(
+        y + i,
+        _mm512_fmadd_ps(a, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+#elif defined(__AVX__)
+  __m256 a = _mm256_set1_ps(alpha);
+  for (; i + 8 <= n; i += 8) {
+#ifdef __FMA__
+    _mm256_storeu_ps(
+        y + i,
+        _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#else
+    _mm256_storeu_ps(y + i,
+                     _mm256_add_ps(_mm256_mul_ps(a, _mm256_loadu_ps(x + i)),
+                                   _mm256_loadu_ps(y + i)));
+#endif
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+// x[i] *= alpha, i < n
+inline void VecScale(float alpha, float* x, int64_t n) {
+  int64_t i = 0;
+#if defined(__AVX512F__)
+  __m512 a = _mm512_set1_ps(alpha);
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(x + i, _mm512_mul_ps(a, _mm512_loadu_ps(x + i)));
+  }
+#elif defined(__AVX__)
+  __m256 a = _mm256_set1_ps(alpha);
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(a, _mm256_loadu_ps(x + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    x[i] *= alpha;
+  }
+}
+
+}  // namespace funcs
+}  // namespace phi
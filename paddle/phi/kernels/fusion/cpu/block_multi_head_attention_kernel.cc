@@ -0,0 +1,467 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "glog/logging.h"
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#include "paddle/phi/common/bfloat16.h"
+#include "paddle/phi/common/float16.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/kernels/funcs/cpu_simd_utils.h"
+
+namespace phi {
+namespace fusion {
+
+// CPU version of block_multihead_attention. It reads the same inputs as the
+// GPU kernel:
+//   qkv:          [token_num, (q_num_head + 2 * kv_num_head) * dim_head]
+//   key_cache:    [max_block_num, kv_num_head, block_size, dim_head]
+//   block_tables: [bsz, max_block_per_seq]
+//   rope_emb:     [2, 1, max_seq_len, 1, dim_head / 2 (dim_head for neox)]
+// A batch with seq_lens_encoder > 0 runs prefill, a batch with
+// seq_lens_decoder > 0 decodes one token at position seq_lens_decoder.
+// Both phases read K/V back from the paged cache, with fp32 accumulation.
+
+// Rotates one head in place. pos is the position in the sequence.
+inline void BlhaApplyRope(float* x,
+                          const float* cos_emb,
+                          const float* sin_emb,
+                          int pos,
+                          int emb_last_dim,
+                          int dim_head,
+                          bool use_neox_style) {
+  const int half = dim_head / 2;
+  const float* cos_pos = cos_emb + static_cast<int64_t>(pos) * emb_last_dim;
+  const float* sin_pos = sin_emb + static_cast<int64_t>(pos) * emb_last_dim;
+  if (use_neox_style) {
+    for (int i = 0; i < half; ++i) {
+      const float left = x[i];
+      const float right = x[i + half];
+      x[i] = left * cos_pos[i] - right * sin_pos[i];
+      x[i + half] = right * cos_pos[i] + left * sin_pos[i];
+    }
+  } else {
+    for (int i = 0; i < half; ++i) {
+      const float left = x[2 * i];
+      const float right = x[2 * i + 1];
+      x[2 * i] = left * cos_pos[i] - right * sin_pos[i];
+      x[2 * i + 1] = right * cos_pos[i] + left * sin_pos[i];
+    }
+  }
+}
+
+// Attention of one query head over positions [0, kv_len) of a paged cache.
+// scores must hold kv_len floats, rows block_size * dim_head floats.
+template <typename T, typename CacheT>
+void BlhaPagedAttention(const float* q,
+                        const CacheT* key_cache,
+                        const CacheT* value_cache,
+                        const int* block_table,
+                        const T* mask_row,
+                        int kv_hi,
+                        int kv_num_head,
+                        int block_size,
+                        int dim_head,
+                        int kv_len,
+                        float scale,
+                        float* scores,
+                        float* rows,
+                        float* out) {
+  const int64_t block_stride =
+      static_cast<int64_t>(kv_num_head) * block_size * dim_head;
+  const int64_t head_offset =
+      static_cast<int64_t>(kv_hi) * block_size * dim_head;
+
+  float max_score = -FLT_MAX;
+  for (int start = 0; start < kv_len; start += block_size) {
+    const int n = std::min(block_size, kv_len - start);
+    const int64_t base =
+        block_table[start / block_size] * block_stride + head_offset;
+    funcs::CvtToFloat(
+        key_cache + base, rows, static_cast<int64_t>(n) * dim_head);
+    for (int r = 0; r < n; ++r) {
+      float s = funcs::VecDot(q, rows + r * dim_head, dim_head) * scale;
+      if (mask_row) {
+        s += static_cast<float>(mask_row[start + r]);
+      }
+      scores[start + r] = s;
+      max_score = std::max(max_score, s);
+    }
+  }
+
+  float sum = 0.f;
+  for (int j = 0; j < kv_len; ++j) {
+    scores[j] = std::exp(scores[j] - max_score);
+    sum += scores[j];
+  }
+  const float inv_sum = 1.f / (sum + 1e-6f);
+
+  std::memset(out, 0, dim_head * sizeof(float));
+  for (int start = 0; start < kv_len; start += block_size) {
+    const int n = std::min(block_size, kv_len - start);
+    const int64_t base =
+        block_table[start / block_size] * block_stride + head_offset;
+    funcs::CvtToFloat(
+        value_cache + base, rows, static_cast<int64_t>(n) * dim_head);
+    for (int r = 0; r < n; ++r) {
+      funcs::VecAxpy(scores[start + r], rows + r * dim_head, out, dim_head);
+    }
+  }
+  funcs::VecScale(inv_sum, out, dim_head);
+}
+
+template <typename T, typename CacheT, typename Context>
+void BlockMultiheadAttentionCPUImpl(
+    const Context& dev_ctx,
+    const DenseTensor& qkv,
+    const DenseTensor& key_cache,
+    const DenseTensor& value_cache,
+    const DenseTensor& seq_lens_encoder,
+    const DenseTensor& seq_lens_decoder,
+    const DenseTensor& padding_offsets,
+    const DenseTensor& block_tables,
+    const paddle::optional<DenseTensor>& rope_emb,
+    const paddle::optional<DenseTensor>& mask,
+    const paddle::optional<DenseTensor>& tgt_mask,
+    const paddle::optional<DenseTensor>& qkv_bias,
+    int max_seq_len,
+    int block_size,
+    bool use_neox_style,
+    DenseTensor* fmha_out,
+    DenseTensor* qkv_out,
+    DenseTensor* key_cache_out,
+    DenseTensor* value_cache_out) {
+  const int token_num = qkv.dims()[0];
+  const int kv_num_head = key_cache.dims()[1];
+  const int dim_head = key_cache.dims()[3];
+  const int total_num_head = qkv.dims()[qkv.dims().size() - 1] / dim_head;
+  const int q_num_head = total_num_head - 2 * kv_num_head;
+  const int bsz = seq_lens_encoder.dims()[0];
+  const int max_block_per_seq = block_tables.dims()[1];
+  const int gqa_group_size = q_num_head / kv_num_head;
+  const int64_t row_size = static_cast<int64_t>(total_num_head) * dim_head;
+  PADDLE_ENFORCE_EQ(
+      q_num_head % kv_num_head,
+      0,
+      errors::InvalidArgument("q_num_head (%d) must be divisible by "
+                              "kv_num_head (%d).",
+                              q_num_head,
+                              kv_num_head));
+  PADDLE_ENFORCE_EQ(
+      key_cache.dims()[2],
+      block_size,
+      errors::InvalidArgument("The 3rd dim of key_cache (%d) must be equal "
+                              "to block_size (%d).",
+                              key_cache.dims()[2],
+                              block_size));
+
+  T* qkv_data = dev_ctx.template Alloc<T>(qkv_out);
+  if (qkv_data != qkv.data<T>()) {
+    std::memcpy(qkv_data, qkv.data<T>(), qkv.numel() * sizeof(T));
+  }
+  CacheT* k_cache = dev_ctx.template Alloc<CacheT>(key_cache_out);
+  if (k_cache != key_cache.data<CacheT>()) {
+    std::memcpy(
+        k_cache, key_cache.data<CacheT>(), key_cache.numel() * sizeof(CacheT));
+  }
+  CacheT* v_cache = dev_ctx.template Alloc<CacheT>(value_cache_out);
+  if (v_cache != value_cache.data<CacheT>()) {
+    std::memcpy(v_cache,
+                value_cache.data<CacheT>(),
+                value_cache.numel() * sizeof(CacheT));
+  }
+  T* out_data = dev_ctx.template Alloc<T>(fmha_out);
+  std::memset(out_data, 0, fmha_out->numel() * sizeof(T));
+
+  const int* enc_lens = seq_lens_encoder.data<int>();
+  const int* dec_lens = seq_lens_decoder.data<int>();
+  const int* offsets = padding_offsets.data<int>();
+  const int* block_table_data = block_tables.data<int>();
+  const T* bias_data = qkv_bias ? qkv_bias.get().data<T>() : nullptr;
+
+  const float* cos_emb = nullptr;
+  const float* sin_emb = nullptr;
+  int emb_last_dim = 0;
+  if (rope_emb) {
+    const auto& emb_dims = rope_emb.get().dims();
+    // The cos and sin tables of shape [2, 1, max_seq_len, 1, dim] are shared
+    // by the whole batch.
+    PADDLE_ENFORCE_EQ(
+        emb_dims.size() == 5 && emb_dims[1] == 1,
+        true,
+        errors::InvalidArgument("The rope_emb of the CPU kernel must be of "
+                                "shape [2, 1, max_seq_len, 1, dim], but "
+                                "received [%s].",
+                                emb_dims));
+    emb_last_dim = emb_dims[emb_dims.size() - 1];
+    cos_emb = rope_emb.get().data<float>();
+    sin_emb = cos_emb + emb_dims[2] * emb_last_dim;
+  }
+
+  // Batch and cache position of every token, -1 for tokens to skip.
+  std::vector<int> token_bi(token_num, -1);
+  std::vector<int> token_pos(token_num, -1);
+  for (int t = 0; t < token_num; ++t) {
+    const int ori_token_idx = t + offsets[t];
+    const int bi = ori_token_idx / max_seq_len;
+    if (bi >= bsz) continue;
+    if (enc_lens[bi] > 0) {
+      token_bi[t] = bi;
+      token_pos[t] = ori_token_idx % max_seq_len;
+    } else if (dec_lens[bi] > 0) {
+      token_bi[t] = bi;
+      token_pos[t] = dec_lens[bi];
+    }
+    if (token_pos[t] >= 0) {
+      PADDLE_ENFORCE_LT(
+          token_pos[t] / block_size,
+          max_block_per_seq,
+          errors::OutOfRange(
+              "Position %d of batch %d is out of the block table.",
+              token_pos[t],
+              bi));
+    }
+  }
+
+  // Step 1: add bias, apply rope and write K/V of every token to the cache.
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int t = 0; t < token_num; ++t) {
+    const int bi = token_bi[t];
+    if (bi < 0) continue;
+    const int pos = token_pos[t];
+    std::vector<float> head(dim_head);
+    T* row = qkv_data + t * row_size;
+    const int block_idx =
+        block_table_data[bi * max_block_per_seq + pos / block_size];
+    const int block_offset = pos % block_size;
+    for (int h = 0; h < total_num_head; ++h) {
+      T* x = row + h * dim_head;
+      funcs::CvtToFloat(x, head.data(), dim_head);
+      if (bias_data) {
+        for (int d = 0; d < dim_head; ++d) {
+          head[d] += static_cast<float>(bias_data[h * dim_head + d]);
+        }
+      }
+      if (cos_emb && h < q_num_head + kv_num_head) {
+        BlhaApplyRope(head.data(),
+                      cos_emb,
+                      sin_emb,
+                      pos,
+                      emb_last_dim,
+                      dim_head,
+                      use_neox_style);
+      }
+      funcs::CvtFromFloat(head.data(), x, dim_head);
+      if (h >= q_num_head) {
+        const bool is_key = h < q_num_head + kv_num_head;
+        const int kv_hi =
+            is_key ? h - q_num_head : h - q_num_head - kv_num_head;
+        CacheT* cache = is_key ? k_cache : v_cache;
+        CacheT* dst = cache +
+                      ((static_cast<int64_t>(block_idx) * kv_num_head + kv_hi) *
+                           block_size +
+                       block_offset) *
+                          dim_head;
+        funcs::CvtFromFloat(head.data(), dst, dim_head);
+      }
+    }
+  }
+
+  // Step 2: attention of every (token, q head) over its cached prefix.
+  const float scale = 1.0f / std::sqrt(static_cast<float>(dim_head));
+  const T* mask_data = mask ? mask.get().data<T>() : nullptr;
+  const T* tgt_mask_data = tgt_mask ? tgt_mask.get().data<T>() : nullptr;
+  const int64_t num_items = static_cast<int64_t>(token_num) * q_num_head;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel
+#endif
+  {
+    std::vector<float> q(dim_head);
+    std::vector<float> out(dim_head);
+    std::vector<float> scores(max_block_per_seq * block_size);
+    std::vector<float> rows(static_cast<int64_t>(block_size) * dim_head);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp for schedule(dynamic)
+#endif
+    for (int64_t item = 0; item < num_items; ++item) {
+      const int t = item / q_num_head;
+      const int hi = item % q_num_head;
+      const int bi = token_bi[t];
+      if (bi < 0) continue;
+      const int pos = token_pos[t];
+
+      int kv_len = pos + 1;
+      const T* mask_row = nullptr;
+      if (enc_lens[bi] > 0) {
+        if (mask_data) {
+          // Non-causal prefill with an additive
+          // [bsz, 1 or q_num_head, max_len, max_len] mask.
+          const auto& mask_dims = mask.get().dims();
+          const int mask_hi = mask_dims[1] == 1 ? 0 : hi;
+          kv_len = enc_lens[bi];
+          mask_row =
+              mask_data +
+              ((static_cast<int64_t>(bi) * mask_dims[1] + mask_hi) *
+                   mask_dims[2] +
+               pos) *
+                  mask_dims[3];
+        }
+      } else if (tgt_mask_data) {
+        // [bsz, 1 or q_num_head, 1, mask_length]
+        const auto& mask_dims = tgt_mask.get().dims();
+        const int mask_hi = mask_dims[1] == 1 ? 0 : hi;
+        mask_row =
+            tgt_mask_data +
+            (static_cast<int64_t>(bi) * mask_dims[1] + mask_hi) * mask_dims[3];
+      }
+
+      funcs::CvtToFloat(qkv_data + t * row_size + hi * dim_head,
+                        q.data(),
+                        dim_head);
+      BlhaPagedAttention<T, CacheT>(
+          q.data(),
+          k_cache,
+          v_cache,
+          block_table_data + bi * max_block_per_seq,
+          mask_row,
+          hi / gqa_group_size,
+          kv_num_head,
+          block_size,
+          dim_head,
+          kv_len,
+          scale,
+          scores.data(),
+          rows.data(),
+          out.data());
+      funcs::CvtFromFloat(
+          out.data(),
+          out_data + (static_cast<int64_t>(t) * q_num_head + hi) * dim_head,
+          dim_head);
+    }
+  }
+}
+
+template <typename T, typename Context>
+void BlockMultiheadAttentionKernel(
+    const Context& dev_ctx,
+    const DenseTensor& qkv,
+    const DenseTensor& key_cache,
+    const DenseTensor& value_cache,
+    const DenseTensor& seq_lens_encoder,
+    const DenseTensor& seq_lens_decoder,
+    const DenseTensor& seq_lens_this_time,
+    const DenseTensor& padding_offsets,
+    const DenseTensor& cum_offsets,
+    const DenseTensor& cu_seqlens_q,
+    const DenseTensor& cu_seqlens_k,
+    const DenseTensor& block_tables,
+    const paddle::optional<DenseTensor>& pre_key_cache,
+    const paddle::optional<DenseTensor>& pre_value_cache,
+    const paddle::optional<DenseTensor>& rope_emb,
+    const paddle::optional<DenseTensor>& mask,
+    const paddle::optional<DenseTensor>& tgt_mask,
+    const paddle::optional<DenseTensor>& cache_k_quant_scales,
+    const paddle::optional<DenseTensor>& cache_v_quant_scales,
+    const paddle::optional<DenseTensor>& cache_k_dequant_scales,
+    const paddle::optional<DenseTensor>& cache_v_dequant_scales,
+    const paddle::optional<DenseTensor>& qkv_out_scale,
+    const paddle::optional<DenseTensor>& qkv_bias,
+    const paddle::optional<DenseTensor>& out_shift,
+    const paddle::optional<DenseTensor>& out_smooth,
+    const paddle::optional<DenseTensor>& max_enc_len_this_time,
+    const paddle::optional<DenseTensor>& max_dec_len_this_time,
+    int max_seq_len,
+    int block_size,
+    bool use_neox_style,
+    const bool dynamic_cachekv_quant,
+    const int quant_round_type,
+    const float quant_max_bound,
+    const float quant_min_bound,
+    const float out_scale,
+    const std::string& compute_dtype,
+    DenseTensor* fmha_out,
+    DenseTensor* qkv_out,
+    DenseTensor* key_cache_out,
+    DenseTensor* value_cache_out) {
+  PADDLE_ENFORCE_EQ(
+      qkv_out_scale || cache_k_quant_scales || pre_key_cache ||
+          out_scale > 0 || out_shift || out_smooth,
+      false,
+      errors::Unimplemented(
+          "The CPU kernel of block_multihead_attention does not support "
+          "quantized qkv/cache/output or pre_key_cache yet."));
+
+  VLOG(3) << "block_multihead_attention cpu, qkv: " << qkv.dims()
+          << " key_cache: " << key_cache.dims()
+          << " cache dtype: " << key_cache.dtype();
+
+#define PD_BLHA_CPU_CALL(cache_t)                                     \
+  BlockMultiheadAttentionCPUImpl<T, cache_t, Context>(dev_ctx,          \
+                                                      qkv,              \
+                                                      key_cache,        \
+                                                      value_cache,      \
+                                                      seq_lens_encoder, \
+                                                      seq_lens_decoder, \
+                                                      padding_offsets,  \
+                                                      block_tables,     \
+                                                      rope_emb,         \
+                                                      mask,             \
+                                                      tgt_mask,         \
+                                                      qkv_bias,         \
+                                                      max_seq_len,      \
+                                                      block_size,       \
+                                                      use_neox_style,   \
+                                                      fmha_out,         \
+                                                      qkv_out,          \
+                                                      key_cache_out,    \
+                                                      value_cache_out)
+
+  // The cache may be kept in a lower precision than qkv, e.g. fp32
+  // activations with a bf16 cache.
+  if (key_cache.dtype() == qkv.dtype()) {
+    PD_BLHA_CPU_CALL(T);
+  } else if (key_cache.dtype() == phi::DataType::BFLOAT16) {
+    PD_BLHA_CPU_CALL(phi::dtype::bfloat16);
+  } else if (key_cache.dtype() == phi::DataType::FLOAT16) {
+    PD_BLHA_CPU_CALL(phi::dtype::float16);
+  } else {
+    PADDLE_THROW(errors::Unimplemented(
+        "The CPU kernel of block_multihead_attention does not support "
+        "cache dtype %s with qkv dtype %s.",
+        key_cache.dtype(),
+        qkv.dtype()));
+  }
+#undef PD_BLHA_CPU_CALL
+}
+
+}  // namespace fusion
+}  // namespace phi
+
+PD_REGISTER_KERNEL(block_multihead_attention,
+                   CPU,
+                   ALL_LAYOUT,
+                   phi::fusion::BlockMultiheadAttentionKernel,
+                   float,
+                   phi::dtype::bfloat16,
+                   phi::dtype::float16) {
+  kernel->InputAt(24).SetBackend(phi::Backend::CPU);
+  kernel->InputAt(25).SetBackend(phi::Backend::CPU);
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#include "paddle/phi/core/enforce.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/kernels/fusion/cpu/fused_rope_utils.h"
+
+namespace phi {
+namespace fusion {
+
+template <typename T, typename Context>
+void FusedRopeGradKernel(const Context& dev_ctx,
+                         const paddle::optional<DenseTensor>& sin,
+                         const paddle::optional<DenseTensor>& cos,
+                         const paddle::optional<DenseTensor>& position_ids,
+                         const DenseTensor& dout_q,
+                         const paddle::optional<DenseTensor>& dout_k,
+                         const paddle::optional<DenseTensor>& dout_v,
+                         bool use_neox_rotary_style,
+                         bool time_major,
+                         float rotary_emb_base,
+                         DenseTensor* dq,
+                         DenseTensor* dk,
+                         DenseTensor* dv) {
+  int64_t numel = dout_q.numel();
+  if (numel <= 0) return;
+  dev_ctx.template Alloc<T>(dq);
+
+  auto head_dim = dout_q.dims()[3];
+  PADDLE_ENFORCE_NE(head_dim % 2,
+                    1,
+                    phi::errors::InvalidArgument(
+                        "The head_dim of input must be a multiple of 2."));
+
+  std::vector<const DenseTensor*> ins = {&dout_q};
+  std::vector<DenseTensor*> outs = {dq};
+  if (dout_k) {
+    dev_ctx.template Alloc<T>(dk);
+    ins.push_back(dout_k.get_ptr());
+    outs.push_back(dk);
+  }
+  if (dout_v) {
+    dev_ctx.template Alloc<T>(dv);
+    ins.push_back(dout_v.get_ptr());
+    outs.push_back(dv);
+  }
+
+  // The shapes of sin, cos and position_ids are checked in the forward.
+  FusedRopeCPUImpl<T, Context>(dev_ctx,
+                               ins,
+                               outs,
+                               sin,
+                               cos,
+                               position_ids,
+                               use_neox_rotary_style,
+                               time_major,
+                               rotary_emb_base,
+                               /*sign=*/-1);
+}
+
+}  // namespace fusion
+}  // namespace phi
+
+PD_REGISTER_KERNEL(fused_rotary_position_embedding_grad,
+                   CPU,
+                   ALL_LAYOUT,
+                   phi::fusion::FusedRopeGradKernel,
+                   float,
+                   double,
+                   phi::dtype::float16,
+                   phi::dtype::bfloat16) {}
@@ -0,0 +1,391 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "paddle/phi/common/amp_type_traits.h"
+#include "paddle/phi/core/dense_tensor.h"
+#include "paddle/phi/core/enforce.h"
+#include "paddle/phi/kernels/funcs/cpu_simd_utils.h"
+
+namespace phi {
+namespace fusion {
+
+// The CPU fused_rope follows the semantics of fusion/gpu/fused_rope_utils.h,
+// but folds the rotation sign into the sin table, so that both styles and
+// both directions become
+//
+//   out[i] = cos[i] * x[i] + sin_eff[i] * x[rot(i)]
+//
+// where rot(i) is the partner of i in the other half (rotate_half) or in the
+// same pair (rotate_every_two, use_neox_rotary_style=true). Every row of q/k/v
+// is then read and written exactly once.
+
+// Rows of cos and signed sin, indexed by position, each head_dim long.
+template <typename MT>
+struct RopeSinCosTable {
+  int64_t head_dim = 0;
+  int64_t num_positions = 0;
+  std::vector<MT> cos;
+  std::vector<MT> sin;
+
+  const MT* CosRow(int64_t pos) const { return cos.data() + pos * head_dim; }
+  const MT* SinRow(int64_t pos) const { return sin.data() + pos * head_dim; }
+};
+
+// Writes cos/sin of one position into the table, applying the sign of
+// sign * sign_r (rotate_half) or the pair rule (rotate_every_two).
+template <typename MT>
+inline void FillRopeRow(const MT* sin_row,
+                        const MT* cos_row,
+                        int64_t head_dim,
+                        bool rotate_every_two,
+                        int sign,
+                        MT* sin_out,
+                        MT* cos_out) {
+  std::memcpy(cos_out, cos_row, head_dim * sizeof(MT));
+  if (rotate_every_two) {
+    for (int64_t i = 0; i < head_dim; i += 2) {
+      if (sign == 1) {
+        sin_out[i] = -sin_row[i];
+        sin_out[i + 1] = sin_row[i + 1];
+      } else {
+        sin_out[i] = sin_row[i + 1];
+        sin_out[i + 1] = -sin_row[i];
+      }
+    }
+  } else {
+    int64_t half = head_dim / 2;
+    for (int64_t i = 0; i < head_dim; ++i) {
+      MT sign_r = i < half ? static_cast<MT>(-1) : static_cast<MT>(1);
+      sin_out[i] = static_cast<MT>(sign) * sign_r * sin_row[i];
+    }
+  }
+}
+
+// Builds the table from the passed sin/cos, shape [seq_len, head_dim] or
+// [1, seq_len, 1, head_dim]. These depend on the tensor contents and are
+// rebuilt on every call.
+template <typename T, typename MT>
+void BuildRopeTableFromTensor(const DenseTensor& sin,
+                              const DenseTensor& cos,
+                              int64_t head_dim,
+                              bool rotate_every_two,
+                              int sign,
+                              RopeSinCosTable<MT>* table) {
+  int64_t num_positions = sin.numel() / head_dim;
+  table->head_dim = head_dim;
+  table->num_positions = num_positions;
+  table->cos.resize(num_positions * head_dim);
+  table->sin.resize(num_positions * head_dim);
+  const T* sin_data = sin.data<T>();
+  const T* cos_data = cos.data<T>();
+  std::vector<MT> sin_row(head_dim), cos_row(head_dim);
+  for (int64_t pos = 0; pos < num_positions; ++pos) {
+    for (int64_t i = 0; i < head_dim; ++i) {
+      sin_row[i] = static_cast<MT>(sin_data[pos * head_dim + i]);
+      cos_row[i] = static_cast<MT>(cos_data[pos * head_dim + i]);
+    }
+    FillRopeRow<MT>(sin_row.data(),
+                    cos_row.data(),
+                    head_dim,
+                    rotate_every_two,
+                    sign,
+                    table->sin.data() + pos * head_dim,
+                    table->cos.data() + pos * head_dim);
+  }
+}
+
+// Returns the table generated from rotary_emb_base for positions
+// [0, num_positions). Generated tables only depend on the key below, so they
+// are cached for the life of the process and grown on demand; the returned
+// table is immutable and may be shared by concurrent calls.
+template <typename MT>
+std::shared_ptr<const RopeSinCosTable<MT>> GetCachedRopeTable(
+    int64_t num_positions,
+    int64_t head_dim,
+    float rotary_emb_base,
+    bool rotate_every_two,
+    int sign) {
+  using Key = std::tuple<int64_t, float, bool, int>;
+  static std::mutex mutex;
+  static std::map<Key, std::shared_ptr<const RopeSinCosTable<MT>>> cache;
+
+  Key key(head_dim, rotary_emb_base, rotate_every_two, sign);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = cache.find(key);
+  if (it != cache.end() && it->second->num_positions >= num_positions) {
+    return it->second;
+  }
+
+  // Round up to limit rebuilds when seq_len grows step by step.
+  int64_t capacity = 64;
+  while (capacity < num_positions) {
+    capacity *= 2;
+  }
+  auto table = std::make_shared<RopeSinCosTable<MT>>();
+  table->head_dim = head_dim;
+  table->num_positions = capacity;
+  table->cos.resize(capacity * head_dim);
+  table->sin.resize(capacity * head_dim);
+  MT div_c = static_cast<MT>(1.0f / head_dim);
+  std::vector<MT> inv_freq(head_dim), sin_row(head_dim), cos_row(head_dim);
+  for (int64_t i = 0; i < head_dim; ++i) {
+    MT idx = static_cast<MT>(i / 2 * 2.0);
+    inv_freq[i] = static_cast<MT>(1) /
+                  std::pow(static_cast<MT>(rotary_emb_base), idx * div_c);
+  }
+  for (int64_t pos = 0; pos < capacity; ++pos) {
+    for (int64_t i = 0; i < head_dim; ++i) {
+      MT value = static_cast<MT>(pos) * inv_freq[i];
+      sin_row[i] = std::sin(value);
+      cos_row[i] = std::cos(value);
+    }
+    FillRopeRow<MT>(sin_row.data(),
+                    cos_row.data(),
+                    head_dim,
+                    rotate_every_two,
+                    sign,
+                    table->sin.data() + pos * head_dim,
+                    table->cos.data() + pos * head_dim);
+  }
+  cache[key] = table;
+  return table;
+}
+
+// out = cos * x + sin * rot(x) for one head, in the compute type.
+template <typename MT>
+inline void RopeRotateRow(const MT* x,
+                          const MT* cos,
+                          const MT* sin,
+                          int64_t head_dim,
+                          bool rotate_every_two,
+                          MT* out) {
+  if (rotate_every_two) {
+    for (int64_t i = 0; i < head_dim; i += 2) {
+      MT x0 = x[i];
+      MT x1 = x[i + 1];
+      out[i] = cos[i] * x0 + sin[i] * x1;
+      out[i + 1] = cos[i + 1] * x1 + sin[i + 1] * x0;
+    }
+  } else {
+    int64_t half = head_dim / 2;
+    for (int64_t i = 0; i < half; ++i) {
+      MT x0 = x[i];
+      MT x1 = x[i + half];
+      out[i] = cos[i] * x0 + sin[i] * x1;
+      out[i + half] = cos[i + half] * x1 + sin[i + half] * x0;
+    }
+  }
+}
+
+template <>
+inline void RopeRotateRow<float>(const float* x,
+                                 const float* cos,
+                                 const float* sin,
+                                 int64_t head_dim,
+                                 bool rotate_every_two,
+                                 float* out) {
+  int64_t i = 0;
+  if (rotate_every_two) {
+    // Swapping the two lanes of every pair keeps the pairs inside one vector
+    // as long as the vector starts at an even index.
+#if defined(__AVX512F__)
+    for (; i + 16 <= head_dim; i += 16) {
+      __m512 v = _mm512_loadu_ps(x + i);
+      __m512 r = _mm512_permute_ps(v, 0xB1);
+      __m512 o = _mm512_mul_ps(_mm512_loadu_ps(cos + i), v);
+      o = _mm512_fmadd_ps(_mm512_loadu_ps(sin + i), r, o);
+      _mm512_storeu_ps(out + i, o);
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= head_dim; i += 8) {
+      __m256 v = _mm256_loadu_ps(x + i);
+      __m256 r = _mm256_permute_ps(v, 0xB1);
+      __m256 o = _mm256_mul_ps(_mm256_loadu_ps(cos + i), v);
+#ifdef __FMA__
+      o = _mm256_fmadd_ps(_mm256_loadu_ps(sin + i), r, o);
+#else
+      o = _mm256_add_ps(o, _mm256_mul_ps(_mm256_loadu_ps(sin + i), r));
+#endif
+      _mm256_storeu_ps(out + i, o);
+    }
+#endif
+    for (; i < head_dim; i += 2) {
+      float x0 = x[i];
+      float x1 = x[i + 1];
+      out[i] = cos[i] * x0 + sin[i] * x1;
+      out[i + 1] = cos[i + 1] * x1 + sin[i + 1] * x0;
+    }
+  } else {
+    const int64_t half = head_dim / 2;
+#if defined(__AVX512F__)
+    for (; i + 16 <= half; i += 16) {
+      __m512 x0 = _mm512_loadu_ps(x + i);
+      __m512 x1 = _mm512_loadu_ps(x + i + half);
+      __m512 lo = _mm512_mul_ps(_mm512_loadu_ps(cos + i), x0);
+      lo = _mm512_fmadd_ps(_mm512_loadu_ps(sin + i), x1, lo);
+      __m512 hi = _mm512_mul_ps(_mm512_loadu_ps(cos + i + half), x1);
+      hi = _mm512_fmadd_ps(_mm512_loadu_ps(sin + i + half), x0, hi);
+      _mm512_storeu_ps(out + i, lo);
+      _mm512_storeu_ps(out + i + half, hi);
+    }
+#elif defined(__AVX__)
+    for (; i + 8 <= half; i += 8) {
+      __m256 x0 = _mm256_loadu_ps(x + i);
+      __m256 x1 = _mm256_loadu_ps(x + i + half);
+      __m256 lo = _mm256_mul_ps(_mm256_loadu_ps(cos + i), x0);
+      __m256 hi = _mm256_mul_ps(_mm256_loadu_ps(cos + i + half), x1);
+#ifdef __FMA__
+      lo = _mm256_fmadd_ps(_mm256_loadu_ps(sin + i), x1, lo);
+      hi = _mm256_fmadd_ps(_mm256_loadu_ps(sin + i + half), x0, hi);
+#else
+      lo = _mm256_add_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(sin + i), x1));
+      hi = _mm256_add_ps(hi,
+                         _mm256_mul_ps(_mm256_loadu_ps(sin + i + half), x0));
+#endif
+      _mm256_storeu_ps(out + i, lo);
+      _mm256_storeu_ps(out + i + half, hi);
+    }
+#endif
+    for (; i < half; ++i) {
+      float x0 = x[i];
+      float x1 = x[i + half];
+      out[i] = cos[i] * x0 + sin[i] * x1;
+      out[i + half] = cos[i + half] * x1 + sin[i + half] * x0;
+    }
+  }
+}
+
+// Shared by the forward (sign = 1) and backward (sign = -1) kernels. ins and
+// outs hold up to three tensors (q, k, v) of shape
+// [batch_size, seq_len, num_heads, head_dim], or [seq_len, batch_size, ...]
+// when time_major; num_heads may differ between them (MQA/GQA).
+template <typename T, typename Context>
+void FusedRopeCPUImpl(const Context& dev_ctx,
+                      const std::vector<const DenseTensor*>& ins,
+                      const std::vector<DenseTensor*>& outs,
+                      const paddle::optional<DenseTensor>& sin,
+                      const paddle::optional<DenseTensor>& cos,
+                      const paddle::optional<DenseTensor>& position_ids,
+                      bool use_neox_rotary_style,
+                      bool time_major,
+                      float rotary_emb_base,
+                      int sign) {
+  using MT = typename phi::dtype::MPTypeTrait<T>::Type;
+  const auto& dims = ins[0]->dims();
+  const int64_t batch_size = time_major ? dims[1] : dims[0];
+  const int64_t seq_len = time_major ? dims[0] : dims[1];
+  const int64_t head_dim = dims[3];
+
+  std::shared_ptr<const RopeSinCosTable<MT>> table;
+  const int64_t* position_ids_data = nullptr;
+  if (sin.get_ptr() && cos.get_ptr()) {
+    auto passed = std::make_shared<RopeSinCosTable<MT>>();
+    BuildRopeTableFromTensor<T, MT>(*sin.get_ptr(),
+                                    *cos.get_ptr(),
+                                    head_dim,
+                                    use_neox_rotary_style,
+                                    sign,
+                                    passed.get());
+    table = passed;
+    if (position_ids) {
+      position_ids_data = position_ids->data<int64_t>();
+      // Check here rather than inside the parallel region below.
+      for (int64_t i = 0; i < batch_size * seq_len; ++i) {
+        PADDLE_ENFORCE_EQ(
+            position_ids_data[i] >= 0 &&
+                position_ids_data[i] < table->num_positions,
+            true,
+            phi::errors::InvalidArgument(
+                "The position_ids must be in [0, %d), but received %d.",
+                table->num_positions,
+                position_ids_data[i]));
+      }
+    }
+  } else {
+    // Generated sin/cos ignore position_ids, the same as the GPU kernel.
+    table = GetCachedRopeTable<MT>(seq_len,
+                                   head_dim,
+                                   rotary_emb_base,
+                                   use_neox_rotary_style,
+                                   sign);
+  }
+
+  const int64_t num_rows = batch_size * seq_len;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel
+#endif
+  {
+    std::vector<MT> x_buf, out_buf;
+    if constexpr (!std::is_same<T, MT>::value) {
+      x_buf.resize(head_dim);
+      out_buf.resize(head_dim);
+    }
+#ifdef PADDLE_WITH_MKLML
+#pragma omp for
+#endif
+    for (int64_t row = 0; row < num_rows; ++row) {
+      // row enumerates memory order, i.e. [seq, batch] when time_major.
+      int64_t bi = time_major ? row % batch_size : row / seq_len;
+      int64_t si = time_major ? row / batch_size : row % seq_len;
+      int64_t pos =
+          position_ids_data ? position_ids_data[bi * seq_len + si] : si;
+      const MT* cos_row = table->CosRow(pos);
+      const MT* sin_row = table->SinRow(pos);
+      for (size_t t = 0; t < ins.size(); ++t) {
+        const int64_t num_heads = ins[t]->dims()[2];
+        const T* in = ins[t]->data<T>() + row * num_heads * head_dim;
+        T* out = outs[t]->data<T>() + row * num_heads * head_dim;
+        for (int64_t h = 0; h < num_heads; ++h) {
+          const T* x = in + h * head_dim;
+          T* y = out + h * head_dim;
+          if constexpr (std::is_same<T, MT>::value) {
+            RopeRotateRow<MT>(reinterpret_cast<const MT*>(x),
+                              cos_row,
+                              sin_row,
+                              head_dim,
+                              use_neox_rotary_style,
+                              reinterpret_cast<MT*>(y));
+          } else {
+            funcs::CvtToFloat<T>(x, x_buf.data(), head_dim);
+            RopeRotateRow<MT>(x_buf.data(),
+                              cos_row,
+                              sin_row,
+                              head_dim,
+                              use_neox_rotary_style,
+                              out_buf.data());
+            funcs::CvtFromFloat<T>(out_buf.data(), y, head_dim);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace fusion
+}  // namespace phi
@@ -14,7 +14,15 @@ limitations under the License. */
 
 #pragma once
 
-#include <set>
+#ifdef PADDLE_WITH_MKLML
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "paddle/phi/core/dense_tensor.h"
 #include "paddle/phi/core/kernel_registry.h"
@@ -28,9 +36,101 @@ namespace sparse {
 
 using Dims4D = phi::funcs::sparse::Dims4D;
 
+// CoordHashTable maps packed coordinates (the non-negative int64 index from
+// PointToIndex) to an int64 value with open addressing and linear probing.
+// Insert may be called from many threads at once, slots are claimed with a
+// CAS on the key. Lookups must not run concurrently with inserts.
+class CoordHashTable {
+ public:
+  static constexpr int64_t kEmpty = -1;
+
+  explicit CoordHashTable(int64_t num_keys) {
+    // Keep the load factor at or below 0.5.
+    capacity_ = 16;
+    while (capacity_ < 2 * num_keys) {
+      capacity_ *= 2;
+    }
+    mask_ = capacity_ - 1;
+    keys_.reset(new std::atomic<int64_t>[capacity_]);
+    values_.reset(new int64_t[capacity_]);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+    for (int64_t i = 0; i < capacity_; ++i) {
+      keys_[i].store(kEmpty, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the key is already present, the value is then kept.
+  bool Insert(int64_t key, int64_t value) {
+    for (int64_t slot = Hash(key);; slot = (slot + 1) & mask_) {
+      int64_t cur = keys_[slot].load(std::memory_order_relaxed);
+      if (cur == kEmpty) {
+        if (keys_[slot].compare_exchange_strong(
+                cur, key, std::memory_order_relaxed)) {
+          values_[slot] = value;
+          return true;
+        }
+      }
+      if (cur == key) {
+        return false;
+      }
+    }
+  }
+
+  // Returns the slot of the key, or kEmpty if it is absent.
+  int64_t FindSlot(int64_t key) const {
+    for (int64_t slot = Hash(key);; slot = (slot + 1) & mask_) {
+      int64_t cur = keys_[slot].load(std::memory_order_relaxed);
+      if (cur == key) {
+        return slot;
+      }
+      if (cur == kEmpty) {
+        return kEmpty;
+      }
+    }
+  }
+
+  bool Contains(int64_t key) const { return FindSlot(key) != kEmpty; }
+
+  int64_t Capacity() const { return capacity_; }
+  int64_t KeyAt(int64_t slot) const {
+    return keys_[slot].load(std::memory_order_relaxed);
+  }
+  int64_t& ValueAt(int64_t slot) { return values_[slot]; }
+  int64_t ValueAt(int64_t slot) const { return values_[slot]; }
+
+ private:
+  int64_t Hash(int64_t key) const {
+    // splitmix64 finalizer, neighbouring voxels must not share a probe run.
+    uint64_t h = static_cast<uint64_t>(key);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h = h ^ (h >> 31);
+    return static_cast<int64_t>(h & static_cast<uint64_t>(mask_));
+  }
+
+  int64_t capacity_;
+  int64_t mask_;
+  std::unique_ptr<std::atomic<int64_t>[]> keys_;
+  std::unique_ptr<int64_t[]> values_;
+};
+
+inline int GetRulebookNumThreads() {
+#ifdef PADDLE_WITH_MKLML
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
 // such as: kernel(3, 3, 3), kernel_size = 27
 // counter_per_weight: (kernel_size)
-// TODO(zhangkaihuo): optimize performance with multithreading
+//
+// Every thread takes a contiguous range of the input points and builds one
+// (in_i, out_index) list per kernel offset. The lists are then concatenated
+// offset by offset in thread order, so the rulebook is ordered by kernel
+// offset and then by input point, independent of the number of threads.
 template <typename T, typename Context, typename IntT = int>
 void ProductRuleBook(const Context& dev_ctx,
                      const SparseCooTensor& x,
@@ -50,8 +150,6 @@ void ProductRuleBook(const Context& dev_ctx,
                          : kernel_sizes[0] * kernel_sizes[1] * kernel_sizes[2];
   memset(counter_per_kernel, 0, kernel_size * sizeof(int));
 
-  int rulebook_len = 0;
-  // calc the rulebook_len
   const auto& x_dims = x.dims();
 
   int xdim0, xdim1, xdim2, xdim3;
@@ -98,38 +196,68 @@ void ProductRuleBook(const Context& dev_ctx,
   const Dims4D c_strides(sdim0, sdim1, sdim2, sdim3);
   const Dims4D c_dilations(ddim0, ddim1, ddim2, ddim3);
 
-  std::set<IntT> hash_in;
+  auto get_point = [&](int64_t i, IntT* batch, IntT* z, IntT* y, IntT* px) {
+    *batch = indices_ptr[i];
+    *z = is2D ? 0 : indices_ptr[i + non_zero_num];
+    *y = is2D ? indices_ptr[i + non_zero_num]
+              : indices_ptr[i + 2 * non_zero_num];
+    *px = is2D ? indices_ptr[i + 2 * non_zero_num]
+               : indices_ptr[i + 3 * non_zero_num];
+  };
+
+  std::unique_ptr<CoordHashTable> hash_in;
   if (subm) {
-    for (int i = 0; i < non_zero_num; i++) {
-      IntT batch = indices_ptr[i];
-      IntT in_z = is2D ? 0 : indices_ptr[i + non_zero_num];
-      IntT in_y = is2D ? indices_ptr[i + non_zero_num]
-                       : indices_ptr[i + 2 * non_zero_num];
-      IntT in_x = is2D ? indices_ptr[i + 2 * non_zero_num]
-                       : indices_ptr[i + 3 * non_zero_num];
-      IntT index = phi::funcs::sparse::PointToIndex<Dims4D>(
-          batch, in_x, in_y, in_z, c_x_dims);
-      hash_in.insert(index);
+    hash_in = std::make_unique<CoordHashTable>(non_zero_num);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+    for (int64_t i = 0; i < non_zero_num; i++) {
+      IntT batch, in_z, in_y, in_x;
+      get_point(i, &batch, &in_z, &in_y, &in_x);
+      hash_in->Insert(phi::funcs::sparse::PointToIndex<Dims4D, int64_t>(
+                          batch, in_x, in_y, in_z, c_x_dims),
+                      i);
     }
   }
 
-  auto f_calc_rulebook = [&](IntT* rulebook_ptr) {
-    int kernel_index = 0, rulebook_index = 0;
-    int zceil = is2D ? 1 : kernel_sizes[0];
-    int yceil = is2D ? kernel_sizes[0] : kernel_sizes[1];
-    int xceil = is2D ? kernel_sizes[1] : kernel_sizes[2];
+  const int num_threads = static_cast<int>(
+      std::max<int64_t>(1, std::min<int64_t>(GetRulebookNumThreads(),
+                                             non_zero_num / 1024 + 1)));
+  // local[tid * kernel_size + k] holds the (in_i, out_index) pairs found by
+  // thread tid for kernel offset k.
+  std::vector<std::vector<std::pair<IntT, IntT>>> local(num_threads *
+                                                        kernel_size);
+  const int zceil = is2D ? 1 : kernel_sizes[0];
+  const int yceil = is2D ? kernel_sizes[0] : kernel_sizes[1];
+  const int xceil = is2D ? kernel_sizes[1] : kernel_sizes[2];
+
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for num_threads(num_threads)
+#endif
+  for (int tid = 0; tid < num_threads; ++tid) {
+    const int64_t begin = non_zero_num * tid / num_threads;
+    const int64_t end = non_zero_num * (tid + 1) / num_threads;
+    int kernel_index = 0;
     for (int kz = 0; kz < zceil; kz++) {
       for (int ky = 0; ky < yceil; ky++) {
-        for (int kx = 0; kx < xceil; kx++) {
-          ++kernel_index;
-          for (int64_t i = 0; i < non_zero_num; i++) {
-            IntT batch = indices_ptr[i];
-            IntT in_z = is2D ? 0 : indices_ptr[i + non_zero_num];
-            IntT in_y = is2D ? indices_ptr[i + non_zero_num]
-                             : indices_ptr[i + 2 * non_zero_num];
-            IntT in_x = is2D ? indices_ptr[i + 2 * non_zero_num]
-                             : indices_ptr[i + 3 * non_zero_num];
-
+        for (int kx = 0; kx < xceil; kx++, kernel_index++) {
+          auto& list = local[tid * kernel_size + kernel_index];
+          for (int64_t i = begin; i < end; i++) {
+            IntT batch, in_z, in_y, in_x;
+            get_point(i, &batch, &in_z, &in_y, &in_x);
+            if (!phi::funcs::sparse::Check(c_x_dims,
+                                           c_kernel_dims,
+                                           c_paddings,
+                                           c_dilations,
+                                           c_strides,
+                                           in_x,
+                                           in_y,
+                                           in_z,
+                                           kx,
+                                           ky,
+                                           kz)) {
+              continue;
+            }
             IntT out_z =
                 is2D ? 0
                      : (in_z + paddings[0] - kz * dilations[0]) / strides[0];
@@ -137,53 +265,55 @@ void ProductRuleBook(const Context& dev_ctx,
                 (in_y + c_paddings[2] - ky * c_dilations[2]) / c_strides[2];
             IntT out_x =
                 (in_x + c_paddings[3] - kx * c_dilations[3]) / c_strides[3];
-            if (phi::funcs::sparse::Check(c_x_dims,
-                                          c_kernel_dims,
-                                          c_paddings,
-                                          c_dilations,
-                                          c_strides,
-                                          in_x,
-                                          in_y,
-                                          in_z,
-                                          kx,
-                                          ky,
-                                          kz)) {
-              if (subm) {
-                IntT out_index = phi::funcs::sparse::PointToIndex<Dims4D>(
+            int64_t out_index =
+                phi::funcs::sparse::PointToIndex<Dims4D, int64_t>(
                     batch, out_x, out_y, out_z, c_out_dims);
-                if (hash_in.find(out_index) == hash_in.end()) {
-                  continue;
-                }
-              }
-
-              if (rulebook_ptr == nullptr) {
-                counter_per_kernel[kernel_index - 1] += 1;
-                ++rulebook_len;
-              } else {
-                rulebook_ptr[rulebook_index] = kernel_index - 1;
-                rulebook_ptr[rulebook_index + rulebook_len] = i;  // in_i
-                rulebook_ptr[rulebook_index + rulebook_len * 2] =
-                    phi::funcs::sparse::PointToIndex<Dims4D>(
-                        batch, out_x, out_y, out_z, c_out_dims);  // out_index
-                ++rulebook_index;
-              }
+            if (subm && !hash_in->Contains(out_index)) {
+              continue;
             }
+            list.emplace_back(static_cast<IntT>(i),
+                              static_cast<IntT>(out_index));
           }
         }
       }
     }
-  };
+  }
+
+  // offsets[tid * kernel_size + k] is where the list of (tid, k) starts.
+  std::vector<int64_t> offsets(num_threads * kernel_size);
+  int64_t rulebook_len = 0;
+  for (int k = 0; k < kernel_size; k++) {
+    for (int tid = 0; tid < num_threads; ++tid) {
+      offsets[tid * kernel_size + k] = rulebook_len;
+      rulebook_len += local[tid * kernel_size + k].size();
+      counter_per_kernel[k] += local[tid * kernel_size + k].size();
+    }
+  }
 
-  f_calc_rulebook(nullptr);
   // alloc the rulebook
   *rulebook = phi::Empty(dev_ctx,
                          DenseTensorMeta(phi::CppTypeToDataType<IntT>::Type(),
                                          {3, rulebook_len},
                                          DataLayout::NCHW));
   IntT* rulebook_ptr = rulebook->data<IntT>();
-  f_calc_rulebook(rulebook_ptr);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t j = 0; j < num_threads * kernel_size; ++j) {
+    const int k = static_cast<int>(j % kernel_size);
+    const auto& list = local[j];
+    int64_t pos = offsets[j];
+    for (const auto& item : list) {
+      rulebook_ptr[pos] = k;
+      rulebook_ptr[pos + rulebook_len] = item.first;        // in_i
+      rulebook_ptr[pos + rulebook_len * 2] = item.second;  // out_index
+      ++pos;
+    }
+  }
 }
 
+// Deduplicates the output indices of the rulebook with a hash table, sorts
+// only the unique ones and rewrites the rulebook to point at output rows.
 template <typename T, typename Context, typename IntT = int>
 void UpdateRulebookAndOutIndex(const Context& dev_ctx,
                                const SparseCooTensor& x,
@@ -194,14 +324,27 @@ void UpdateRulebookAndOutIndex(const Context& dev_ctx,
                                SparseCooTensor* out) {
   const bool is2D = out_dims.size() == 4 ? true : false;
 
-  std::set<IntT> out_indexs;
-  int n = rulebook->dims()[1];
+  const int64_t n = rulebook->dims()[1];
   IntT* rulebook_ptr = rulebook->data<IntT>();
-  for (int i = 0; i < n; i++) {
-    out_indexs.insert(rulebook_ptr[i + n * 2]);
+  CoordHashTable out_table(n);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t i = 0; i < n; i++) {
+    out_table.Insert(rulebook_ptr[i + n * 2], 0);
+  }
+
+  std::vector<IntT> out_indexs;
+  out_indexs.reserve(n);
+  for (int64_t slot = 0; slot < out_table.Capacity(); ++slot) {
+    int64_t key = out_table.KeyAt(slot);
+    if (key != CoordHashTable::kEmpty) {
+      out_indexs.push_back(static_cast<IntT>(key));
+    }
   }
+  std::sort(out_indexs.begin(), out_indexs.end());
 
-  int out_non_zero_num = out_indexs.size();
+  const int64_t out_non_zero_num = out_indexs.size();
   const int64_t sparse_dim = is2D ? 3 : 4;
   DenseTensorMeta indices_meta(phi::CppTypeToDataType<IntT>::Type(),
                                {sparse_dim, out_non_zero_num},
@@ -211,7 +354,6 @@ void UpdateRulebookAndOutIndex(const Context& dev_ctx,
   phi::DenseTensor out_indices = phi::Empty(dev_ctx, std::move(indices_meta));
   phi::DenseTensor out_values = phi::Empty(dev_ctx, std::move(values_meta));
   IntT* out_indices_ptr = out_indices.data<IntT>();
-  int i = 0;
 
   int odim0, odim1, odim2, odim3;
   odim0 = out_dims[0];
@@ -220,8 +362,12 @@ void UpdateRulebookAndOutIndex(const Context& dev_ctx,
   odim3 = is2D ? 1 : out_dims[1];
   const Dims4D c_out_dims(odim0, odim1, odim2, odim3);
 
-  for (auto it = out_indexs.begin(); it != out_indexs.end(); it++, i++) {
-    const IntT index = *it;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t i = 0; i < out_non_zero_num; i++) {
+    const IntT index = out_indexs[i];
+    out_table.ValueAt(out_table.FindSlot(index)) = i;
     IntT batch, x, y, z;
     phi::funcs::sparse::IndexToPoint<Dims4D>(
         index, c_out_dims, &batch, &x, &y, &z);
@@ -235,10 +381,13 @@ void UpdateRulebookAndOutIndex(const Context& dev_ctx,
       out_indices_ptr[i + out_non_zero_num * 3] = x;
     }
   }
-  for (i = 0; i < n; i++) {
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (int64_t i = 0; i < n; i++) {
     IntT out_index = rulebook_ptr[i + n * 2];
     rulebook_ptr[i + n * 2] =
-        std::distance(out_indexs.begin(), out_indexs.find(out_index));
+        static_cast<IntT>(out_table.ValueAt(out_table.FindSlot(out_index)));
   }
 
   out->SetMember(out_indices, out_values, out_dims, true);
@@ -247,19 +396,47 @@ void UpdateRulebookAndOutIndex(const Context& dev_ctx,
 template <typename T, typename IntT = int>
 void Gather(
     const T* x, const IntT* indexs, const int n, const int channels, T* out) {
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
   for (int i = 0; i < n; i++) {
     IntT real_i = indexs[i];
     memcpy(out + i * channels, x + real_i * channels, channels * sizeof(T));
   }
 }
 
+// Rows of x that land on the same output row are summed in the order they
+// appear in x, so the result does not depend on the number of threads. The
+// rows are first bucketed by output row (a counting sort) so that every
+// output row is owned by exactly one thread.
 template <typename T, typename IntT = int>
 void Scatter(
     const T* x, const IntT* indexs, const int n, const int channels, T* out) {
+  if (n <= 0) return;
+  IntT num_out = *std::max_element(indexs, indexs + n) + 1;
+  std::vector<int64_t> row_offsets(num_out + 1, 0);
   for (int i = 0; i < n; i++) {
-    IntT real_i = indexs[i];
-    for (int j = 0; j < channels; j++) {
-      out[real_i * channels + j] += x[i * channels + j];
+    row_offsets[indexs[i] + 1]++;
+  }
+  for (IntT r = 0; r < num_out; r++) {
+    row_offsets[r + 1] += row_offsets[r];
+  }
+  std::vector<int> order(n);
+  std::vector<int64_t> cursor(row_offsets.begin(), row_offsets.end() - 1);
+  for (int i = 0; i < n; i++) {
+    order[cursor[indexs[i]]++] = i;
+  }
+
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+  for (IntT r = 0; r < num_out; r++) {
+    T* dst = out + r * channels;
+    for (int64_t p = row_offsets[r]; p < row_offsets[r + 1]; p++) {
+      const T* src = x + static_cast<int64_t>(order[p]) * channels;
+      for (int j = 0; j < channels; j++) {
+        dst[j] += src[j];
+      }
     }
   }
 }
@@ -644,6 +644,7 @@ class DistributedStrategy:
         support_sparse_table_class = [
             'DownpourSparseTable',
             'DownpourSparseSSDTable',
+            'DownpourSparseFlatTable',
         ]
         support_sparse_accessor_class = [
             'DownpourSparseValueAccessor',
@@ -781,10 +782,12 @@ class DistributedStrategy:
             )
             if table_class not in support_sparse_table_class:
                 raise ValueError(
-                    f"support sparse_table_class: ['DownpourSparseTable, DownpourSparseSSDTable'], but actual {table_class}"
+                    f"support sparse_table_class: ['DownpourSparseTable, DownpourSparseSSDTable, DownpourSparseFlatTable'], but actual {table_class}"
                 )
             if table_class == "DownpourSparseSSDTable":
                 table_data.table_class = 'SSDSparseTable'
+            elif table_class == "DownpourSparseFlatTable":
+                table_data.table_class = 'MemoryFlatSparseTable'
             else:
                 table_data.table_class = 'MemorySparseTable'
             table_data.shard_num = config.get('sparse_shard_num', 1000)
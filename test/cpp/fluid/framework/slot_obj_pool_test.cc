@@ -0,0 +1,153 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <future>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/data_feed.h"
+
+namespace paddle {
+namespace framework {
+
+// The pools are used from threads that exit before the pools are destroyed,
+// as SlotObjPool requires.
+
+TEST(SlotObjPool, Counters) {
+  int32_t max_size = FLAGS_record_pool_max_size;
+  // a depot of 4 magazines
+  FLAGS_record_pool_max_size = 1024;
+  SlotObjPool pool;
+  FLAGS_record_pool_max_size = max_size;
+  pool.set_max_capacity(1 << 20);
+
+  std::thread([&pool]() {
+    std::vector<SlotRecord> records;
+    pool.get(&records, 100);
+    auto stat = pool.stat();
+    EXPECT_EQ(stat.misses, 100UL);
+    EXPECT_EQ(stat.hits, 0UL);
+    EXPECT_EQ(stat.in_use, 100);
+    EXPECT_EQ(stat.cached, 0);
+
+    pool.put(&records);
+    stat = pool.stat();
+    EXPECT_EQ(stat.recycled, 100UL);
+    EXPECT_EQ(stat.cached, 100);
+    EXPECT_EQ(stat.in_use, 0);
+
+    pool.get(&records, 150);
+    stat = pool.stat();
+    EXPECT_EQ(stat.hits, 100UL);
+    EXPECT_EQ(stat.misses, 150UL);
+    EXPECT_EQ(stat.cached, 0);
+    pool.put(&records);
+
+    // 8 magazines of records: 4 go to the depot, 3 more overflow it and
+    // are freed, and the last one stays in the magazine of this thread
+    pool.get(&records, 8 * SlotObjPool::kMagazineSize);
+    pool.put(&records);
+    stat = pool.stat();
+    EXPECT_EQ(stat.in_use, 0);
+    EXPECT_EQ(stat.freed, 3UL * SlotObjPool::kMagazineSize);
+    EXPECT_EQ(stat.cached, 5 * SlotObjPool::kMagazineSize);
+    EXPECT_EQ(pool.capacity(), 5UL * SlotObjPool::kMagazineSize);
+
+    pool.clear();
+    stat = pool.stat();
+    EXPECT_EQ(stat.cached, 0);
+    EXPECT_EQ(stat.hits + stat.freed, stat.recycled);
+  }).join();
+
+  // records over the max capacity are freed
+  pool.set_max_capacity(10);
+  std::thread([&pool]() {
+    std::vector<SlotRecord> records;
+    pool.get(&records, 30);
+    uint64_t freed = pool.stat().freed;
+    pool.put(&records);
+    EXPECT_EQ(pool.capacity(), 10UL);
+    EXPECT_EQ(pool.stat().freed, freed + 20);
+    pool.clear();
+  }).join();
+}
+
+TEST(SlotObjPool, MultiThreadGetPut) {
+  SlotObjPool pool;
+  const int thread_num = 8;
+  const int round_num = 100;
+  const int batch_size = 300;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&pool, t]() {
+      std::vector<SlotRecord> records;
+      for (int round = 0; round < round_num; ++round) {
+        pool.get(&records, batch_size);
+        for (auto* record : records) {
+          ASSERT_NE(record, nullptr);
+          record->ins_id_ = std::to_string(t);
+        }
+        pool.put(&records);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // the magazines of the exited threads went to the depot or were freed
+  auto stat = pool.stat();
+  EXPECT_EQ(stat.in_use, 0);
+  EXPECT_EQ(stat.hits + stat.misses,
+            static_cast<uint64_t>(thread_num * round_num * batch_size));
+  EXPECT_EQ(stat.recycled,
+            static_cast<uint64_t>(thread_num * round_num * batch_size));
+  EXPECT_EQ(stat.cached,
+            static_cast<int64_t>(stat.recycled - stat.hits - stat.freed));
+  pool.clear();
+  stat = pool.stat();
+  EXPECT_EQ(stat.cached, 0);
+  EXPECT_EQ(stat.hits + stat.freed, stat.recycled);
+}
+
+TEST(SlotObjPool, ClearKeepsOtherThreadMagazines) {
+  SlotObjPool pool;
+  std::promise<void> put_done, clear_done;
+  std::shared_future<void> cleared = clear_done.get_future().share();
+  std::thread thread([&]() {
+    std::vector<SlotRecord> records;
+    pool.get(&records, 10);
+    pool.put(&records);
+    put_done.set_value();
+    cleared.wait();
+  });
+
+  // the records in the magazine of the running thread are kept
+  put_done.get_future().wait();
+  pool.clear();
+  EXPECT_EQ(pool.capacity(), 10UL);
+
+  // and go to the depot when the thread exits
+  clear_done.set_value();
+  thread.join();
+  EXPECT_EQ(pool.capacity(), 10UL);
+  pool.clear();
+  EXPECT_EQ(pool.capacity(), 0UL);
+  EXPECT_EQ(pool.stat().freed, 10UL);
+}
+
+}  // namespace framework
+}  // namespace paddle
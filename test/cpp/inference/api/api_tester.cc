@@ -71,6 +71,14 @@ TEST(paddle_inference_api, demo) {
   predictor->TryShrinkMemory();
 }
 
+TEST(paddle_inference_api, async_run_unsupported) {
+  DemoConfig config;
+  auto predictor = CreatePaddlePredictor(config);
+  EXPECT_EQ(predictor->GetAsyncInputTensor("x", 0), nullptr);
+  EXPECT_EQ(predictor->GetAsyncOutputTensor("y", 0), nullptr);
+  EXPECT_FALSE(predictor->RunAsync(0).get());
+}
+
 TEST(paddle_inference_api, get_version) {
   LOG(INFO) << "paddle version:\n" << get_version();
   auto version = get_version();
@@ -0,0 +1,171 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/paddle_batching_predictor.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace paddle {
+
+/*
+ * Sums every row of the input x of shape [batch, length] into the output y
+ * of shape [batch, 1], and records the batch sizes it runs.
+ */
+class SumPredictor : public PaddlePredictor {
+ public:
+  struct Record {
+    std::mutex mutex;
+    std::vector<int> batch_sizes;
+  };
+
+  explicit SumPredictor(std::shared_ptr<Record> record)
+      : record_(std::move(record)) {}
+
+  bool Run(const std::vector<PaddleTensor> &inputs,
+           std::vector<PaddleTensor> *output_data,
+           int batch_size = 0) override {
+    const PaddleTensor &x = inputs.at(0);
+    const int rows = x.shape[0];
+    const int cols = x.shape[1];
+    {
+      std::lock_guard<std::mutex> lock(record_->mutex);
+      record_->batch_sizes.push_back(rows);
+    }
+    PaddleTensor y;
+    y.name = "y";
+    y.dtype = PaddleDType::FLOAT32;
+    y.shape = {rows, 1};
+    y.data = PaddleBuf(rows * sizeof(float));
+    const float *x_data = static_cast<const float *>(x.data.data());
+    float *y_data = static_cast<float *>(y.data.data());
+    for (int i = 0; i < rows; ++i) {
+      y_data[i] = 0;
+      for (int j = 0; j < cols; ++j) {
+        y_data[i] += x_data[i * cols + j];
+      }
+    }
+    output_data->clear();
+    output_data->push_back(std::move(y));
+    return true;
+  }
+
+  std::unique_ptr<PaddlePredictor> Clone(void *stream = nullptr) override {
+    return std::make_unique<SumPredictor>(record_);
+  }
+
+ private:
+  std::shared_ptr<Record> record_;
+};
+
+std::vector<PaddleTensor> MakeRequest(int length, float value) {
+  PaddleTensor x;
+  x.name = "x";
+  x.dtype = PaddleDType::FLOAT32;
+  x.shape = {1, length};
+  x.data = PaddleBuf(length * sizeof(float));
+  float *data = static_cast<float *>(x.data.data());
+  for (int i = 0; i < length; ++i) {
+    data[i] = value;
+  }
+  std::vector<PaddleTensor> inputs;
+  inputs.push_back(std::move(x));
+  return inputs;
+}
+
+float GetResult(std::future<std::vector<PaddleTensor>> *future) {
+  auto outputs = future->get();
+  EXPECT_EQ(outputs.size(), 1UL);
+  EXPECT_EQ(outputs[0].shape, std::vector<int>({1, 1}));
+  return *static_cast<const float *>(outputs[0].data.data());
+}
+
+TEST(BatchingPredictor, FullBatch) {
+  auto record = std::make_shared<SumPredictor::Record>();
+  BatchingConfig config;
+  config.max_batch_size = 4;
+  config.batch_timeout_us = 60 * 1000 * 1000;
+  config.num_predictors = 2;
+  BatchingPredictor predictor(std::make_unique<SumPredictor>(record), config);
+
+  std::vector<std::future<std::vector<PaddleTensor>>> futures;
+  for (int i = 0; i < 8; ++i) {
+    futures.push_back(predictor.Run(MakeRequest(3, i)));
+  }
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(GetResult(&futures[i]), 3.0f * i);
+  }
+  EXPECT_EQ(record->batch_sizes, std::vector<int>({4, 4}));
+
+  BatchingStats stats = predictor.GetStats();
+  EXPECT_EQ(stats.num_requests, 8UL);
+  EXPECT_EQ(stats.num_batches, 2UL);
+  EXPECT_DOUBLE_EQ(stats.AvgBatchFill(), 1.0);
+}
+
+TEST(BatchingPredictor, Timeout) {
+  auto record = std::make_shared<SumPredictor::Record>();
+  BatchingConfig config;
+  config.max_batch_size = 8;
+  config.batch_timeout_us = 100 * 1000;
+  BatchingPredictor predictor(std::make_unique<SumPredictor>(record), config);
+
+  std::vector<std::future<std::vector<PaddleTensor>>> futures;
+  for (int i = 0; i < 3; ++i) {
+    futures.push_back(predictor.Run(MakeRequest(2, 1)));
+  }
+  for (auto &future : futures) {
+    EXPECT_EQ(GetResult(&future), 2.0f);
+  }
+
+  BatchingStats stats = predictor.GetStats();
+  EXPECT_EQ(stats.num_requests, 3UL);
+  EXPECT_EQ(stats.num_batches, 1UL);
+  EXPECT_DOUBLE_EQ(stats.AvgBatchFill(), 3.0 / 8);
+  EXPECT_GT(stats.max_queue_delay_us, 0);
+}
+
+TEST(BatchingPredictor, ShapeBuckets) {
+  auto record = std::make_shared<SumPredictor::Record>();
+  BatchingConfig config;
+  config.max_batch_size = 8;
+  config.batch_timeout_us = 100 * 1000;
+  config.shape_buckets["x"] = {4, 8};
+  BatchingPredictor predictor(std::make_unique<SumPredictor>(record), config);
+
+  // Lengths 3 and 4 are padded to 4 and batched together, length 6 is padded
+  // to 8 and runs in a batch of its own.
+  auto short_a = predictor.Run(MakeRequest(3, 1));
+  auto long_a = predictor.Run(MakeRequest(6, 1));
+  auto short_b = predictor.Run(MakeRequest(4, 2));
+  EXPECT_EQ(GetResult(&short_a), 3.0f);
+  EXPECT_EQ(GetResult(&long_a), 6.0f);
+  EXPECT_EQ(GetResult(&short_b), 8.0f);
+  EXPECT_EQ(record->batch_sizes, std::vector<int>({2, 1}));
+}
+
+TEST(BatchingPredictor, InvalidRequest) {
+  BatchingConfig config;
+  BatchingPredictor predictor(
+      std::make_unique<SumPredictor>(std::make_shared<SumPredictor::Record>()),
+      config);
+  auto inputs = MakeRequest(2, 1);
+  inputs[0].shape = {2, 1};
+  EXPECT_ANY_THROW(predictor.Run(std::move(inputs)));
+}
+
+}  // namespace paddle
@@ -0,0 +1,79 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/shared_weight_registry.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "paddle/common/ddim.h"
+#include "paddle/phi/common/place.h"
+
+namespace paddle {
+namespace inference {
+
+std::unique_ptr<phi::DenseTensor> MakeWeight(float value) {
+  auto tensor = std::make_unique<phi::DenseTensor>();
+  tensor->Resize(common::make_ddim({2, 3}));
+  float* data = tensor->mutable_data<float>(phi::CPUPlace());
+  for (int i = 0; i < 6; ++i) {
+    data[i] = value;
+  }
+  return tensor;
+}
+
+TEST(SharedWeightRegistry, Share) {
+  auto& registry = SharedWeightRegistry::Instance();
+  std::string model = SharedWeightRegistry::ModelKey("a", "b", true);
+
+  auto first = MakeWeight(1);
+  auto same = MakeWeight(1);
+  auto changed = MakeWeight(2);
+  EXPECT_FALSE(registry.Share(model, "w", first.get()));
+  EXPECT_TRUE(registry.Share(model, "w", same.get()));
+  EXPECT_EQ(same->data(), first->data());
+  EXPECT_FALSE(registry.Share(model, "w", changed.get()));
+  EXPECT_NE(changed->data(), first->data());
+
+  // Another model or weight name is never shared.
+  std::string other_model = SharedWeightRegistry::ModelKey("c", "b", true);
+  auto other = MakeWeight(1);
+  EXPECT_FALSE(registry.Share(other_model, "w", other.get()));
+  EXPECT_FALSE(registry.Share(model, "v", other.get()));
+  EXPECT_NE(other->data(), first->data());
+}
+
+TEST(SharedWeightRegistry, Release) {
+  auto& registry = SharedWeightRegistry::Instance();
+  std::string model = SharedWeightRegistry::ModelKey("d", "e", true);
+  size_t size = registry.Size();
+
+  auto first = MakeWeight(1);
+  auto second = MakeWeight(1);
+  EXPECT_FALSE(registry.Share(model, "w", first.get()));
+  EXPECT_TRUE(registry.Share(model, "w", second.get()));
+  EXPECT_EQ(registry.Size(), size + 1);
+
+  // The weight lives as long as a predictor holds it.
+  first.reset();
+  EXPECT_EQ(registry.Size(), size + 1);
+  second.reset();
+  EXPECT_EQ(registry.Size(), size);
+
+  auto third = MakeWeight(1);
+  EXPECT_FALSE(registry.Share(model, "w", third.get()));
+}
+
+}  // namespace inference
+}  // namespace paddle
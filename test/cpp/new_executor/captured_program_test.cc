@@ -0,0 +1,142 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/captured_program.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/pir_interpreter.h"
+#include "paddle/fluid/framework/new_executor/standalone_executor.h"
+#include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
+#include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
+#include "paddle/fluid/pir/transforms/pd_op_to_kernel_pass.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/pir/include/core/builder.h"
+#include "paddle/pir/include/core/builtin_op.h"
+#include "paddle/pir/include/core/ir_context.h"
+#include "paddle/pir/include/core/program.h"
+
+COMMON_DECLARE_bool(pir_capture_cpu_program);
+COMMON_DECLARE_bool(pir_skip_stable_infer_meta);
+COMMON_DECLARE_bool(enable_pir_in_executor_trace_run);
+
+PD_DECLARE_KERNEL(full, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(sqrt, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+namespace {
+
+// out = sqrt(sqrt(x + y) + x) + y = sqrt(3 + 4) + 5
+std::unique_ptr<pir::Program> BuildKernelProgram(
+    const std::vector<int64_t>& shape, const std::string& out_name) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program(ctx);
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  auto x = builder
+               .Build<paddle::dialect::FullOp>(
+                   shape, 4.0, phi::DataType::FLOAT32, phi::CPUPlace())
+               ->result(0);
+  auto y = builder
+               .Build<paddle::dialect::FullOp>(
+                   shape, 5.0, phi::DataType::FLOAT32, phi::CPUPlace())
+               ->result(0);
+  auto add1 = builder.Build<paddle::dialect::AddOp>(x, y)->result(0);
+  auto sqrt1 = builder.Build<paddle::dialect::SqrtOp>(add1)->result(0);
+  auto add2 = builder.Build<paddle::dialect::AddOp>(sqrt1, x)->result(0);
+  auto sqrt2 = builder.Build<paddle::dialect::SqrtOp>(add2)->result(0);
+  auto out = builder.Build<paddle::dialect::AddOp>(sqrt2, y)->result(0);
+  builder.Build<pir::ShadowOutputOp>(out, out_name);
+  return paddle::dialect::PdOpLowerToKernelPass(&program);
+}
+
+}  // namespace
+
+TEST(CapturedProgram, Run) {
+  // The capture does not need InferMeta to be skipped in interpreted runs.
+  FLAGS_pir_skip_stable_infer_meta = false;
+  FLAGS_pir_capture_cpu_program = true;
+  FLAGS_enable_pir_in_executor_trace_run = true;
+
+  std::string out_name = "captured_program_out";
+  auto kernel_program = BuildKernelProgram({64, 64}, out_name);
+  Scope scope;
+  InterpreterCore core(phi::CPUPlace(), {}, kernel_program->block(), &scope);
+  core.SetSkipGcVars({out_name});
+
+  // The first run captures the program, the others replay it.
+  for (int i = 0; i < 3; ++i) {
+    core.Run({});
+    const Scope* run_scope =
+        core.local_scope() == nullptr ? &scope : core.local_scope();
+    const auto& out_tensor =
+        run_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+    ASSERT_EQ(out_tensor.numel(), 64 * 64);
+    for (int64_t j = 0; j < out_tensor.numel(); ++j) {
+      ASSERT_NEAR(out_tensor.data<float>()[j], std::sqrt(7.0f) + 5.0f, 1e-5);
+    }
+  }
+  auto* interpreter = dynamic_cast<const PirInterpreter*>(core.Impl());
+  ASSERT_NE(interpreter, nullptr);
+  EXPECT_EQ(interpreter->CapturedReplayCount(), 2UL);
+
+  FLAGS_pir_capture_cpu_program = false;
+  FLAGS_enable_pir_in_executor_trace_run = false;
+}
+
+// Reports the executor time per instruction of a batch-1 sized program with
+// and without the captured program.
+TEST(CapturedProgram, ReplayOverhead) {
+  FLAGS_enable_pir_in_executor_trace_run = true;
+  constexpr int kRunNum = 1000;
+  constexpr int kInstrNum = 7;
+
+  for (bool capture : {false, true}) {
+    FLAGS_pir_capture_cpu_program = capture;
+    std::string out_name = "captured_program_overhead_out";
+    auto kernel_program = BuildKernelProgram({1}, out_name);
+    Scope scope;
+    InterpreterCore core(phi::CPUPlace(), {}, kernel_program->block(), &scope);
+    core.SetSkipGcVars({out_name});
+    core.Run({});
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRunNum; ++i) {
+      core.Run({}, /*need_fetch=*/false);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    LOG(INFO) << (capture ? "Captured" : "Interpreted") << " run: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                         .count() /
+                     (kRunNum * kInstrNum)
+              << "ns per instruction";
+  }
+
+  FLAGS_pir_capture_cpu_program = false;
+  FLAGS_enable_pir_in_executor_trace_run = false;
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,137 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/cpu_thread_budget.h"
+
+#include <gtest/gtest.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include <thread>
+
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#if defined(PADDLE_WITH_MKLML)
+#include "paddle/phi/backends/dynload/mklml.h"
+#endif
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+TEST(CpuThreadBudget, Width) {
+  // Four towers of two instructions between a source and a sink.
+  std::map<size_t, std::set<size_t>> downstream = {{0, {1, 2, 3, 4}},
+                                                   {1, {5}},
+                                                   {2, {6}},
+                                                   {3, {7}},
+                                                   {4, {8}},
+                                                   {5, {9}},
+                                                   {6, {9}},
+                                                   {7, {9}},
+                                                   {8, {9}}};
+  phi::CPUContext dev_ctx;
+  CpuThreadBudget budget(16, downstream, 10, &dev_ctx);
+  EXPECT_EQ(budget.InterOpNumThreads(), 4UL);
+  EXPECT_EQ(budget.Width(0), 1UL);
+  EXPECT_EQ(budget.Width(1), 4UL);
+  EXPECT_EQ(budget.Width(5), 4UL);
+  EXPECT_EQ(budget.Width(9), 1UL);
+
+  // The source has all the threads, a tower a quarter of them.
+  EXPECT_EQ(budget.Acquire(0), 16);
+  budget.Release();
+  EXPECT_EQ(budget.Acquire(1), 4);
+  EXPECT_EQ(budget.Acquire(2), 4);
+  budget.Release();
+  budget.Release();
+
+  // The sink shares the threads with the instructions still running.
+  EXPECT_EQ(budget.Acquire(5), 4);
+  EXPECT_EQ(budget.Acquire(9), 8);
+  budget.Release();
+  budget.Release();
+
+  CpuThreadBudget small_budget(2, downstream, 10, &dev_ctx);
+  EXPECT_EQ(small_budget.InterOpNumThreads(), 2UL);
+  EXPECT_EQ(small_budget.Acquire(1), 1);
+  small_budget.Release();
+}
+
+TEST(CpuThreadBudget, IntraOpThreadsGuard) {
+  std::map<size_t, std::set<size_t>> downstream = {{0, {1, 2}}};
+  phi::CPUContext dev_ctx;
+  CpuThreadBudget budget(8, downstream, 3, &dev_ctx);
+  EXPECT_EQ(dev_ctx.GetIntraOpNumThreads(), 0);
+  {
+    IntraOpThreadsGuard guard(&budget, 1);
+    EXPECT_EQ(dev_ctx.GetIntraOpNumThreads(), 4);
+  }
+  EXPECT_EQ(dev_ctx.GetIntraOpNumThreads(), 0);
+}
+
+TEST(CpuThreadBudget, KernelThreads) {
+  std::map<size_t, std::set<size_t>> downstream = {{0, {1, 2}}};
+  phi::CPUContext dev_ctx;
+  CpuThreadBudget budget(8, downstream, 3, &dev_ctx);
+#if defined(_OPENMP)
+  int main_omp_threads = omp_get_max_threads();
+#endif
+
+  // Runs on another thread like an instruction on an interpreter worker, and
+  // checks the threads the OpenMP and MKL routines of a kernel would get.
+  std::thread worker([&]() {
+#if defined(_OPENMP)
+    int unbounded_omp_threads = omp_get_max_threads();
+#endif
+#if defined(PADDLE_WITH_MKLML)
+    int unbounded_mkl_threads = phi::dynload::MKL_Get_Max_Threads();
+#endif
+    {
+      IntraOpThreadsGuard guard(&budget, 1);
+      EXPECT_EQ(dev_ctx.GetIntraOpNumThreads(), 4);
+#if defined(_OPENMP)
+      EXPECT_EQ(omp_get_max_threads(), 4);
+      int team_size = 0;
+#pragma omp parallel
+      {
+#pragma omp single
+        team_size = omp_get_num_threads();
+      }
+      EXPECT_LE(team_size, 4);
+#endif
+#if defined(PADDLE_WITH_MKLML)
+      EXPECT_EQ(phi::dynload::MKL_Get_Max_Threads(), 4);
+#endif
+    }
+#if defined(_OPENMP)
+    EXPECT_EQ(omp_get_max_threads(), unbounded_omp_threads);
+#endif
+#if defined(PADDLE_WITH_MKLML)
+    EXPECT_EQ(phi::dynload::MKL_Get_Max_Threads(), unbounded_mkl_threads);
+#endif
+  });
+  worker.join();
+
+  // The bound is per thread, the other threads are not affected.
+  EXPECT_EQ(dev_ctx.GetIntraOpNumThreads(), 0);
+#if defined(_OPENMP)
+  EXPECT_EQ(omp_get_max_threads(), main_omp_threads);
+#endif
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
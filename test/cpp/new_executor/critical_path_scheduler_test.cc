@@ -0,0 +1,148 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/critical_path_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/standalone_executor.h"
+#include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
+#include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
+#include "paddle/fluid/pir/transforms/pd_op_to_kernel_pass.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/pir/include/core/builder.h"
+#include "paddle/pir/include/core/builtin_op.h"
+#include "paddle/pir/include/core/ir_context.h"
+#include "paddle/pir/include/core/program.h"
+
+COMMON_DECLARE_bool(pir_critical_path_schedule);
+
+PD_DECLARE_KERNEL(full, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(sqrt, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+TEST(CriticalPathScheduler, CriticalPath) {
+  // 0 -> 1 -> 2 -> 3 -> 5
+  // 0 -> 4 -> 5
+  std::map<size_t, std::set<size_t>> downstream = {
+      {0, {1, 4}}, {1, {2}}, {2, {3}}, {3, {5}}, {4, {5}}};
+  CriticalPathScheduler scheduler(downstream, 6);
+  // Unit costs give the depth of the remaining graph.
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(0), 5.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(1), 4.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(4), 2.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(5), 1.0);
+
+  // An expensive instruction 4 makes its branch the critical one.
+  scheduler.SetCosts({1, 1, 1, 1, 10, 1});
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(0), 12.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(1), 4.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(4), 11.0);
+}
+
+TEST(CriticalPathScheduler, Profile) {
+  std::map<size_t, std::set<size_t>> downstream = {{0, {1, 2}}};
+  CriticalPathScheduler scheduler(downstream, 3);
+
+  // The first run is not measured.
+  scheduler.BeginRun();
+  EXPECT_FALSE(scheduler.IsProfiling());
+  scheduler.RecordTask(4000);
+  scheduler.RecordDispatch();
+  scheduler.RecordInline();
+  SchedulingStat stat = scheduler.EndRun(/*wall_us=*/5, /*worker_num=*/2);
+  EXPECT_DOUBLE_EQ(stat.busy_us, 4.0);
+  EXPECT_DOUBLE_EQ(stat.idle_us, 6.0);
+  EXPECT_EQ(stat.dispatched, 1UL);
+  EXPECT_EQ(stat.inlined, 1UL);
+
+  for (int i = 0; i < 3; ++i) {
+    scheduler.BeginRun();
+    EXPECT_TRUE(scheduler.IsProfiling());
+    scheduler.RecordInstruction(0, 100000);
+    scheduler.RecordInstruction(1, 1000);
+    scheduler.RecordInstruction(2, 50000);
+    stat = scheduler.EndRun(100, 2);
+    EXPECT_EQ(stat.dispatched, 0UL);
+  }
+
+  scheduler.BeginRun();
+  EXPECT_FALSE(scheduler.IsProfiling());
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(0), 150.0);
+  EXPECT_DOUBLE_EQ(scheduler.CriticalPath(1), 1.0);
+  EXPECT_TRUE(scheduler.IsTiny(1));
+  EXPECT_FALSE(scheduler.IsTiny(2));
+}
+
+TEST(CriticalPathScheduler, Run) {
+  FLAGS_pir_critical_path_schedule = true;
+
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program(ctx);
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  auto x = builder
+               .Build<paddle::dialect::FullOp>(std::vector<int64_t>{64, 64},
+                                               4.0,
+                                               phi::DataType::FLOAT32,
+                                               phi::CPUPlace())
+               ->result(0);
+  auto y = builder
+               .Build<paddle::dialect::FullOp>(std::vector<int64_t>{64, 64},
+                                               5.0,
+                                               phi::DataType::FLOAT32,
+                                               phi::CPUPlace())
+               ->result(0);
+  // A long branch sqrt(sqrt(x) + y) = sqrt(7) and a short one x + y = 9.
+  auto sqrt1 = builder.Build<paddle::dialect::SqrtOp>(x)->result(0);
+  auto add1 = builder.Build<paddle::dialect::AddOp>(sqrt1, y)->result(0);
+  auto sqrt2 = builder.Build<paddle::dialect::SqrtOp>(add1)->result(0);
+  auto add2 = builder.Build<paddle::dialect::AddOp>(x, y)->result(0);
+  auto out = builder.Build<paddle::dialect::AddOp>(sqrt2, add2)->result(0);
+  std::string out_name = "critical_path_scheduler_out";
+  builder.Build<pir::ShadowOutputOp>(out, out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+  Scope scope;
+  InterpreterCore core(phi::CPUPlace(), {}, kernel_program->block(), &scope);
+  core.SetSkipGcVars({out_name});
+
+  // Runs before, during and after the costs are measured.
+  for (int i = 0; i < 6; ++i) {
+    core.Run({});
+    const Scope* run_scope =
+        core.local_scope() == nullptr ? &scope : core.local_scope();
+    const auto& out_tensor =
+        run_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+    ASSERT_EQ(out_tensor.numel(), 64 * 64);
+    for (int64_t j = 0; j < out_tensor.numel(); ++j) {
+      ASSERT_NEAR(out_tensor.data<float>()[j], std::sqrt(7.0f) + 9.0f, 1e-5);
+    }
+  }
+
+  FLAGS_pir_critical_path_schedule = false;
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
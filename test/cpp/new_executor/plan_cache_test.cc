@@ -0,0 +1,224 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/plan_cache.h"
+
+#include <dirent.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/pir_interpreter.h"
+#include "paddle/fluid/framework/new_executor/standalone_executor.h"
+#include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
+#include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
+#include "paddle/fluid/pir/transforms/pd_op_to_kernel_pass.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/pir/include/core/builder.h"
+#include "paddle/pir/include/core/builtin_op.h"
+#include "paddle/pir/include/core/ir_context.h"
+#include "paddle/pir/include/core/program.h"
+
+COMMON_DECLARE_string(pir_plan_cache_dir);
+
+PD_DECLARE_KERNEL(full, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(sqrt, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+namespace {
+
+CompiledPlan MakePlan(size_t instr_num) {
+  // A chain 0 -> 1 -> ... with a shortcut from every even instruction.
+  CompiledPlan plan;
+  plan.happens_before.assign(instr_num, std::vector<bool>(instr_num, false));
+  for (size_t i = 0; i + 1 < instr_num; ++i) {
+    plan.downstream_map[i].insert(i + 1);
+    if (i % 2 == 0 && i + 2 < instr_num) {
+      plan.downstream_map[i].insert(i + 2);
+    }
+    for (size_t j = i + 1; j < instr_num; ++j) {
+      plan.happens_before[i][j] = true;
+    }
+  }
+  for (size_t i = 0; i < instr_num; ++i) {
+    plan.trace_execute_order.push_back(i);
+  }
+  // Every instruction waits for the last one of the previous step.
+  for (size_t i = 0; i < instr_num; ++i) {
+    plan.waiter_recorders[instr_num + i].insert(instr_num - 1);
+  }
+  return plan;
+}
+
+void ExpectSamePlan(const CompiledPlan& lhs, const CompiledPlan& rhs) {
+  EXPECT_EQ(lhs.downstream_map, rhs.downstream_map);
+  EXPECT_EQ(lhs.happens_before, rhs.happens_before);
+  EXPECT_EQ(lhs.trace_execute_order, rhs.trace_execute_order);
+  EXPECT_EQ(lhs.waiter_recorders, rhs.waiter_recorders);
+}
+
+// Runs out = sqrt(x + y) + x with x = 4 and y = 5 through a new
+// interpreter and scope, as another process would, and returns out.
+std::vector<float> RunProgram(const std::vector<int64_t>& shape,
+                              bool* plan_loaded) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program(ctx);
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+  pir::Builder builder = pir::Builder(ctx, program.block());
+  auto x = builder
+               .Build<paddle::dialect::FullOp>(
+                   shape, 4.0, phi::DataType::FLOAT32, phi::CPUPlace())
+               ->result(0);
+  auto y = builder
+               .Build<paddle::dialect::FullOp>(
+                   shape, 5.0, phi::DataType::FLOAT32, phi::CPUPlace())
+               ->result(0);
+  auto add = builder.Build<paddle::dialect::AddOp>(x, y)->result(0);
+  auto sqrt = builder.Build<paddle::dialect::SqrtOp>(add)->result(0);
+  auto out = builder.Build<paddle::dialect::AddOp>(sqrt, x)->result(0);
+  std::string out_name = "plan_cache_out";
+  builder.Build<pir::ShadowOutputOp>(out, out_name);
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  Scope scope;
+  InterpreterCore core(phi::CPUPlace(), {}, kernel_program->block(), &scope);
+  core.SetSkipGcVars({out_name});
+  core.Run({});
+  auto* interpreter = dynamic_cast<const PirInterpreter*>(core.Impl());
+  EXPECT_NE(interpreter, nullptr);
+  *plan_loaded = interpreter != nullptr && interpreter->CompiledPlanLoaded();
+
+  const Scope* run_scope =
+      core.local_scope() == nullptr ? &scope : core.local_scope();
+  const auto& out_tensor =
+      run_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+  return std::vector<float>(out_tensor.data<float>(),
+                            out_tensor.data<float>() + out_tensor.numel());
+}
+
+std::vector<std::string> ListPlanFiles(const std::string& dir) {
+  std::vector<std::string> paths;
+  DIR* dp = opendir(dir.c_str());
+  if (dp == nullptr) {
+    return paths;
+  }
+  while (struct dirent* entry = readdir(dp)) {
+    std::string name = entry->d_name;
+    if (name.size() > 5 && name.substr(name.size() - 5) == ".plan") {
+      paths.push_back(dir + "/" + name);
+    }
+  }
+  closedir(dp);
+  return paths;
+}
+
+}  // namespace
+
+TEST(PlanCache, Serialize) {
+  // More than one word per row of the happens-before matrix.
+  CompiledPlan plan = MakePlan(70);
+  std::string data = SerializeCompiledPlan(42, plan);
+
+  CompiledPlan loaded;
+  ASSERT_TRUE(DeserializeCompiledPlan(data, 42, 70, &loaded));
+  ExpectSamePlan(plan, loaded);
+
+  // A plan of another key or instruction number is rejected.
+  EXPECT_FALSE(DeserializeCompiledPlan(data, 43, 70, &loaded));
+  EXPECT_FALSE(DeserializeCompiledPlan(data, 42, 71, &loaded));
+  // So is a truncated or corrupted one.
+  std::string truncated = data.substr(0, data.size() - 1);
+  EXPECT_FALSE(DeserializeCompiledPlan(truncated, 42, 70, &loaded));
+  std::string corrupted = data;
+  corrupted[0] = 'X';
+  EXPECT_FALSE(DeserializeCompiledPlan(corrupted, 42, 70, &loaded));
+}
+
+TEST(PlanCache, SaveAndLoad) {
+  char dir_template[] = "/tmp/plan_cache_test_XXXXXX";
+  char* dir = mkdtemp(dir_template);
+  ASSERT_NE(dir, nullptr);
+
+  CompiledPlan plan = MakePlan(5);
+  CompiledPlan loaded;
+  EXPECT_FALSE(LoadCompiledPlan(dir, 7, 5, &loaded));
+  SaveCompiledPlan(dir, 7, plan);
+  ASSERT_TRUE(LoadCompiledPlan(dir, 7, 5, &loaded));
+  ExpectSamePlan(plan, loaded);
+  EXPECT_FALSE(LoadCompiledPlan(dir, 8, 5, &loaded));
+
+  std::string path = std::string(dir) + "/0000000000000007.plan";
+  EXPECT_EQ(std::remove(path.c_str()), 0);
+  EXPECT_EQ(std::remove(dir), 0);
+}
+
+TEST(PlanCache, PirInterpreter) {
+  char dir_template[] = "/tmp/plan_cache_interpreter_test_XXXXXX";
+  char* dir = mkdtemp(dir_template);
+  ASSERT_NE(dir, nullptr);
+  FLAGS_pir_plan_cache_dir = dir;
+  const float expect = std::sqrt(9.0f) + 4.0f;
+
+  // The first run analyses the program and saves the plan, the second one
+  // loads it instead of analysing.
+  bool plan_loaded = true;
+  std::vector<float> analysed = RunProgram({8, 8}, &plan_loaded);
+  EXPECT_FALSE(plan_loaded);
+  ASSERT_EQ(ListPlanFiles(dir).size(), 1UL);
+  std::vector<float> loaded = RunProgram({8, 8}, &plan_loaded);
+  EXPECT_TRUE(plan_loaded);
+  EXPECT_EQ(analysed, loaded);
+  ASSERT_EQ(analysed.size(), 64UL);
+  for (float value : analysed) {
+    EXPECT_NEAR(value, expect, 1e-5);
+  }
+
+  // Another program has another key, it does not load the first plan.
+  std::vector<float> other = RunProgram({4, 4}, &plan_loaded);
+  EXPECT_FALSE(plan_loaded);
+  EXPECT_EQ(other, std::vector<float>(16, analysed[0]));
+  ASSERT_EQ(ListPlanFiles(dir).size(), 2UL);
+
+  // A damaged plan is ignored: the program is analysed again, runs the
+  // same, and the plan is saved again.
+  for (const std::string& path : ListPlanFiles(dir)) {
+    std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+    fout << "not a compiled plan";
+  }
+  std::vector<float> reanalysed = RunProgram({8, 8}, &plan_loaded);
+  EXPECT_FALSE(plan_loaded);
+  EXPECT_EQ(analysed, reanalysed);
+  RunProgram({8, 8}, &plan_loaded);
+  EXPECT_TRUE(plan_loaded);
+
+  FLAGS_pir_plan_cache_dir = "";
+  for (const std::string& path : ListPlanFiles(dir)) {
+    EXPECT_EQ(std::remove(path.c_str()), 0);
+  }
+  EXPECT_EQ(std::remove(dir), 0);
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <string>
 
@@ -37,6 +38,8 @@
 #include "paddle/pir/include/dialect/control_flow/ir/cf_dialect.h"
 #include "paddle/pir/include/dialect/control_flow/ir/cf_op.h"
 
+COMMON_DECLARE_bool(pir_skip_stable_infer_meta);
+
 DECLARE_FILE_SYMBOLS(kernel_dialect);
 
 PD_DECLARE_KERNEL(full, CPU, ALL_LAYOUT);
@@ -45,6 +48,7 @@ PD_DECLARE_KERNEL(uniform, CPU, ALL_LAYOUT);
 PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
 PD_DECLARE_KERNEL(sqrt, CPU, ALL_LAYOUT);
 PD_DECLARE_KERNEL(less_than, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(reshape, CPU, ALL_LAYOUT);
 
 bool simple_cmp(float a, float b) { return std::abs((a - b) / a) < 1e-5; }
 
@@ -343,5 +347,95 @@ TEST(StandaloneExecutor, while_op) {
   EXPECT_EQ(res0, true);
 }
 
+TEST(StandaloneExecutor, skip_stable_infer_meta) {
+  FLAGS_pir_skip_stable_infer_meta = true;
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program(ctx);
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  pir::OpInfo feed_op_info =
+      ctx->GetRegisteredOpInfo(paddle::dialect::FeedOp::name());
+  pir::Type dense_tensor_dtype =
+      paddle::dialect::DenseTensorType::get(ctx,
+                                            pir::Float32Type::get(ctx),
+                                            phi::DDim({1}),
+                                            phi::DataLayout::NCHW,
+                                            phi::LoD({{0}}),
+                                            0);
+  std::vector<pir::Value> feeds;
+  for (std::string name : {"x", "y"}) {
+    pir::AttributeMap attr_map;
+    attr_map["name"] = pir::StrAttribute::get(ctx, name);
+    attr_map["col"] = pir::Int32Attribute::get(ctx, 0);
+    pir::Operation* feed_op = pir::Operation::Create(
+        {}, attr_map, {dense_tensor_dtype}, feed_op_info);
+    program.block()->push_back(feed_op);
+    feeds.push_back(feed_op->result(0));
+  }
+
+  // sqrt_ writes its input in place, and reshape reads its shape from a
+  // tensor in InferMeta
+  auto add_out =
+      builder.Build<paddle::dialect::AddOp>(feeds[0], feeds[1])->result(0);
+  auto sqrt_out = builder.Build<paddle::dialect::Sqrt_Op>(add_out)->result(0);
+  auto reshape_out = builder
+                         .Build<paddle::dialect::ReshapeOp>(
+                             sqrt_out, std::vector<int64_t>{-1, 1})
+                         ->result(0);
+  builder.Build<pir::ShadowOutputOp>(sqrt_out, "sqrt_out");
+  builder.Build<pir::ShadowOutputOp>(reshape_out, "reshape_out");
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+  Scope scope;
+  InterpreterCore test_core(
+      phi::CPUPlace(), {}, kernel_program->block(), &scope);
+  test_core.SetSkipGcVars({"sqrt_out", "reshape_out"});
+  auto* interpreter = dynamic_cast<const PirInterpreter*>(test_core.Impl());
+  ASSERT_NE(interpreter, nullptr);
+
+  phi::DeviceContext* dev_ctx =
+      phi::DeviceContextPool::Instance().Get(phi::CPUPlace());
+  auto run = [&](int64_t numel, float value) {
+    phi::DenseTensor tensor;
+    tensor.Resize(phi::DDim({numel}));
+    dev_ctx->Alloc<float>(&tensor);
+    for (int64_t i = 0; i < numel; ++i) {
+      tensor.data<float>()[i] = value;
+    }
+    test_core.Run({"x", "y"}, {tensor, tensor});
+
+    Scope* run_scope =
+        test_core.local_scope() == nullptr ? &scope : test_core.local_scope();
+    const auto& sqrt_tensor =
+        run_scope->FindVar("sqrt_out")->Get<phi::DenseTensor>();
+    const auto& reshape =
+        run_scope->FindVar("reshape_out")->Get<phi::DenseTensor>();
+    ASSERT_EQ(sqrt_tensor.dims(), phi::DDim({numel}));
+    ASSERT_EQ(reshape.dims(), phi::DDim({numel, 1}));
+    float expected = std::sqrt(2 * value);
+    for (int64_t i = 0; i < numel; ++i) {
+      ASSERT_TRUE(simple_cmp(sqrt_tensor.data<float>()[i], expected));
+      ASSERT_TRUE(simple_cmp(reshape.data<float>()[i], expected));
+    }
+  };
+
+  run(2, 2.0);
+  auto [skipped1, executed1] = interpreter->InferMetaStat();
+  // same input metas, the InferMeta of add and sqrt_ are skipped, but not
+  // that of reshape
+  run(2, 8.0);
+  auto [skipped2, executed2] = interpreter->InferMetaStat();
+  EXPECT_GT(skipped2, skipped1);
+  EXPECT_GT(executed2, executed1);
+  // a new input shape runs every InferMeta again
+  run(3, 2.0);
+  auto [skipped3, executed3] = interpreter->InferMetaStat();
+  EXPECT_GT(executed3 - executed2, executed2 - executed1);
+  EXPECT_LE(skipped3 - skipped2, skipped2 - skipped1);
+
+  FLAGS_pir_skip_stable_infer_meta = false;
+}
+
 }  // namespace framework
 }  // namespace paddle
@@ -0,0 +1,164 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/pir_interpreter.h"
+#include "paddle/fluid/framework/new_executor/standalone_executor.h"
+#include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
+#include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
+#include "paddle/fluid/pir/transforms/pd_op_to_kernel_pass.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/pir/include/core/builder.h"
+#include "paddle/pir/include/core/builtin_op.h"
+#include "paddle/pir/include/core/ir_context.h"
+#include "paddle/pir/include/core/program.h"
+
+COMMON_DECLARE_bool(pir_static_memory_plan);
+COMMON_DECLARE_bool(enable_pir_in_executor_trace_run);
+
+PD_DECLARE_KERNEL(full, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(sqrt, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+namespace {
+
+bool Overlaps(const MemoryBlock& a, const MemoryBlock& b, size_t alignment) {
+  auto end = [alignment](const MemoryBlock& block) {
+    return block.offset +
+           (block.bytes + alignment - 1) / alignment * alignment;
+  };
+  bool live_together = !(a.last_use < b.def || b.last_use < a.def);
+  bool share_memory = a.offset < end(b) && b.offset < end(a);
+  return live_together && share_memory;
+}
+
+}  // namespace
+
+TEST(StaticMemoryPlan, AssignMemoryOffsets) {
+  // A chain of tensors, each used only by the next instruction.
+  std::vector<MemoryBlock> blocks;
+  for (size_t i = 0; i < 8; ++i) {
+    blocks.push_back(MemoryBlock{i, i, i + 1, 1000});
+  }
+  size_t arena_size = AssignMemoryOffsets(&blocks, 256);
+  // Two buffers are enough for a chain.
+  EXPECT_EQ(arena_size, 2048UL);
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    EXPECT_EQ(blocks[i].offset % 256, 0UL);
+    for (size_t j = i + 1; j < blocks.size(); ++j) {
+      EXPECT_FALSE(Overlaps(blocks[i], blocks[j], 256));
+    }
+  }
+}
+
+TEST(StaticMemoryPlan, AssignMemoryOffsetsBestFit) {
+  // When block 5 is placed, blocks 1 and 3 are dead, leaving gaps of 2048
+  // and 1024 bytes between the live blocks 0, 2 and 4.
+  std::vector<MemoryBlock> blocks = {
+      MemoryBlock{0, 0, 10, 4096},
+      MemoryBlock{1, 0, 2, 2048},
+      MemoryBlock{2, 0, 10, 1024},
+      MemoryBlock{3, 0, 2, 1024},
+      MemoryBlock{4, 0, 10, 1024},
+      MemoryBlock{5, 3, 10, 1024},
+  };
+  size_t arena_size = AssignMemoryOffsets(&blocks, 256);
+  // Block 5 takes the smallest gap that fits it.
+  EXPECT_EQ(blocks[5].offset, blocks[3].offset);
+  EXPECT_EQ(arena_size, 9216UL);
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    for (size_t j = i + 1; j < blocks.size(); ++j) {
+      EXPECT_FALSE(Overlaps(blocks[i], blocks[j], 256));
+    }
+  }
+}
+
+TEST(StaticMemoryPlan, Run) {
+  FLAGS_pir_static_memory_plan = true;
+  FLAGS_enable_pir_in_executor_trace_run = true;
+
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program(ctx);
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  auto x = builder
+               .Build<paddle::dialect::FullOp>(std::vector<int64_t>{64, 64},
+                                               4.0,
+                                               phi::DataType::FLOAT32,
+                                               phi::CPUPlace())
+               ->result(0);
+  auto y = builder
+               .Build<paddle::dialect::FullOp>(std::vector<int64_t>{64, 64},
+                                               5.0,
+                                               phi::DataType::FLOAT32,
+                                               phi::CPUPlace())
+               ->result(0);
+  // out = sqrt(sqrt(x + y) + x) + y = sqrt(3 + 4) + 5
+  auto add1 = builder.Build<paddle::dialect::AddOp>(x, y)->result(0);
+  auto sqrt1 = builder.Build<paddle::dialect::SqrtOp>(add1)->result(0);
+  auto add2 = builder.Build<paddle::dialect::AddOp>(sqrt1, x)->result(0);
+  auto sqrt2 = builder.Build<paddle::dialect::SqrtOp>(add2)->result(0);
+  auto out = builder.Build<paddle::dialect::AddOp>(sqrt2, y)->result(0);
+  std::string out_name = "static_memory_plan_out";
+  builder.Build<pir::ShadowOutputOp>(out, out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+  Scope scope;
+  InterpreterCore core(phi::CPUPlace(), {}, kernel_program->block(), &scope);
+  core.SetSkipGcVars({out_name});
+  auto* interpreter = dynamic_cast<const PirInterpreter*>(core.Impl());
+  ASSERT_NE(interpreter, nullptr);
+
+  // The first run records the plan, the others run with it.
+  for (int i = 0; i < 3; ++i) {
+    core.Run({});
+    const StaticMemoryPlanner* planner = interpreter->GetStaticMemoryPlanner();
+    ASSERT_NE(planner, nullptr);
+    if (i == 0) {
+      EXPECT_EQ(planner->BoundNum(), 0UL);
+      EXPECT_EQ(planner->ArenaSize(), 0UL);
+    } else {
+      // At least the four tensors between the full ops and out.
+      EXPECT_GE(planner->BoundNum(), 4UL);
+      EXPECT_GT(planner->ArenaSize(), 0UL);
+    }
+    const Scope* run_scope =
+        core.local_scope() == nullptr ? &scope : core.local_scope();
+    const auto& out_tensor =
+        run_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+    ASSERT_EQ(out_tensor.numel(), 64 * 64);
+    for (int64_t j = 0; j < out_tensor.numel(); ++j) {
+      ASSERT_NEAR(out_tensor.data<float>()[j], std::sqrt(7.0f) + 5.0f, 1e-5);
+    }
+  }
+
+  FLAGS_pir_static_memory_plan = false;
+  FLAGS_enable_pir_in_executor_trace_run = false;
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
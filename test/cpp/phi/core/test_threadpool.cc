@@ -0,0 +1,314 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "paddle/phi/core/threadpool.h"
+#include "paddle/phi/core/utils/work_stealing_deque.h"
+#include "test/cpp/phi/core/timer.h"
+
+namespace phi {
+namespace tests {
+
+TEST(WorkStealingDeque, OwnerIsLifoThiefIsFifo) {
+  WorkStealingDeque<int> deque(2);
+  int items[5] = {0, 1, 2, 3, 4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(deque.Push(&items[i]));
+  }
+  EXPECT_FALSE(deque.Push(&items[4]));
+  EXPECT_EQ(deque.Steal(), &items[0]);
+  EXPECT_EQ(deque.Pop(), &items[3]);
+  EXPECT_EQ(deque.Pop(), &items[2]);
+  EXPECT_EQ(deque.Steal(), &items[1]);
+  EXPECT_EQ(deque.Pop(), nullptr);
+  EXPECT_EQ(deque.Steal(), nullptr);
+  EXPECT_TRUE(deque.Empty());
+}
+
+TEST(WorkStealingDeque, ConcurrentSteal) {
+  const int n = 100000;
+  WorkStealingDeque<int> deque(8);
+  std::vector<int> items(n);
+  std::vector<std::atomic<int>> taken(n);
+  for (auto& t : taken) {
+    t = 0;
+  }
+  std::atomic<bool> done(false);
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 4; ++i) {
+    thieves.emplace_back([&]() {
+      while (!done || !deque.Empty()) {
+        if (int* item = deque.Steal()) {
+          taken[item - items.data()]++;
+        }
+      }
+    });
+  }
+  for (int i = 0; i < n; ++i) {
+    while (!deque.Push(&items[i])) {
+      if (int* item = deque.Pop()) {
+        taken[item - items.data()]++;
+      }
+    }
+  }
+  while (int* item = deque.Pop()) {
+    taken[item - items.data()]++;
+  }
+  done = true;
+  for (auto& t : thieves) {
+    t.join();
+  }
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(taken[i], 1);
+  }
+}
+
+TEST(ThreadPool, SingleThreadKeepsOrder) {
+  ThreadPool pool(1);
+  std::vector<int> order;
+  std::vector<std::future<void>> fs;
+  for (int i = 0; i < 100; ++i) {
+    fs.push_back(pool.Run([&order, i]() { order.push_back(i); }));
+  }
+  for (auto& f : fs) {
+    f.wait();
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(ThreadPool, NestedRun) {
+  ThreadPool pool(4);
+  std::atomic<int> sum(0);
+  auto outer = pool.Run([&]() {
+    std::vector<std::future<void>> fs;
+    for (int i = 0; i < 100; ++i) {
+      fs.push_back(pool.Run([&sum]() { sum++; }));
+    }
+    for (auto& f : fs) {
+      f.wait();
+    }
+  });
+  outer.wait();
+  EXPECT_EQ(sum, 100);
+}
+
+TEST(ThreadPool, RunAndGetException) {
+  ThreadPool pool(2);
+  auto f = pool.RunAndGetException([]() {
+    PADDLE_THROW(phi::errors::InvalidArgument("expected error"));
+  });
+  auto ex = f.get();
+  ASSERT_NE(ex, nullptr);
+  EXPECT_NE(std::string(ex->what()).find("expected error"),
+            std::string::npos);
+
+  auto g =
+      pool.Run([]() { PADDLE_THROW(phi::errors::InvalidArgument("error")); });
+  EXPECT_THROW(g.get(), common::enforce::EnforceNotMet);
+}
+
+TEST(ThreadPool, RunFutureIsNotDeferred) {
+  ThreadPool pool(1);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  auto f = pool.Run([released]() { released.wait(); });
+  EXPECT_EQ(f.wait_for(std::chrono::milliseconds(0)),
+            std::future_status::timeout);
+  release.set_value();
+  EXPECT_EQ(f.wait_for(std::chrono::seconds(60)), std::future_status::ready);
+  f.get();
+}
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  for (int64_t grain : {1, 7, 1000, 5000}) {
+    std::vector<int> hits(4096, 0);
+    pool.ParallelFor(0, hits.size(), grain, [&hits](int64_t i) { hits[i]++; });
+    for (int hit : hits) {
+      EXPECT_EQ(hit, 1);
+    }
+  }
+  // Empty range.
+  pool.ParallelFor(5, 5, 1, [](int64_t i) { FAIL(); });
+
+  // Nested inside a task of the same pool must not deadlock.
+  std::atomic<int64_t> sum(0);
+  pool.Run([&]() {
+        pool.ParallelFor(0, 1000, 1, [&sum](int64_t i) { sum += i; });
+      })
+      .wait();
+  EXPECT_EQ(sum, 999 * 1000 / 2);
+
+  EXPECT_THROW(pool.ParallelFor(0,
+                                100,
+                                1,
+                                [](int64_t i) {
+                                  if (i == 42) {
+                                    PADDLE_THROW(
+                                        phi::errors::InvalidArgument("42"));
+                                  }
+                                }),
+               common::enforce::EnforceNotMet);
+}
+
+// SingleQueuePool mirrors the previous design of phi::ThreadPool, one queue
+// behind one mutex, and is kept here as the baseline of the benchmark.
+class SingleQueuePool {
+ public:
+  explicit SingleQueuePool(int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this]() {
+        while (true) {
+          std::packaged_task<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            scheduled_.wait(lock,
+                            [this] { return !tasks_.empty() || !running_; });
+            if (!running_ && tasks_.empty()) {
+              return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+          }
+          task();
+        }
+      });
+    }
+  }
+
+  ~SingleQueuePool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    scheduled_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  template <typename Callback>
+  std::future<void> Run(Callback fn) {
+    std::packaged_task<void()> task(fn);
+    auto f = task.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push(std::move(task));
+    }
+    scheduled_.notify_one();
+    return std::async(std::launch::deferred, [f = std::move(f)]() mutable {
+      f.get();
+    });
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::queue<std::packaged_task<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable scheduled_;
+  bool running_{true};
+};
+
+template <typename Pool>
+double RunTinyTasks(Pool* pool, int num_producers, int tasks_per_producer) {
+  std::atomic<int64_t> sum(0);
+  Timer timer;
+  timer.tic();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&]() {
+      std::vector<std::future<void>> fs;
+      fs.reserve(tasks_per_producer);
+      for (int i = 0; i < tasks_per_producer; ++i) {
+        fs.push_back(pool->Run([&sum]() { sum++; }));
+      }
+      for (auto& f : fs) {
+        f.wait();
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  double used = timer.toc();
+  EXPECT_EQ(sum, static_cast<int64_t>(num_producers) * tasks_per_producer);
+  return used;
+}
+
+TEST(ThreadPool, Benchmark) {
+  const int num_threads =
+      std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+  const int num_producers = 8;
+  const int tasks_per_producer = 20000;
+
+  double single_queue = 0, work_stealing = 0;
+  {
+    SingleQueuePool pool(num_threads);
+    single_queue = RunTinyTasks(&pool, num_producers, tasks_per_producer);
+  }
+  {
+    ThreadPool pool(num_threads);
+    work_stealing = RunTinyTasks(&pool, num_producers, tasks_per_producer);
+  }
+  LOG(INFO) << "Run " << num_producers * tasks_per_producer
+            << " tiny tasks on " << num_threads
+            << " threads: single queue pool " << single_queue
+            << "ms, work stealing pool " << work_stealing << "ms.";
+
+  const int64_t n = 1 << 20;
+  std::vector<float> data(n, 1.0f);
+  double futures = 0, parallel_for = 0;
+  Timer timer;
+  {
+    SingleQueuePool pool(num_threads);
+    timer.tic();
+    std::vector<std::future<void>> fs;
+    for (int64_t i = 0; i < n; i += 1024) {
+      fs.push_back(pool.Run([&data, i]() {
+        for (int64_t j = i; j < i + 1024; ++j) {
+          data[j] = data[j] * 2.0f + 1.0f;
+        }
+      }));
+    }
+    for (auto& f : fs) {
+      f.wait();
+    }
+    futures = timer.toc();
+  }
+  {
+    ThreadPool pool(num_threads);
+    timer.tic();
+    pool.ParallelFor(
+        0, n, 1024, [&data](int64_t i) { data[i] = data[i] * 2.0f + 1.0f; });
+    parallel_for = timer.toc();
+  }
+  LOG(INFO) << "Loop over " << n << " floats: one future per 1024 items "
+            << futures << "ms, ParallelFor " << parallel_for << "ms.";
+}
+
+}  // namespace tests
+}  // namespace phi
@@ -160,6 +160,66 @@ TEST(AnalysisPredictor, ZeroCopy) {
   predictor->TryShrinkMemory();
 }
 
+TEST(AnalysisPredictor, RunAsync) {
+  AnalysisConfig config;
+  config.SetModel(FLAGS_dirname);
+  auto predictor = CreatePaddlePredictor<AnalysisConfig>(config);
+  const std::vector<std::string> input_names = {
+      "firstw", "secondw", "thirdw", "forthw"};
+  const std::string output_name = "fc_1.tmp_2";
+  std::vector<std::vector<int64_t>> batches = {
+      {0, 1, 2, 3}, {4, 5, 6, 7}, {8, 9, 10, 11}};
+
+  auto get_output = [](ZeroCopyTensor* out) {
+    auto shape = out->shape();
+    int num = std::accumulate(
+        shape.begin(), shape.end(), 1, std::multiplies<int>());
+    std::vector<float> data(num);
+    out->copy_to_cpu(data.data());
+    return data;
+  };
+
+  // the outputs of synchronous runs, before any async run is pending
+  std::vector<std::vector<float>> expected;
+  for (auto& batch : batches) {
+    for (auto& name : input_names) {
+      auto input = predictor->GetInputTensor(name);
+      input->Reshape({4, 1});
+      input->copy_from_cpu(batch.data());
+    }
+    ASSERT_TRUE(predictor->ZeroCopyRun());
+    expected.push_back(
+        get_output(predictor->GetOutputTensor(output_name).get()));
+  }
+
+  auto fill_buffer = [&](int buffer_id, const std::vector<int64_t>& batch) {
+    for (auto& name : input_names) {
+      auto input = predictor->GetAsyncInputTensor(name, buffer_id);
+      input->Reshape({4, 1});
+      input->copy_from_cpu(batch.data());
+    }
+  };
+
+  // fill both buffers, and overlap the two runs
+  fill_buffer(0, batches[0]);
+  fill_buffer(1, batches[1]);
+  auto run0 = predictor->RunAsync(0);
+  auto run1 = predictor->RunAsync(1);
+  ASSERT_TRUE(run0.get());
+  EXPECT_EQ(get_output(predictor->GetAsyncOutputTensor(output_name, 0).get()),
+            expected[0]);
+  // refill buffer 0 while buffer 1 may still run
+  fill_buffer(0, batches[2]);
+  auto run2 = predictor->RunAsync(0);
+  ASSERT_TRUE(run1.get());
+  ASSERT_TRUE(run2.get());
+
+  EXPECT_EQ(get_output(predictor->GetAsyncOutputTensor(output_name, 1).get()),
+            expected[1]);
+  EXPECT_EQ(get_output(predictor->GetAsyncOutputTensor(output_name, 0).get()),
+            expected[2]);
+}
+
 TEST(AnalysisPredictor, CollectShapeRangeInfo) {
   AnalysisConfig config;
   config.SetModel(FLAGS_dirname);
@@ -195,6 +195,43 @@ class TestSimpleParamSaveLoad(unittest.TestCase):
                     paddle.framework._current_expected_place_(),
                 )
 
+                # test save_mmap_combine_func and load_combine_func
+                mmap_path = os.path.join(save_dir, 'demo_mmap.pdiparams')
+                param_vec = list(param_dict.values())
+                paddle.base.core.save_mmap_combine_func(
+                    param_vec, list(param_dict.keys()), mmap_path, True
+                )
+                param_new = []
+                for tensor in param_vec:
+                    new_tensor = paddle.base.core.LoDTensor()
+                    new_tensor.set(np.zeros_like(np.array(tensor)), self.place)
+                    param_new.append(new_tensor)
+                paddle.base.core.load_combine_func(
+                    mmap_path,
+                    list(param_dict.keys()),
+                    param_new,
+                    False,
+                    paddle.framework._current_expected_place_(),
+                )
+                for new_tensor, tensor in zip(param_new, param_vec):
+                    np.testing.assert_array_equal(
+                        np.array(new_tensor), np.array(tensor)
+                    )
+
+                # tensors are loaded by name, whatever order they are saved in
+                param_new.reverse()
+                paddle.base.core.load_combine_func(
+                    mmap_path,
+                    list(reversed(param_dict.keys())),
+                    param_new,
+                    False,
+                    paddle.framework._current_expected_place_(),
+                )
+                for new_tensor, tensor in zip(reversed(param_new), param_vec):
+                    np.testing.assert_array_equal(
+                        np.array(new_tensor), np.array(tensor)
+                    )
+
                 # test save_vars
                 path_prefix = os.path.join(save_dir, 'new')
                 params_path = path_prefix + ".pdiparams"
@@ -516,6 +516,181 @@ class TestBlockMultiHeadAttnEncDec(unittest.TestCase):
         )
 
 
+class TestBlockMultiHeadAttnEncDecCPU(unittest.TestCase):
+    def setUp(self):
+        paddle.disable_static()
+        self.name = "TestBlockMultiHeadAttnEncDecCPU"
+        self.place = paddle.CPUPlace()
+        self.batch_size = 2
+        self.num_head = 4
+        self.seq_len = 32
+        self.max_dec_len = 32
+        self.dim_head = 64
+        self.hid_dim = self.num_head * self.dim_head
+        self.blocksize = 16
+        self.block_num_per_seq = (
+            self.seq_len + self.max_dec_len + self.blocksize - 1
+        ) // self.blocksize
+        self.max_block_num = self.block_num_per_seq * self.batch_size
+        self.free_list = list(range(self.max_block_num - 1, -1, -1))
+        self.dtype = 'float32'
+        self.seq_lens_encoder = paddle.to_tensor(
+            [self.seq_len] * self.batch_size, "int32", place=self.place
+        )
+        self.seq_lens_decoder = paddle.to_tensor(
+            [0] * self.batch_size, "int32", place=self.place
+        )
+        self.seq_lens_this_time = self.seq_lens_encoder
+        self.shape = (
+            self.batch_size,
+            self.num_head,
+            self.seq_len,
+            self.dim_head,
+        )
+        self.cache_shape = (
+            self.max_block_num,
+            self.num_head,
+            self.blocksize,
+            self.dim_head,
+        )
+        with paddle.base.dygraph.guard(self.place):
+            self.attention_mask = create_attn_mask(
+                self.dtype, self.batch_size, [self.seq_len] * self.batch_size
+            )
+            self.tgt_mask = paddle.randn(
+                [self.batch_size, self.num_head, 1, self.seq_len + 1],
+                dtype=self.dtype,
+            )
+            self.cache_k = paddle.zeros(
+                shape=self.cache_shape, dtype=self.dtype
+            )
+            self.cache_v = paddle.zeros(
+                shape=self.cache_shape, dtype=self.dtype
+            )
+            self.block_tables = paddle.zeros(
+                shape=(self.batch_size, self.block_num_per_seq), dtype="int32"
+            )
+            for i in range(self.batch_size):
+                for j in range(self.block_num_per_seq):
+                    self.block_tables[i, j] = self.free_list.pop()
+            (
+                self.padding_offset,
+                self.cum_offset,
+                self.cu_seqlens_q,
+                self.cu_seqlens_k,
+            ) = get_padding_offset(
+                self.batch_size, self.seq_len, self.seq_lens_this_time
+            )
+        self.scale = 1.0 / np.sqrt(self.shape[-1])
+        self.token_num = self.padding_offset.shape[0]
+
+    def run_blha(self, qkv, seq_len, tgt_mask):
+        return block_multihead_attention(
+            qkv,
+            self.cache_k,
+            self.cache_v,
+            self.seq_lens_encoder,
+            self.seq_lens_decoder,
+            self.seq_lens_this_time,
+            self.padding_offset,
+            self.cum_offset,
+            self.cu_seqlens_q,
+            self.cu_seqlens_k,
+            self.block_tables,
+            None,  # pre_key_cache
+            None,  # pre_value_cache
+            None,  # cache_k_quant_scales
+            None,  # cache_v_quant_scales
+            None,  # cache_k_dequant_scales
+            None,  # cache_v_dequant_scales
+            None,  # qkv_out_scale
+            None,  # qkv_bias
+            None,  # out_shift
+            None,  # out_smooth
+            None,  # max_enc_len_this_time
+            None,  # max_dec_len_this_time
+            None,  # rotary_embs
+            None,  # attn_mask
+            tgt_mask,  # tgt_mask
+            seq_len,
+            self.blocksize,
+            False,  # use_neox_rotary_style
+        )[0]
+
+    def make_qkv(self, tokens):
+        q, k, v = (
+            paddle.to_tensor(
+                np.random.random(self.shape), place=self.place, dtype=self.dtype
+            )
+            for _ in range(3)
+        )
+        qkv = paddle.stack(
+            [
+                t.transpose([0, 2, 1, 3]).reshape([tokens, self.hid_dim])
+                for t in (q, k, v)
+            ],
+            axis=1,
+        ).reshape([tokens, -1])
+        return q, k, v, qkv
+
+    def test_all(self):
+        with paddle.base.dygraph.guard(self.place):
+            self.check_enc_dec()
+
+    def check_enc_dec(self):
+        # encoder
+        q, k, v, qkv = self.make_qkv(self.token_num)
+        out_ = naive_attention_impl(
+            q, k, v, None, None, None, None, self.attention_mask, self.scale
+        )
+        out_ = remove_padding(
+            self.seq_lens_this_time, self.cu_seqlens_q, out_, self.token_num
+        )
+        out = self.run_blha(qkv, self.seq_len, None)
+        np.testing.assert_allclose(
+            out.numpy(), out_.numpy(), rtol=1e-05, atol=1e-05
+        )
+
+        # decoder
+        naive_cache_k, naive_cache_v = block_cache_to_naive_cache(
+            self.cache_k,
+            self.cache_v,
+            self.batch_size,
+            self.block_tables,
+            self.seq_len,
+        )
+        self.seq_lens_decoder[:] = self.seq_lens_encoder
+        self.seq_lens_encoder[:] = 0
+        self.seq_lens_this_time[:] = 1
+        self.shape = (self.batch_size, self.num_head, 1, self.dim_head)
+        q, k, v, qkv = self.make_qkv(self.batch_size)
+        (
+            self.padding_offset,
+            self.cum_offset,
+            self.cu_seqlens_q,
+            self.cu_seqlens_k,
+        ) = get_padding_offset(self.batch_size, 1, self.seq_lens_this_time)
+        out_ = (
+            naive_attention_impl(
+                q,
+                k,
+                v,
+                naive_cache_k,
+                naive_cache_v,
+                None,
+                None,
+                self.tgt_mask,
+                self.scale,
+            )
+            .transpose([0, 2, 1, 3])
+            .reshape([self.batch_size, -1])
+        )
+        out = self.run_blha(qkv, 1, self.tgt_mask)
+        np.testing.assert_allclose(
+            out.numpy(), out_.numpy(), rtol=1e-05, atol=1e-05
+        )
+
+
 @unittest.skipIf(
     not core.is_compiled_with_cuda()
     or get_cuda_version() < 11040
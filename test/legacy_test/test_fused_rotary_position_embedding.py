@@ -689,5 +689,91 @@ class TestFusedRotaryPositionEmbedding(unittest.TestCase):
         self.assertRaises(AssertionError, test_error2)
 
 
+class TestFusedRotaryPositionEmbeddingCPU(unittest.TestCase):
+    def setUp(self):
+        self.place = paddle.CPUPlace()
+        self.shape_q = [2, 8, 4, 16]
+        self.shape_kv = [2, 8, 2, 16]
+        self.rtol = 1e-5
+        self.atol = 1e-6
+
+    def run_rope(self, rope_function, use_neox_rotary_style, position_ids):
+        paddle.seed(1203)
+        q = paddle.randn(self.shape_q, "float32")
+        k = paddle.randn(self.shape_kv, "float32")
+        v = paddle.randn(self.shape_kv, "float32")
+        grads = [paddle.randn(t.shape, "float32") for t in [q, k, v]]
+        sin, cos = get_sin_cos_tensor(
+            self.shape_q[1],
+            self.shape_q[3],
+            rotate_half=not use_neox_rotary_style,
+        )
+        for t in [q, k, v]:
+            t.stop_gradient = False
+        outs = rope_function(
+            q,
+            k,
+            v,
+            sin,
+            cos,
+            position_ids=position_ids,
+            use_neox_rotary_style=use_neox_rotary_style,
+        )
+        paddle.autograd.backward(list(outs), grads)
+        return [t.numpy() for t in outs] + [
+            t.grad.numpy() for t in [q, k, v]
+        ]
+
+    def check(self, use_neox_rotary_style, position_ids=None):
+        with paddle.base.dygraph.guard(self.place):
+            if position_ids is not None:
+                position_ids = paddle.to_tensor(position_ids)
+            expected = self.run_rope(
+                paddle_fused_rotary_position_embedding,
+                use_neox_rotary_style,
+                position_ids,
+            )
+            actual = self.run_rope(
+                fused_rotary_position_embedding,
+                use_neox_rotary_style,
+                position_ids,
+            )
+        for e, a in zip(expected, actual):
+            np.testing.assert_allclose(e, a, rtol=self.rtol, atol=self.atol)
+
+    def test_rotate_every_two(self):
+        self.check(use_neox_rotary_style=True)
+
+    def test_rotate_half(self):
+        self.check(use_neox_rotary_style=False)
+
+    def test_position_ids(self):
+        self.check(use_neox_rotary_style=True, position_ids=position_ids_list)
+        self.check(use_neox_rotary_style=False, position_ids=position_ids_list)
+
+    def test_without_sin_cos(self):
+        with paddle.base.dygraph.guard(self.place):
+            paddle.seed(1203)
+            q = paddle.randn(self.shape_q, "float32")
+            sin, cos = get_sin_cos_tensor(self.shape_q[1], self.shape_q[3])
+            expected, _, _ = fused_rotary_position_embedding(
+                q, sin=sin, cos=cos
+            )
+            actual, _, _ = fused_rotary_position_embedding(q)
+            # time_major only changes the layout of the inputs and outputs.
+            actual_tm, _, _ = fused_rotary_position_embedding(
+                paddle.transpose(q, [1, 0, 2, 3]), time_major=True
+            )
+            np.testing.assert_allclose(
+                expected.numpy(), actual.numpy(), rtol=self.rtol, atol=1e-5
+            )
+            np.testing.assert_allclose(
+                actual.numpy(),
+                paddle.transpose(actual_tm, [1, 0, 2, 3]).numpy(),
+                rtol=self.rtol,
+                atol=self.atol,
+            )
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,136 @@
+# Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import unittest
+
+import numpy as np
+
+import paddle
+import paddle.nn.quant as Q
+
+np.random.seed(123)
+paddle.seed(123)
+
+
+class WeightOnlyLinearCPUTestCase(unittest.TestCase):
+    def config(self):
+        self.dtype = 'float32'
+        self.weight_dtype = 'int8'
+        self.group_size = -1
+        self.bias = True
+        self.in_features = 128
+        self.out_features = 64
+        self.rtol = 1e-4
+        self.atol = 1e-4
+
+    def setUp(self):
+        self.config()
+        self.place = paddle.CPUPlace()
+
+    def get_weight_dequant(self, weight):
+        # Dequantize the quantized values with numpy, the same rounding as
+        # weight_quantize, so that only the GEMM itself is compared.
+        bound = 127.0 if self.weight_dtype == 'int8' else 7.0
+        k, n = weight.shape
+        group = self.group_size if self.group_size > 0 else k
+        dequant = np.empty_like(weight)
+        for g in range(0, k, group):
+            w = weight[g : g + group]
+            scale = np.abs(w).max(axis=0) / bound
+            q = np.clip(np.round(w / scale), -bound, bound)
+            dequant[g : g + group] = q * scale
+        return dequant
+
+    def check(self, m):
+        with paddle.base.dygraph.guard(self.place):
+            weight = np.random.uniform(
+                -1, 1, (self.in_features, self.out_features)
+            ).astype('float32')
+            x = np.random.uniform(-1, 1, (m, self.in_features)).astype(
+                'float32'
+            )
+            bias = (
+                np.random.uniform(-1, 1, (self.out_features,)).astype(
+                    'float32'
+                )
+                if self.bias
+                else None
+            )
+            quant_weight, weight_scale = Q.weight_quantize(
+                paddle.to_tensor(weight, dtype=self.dtype),
+                algo='weight_only_' + self.weight_dtype,
+                arch=70,
+                group_size=self.group_size,
+            )
+            out = Q.weight_only_linear(
+                paddle.to_tensor(x, dtype=self.dtype),
+                quant_weight,
+                bias=(
+                    paddle.to_tensor(bias, dtype=self.dtype)
+                    if self.bias
+                    else None
+                ),
+                weight_scale=weight_scale,
+                weight_dtype=self.weight_dtype,
+                arch=70,
+                group_size=self.group_size,
+            )
+            expect = x @ self.get_weight_dequant(weight)
+            if self.bias:
+                expect = expect + bias
+            np.testing.assert_allclose(
+                out.astype('float32').numpy(),
+                expect,
+                rtol=self.rtol,
+                atol=self.atol,
+            )
+
+    def test_gemv(self):
+        for m in [1, 3, 6]:
+            self.check(m)
+
+    def test_gemm(self):
+        self.check(48)
+
+
+class WeightOnlyLinearCPUTestCaseInt4(WeightOnlyLinearCPUTestCase):
+    def config(self):
+        super().config()
+        self.weight_dtype = 'int4'
+
+
+class WeightOnlyLinearCPUTestCaseGroupWise(WeightOnlyLinearCPUTestCase):
+    def config(self):
+        super().config()
+        self.group_size = 64
+        self.bias = False
+
+
+class WeightOnlyLinearCPUTestCaseInt4GroupWise(WeightOnlyLinearCPUTestCase):
+    def config(self):
+        super().config()
+        self.weight_dtype = 'int4'
+        self.group_size = 128
+
+
+class WeightOnlyLinearCPUTestCaseBF16(WeightOnlyLinearCPUTestCase):
+    def config(self):
+        super().config()
+        self.dtype = 'bfloat16'
+        self.rtol = 5e-2
+        self.atol = 1.5e-1
+
+
+if __name__ == '__main__':
+    unittest.main()